@@ -46,6 +46,9 @@ public class CollisionDebuggerTool : ModuleRules
                 "RHI",
                 "RenderCore",
                 "UMG",
+                "ImageWrapper",
+                "Json",
+                "PhysicsCore",
 				#if WITH_EDITOR
                 "LevelEditor",
 				#endif
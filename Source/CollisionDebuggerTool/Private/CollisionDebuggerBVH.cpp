@@ -0,0 +1,349 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerBVH.h"
+
+namespace CollisionDebuggerBVH
+{
+    static const int32 NumBins = 12;
+
+    /** Position of unused children, any ray that could reach it has long hit something. */
+    static const float UnusedBound = 1.0e30f;
+
+    /** Smallest direction component, keeps the inverse finite so box tests never produce NaN. */
+    static const float MinDirection = 1.0e-20f;
+
+    struct FBinaryNode
+    {
+        FBox3f Bounds = FBox3f(ForceInit);
+        int32 Left = INDEX_NONE;
+        int32 Right = INDEX_NONE;
+        int32 First = 0;
+        int32 Count = 0;
+
+        bool IsLeaf() const { return Left == INDEX_NONE; }
+    };
+
+    static float GetArea(const FBox3f& Box)
+    {
+        if (!Box.IsValid)
+        {
+            return 0.f;
+        }
+        const FVector3f Size = Box.GetSize();
+        return 2.f * (Size.X * Size.Y + Size.Y * Size.Z + Size.Z * Size.X);
+    }
+
+    struct FBinaryBuilder
+    {
+        TConstArrayView<FBox3f> ItemBounds;
+        TArray<FVector3f> Centers;
+        TArray<int32>& Order;
+        TArray<FBinaryNode> Nodes;
+
+        FBinaryBuilder(TConstArrayView<FBox3f> InItemBounds, TArray<int32>& InOrder)
+            : ItemBounds(InItemBounds)
+            , Order(InOrder)
+        {
+            Centers.SetNumUninitialized(ItemBounds.Num());
+            for (int32 i = 0; i < ItemBounds.Num(); i++)
+            {
+                Centers[i] = ItemBounds[i].GetCenter();
+            }
+        }
+
+        int32 GetBin(int32 Item, int32 Axis, float Min, float Scale) const
+        {
+            return FMath::Clamp(int32((Centers[Item][Axis] - Min) * Scale), 0, NumBins - 1);
+        }
+
+        int32 Build(int32 First, int32 Count)
+        {
+            const int32 NodeIndex = Nodes.AddDefaulted();
+            FBox3f Bounds(ForceInit);
+            FBox3f CenterBounds(ForceInit);
+            for (int32 i = First; i < First + Count; i++)
+            {
+                Bounds += ItemBounds[Order[i]];
+                CenterBounds += Centers[Order[i]];
+            }
+            Nodes[NodeIndex].Bounds = Bounds;
+            Nodes[NodeIndex].First = First;
+            Nodes[NodeIndex].Count = Count;
+
+            if (Count <= FCollisionDebuggerBVH::MaxLeafItems)
+            {
+                return NodeIndex;
+            }
+
+            // Binned SAH, the split with the least area weighted item count on both sides wins.
+            int32 BestAxis = INDEX_NONE;
+            int32 BestBin = 0;
+            float BestCost = MAX_flt;
+            for (int32 Axis = 0; Axis < 3; Axis++)
+            {
+                const float Extent = CenterBounds.Max[Axis] - CenterBounds.Min[Axis];
+                if (Extent <= 0.f)
+                {
+                    continue;
+                }
+                const float Scale = NumBins / Extent;
+
+                FBox3f BinBounds[NumBins];
+                int32 BinCounts[NumBins] = {};
+                for (FBox3f& Bin : BinBounds)
+                {
+                    Bin.Init();
+                }
+                for (int32 i = First; i < First + Count; i++)
+                {
+                    const int32 Bin = GetBin(Order[i], Axis, CenterBounds.Min[Axis], Scale);
+                    BinBounds[Bin] += ItemBounds[Order[i]];
+                    BinCounts[Bin]++;
+                }
+
+                float LeftCost[NumBins - 1];
+                FBox3f Accumulated(ForceInit);
+                int32 AccumulatedCount = 0;
+                for (int32 Bin = 0; Bin < NumBins - 1; Bin++)
+                {
+                    Accumulated += BinBounds[Bin];
+                    AccumulatedCount += BinCounts[Bin];
+                    LeftCost[Bin] = GetArea(Accumulated) * AccumulatedCount;
+                }
+
+                Accumulated.Init();
+                AccumulatedCount = 0;
+                for (int32 Bin = NumBins - 1; Bin > 0; Bin--)
+                {
+                    Accumulated += BinBounds[Bin];
+                    AccumulatedCount += BinCounts[Bin];
+                    const float Cost = LeftCost[Bin - 1] + GetArea(Accumulated) * AccumulatedCount;
+                    if (Cost < BestCost)
+                    {
+                        BestCost = Cost;
+                        BestAxis = Axis;
+                        BestBin = Bin - 1;
+                    }
+                }
+            }
+
+            int32 Middle = First;
+            if (BestAxis != INDEX_NONE)
+            {
+                const float Scale = NumBins / (CenterBounds.Max[BestAxis] - CenterBounds.Min[BestAxis]);
+                for (int32 i = First; i < First + Count; i++)
+                {
+                    if (GetBin(Order[i], BestAxis, CenterBounds.Min[BestAxis], Scale) <= BestBin)
+                    {
+                        Swap(Order[i], Order[Middle++]);
+                    }
+                }
+            }
+
+            // Items on top of each other can't be told apart, halving them still bounds the depth.
+            if (Middle == First || Middle == First + Count)
+            {
+                Middle = First + Count / 2;
+            }
+
+            const int32 Left = Build(First, Middle - First);
+            const int32 Right = Build(Middle, First + Count - Middle);
+            Nodes[NodeIndex].Left = Left;
+            Nodes[NodeIndex].Right = Right;
+            return NodeIndex;
+        }
+    };
+}
+
+void FCollisionDebuggerBVHNode::SetBounds(int32 Slot, const FBox3f& Bounds)
+{
+    using namespace CollisionDebuggerBVH;
+
+    const FVector3f Min = Bounds.IsValid ? Bounds.Min : FVector3f(UnusedBound);
+    const FVector3f Max = Bounds.IsValid ? Bounds.Max : FVector3f(UnusedBound);
+    MinX[Slot] = Min.X;
+    MinY[Slot] = Min.Y;
+    MinZ[Slot] = Min.Z;
+    MaxX[Slot] = Max.X;
+    MaxY[Slot] = Max.Y;
+    MaxZ[Slot] = Max.Z;
+}
+
+FBox3f FCollisionDebuggerBVHNode::GetBounds(int32 Slot) const
+{
+    if (Count[Slot] == 0 && Child[Slot] == INDEX_NONE)
+    {
+        return FBox3f(ForceInit);
+    }
+    return FBox3f(FVector3f(MinX[Slot], MinY[Slot], MinZ[Slot]), FVector3f(MaxX[Slot], MaxY[Slot], MaxZ[Slot]));
+}
+
+FCollisionDebuggerBVHRay::FCollisionDebuggerBVHRay(const FVector3f& InOrigin, const FVector3f& InDirection)
+    : Origin(InOrigin)
+    , Direction(InDirection)
+{
+    using namespace CollisionDebuggerBVH;
+
+    auto SafeInverse = [](float Value)
+    {
+        return 1.f / (FMath::Abs(Value) > MinDirection ? Value : (Value < 0.f ? -MinDirection : MinDirection));
+    };
+
+    OriginX = VectorSetFloat1(Origin.X);
+    OriginY = VectorSetFloat1(Origin.Y);
+    OriginZ = VectorSetFloat1(Origin.Z);
+    InvDirX = VectorSetFloat1(SafeInverse(Direction.X));
+    InvDirY = VectorSetFloat1(SafeInverse(Direction.Y));
+    InvDirZ = VectorSetFloat1(SafeInverse(Direction.Z));
+}
+
+void FCollisionDebuggerBVH::Reset()
+{
+    Nodes.Reset();
+    ItemOrder.Reset();
+    Bounds.Init();
+}
+
+void FCollisionDebuggerBVH::Build(TConstArrayView<FBox3f> ItemBounds)
+{
+    using namespace CollisionDebuggerBVH;
+
+    Reset();
+    if (ItemBounds.Num() == 0)
+    {
+        return;
+    }
+
+    ItemOrder.SetNumUninitialized(ItemBounds.Num());
+    for (int32 i = 0; i < ItemOrder.Num(); i++)
+    {
+        ItemOrder[i] = i;
+    }
+
+    FBinaryBuilder Builder(ItemBounds, ItemOrder);
+    Builder.Build(0, ItemBounds.Num());
+    const TArray<FBinaryNode>& Binary = Builder.Nodes;
+    Bounds = Binary[0].Bounds;
+
+    // Every wide node takes the two children of a binary node, then keeps opening its largest
+    // inner child until it holds four. Children are added after their parent, Refit relies on it.
+    Nodes.Reserve(Binary.Num() / 2 + 1);
+    TFunction<int32(int32)> Collapse = [&](int32 BinaryIndex) -> int32
+    {
+        TArray<int32, TInlineAllocator<4>> Children;
+        if (Binary[BinaryIndex].IsLeaf())
+        {
+            Children.Add(BinaryIndex);
+        }
+        else
+        {
+            Children.Add(Binary[BinaryIndex].Left);
+            Children.Add(Binary[BinaryIndex].Right);
+        }
+
+        while (Children.Num() < 4)
+        {
+            int32 Largest = INDEX_NONE;
+            float LargestArea = -1.f;
+            for (int32 i = 0; i < Children.Num(); i++)
+            {
+                const FBinaryNode& Child = Binary[Children[i]];
+                if (!Child.IsLeaf() && GetArea(Child.Bounds) > LargestArea)
+                {
+                    Largest = i;
+                    LargestArea = GetArea(Child.Bounds);
+                }
+            }
+            if (Largest == INDEX_NONE)
+            {
+                break;
+            }
+
+            const FBinaryNode& Opened = Binary[Children[Largest]];
+            Children[Largest] = Opened.Left;
+            Children.Add(Opened.Right);
+        }
+
+        const int32 NodeIndex = Nodes.AddUninitialized();
+        for (int32 Slot = 0; Slot < 4; Slot++)
+        {
+            Nodes[NodeIndex].Child[Slot] = INDEX_NONE;
+            Nodes[NodeIndex].Count[Slot] = 0;
+            Nodes[NodeIndex].SetBounds(Slot, FBox3f(ForceInit));
+        }
+
+        for (int32 Slot = 0; Slot < Children.Num(); Slot++)
+        {
+            const FBinaryNode& Child = Binary[Children[Slot]];
+            int32 ChildIndex = ~Child.First;
+            if (!Child.IsLeaf())
+            {
+                ChildIndex = Collapse(Children[Slot]);
+            }
+
+            FCollisionDebuggerBVHNode& Node = Nodes[NodeIndex];
+            Node.Child[Slot] = ChildIndex;
+            Node.Count[Slot] = Child.IsLeaf() ? Child.Count : 0;
+            Node.SetBounds(Slot, Child.Bounds);
+        }
+        return NodeIndex;
+    };
+    Collapse(0);
+}
+
+void FCollisionDebuggerBVH::Refit(TConstArrayView<FBox3f> ItemBounds)
+{
+    check(ItemBounds.Num() == ItemOrder.Num());
+
+    Bounds.Init();
+    for (int32 NodeIndex = Nodes.Num() - 1; NodeIndex >= 0; NodeIndex--)
+    {
+        FCollisionDebuggerBVHNode& Node = Nodes[NodeIndex];
+        for (int32 Slot = 0; Slot < 4; Slot++)
+        {
+            const int32 Child = Node.Child[Slot];
+            FBox3f SlotBounds(ForceInit);
+            if (FCollisionDebuggerBVHNode::IsLeaf(Child) && Node.Count[Slot] > 0)
+            {
+                for (int32 i = ~Child; i < ~Child + Node.Count[Slot]; i++)
+                {
+                    SlotBounds += ItemBounds[ItemOrder[i]];
+                }
+            }
+            else if (!FCollisionDebuggerBVHNode::IsLeaf(Child))
+            {
+                for (int32 ChildSlot = 0; ChildSlot < 4; ChildSlot++)
+                {
+                    SlotBounds += Nodes[Child].GetBounds(ChildSlot);
+                }
+            }
+            else
+            {
+                continue;
+            }
+
+            Node.SetBounds(Slot, SlotBounds);
+            if (NodeIndex == 0)
+            {
+                Bounds += SlotBounds;
+            }
+        }
+    }
+}
+
+int32 FCollisionDebuggerBVH::IntersectNode(const FCollisionDebuggerBVHNode& Node, const FCollisionDebuggerBVHRay& Ray, float MaxTime, float OutEntry[4])
+{
+    const VectorRegister4Float T0X = VectorMultiply(VectorSubtract(VectorLoadAligned(Node.MinX), Ray.OriginX), Ray.InvDirX);
+    const VectorRegister4Float T1X = VectorMultiply(VectorSubtract(VectorLoadAligned(Node.MaxX), Ray.OriginX), Ray.InvDirX);
+    const VectorRegister4Float T0Y = VectorMultiply(VectorSubtract(VectorLoadAligned(Node.MinY), Ray.OriginY), Ray.InvDirY);
+    const VectorRegister4Float T1Y = VectorMultiply(VectorSubtract(VectorLoadAligned(Node.MaxY), Ray.OriginY), Ray.InvDirY);
+    const VectorRegister4Float T0Z = VectorMultiply(VectorSubtract(VectorLoadAligned(Node.MinZ), Ray.OriginZ), Ray.InvDirZ);
+    const VectorRegister4Float T1Z = VectorMultiply(VectorSubtract(VectorLoadAligned(Node.MaxZ), Ray.OriginZ), Ray.InvDirZ);
+
+    const VectorRegister4Float Near = VectorMax(VectorMax(VectorMin(T0X, T1X), VectorMin(T0Y, T1Y)), VectorMax(VectorMin(T0Z, T1Z), VectorZeroFloat()));
+    const VectorRegister4Float Far = VectorMin(VectorMin(VectorMax(T0X, T1X), VectorMax(T0Y, T1Y)), VectorMin(VectorMax(T0Z, T1Z), VectorSetFloat1(MaxTime)));
+
+    VectorStoreAligned(Near, OutEntry);
+    return VectorMaskBits(VectorCompareLE(Near, Far));
+}
@@ -0,0 +1,277 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerBenchmarkCommandlet.h"
+#include "CollisionDebuggerCaptureCommandlet.h"
+#include "CollisionDebuggerSubsystem.h"
+#include "CollisionDebuggerTraceEngine.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerStart.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMisc.h"
+#include "Misc/DateTime.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonWriter.h"
+
+namespace CollisionDebuggerBenchmarkCommandlet
+{
+    static const TCHAR* const DefaultMap = TEXT("/CollisionDebuggerTool/ExampleLevel");
+    static const FIntPoint DefaultSize = FIntPoint(512, 512);
+
+    struct FBenchmarkTest
+    {
+        FString Name;
+        FInputRenderSettingsInternal Settings;
+    };
+
+    struct FRunResult
+    {
+        double RefreshMs = 0.0;
+        double MeanTileMs = 0.0;
+        double P95TileMs = 0.0;
+        int32 NumTiles = 0;
+    };
+
+    static TArray<int32> ParseIntList(const TMap<FString, FString>& ParamValues, const TCHAR* Key, const TArray<int32>& Default)
+    {
+        const FString* Value = ParamValues.Find(Key);
+        if (!Value)
+        {
+            return Default;
+        }
+
+        TArray<FString> Entries;
+        Value->ParseIntoArray(Entries, TEXT("+"));
+
+        TArray<int32> Result;
+        for (const FString& Entry : Entries)
+        {
+            Result.Add(FCString::Atoi(*Entry));
+        }
+        return Result;
+    }
+
+    /** One full refresh of the view, fed to the engine the way the subsystem feeds it. */
+    static FRunResult TraceOnce(UWorld* World, const FTransform& Camera, const FInputRenderSettingsInternal& Settings, FCollisionDebuggerHitBuffer& Pixels, int32 TileSize)
+    {
+        FCollisionDebuggerTraceEngine TraceEngine;
+        TraceEngine.SetTarget(World, &Pixels);
+
+        const FIntPoint Size = Pixels.GetSize();
+        TArray<FIntRect> Tiles;
+        for (int32 TileY = 0; TileY < Size.Y; TileY += TileSize)
+        {
+            for (int32 TileX = 0; TileX < Size.X; TileX += TileSize)
+            {
+                FIntRect& Rect = Tiles.Add_GetRef(FIntRect(TileX, TileY, TileX + TileSize, TileY + TileSize));
+                Rect.Clip(FIntRect(FIntPoint::ZeroValue, Size));
+            }
+        }
+
+        TArray<double> TileMs;
+        TileMs.SetNumZeroed(Tiles.Num());
+
+        const double StartTime = FPlatformTime::Seconds();
+        int32 NextTile = 0;
+        while (NextTile < Tiles.Num() || !TraceEngine.IsIdle())
+        {
+            while (NextTile < Tiles.Num() && TraceEngine.CanAcceptTile())
+            {
+                FCollisionDebuggerTile Tile;
+                Tile.Rect = Tiles[NextTile];
+                Tile.Camera = Camera;
+                Tile.Settings = Settings;
+
+                const int32 TileIndex = NextTile++;
+                const double SubmitTime = FPlatformTime::Seconds();
+                TraceEngine.SubmitTile(Tile, [&TileMs, TileIndex, SubmitTime](const FCollisionDebuggerTile& TracedTile)
+                {
+                    TileMs[TileIndex] = (FPlatformTime::Seconds() - SubmitTime) * 1000.0;
+                });
+            }
+            FPlatformProcess::YieldThread();
+        }
+
+        FRunResult Result;
+        Result.RefreshMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+        TraceEngine.Wait();
+
+        TileMs.Sort();
+        Result.NumTiles = TileMs.Num();
+        for (double Ms : TileMs)
+        {
+            Result.MeanTileMs += Ms / FMath::Max(TileMs.Num(), 1);
+        }
+        Result.P95TileMs = TileMs.Num() > 0 ? TileMs[FMath::Min(TileMs.Num() - 1, int32(TileMs.Num() * .95))] : 0.0;
+        return Result;
+    }
+}
+
+UCollisionDebuggerBenchmarkCommandlet::UCollisionDebuggerBenchmarkCommandlet()
+{
+    IsClient = false;
+    IsServer = false;
+    IsEditor = true;
+    LogToConsole = true;
+
+    HelpDescription = TEXT("Measures collision debugger trace throughput and writes the results as JSON.");
+    HelpUsage = TEXT("-run=CollisionDebuggerBenchmark [-Map=<map>[+<map>]] [-Size=<x>x<y>] [-TileSizes=<n>[+<n>]] [-Workers=<n>[+<n>]] [-Channel=<name>] [-Profile=<name>] [-Iterations=<n>] [-Output=<file>]");
+}
+
+int32 UCollisionDebuggerBenchmarkCommandlet::Main(const FString& Params)
+{
+    using namespace CollisionDebuggerBenchmarkCommandlet;
+
+    TArray<FString> Tokens;
+    TArray<FString> Switches;
+    TMap<FString, FString> ParamValues;
+    ParseCommandLine(*Params, Tokens, Switches, ParamValues);
+
+    TArray<FString> Maps;
+    const FString* MapParam = ParamValues.Find(TEXT("Map"));
+    (MapParam ? *MapParam : FString(DefaultMap)).ParseIntoArray(Maps, TEXT("+"));
+
+    FIntPoint Size = DefaultSize;
+    if (const FString* SizeParam = ParamValues.Find(TEXT("Size")))
+    {
+        FString SizeX;
+        FString SizeY;
+        Size = SizeParam->Split(TEXT("x"), &SizeX, &SizeY)
+            ? FIntPoint(FCString::Atoi(*SizeX), FCString::Atoi(*SizeY))
+            : FIntPoint(FCString::Atoi(**SizeParam));
+    }
+    if (Size.X <= 0 || Size.Y <= 0)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Invalid benchmark size"));
+        return 1;
+    }
+
+    const TArray<int32> TileSizes = ParseIntList(ParamValues, TEXT("TileSizes"), { 32, 64, 128, 256 });
+    const TArray<int32> WorkerCounts = ParseIntList(ParamValues, TEXT("Workers"), { 1, 2, 4, 0 });
+    const FString* IterationsParam = ParamValues.Find(TEXT("Iterations"));
+    const int32 NumIterations = FMath::Max(IterationsParam ? FCString::Atoi(**IterationsParam) : 3, 1);
+
+    // Channel against profile, each with simple and complex collision.
+    const FString* ChannelParam = ParamValues.Find(TEXT("Channel"));
+    const FString* ProfileParam = ParamValues.Find(TEXT("Profile"));
+    TArray<FBenchmarkTest> Tests;
+    for (int32 TraceComplex = 0; TraceComplex <= 1; TraceComplex++)
+    {
+        for (int32 IsChannel = 1; IsChannel >= 0; IsChannel--)
+        {
+            FInputRenderSettings Input;
+            Input.IsChannelTest = IsChannel > 0;
+            Input.ChannelName = ChannelParam ? *ChannelParam : TEXT("Visibility");
+            Input.ProfileName = ProfileParam ? *ProfileParam : TEXT("BlockAll");
+            Input.TraceComplex = TraceComplex > 0;
+            Tests.Add({ IsChannel ? Input.ChannelName : Input.ProfileName, UCollisionDebuggerSubsystem::ResolveRenderSettings(Input) });
+        }
+    }
+
+    IConsoleVariable* MaxWorkersVar = IConsoleManager::Get().FindConsoleVariable(TEXT("CollisionDebug.MaxWorkers"));
+    const int32 PreviousMaxWorkers = MaxWorkersVar ? MaxWorkersVar->GetInt() : 0;
+
+    FString Json;
+    TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+    Writer->WriteObjectStart();
+    Writer->WriteValue(TEXT("timestamp"), FDateTime::UtcNow().ToIso8601());
+    Writer->WriteValue(TEXT("engineVersion"), FEngineVersion::Current().ToString());
+    Writer->WriteValue(TEXT("cpu"), FPlatformMisc::GetCPUBrand().TrimStartAndEnd());
+    Writer->WriteValue(TEXT("logicalCores"), FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+    Writer->WriteValue(TEXT("width"), Size.X);
+    Writer->WriteValue(TEXT("height"), Size.Y);
+    Writer->WriteValue(TEXT("tilesInFlight"), FCollisionDebuggerTraceEngine::GetMaxTilesInFlight());
+    Writer->WriteValue(TEXT("iterations"), NumIterations);
+    Writer->WriteArrayStart(TEXT("results"));
+
+    int32 NumFailed = 0;
+    for (const FString& Map : Maps)
+    {
+        UWorld* World = UCollisionDebuggerCaptureCommandlet::LoadWorld(Map);
+        if (!World)
+        {
+            NumFailed++;
+            continue;
+        }
+
+        FTransform Camera = FTransform::Identity;
+        for (TActorIterator<APlayerStart> It(World); It; ++It)
+        {
+            Camera = It->GetActorTransform();
+            break;
+        }
+
+        FCollisionDebuggerHitBuffer Pixels;
+        Pixels.Init(Size, ECollisionDebuggerHitFormat::Float32);
+
+        // Warms up the physics scene and the task workers before anything is measured.
+        TraceOnce(World, Camera, Tests[0].Settings, Pixels, TileSizes.Num() > 0 ? FMath::Max(TileSizes[0], 1) : 64);
+
+        for (const FBenchmarkTest& Test : Tests)
+        {
+            for (int32 TileSize : TileSizes)
+            {
+                for (int32 Workers : WorkerCounts)
+                {
+                    if (MaxWorkersVar)
+                    {
+                        MaxWorkersVar->Set(Workers, ECVF_SetByCode);
+                    }
+
+                    TArray<FRunResult> Runs;
+                    for (int32 Iteration = 0; Iteration < NumIterations; Iteration++)
+                    {
+                        Runs.Add(TraceOnce(World, Camera, Test.Settings, Pixels, FMath::Max(TileSize, 1)));
+                    }
+                    Runs.Sort([](const FRunResult& A, const FRunResult& B) { return A.RefreshMs < B.RefreshMs; });
+                    const FRunResult& Median = Runs[Runs.Num() / 2];
+                    const double RaysPerSecond = Pixels.Num() / FMath::Max(Median.RefreshMs / 1000.0, UE_DOUBLE_SMALL_NUMBER);
+
+                    Writer->WriteObjectStart();
+                    Writer->WriteValue(TEXT("map"), Map);
+                    Writer->WriteValue(TEXT("test"), FString(Test.Settings.bIsChannelTest ? TEXT("Channel") : TEXT("Profile")));
+                    Writer->WriteValue(TEXT("name"), Test.Name);
+                    Writer->WriteValue(TEXT("traceComplex"), Test.Settings.TraceComplex);
+                    Writer->WriteValue(TEXT("tileSize"), TileSize);
+                    Writer->WriteValue(TEXT("workers"), FCollisionDebuggerTraceEngine::GetMaxWorkers());
+                    Writer->WriteValue(TEXT("raysPerSecond"), RaysPerSecond);
+                    Writer->WriteValue(TEXT("refreshMs"), Median.RefreshMs);
+                    Writer->WriteValue(TEXT("msPerTileMean"), Median.MeanTileMs);
+                    Writer->WriteValue(TEXT("msPerTileP95"), Median.P95TileMs);
+                    Writer->WriteValue(TEXT("tiles"), Median.NumTiles);
+                    Writer->WriteObjectEnd();
+
+                    UE_LOG(LogTemp, Display, TEXT("%s %s %s complex=%d tile=%d workers=%d: %.0f rays/s, %.2f ms refresh, %.3f ms/tile"),
+                        *Map, Test.Settings.bIsChannelTest ? TEXT("Channel") : TEXT("Profile"), *Test.Name, Test.Settings.TraceComplex ? 1 : 0,
+                        TileSize, FCollisionDebuggerTraceEngine::GetMaxWorkers(), RaysPerSecond, Median.RefreshMs, Median.MeanTileMs);
+                }
+            }
+        }
+
+        UCollisionDebuggerCaptureCommandlet::UnloadWorld(World);
+    }
+
+    if (MaxWorkersVar)
+    {
+        MaxWorkersVar->Set(PreviousMaxWorkers, ECVF_SetByCode);
+    }
+
+    Writer->WriteArrayEnd();
+    Writer->WriteObjectEnd();
+    Writer->Close();
+
+    const FString* OutputParam = ParamValues.Find(TEXT("Output"));
+    const FString OutputPath = OutputParam ? *OutputParam
+        : FPaths::ProjectSavedDir() / TEXT("CollisionBenchmark") / FString::Printf(TEXT("CollisionBenchmark-%s.json"), *FDateTime::Now().ToString());
+    if (!FFileHelper::SaveStringToFile(Json, *OutputPath))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Could not write %s"), *OutputPath);
+        return 1;
+    }
+
+    UE_LOG(LogTemp, Display, TEXT("Benchmark results written to %s"), *OutputPath);
+    return NumFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerCapture.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/Archive.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Modules/ModuleManager.h"
+#include "Async/ParallelFor.h"
+
+namespace CollisionDebuggerCapture
+{
+    static const uint32 Magic = 0x50434443; // "CDCP"
+    static const int32 Version = 1;
+}
+
+const TCHAR* const FCollisionDebuggerCapture::FileExtension = TEXT(".cdcap");
+
+void FCollisionDebuggerCapture::ComputeTileHashes(int32 InTileSize)
+{
+    TileSize = FMath::Max(InTileSize, 1);
+
+    const FIntPoint NumTiles = GetNumTiles();
+    TileHashes.SetNumUninitialized(NumTiles.X * NumTiles.Y);
+    ParallelFor(TileHashes.Num(), [this](int32 TileIndex)
+    {
+        TileHashes[TileIndex] = Pixels.HashRect(GetTileRect(TileIndex));
+    });
+}
+
+FIntPoint FCollisionDebuggerCapture::GetNumTiles() const
+{
+    const FIntPoint Size = Pixels.GetSize();
+    return FIntPoint(FMath::DivideAndRoundUp(Size.X, TileSize), FMath::DivideAndRoundUp(Size.Y, TileSize));
+}
+
+FIntRect FCollisionDebuggerCapture::GetTileRect(int32 TileIndex) const
+{
+    const int32 NumTilesX = GetNumTiles().X;
+    const FIntPoint Min = FIntPoint(TileIndex % NumTilesX, TileIndex / NumTilesX) * TileSize;
+    FIntRect Rect(Min, Min + FIntPoint(TileSize));
+    Rect.Clip(FIntRect(FIntPoint::ZeroValue, Pixels.GetSize()));
+    return Rect;
+}
+
+bool FCollisionDebuggerCapture::SaveToFile(const FString& Path) const
+{
+    TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Path));
+    if (!Writer)
+    {
+        return false;
+    }
+
+    uint32 Magic = CollisionDebuggerCapture::Magic;
+    int32 Version = CollisionDebuggerCapture::Version;
+    FString Name = MapName;
+    FTransform CameraTransform = Camera;
+    bool IsChannelTest = Settings.bIsChannelTest;
+    uint8 Channel = Settings.ChannelToTest;
+    FString Profile = Settings.ProfileNameToTest.ToString();
+    bool TraceComplex = Settings.TraceComplex;
+    uint8 Format = uint8(Pixels.GetFormat());
+    FIntPoint Size = Pixels.GetSize();
+    int32 HashTileSize = TileSize;
+    TArray<uint32> Hashes = TileHashes;
+
+    *Writer << Magic << Version << Name << CameraTransform;
+    *Writer << IsChannelTest << Channel << Profile << TraceComplex;
+    *Writer << Format << Size << HashTileSize << Hashes;
+    Writer->Serialize(const_cast<uint8*>(Pixels.GetData()), int64(Pixels.Num()) * Pixels.GetBytesPerPixel());
+
+    return Writer->Close();
+}
+
+bool FCollisionDebuggerCapture::LoadFromFile(const FString& Path)
+{
+    TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Path));
+    if (!Reader)
+    {
+        return false;
+    }
+
+    uint32 Magic = 0;
+    int32 Version = 0;
+    *Reader << Magic << Version;
+    if (Magic != CollisionDebuggerCapture::Magic || Version != CollisionDebuggerCapture::Version)
+    {
+        UE_LOG(LogTemp, Error, TEXT("%s is not a collision debugger capture"), *Path);
+        return false;
+    }
+
+    bool IsChannelTest = true;
+    uint8 Channel = 0;
+    FString Profile;
+    bool TraceComplex = false;
+    uint8 Format = 0;
+    FIntPoint Size = FIntPoint::ZeroValue;
+
+    *Reader << MapName << Camera;
+    *Reader << IsChannelTest << Channel << Profile << TraceComplex;
+    *Reader << Format << Size << TileSize << TileHashes;
+
+    Settings.bIsChannelTest = IsChannelTest;
+    Settings.ChannelToTest = ECollisionChannel(Channel);
+    Settings.ProfileNameToTest = FName(Profile);
+    Settings.TraceComplex = TraceComplex;
+
+    if (Reader->IsError() || Size.X <= 0 || Size.Y <= 0 || Format > uint8(ECollisionDebuggerHitFormat::Packed64))
+    {
+        return false;
+    }
+
+    Pixels.Init(Size, ECollisionDebuggerHitFormat(Format));
+    Reader->Serialize(Pixels.GetData(), int64(Pixels.Num()) * Pixels.GetBytesPerPixel());
+    return !Reader->IsError() && Reader->Close();
+}
+
+bool FCollisionDebuggerCapture::SaveToExr(const FString& Path) const
+{
+    IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+    TSharedPtr<IImageWrapper> Exr = ImageWrapperModule.CreateImageWrapper(EImageFormat::EXR);
+    if (!Exr.IsValid())
+    {
+        return false;
+    }
+
+    const FIntPoint Size = Pixels.GetSize();
+    TArray<FLinearColor> Decoded;
+    Decoded.SetNumUninitialized(Pixels.Num());
+    ParallelFor(Size.Y, [this, &Decoded, Size](int32 y)
+    {
+        Pixels.DecodeRange(y * Size.X, Size.X, Decoded.GetData() + y * Size.X);
+    });
+
+    if (!Exr->SetRaw(Decoded.GetData(), Decoded.Num() * sizeof(FLinearColor), Size.X, Size.Y, ERGBFormat::RGBAF, 32))
+    {
+        return false;
+    }
+    return FFileHelper::SaveArrayToFile(Exr->GetCompressed(), *Path);
+}
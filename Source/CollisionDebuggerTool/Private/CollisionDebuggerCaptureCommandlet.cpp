@@ -0,0 +1,292 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerCaptureCommandlet.h"
+#include "CollisionDebuggerCapture.h"
+#include "CollisionDebuggerTraceEngine.h"
+#include "CollisionDebuggerSubsystem.h"
+#include "Engine/Engine.h"
+#include "Engine/LevelStreaming.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerStart.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "UObject/Package.h"
+
+namespace CollisionDebuggerCaptureCommandlet
+{
+    static const int32 TileSize = 64;
+    static const FIntPoint DefaultSize = FIntPoint(1024, 1024);
+}
+
+UCollisionDebuggerCaptureCommandlet::UCollisionDebuggerCaptureCommandlet()
+{
+    IsClient = false;
+    IsServer = false;
+    IsEditor = true;
+    LogToConsole = true;
+
+    HelpDescription = TEXT("Traces collision snapshots of maps to .cdcap or .exr files.");
+    HelpUsage = TEXT("-run=CollisionDebuggerCapture -Map=<map>[+<map>] [-Cameras=<file>] [-Channel=<name>[+<name>]] [-Profile=<name>[+<name>]] [-TraceComplex] [-Size=<x>x<y>] [-HitFormat=<0-2>] [-Output=<dir>] [-Exr] [-NoBinary]");
+}
+
+UWorld* UCollisionDebuggerCaptureCommandlet::LoadWorld(const FString& MapName)
+{
+    UPackage* Package = LoadPackage(nullptr, *MapName, LOAD_None);
+    UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+    if (!World)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Could not load map %s"), *MapName);
+        return nullptr;
+    }
+
+    World->AddToRoot();
+    World->WorldType = EWorldType::Editor;
+
+    FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Editor);
+    WorldContext.SetCurrentWorld(World);
+
+    if (!World->bIsWorldInitialized)
+    {
+        UWorld::InitializationValues IVS;
+        IVS.InitializeScenes(false)
+            .AllowAudioPlayback(false)
+            .RequiresHitProxies(false)
+            .CreatePhysicsScene(true)
+            .CreateNavigation(false)
+            .CreateAISystem(false)
+            .ShouldSimulatePhysics(false)
+            .EnableTraceCollision(true)
+            .SetTransactional(false)
+            .CreateFXSystem(false);
+        World->InitWorld(IVS);
+    }
+    World->UpdateWorldComponents(true, false);
+
+    // Streamed sublevels are part of what a player collides with.
+    for (ULevelStreaming* StreamingLevel : World->GetStreamingLevels())
+    {
+        if (StreamingLevel)
+        {
+            StreamingLevel->SetShouldBeLoaded(true);
+            StreamingLevel->SetShouldBeVisible(true);
+        }
+    }
+    World->FlushLevelStreaming(EFlushLevelStreamingType::Full);
+
+    // One tick lets the physics scene publish the new bodies to scene queries.
+    World->Tick(LEVELTICK_ViewportsOnly, 1.f / 60.f);
+    return World;
+}
+
+void UCollisionDebuggerCaptureCommandlet::UnloadWorld(UWorld* World)
+{
+    if (!World)
+    {
+        return;
+    }
+
+    GEngine->DestroyWorldContext(World);
+    World->DestroyWorld(false);
+    World->RemoveFromRoot();
+    CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+}
+
+void UCollisionDebuggerCaptureCommandlet::TraceView(UWorld* World, const FTransform& Camera, const FInputRenderSettingsInternal& Settings, FCollisionDebuggerHitBuffer& OutPixels, int32 TileSize)
+{
+    FCollisionDebuggerTraceEngine TraceEngine;
+    TraceEngine.SetTarget(World, &OutPixels);
+
+    // Nothing waits on a capture, so every tile goes in at once and all workers stay busy.
+    const FIntPoint Size = OutPixels.GetSize();
+    for (int32 TileY = 0; TileY < Size.Y; TileY += TileSize)
+    {
+        for (int32 TileX = 0; TileX < Size.X; TileX += TileSize)
+        {
+            FCollisionDebuggerTile Tile;
+            Tile.Rect = FIntRect(TileX, TileY, TileX + TileSize, TileY + TileSize);
+            Tile.Camera = Camera;
+            Tile.Settings = Settings;
+            TraceEngine.SubmitTile(Tile, nullptr);
+        }
+    }
+    TraceEngine.Wait();
+}
+
+bool UCollisionDebuggerCaptureCommandlet::ParseCameras(const FString& Path, TArray<FTransform>& OutCameras)
+{
+    TArray<FString> Lines;
+    if (!FFileHelper::LoadFileToStringArray(Lines, *Path))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Could not read camera file %s"), *Path);
+        return false;
+    }
+
+    for (int32 LineIndex = 0; LineIndex < Lines.Num(); LineIndex++)
+    {
+        const FString Line = Lines[LineIndex].TrimStartAndEnd().Replace(TEXT(","), TEXT(" "));
+        if (Line.IsEmpty() || Line.StartsWith(TEXT("#")))
+        {
+            continue;
+        }
+
+        TArray<FString> Values;
+        Line.ParseIntoArrayWS(Values);
+        if (Values.Num() < 6)
+        {
+            UE_LOG(LogTemp, Warning, TEXT("%s:%d expected X Y Z Pitch Yaw Roll"), *Path, LineIndex + 1);
+            continue;
+        }
+
+        const FVector Location(FCString::Atod(*Values[0]), FCString::Atod(*Values[1]), FCString::Atod(*Values[2]));
+        const FRotator Rotation(FCString::Atod(*Values[3]), FCString::Atod(*Values[4]), FCString::Atod(*Values[5]));
+        OutCameras.Add(FTransform(Rotation, Location));
+    }
+    return true;
+}
+
+void UCollisionDebuggerCaptureCommandlet::GatherPlayerStarts(UWorld* World, TArray<FTransform>& OutCameras)
+{
+    for (TActorIterator<APlayerStart> It(World); It; ++It)
+    {
+        OutCameras.Add(It->GetActorTransform());
+    }
+}
+
+int32 UCollisionDebuggerCaptureCommandlet::Main(const FString& Params)
+{
+    using namespace CollisionDebuggerCaptureCommandlet;
+
+    TArray<FString> Tokens;
+    TArray<FString> Switches;
+    TMap<FString, FString> ParamValues;
+    ParseCommandLine(*Params, Tokens, Switches, ParamValues);
+
+    const FString* MapParam = ParamValues.Find(TEXT("Map"));
+    if (!MapParam)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Usage: %s"), *HelpUsage);
+        return 1;
+    }
+
+    TArray<FString> Maps;
+    MapParam->ParseIntoArray(Maps, TEXT("+"));
+
+    // Every camera is captured once per requested channel and profile.
+    const bool TraceComplex = Switches.Contains(TEXT("TraceComplex"));
+    TArray<FCaptureTest> Tests;
+    for (int32 IsChannel = 1; IsChannel >= 0; IsChannel--)
+    {
+        const FString* NamesParam = ParamValues.Find(IsChannel ? TEXT("Channel") : TEXT("Profile"));
+        TArray<FString> Names;
+        if (NamesParam)
+        {
+            NamesParam->ParseIntoArray(Names, TEXT("+"));
+        }
+
+        for (const FString& Name : Names)
+        {
+            FInputRenderSettings Input;
+            Input.IsChannelTest = IsChannel > 0;
+            Input.ChannelName = Name;
+            Input.ProfileName = Name;
+            Input.TraceComplex = TraceComplex;
+            Tests.Add({ FString::Printf(TEXT("%s_%s"), IsChannel ? TEXT("Channel") : TEXT("Profile"), *Name), UCollisionDebuggerSubsystem::ResolveRenderSettings(Input) });
+        }
+    }
+    if (Tests.Num() == 0)
+    {
+        FInputRenderSettings Input;
+        Input.TraceComplex = TraceComplex;
+        Tests.Add({ TEXT("Channel_WorldStatic"), UCollisionDebuggerSubsystem::ResolveRenderSettings(Input) });
+    }
+
+    FIntPoint Size = DefaultSize;
+    if (const FString* SizeParam = ParamValues.Find(TEXT("Size")))
+    {
+        FString SizeX;
+        FString SizeY;
+        Size = SizeParam->Split(TEXT("x"), &SizeX, &SizeY)
+            ? FIntPoint(FCString::Atoi(*SizeX), FCString::Atoi(*SizeY))
+            : FIntPoint(FCString::Atoi(**SizeParam));
+    }
+    if (Size.X <= 0 || Size.Y <= 0)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Invalid capture size"));
+        return 1;
+    }
+
+    ECollisionDebuggerHitFormat HitFormat = ECollisionDebuggerHitFormat::Packed64;
+    if (const FString* FormatParam = ParamValues.Find(TEXT("HitFormat")))
+    {
+        HitFormat = ECollisionDebuggerHitFormat(FMath::Clamp(FCString::Atoi(**FormatParam), 0, int32(ECollisionDebuggerHitFormat::Packed64)));
+    }
+
+    const FString* OutputParam = ParamValues.Find(TEXT("Output"));
+    const FString OutputDir = OutputParam ? *OutputParam : FPaths::ProjectSavedDir() / TEXT("CollisionCaptures");
+    const FString* CamerasParam = ParamValues.Find(TEXT("Cameras"));
+    const bool WriteBinary = !Switches.Contains(TEXT("NoBinary"));
+    const bool WriteExr = Switches.Contains(TEXT("Exr"));
+
+    int32 NumFailed = 0;
+    for (const FString& Map : Maps)
+    {
+        UWorld* World = LoadWorld(Map);
+        if (!World)
+        {
+            NumFailed++;
+            continue;
+        }
+
+        TArray<FTransform> Cameras;
+        if (CamerasParam)
+        {
+            ParseCameras(*CamerasParam, Cameras);
+        }
+        else
+        {
+            GatherPlayerStarts(World, Cameras);
+        }
+
+        if (Cameras.Num() == 0)
+        {
+            UE_LOG(LogTemp, Warning, TEXT("No cameras to capture %s from"), *Map);
+        }
+
+        for (int32 CameraIndex = 0; CameraIndex < Cameras.Num(); CameraIndex++)
+        {
+            for (const FCaptureTest& Test : Tests)
+            {
+                const double StartTime = FPlatformTime::Seconds();
+
+                FCollisionDebuggerCapture Capture;
+                Capture.MapName = Map;
+                Capture.Camera = Cameras[CameraIndex];
+                Capture.Settings = Test.Settings;
+                Capture.Pixels.Init(Size, HitFormat);
+                TraceView(World, Capture.Camera, Capture.Settings, Capture.Pixels, TileSize);
+                Capture.ComputeTileHashes(TileSize);
+
+                const FString BasePath = OutputDir / FPackageName::GetShortName(Map) / FString::Printf(TEXT("%03d_%s"), CameraIndex, *Test.Name);
+                if (WriteBinary && !Capture.SaveToFile(BasePath + FCollisionDebuggerCapture::FileExtension))
+                {
+                    UE_LOG(LogTemp, Error, TEXT("Could not write %s%s"), *BasePath, FCollisionDebuggerCapture::FileExtension);
+                    NumFailed++;
+                }
+                if (WriteExr && !Capture.SaveToExr(BasePath + TEXT(".exr")))
+                {
+                    UE_LOG(LogTemp, Error, TEXT("Could not write %s.exr"), *BasePath);
+                    NumFailed++;
+                }
+
+                UE_LOG(LogTemp, Display, TEXT("Captured %s camera %d %s in %.1f ms"), *Map, CameraIndex, *Test.Name, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+            }
+        }
+
+        UnloadWorld(World);
+    }
+
+    return NumFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,268 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerCaptureDiff.h"
+#include "CollisionDebuggerTraceEngine.h"
+#include "Async/ParallelFor.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Math/VectorRegister.h"
+#include "Misc/FileHelper.h"
+#include "Modules/ModuleManager.h"
+
+#include <atomic>
+
+namespace CollisionDebuggerCaptureDiff
+{
+    static const int32 NumKinds = int32(ECollisionDebuggerDiffKind::Num);
+
+    static const TCHAR* const KindNames[NumKinds] = { TEXT("None"), TEXT("Added"), TEXT("Removed"), TEXT("Flipped"), TEXT("Moved"), TEXT("Rotated") };
+
+    static const FColor KindColors[NumKinds] =
+    {
+        FColor::Black,
+        FColor(255, 40, 40),
+        FColor(40, 120, 255),
+        FColor(255, 0, 255),
+        FColor(255, 200, 0),
+        FColor(0, 220, 120),
+    };
+
+    struct FTileChange
+    {
+        FIntPoint Min = FIntPoint(MAX_int32);
+        FIntPoint Max = FIntPoint(MIN_int32);
+        int32 NumPixels[NumKinds] = {};
+        bool Changed = false;
+    };
+
+    /** Both pixels are FLinearColor(Normal, Time) with a negative time on a miss. */
+    static ECollisionDebuggerDiffKind Classify(const VectorRegister4Float& Base, const VectorRegister4Float& Test, const VectorRegister4Float& Epsilon, float TimeTolerance, float NormalTolerance)
+    {
+        const VectorRegister4Float Delta = VectorAbs(VectorSubtract(Base, Test));
+        if (!VectorAnyGreaterThan(Delta, Epsilon))
+        {
+            return ECollisionDebuggerDiffKind::None;
+        }
+
+        const bool BaseHit = VectorGetComponent(Base, 3) >= 0.f;
+        const bool TestHit = VectorGetComponent(Test, 3) >= 0.f;
+        if (!BaseHit || !TestHit)
+        {
+            if (BaseHit == TestHit)
+            {
+                return ECollisionDebuggerDiffKind::None;
+            }
+            return TestHit ? ECollisionDebuggerDiffKind::Added : ECollisionDebuggerDiffKind::Removed;
+        }
+
+        const float Dot = VectorGetComponent(VectorDot3(Base, Test), 0);
+        if (Dot < 0.f)
+        {
+            return ECollisionDebuggerDiffKind::Flipped;
+        }
+        if (VectorGetComponent(Delta, 3) > TimeTolerance)
+        {
+            return ECollisionDebuggerDiffKind::Moved;
+        }
+        if (Dot < NormalTolerance)
+        {
+            return ECollisionDebuggerDiffKind::Rotated;
+        }
+        return ECollisionDebuggerDiffKind::None;
+    }
+}
+
+int32 FCollisionDebuggerDiffResult::GetNumChangedPixels() const
+{
+    int32 NumChanged = 0;
+    for (int32 Kind = 1; Kind < int32(ECollisionDebuggerDiffKind::Num); Kind++)
+    {
+        NumChanged += NumPixels[Kind];
+    }
+    return NumChanged;
+}
+
+const TCHAR* FCollisionDebuggerCaptureDiff::GetKindName(ECollisionDebuggerDiffKind Kind)
+{
+    return Kind < ECollisionDebuggerDiffKind::Num ? CollisionDebuggerCaptureDiff::KindNames[int32(Kind)] : TEXT("Unknown");
+}
+
+bool FCollisionDebuggerCaptureDiff::Compare(const FCollisionDebuggerCapture& Base, const FCollisionDebuggerCapture& Test, const FCollisionDebuggerDiffSettings& Settings, FCollisionDebuggerDiffResult& OutResult)
+{
+    using namespace CollisionDebuggerCaptureDiff;
+
+    OutResult = FCollisionDebuggerDiffResult();
+    const FIntPoint Size = Base.Pixels.GetSize();
+    if (Size != Test.Pixels.GetSize() || Base.Pixels.Num() == 0)
+    {
+        return false;
+    }
+
+    OutResult.Size = Size;
+    OutResult.PixelKinds.SetNumZeroed(Base.Pixels.Num());
+
+    // Raw bytes and tile hashes only mean the same thing when both captures store pixels alike.
+    const bool SameFormat = Base.Pixels.GetFormat() == Test.Pixels.GetFormat();
+    const FIntPoint NumTiles = Base.GetNumTiles();
+    const bool CanSkipTiles = SameFormat && Base.TileSize == Test.TileSize
+        && Base.TileHashes.Num() == NumTiles.X * NumTiles.Y && Test.TileHashes.Num() == Base.TileHashes.Num();
+
+    const int32 Bpp = Base.Pixels.GetBytesPerPixel();
+    const float TimeTolerance = float(Settings.DepthTolerance / FCollisionDebuggerTraceEngine::TraceLength);
+    const VectorRegister4Float Epsilon = VectorSetFloat1(UE_KINDA_SMALL_NUMBER);
+
+    TArray<FTileChange> TileChanges;
+    TileChanges.SetNum(NumTiles.X * NumTiles.Y);
+    std::atomic<int32> NumSkipped{ 0 };
+
+    ParallelFor(TileChanges.Num(), [&](int32 TileIndex)
+    {
+        if (CanSkipTiles && Base.TileHashes[TileIndex] == Test.TileHashes[TileIndex])
+        {
+            NumSkipped++;
+            return;
+        }
+
+        const FIntRect Rect = Base.GetTileRect(TileIndex);
+        TArray<FLinearColor, TInlineAllocator<128>> BaseRow;
+        TArray<FLinearColor, TInlineAllocator<128>> TestRow;
+        BaseRow.SetNumUninitialized(Rect.Width());
+        TestRow.SetNumUninitialized(Rect.Width());
+
+        FTileChange& Change = TileChanges[TileIndex];
+        for (int32 y = Rect.Min.Y; y < Rect.Max.Y; y++)
+        {
+            const int32 RowStart = Rect.Min.X + y * Size.X;
+            if (SameFormat && FMemory::Memcmp(Base.Pixels.GetData() + RowStart * Bpp, Test.Pixels.GetData() + RowStart * Bpp, Rect.Width() * Bpp) == 0)
+            {
+                continue;
+            }
+
+            Base.Pixels.DecodeRange(RowStart, Rect.Width(), BaseRow.GetData());
+            Test.Pixels.DecodeRange(RowStart, Rect.Width(), TestRow.GetData());
+
+            for (int32 x = 0; x < Rect.Width(); x++)
+            {
+                const ECollisionDebuggerDiffKind Kind = Classify(VectorLoad(&BaseRow[x].R), VectorLoad(&TestRow[x].R), Epsilon, TimeTolerance, Settings.NormalTolerance);
+                if (Kind == ECollisionDebuggerDiffKind::None)
+                {
+                    continue;
+                }
+
+                const FIntPoint Pixel(Rect.Min.X + x, y);
+                OutResult.PixelKinds[RowStart + x] = uint8(Kind);
+                Change.NumPixels[int32(Kind)]++;
+                Change.Min = Change.Min.ComponentMin(Pixel);
+                Change.Max = Change.Max.ComponentMax(Pixel + FIntPoint(1));
+                Change.Changed = true;
+            }
+        }
+    });
+
+    OutResult.NumTilesSkipped = NumSkipped.load();
+    OutResult.NumTilesCompared = TileChanges.Num() - OutResult.NumTilesSkipped;
+
+    // Group touching changed tiles into regions.
+    TBitArray<> Visited(false, TileChanges.Num());
+    TArray<int32> Stack;
+    for (int32 TileIndex = 0; TileIndex < TileChanges.Num(); TileIndex++)
+    {
+        if (!TileChanges[TileIndex].Changed || Visited[TileIndex])
+        {
+            continue;
+        }
+
+        FCollisionDebuggerDiffRegion& Region = OutResult.Regions.AddDefaulted_GetRef();
+        FIntPoint Min = FIntPoint(MAX_int32);
+        FIntPoint Max = FIntPoint(MIN_int32);
+
+        Visited[TileIndex] = true;
+        Stack.Add(TileIndex);
+        while (Stack.Num() > 0)
+        {
+            const int32 Current = Stack.Pop(false);
+            const FTileChange& Change = TileChanges[Current];
+            Min = Min.ComponentMin(Change.Min);
+            Max = Max.ComponentMax(Change.Max);
+            for (int32 Kind = 0; Kind < NumKinds; Kind++)
+            {
+                Region.NumPixels[Kind] += Change.NumPixels[Kind];
+                OutResult.NumPixels[Kind] += Change.NumPixels[Kind];
+            }
+
+            const FIntPoint Coord(Current % NumTiles.X, Current / NumTiles.X);
+            for (int32 OffsetY = -1; OffsetY <= 1; OffsetY++)
+            {
+                for (int32 OffsetX = -1; OffsetX <= 1; OffsetX++)
+                {
+                    const FIntPoint Neighbor = Coord + FIntPoint(OffsetX, OffsetY);
+                    if (Neighbor.X < 0 || Neighbor.Y < 0 || Neighbor.X >= NumTiles.X || Neighbor.Y >= NumTiles.Y)
+                    {
+                        continue;
+                    }
+
+                    const int32 NeighborIndex = Neighbor.X + Neighbor.Y * NumTiles.X;
+                    if (TileChanges[NeighborIndex].Changed && !Visited[NeighborIndex])
+                    {
+                        Visited[NeighborIndex] = true;
+                        Stack.Add(NeighborIndex);
+                    }
+                }
+            }
+        }
+        Region.Rect = FIntRect(Min, Max);
+    }
+
+    return true;
+}
+
+void FCollisionDebuggerCaptureDiff::MakeDiffImage(const FCollisionDebuggerCapture& Base, const FCollisionDebuggerDiffResult& Result, TArray<FColor>& OutImage)
+{
+    using namespace CollisionDebuggerCaptureDiff;
+
+    const FIntPoint Size = Base.Pixels.GetSize();
+    OutImage.SetNumUninitialized(Base.Pixels.Num());
+    ParallelFor(Size.Y, [&](int32 y)
+    {
+        TArray<FLinearColor, TInlineAllocator<1024>> Row;
+        Row.SetNumUninitialized(Size.X);
+        Base.Pixels.DecodeRange(y * Size.X, Size.X, Row.GetData());
+
+        for (int32 x = 0; x < Size.X; x++)
+        {
+            const int32 index = x + y * Size.X;
+            const uint8 Kind = Result.PixelKinds.IsValidIndex(index) ? Result.PixelKinds[index] : 0;
+            if (Kind != 0 && Kind < NumKinds)
+            {
+                OutImage[index] = KindColors[Kind];
+                continue;
+            }
+
+            // Unchanged pixels are a dim depth image so the changes can be placed.
+            const float Time = Row[x].A;
+            const uint8 Shade = Time < 0.f ? 0 : uint8(FMath::Lerp(160.f, 20.f, FMath::Sqrt(FMath::Min(Time, 1.f))));
+            OutImage[index] = FColor(Shade, Shade, Shade);
+        }
+    });
+}
+
+bool FCollisionDebuggerCaptureDiff::SaveDiffImage(const FCollisionDebuggerCapture& Base, const FCollisionDebuggerDiffResult& Result, const FString& Path)
+{
+    IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+    TSharedPtr<IImageWrapper> Png = ImageWrapperModule.CreateImageWrapper(EImageFormat::PNG);
+    if (!Png.IsValid())
+    {
+        return false;
+    }
+
+    TArray<FColor> Image;
+    MakeDiffImage(Base, Result, Image);
+
+    const FIntPoint Size = Base.Pixels.GetSize();
+    if (!Png->SetRaw(Image.GetData(), Image.Num() * sizeof(FColor), Size.X, Size.Y, ERGBFormat::BGRA, 8))
+    {
+        return false;
+    }
+    return FFileHelper::SaveArrayToFile(Png->GetCompressed(), *Path);
+}
@@ -0,0 +1,273 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerChangeTracker.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+#if WITH_EDITOR
+    #include "Editor.h"
+#endif
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugInvalidation(
+    TEXT("CollisionDebug.Invalidation"),
+    1,
+    TEXT("Only retrace tiles of the debug view that a camera move or a collision change in the world touched.\n")
+    TEXT(" 0: off, tiles are retraced continuously \n")
+    TEXT(" 1: on  \n"),
+    ECVF_Default);
+
+bool FCollisionDebuggerChangeTracker::IsEnabled()
+{
+    return CVarCollisionDebugInvalidation.GetValueOnGameThread() > 0;
+}
+
+FCollisionDebuggerChangeTracker::~FCollisionDebuggerChangeTracker()
+{
+    Stop();
+}
+
+void FCollisionDebuggerChangeTracker::Start(UWorld* InWorld)
+{
+    check(IsInGameThread());
+    Stop();
+
+    if (!InWorld)
+    {
+        return;
+    }
+    World = InWorld;
+
+    for (TActorIterator<AActor> It(InWorld); It; ++It)
+    {
+        TrackActor(*It);
+    }
+    // Everything was traced against the state being tracked from here on.
+    DirtyBounds.Reset();
+    ChangedPrimitives.Reset();
+
+    ActorSpawnedHandle = InWorld->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateRaw(this, &FCollisionDebuggerChangeTracker::OnActorSpawned));
+    ActorDestroyedHandle = InWorld->AddOnActorDestroyedHandler(FOnActorDestroyed::FDelegate::CreateRaw(this, &FCollisionDebuggerChangeTracker::OnActorDestroyed));
+    LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddRaw(this, &FCollisionDebuggerChangeTracker::OnLevelAdded);
+    LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddRaw(this, &FCollisionDebuggerChangeTracker::OnLevelRemoved);
+#if WITH_EDITOR
+    if (GEngine)
+    {
+        ActorMovedHandle = GEngine->OnActorMoved().AddRaw(this, &FCollisionDebuggerChangeTracker::OnActorMoved);
+    }
+    PropertyChangedHandle = FCoreUObjectDelegates::OnObjectPropertyChanged.AddRaw(this, &FCollisionDebuggerChangeTracker::OnObjectPropertyChanged);
+#endif // WITH_EDITOR
+}
+
+void FCollisionDebuggerChangeTracker::Stop()
+{
+    if (UWorld* TrackedWorld = World.Get())
+    {
+        TrackedWorld->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+        TrackedWorld->RemoveOnActorDestroyededHandler(ActorDestroyedHandle);
+    }
+    FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+    FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+#if WITH_EDITOR
+    if (GEngine)
+    {
+        GEngine->OnActorMoved().Remove(ActorMovedHandle);
+    }
+    FCoreUObjectDelegates::OnObjectPropertyChanged.Remove(PropertyChangedHandle);
+#endif // WITH_EDITOR
+
+    for (const TPair<TWeakObjectPtr<AActor>, TArray<FTrackedPrimitive>>& Actor : TrackedActors)
+    {
+        ForgetPrimitives(Actor.Value);
+    }
+
+    TrackedActors.Empty();
+    DirtyBounds.Empty();
+    ChangedPrimitives.Empty();
+    World.Reset();
+}
+
+void FCollisionDebuggerChangeTracker::ConsumeDirtyBounds(TArray<FBox>& OutBounds)
+{
+    OutBounds = MoveTemp(DirtyBounds);
+    DirtyBounds.Reset();
+}
+
+void FCollisionDebuggerChangeTracker::ConsumeChangedPrimitives(TArray<TWeakObjectPtr<UPrimitiveComponent>>& OutPrimitives)
+{
+    OutPrimitives = MoveTemp(ChangedPrimitives);
+    ChangedPrimitives.Reset();
+}
+
+FBox FCollisionDebuggerChangeTracker::GetCollisionBounds(const UPrimitiveComponent* Component)
+{
+    if (!Component->IsRegistered() || !Component->IsQueryCollisionEnabled())
+    {
+        return FBox(ForceInit);
+    }
+    return Component->Bounds.GetBox();
+}
+
+void FCollisionDebuggerChangeTracker::MarkDirty(const FBox& Bounds)
+{
+    if (Bounds.IsValid)
+    {
+        DirtyBounds.Add(Bounds);
+    }
+}
+
+void FCollisionDebuggerChangeTracker::TrackActor(AActor* Actor)
+{
+    if (!IsValid(Actor))
+    {
+        return;
+    }
+
+    TArray<FTrackedPrimitive>& Primitives = TrackedActors.FindOrAdd(Actor);
+    Actor->ForEachComponent<UPrimitiveComponent>(false, [this, &Primitives](UPrimitiveComponent* Component)
+    {
+        if (Primitives.ContainsByPredicate([Component](const FTrackedPrimitive& Primitive) { return Primitive.Component == Component; }))
+        {
+            return;
+        }
+
+        FTrackedPrimitive& Primitive = Primitives.AddDefaulted_GetRef();
+        Primitive.Component = Component;
+        Primitive.Bounds = GetCollisionBounds(Component);
+        MarkDirty(Primitive.Bounds);
+        ChangedPrimitives.Add(Component);
+
+        Component->TransformUpdated.AddRaw(this, &FCollisionDebuggerChangeTracker::OnTransformUpdated);
+        Component->OnComponentCollisionSettingsChangedEvent.AddRaw(this, &FCollisionDebuggerChangeTracker::OnCollisionSettingsChanged);
+    });
+}
+
+void FCollisionDebuggerChangeTracker::ForgetActor(AActor* Actor)
+{
+    TArray<FTrackedPrimitive> Primitives;
+    if (TrackedActors.RemoveAndCopyValue(Actor, Primitives))
+    {
+        ForgetPrimitives(Primitives);
+    }
+}
+
+void FCollisionDebuggerChangeTracker::ForgetPrimitives(const TArray<FTrackedPrimitive>& Primitives)
+{
+    // Components rebuilt by a construction script are stale here, their last bounds still count.
+    for (const FTrackedPrimitive& Primitive : Primitives)
+    {
+        MarkDirty(Primitive.Bounds);
+        ChangedPrimitives.Add(Primitive.Component);
+        if (UPrimitiveComponent* Component = Primitive.Component.Get())
+        {
+            Component->TransformUpdated.RemoveAll(this);
+            Component->OnComponentCollisionSettingsChangedEvent.RemoveAll(this);
+        }
+    }
+}
+
+void FCollisionDebuggerChangeTracker::RefreshComponent(UPrimitiveComponent* Component)
+{
+    TArray<FTrackedPrimitive>* Primitives = Component ? TrackedActors.Find(Component->GetOwner()) : nullptr;
+    FTrackedPrimitive* Primitive = Primitives ? Primitives->FindByPredicate([Component](const FTrackedPrimitive& Entry) { return Entry.Component == Component; }) : nullptr;
+    if (!Primitive)
+    {
+        return;
+    }
+
+    const FBox NewBounds = GetCollisionBounds(Component);
+    MarkDirty(Primitive->Bounds);
+    if (!(NewBounds == Primitive->Bounds))
+    {
+        MarkDirty(NewBounds);
+    }
+    Primitive->Bounds = NewBounds;
+    ChangedPrimitives.Add(Component);
+}
+
+void FCollisionDebuggerChangeTracker::OnActorSpawned(AActor* Actor)
+{
+    TrackActor(Actor);
+}
+
+void FCollisionDebuggerChangeTracker::OnActorDestroyed(AActor* Actor)
+{
+    ForgetActor(Actor);
+}
+
+void FCollisionDebuggerChangeTracker::OnLevelAdded(ULevel* Level, UWorld* InWorld)
+{
+    if (!Level || InWorld != World.Get())
+    {
+        return;
+    }
+
+    for (AActor* Actor : Level->Actors)
+    {
+        TrackActor(Actor);
+    }
+}
+
+void FCollisionDebuggerChangeTracker::OnLevelRemoved(ULevel* Level, UWorld* InWorld)
+{
+    if (InWorld != World.Get())
+    {
+        return;
+    }
+
+    // A null level means every level of the world went away.
+    if (!Level)
+    {
+        for (const TPair<TWeakObjectPtr<AActor>, TArray<FTrackedPrimitive>>& Actor : TrackedActors)
+        {
+            ForgetPrimitives(Actor.Value);
+        }
+        TrackedActors.Empty();
+        return;
+    }
+
+    for (AActor* Actor : Level->Actors)
+    {
+        ForgetActor(Actor);
+    }
+}
+
+void FCollisionDebuggerChangeTracker::OnTransformUpdated(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+    RefreshComponent(Cast<UPrimitiveComponent>(Component));
+}
+
+void FCollisionDebuggerChangeTracker::OnCollisionSettingsChanged(UPrimitiveComponent* Component)
+{
+    RefreshComponent(Component);
+}
+
+#if WITH_EDITOR
+void FCollisionDebuggerChangeTracker::OnActorMoved(AActor* Actor)
+{
+    // Editor moves can rerun the construction script, which replaces the components.
+    if (Actor && Actor->GetWorld() == World.Get())
+    {
+        ForgetActor(Actor);
+        TrackActor(Actor);
+    }
+}
+
+void FCollisionDebuggerChangeTracker::OnObjectPropertyChanged(UObject* Object, FPropertyChangedEvent& PropertyChangedEvent)
+{
+    AActor* Actor = Cast<AActor>(Object);
+    if (UActorComponent* Component = Cast<UActorComponent>(Object))
+    {
+        Actor = Component->GetOwner();
+    }
+
+    if (Actor && Actor->GetWorld() == World.Get())
+    {
+        ForgetActor(Actor);
+        TrackActor(Actor);
+    }
+}
+#endif // WITH_EDITOR
@@ -0,0 +1,215 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerDiffCommandlet.h"
+#include "CollisionDebuggerCapture.h"
+#include "CollisionDebuggerCaptureDiff.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonWriter.h"
+
+namespace CollisionDebuggerDiffCommandlet
+{
+    enum class EPairStatus : uint8
+    {
+        Unchanged,
+        Changed,
+        MissingInTest,
+        NewInTest,
+        Error,
+    };
+
+    static const TCHAR* GetStatusName(EPairStatus Status)
+    {
+        switch (Status)
+        {
+        case EPairStatus::Unchanged: return TEXT("Unchanged");
+        case EPairStatus::Changed: return TEXT("Changed");
+        case EPairStatus::MissingInTest: return TEXT("MissingInTest");
+        case EPairStatus::NewInTest: return TEXT("NewInTest");
+        default: return TEXT("Error");
+        }
+    }
+
+    struct FCapturePair
+    {
+        FString RelativePath;
+        EPairStatus Status = EPairStatus::Error;
+        FCollisionDebuggerDiffResult Result;
+    };
+
+    static void FindCaptures(const FString& Directory, TSet<FString>& OutRelativePaths)
+    {
+        TArray<FString> Files;
+        IFileManager::Get().FindFilesRecursive(Files, *Directory, *(FString(TEXT("*")) + FCollisionDebuggerCapture::FileExtension), true, false);
+        for (FString& File : Files)
+        {
+            FPaths::MakePathRelativeTo(File, *(Directory / TEXT("")));
+            OutRelativePaths.Add(File);
+        }
+    }
+
+    static void WriteSummary(const FString& Path, const FString& BaseDir, const FString& TestDir, const TArray<FCapturePair>& Pairs)
+    {
+        FString Json;
+        TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+        Writer->WriteObjectStart();
+        Writer->WriteValue(TEXT("base"), BaseDir);
+        Writer->WriteValue(TEXT("test"), TestDir);
+
+        Writer->WriteArrayStart(TEXT("captures"));
+        for (const FCapturePair& Pair : Pairs)
+        {
+            if (Pair.Status == EPairStatus::Unchanged)
+            {
+                continue;
+            }
+
+            Writer->WriteObjectStart();
+            Writer->WriteValue(TEXT("capture"), Pair.RelativePath);
+            Writer->WriteValue(TEXT("status"), FString(GetStatusName(Pair.Status)));
+            if (Pair.Status == EPairStatus::Changed)
+            {
+                Writer->WriteValue(TEXT("changedPixels"), Pair.Result.GetNumChangedPixels());
+                Writer->WriteValue(TEXT("tilesCompared"), Pair.Result.NumTilesCompared);
+
+                Writer->WriteArrayStart(TEXT("regions"));
+                for (const FCollisionDebuggerDiffRegion& Region : Pair.Result.Regions)
+                {
+                    Writer->WriteObjectStart();
+                    Writer->WriteValue(TEXT("x"), Region.Rect.Min.X);
+                    Writer->WriteValue(TEXT("y"), Region.Rect.Min.Y);
+                    Writer->WriteValue(TEXT("width"), Region.Rect.Width());
+                    Writer->WriteValue(TEXT("height"), Region.Rect.Height());
+                    for (int32 Kind = 1; Kind < int32(ECollisionDebuggerDiffKind::Num); Kind++)
+                    {
+                        if (Region.NumPixels[Kind] > 0)
+                        {
+                            Writer->WriteValue(FCollisionDebuggerCaptureDiff::GetKindName(ECollisionDebuggerDiffKind(Kind)), Region.NumPixels[Kind]);
+                        }
+                    }
+                    Writer->WriteObjectEnd();
+                }
+                Writer->WriteArrayEnd();
+            }
+            Writer->WriteObjectEnd();
+        }
+        Writer->WriteArrayEnd();
+
+        Writer->WriteObjectEnd();
+        Writer->Close();
+        FFileHelper::SaveStringToFile(Json, *Path);
+    }
+}
+
+UCollisionDebuggerDiffCommandlet::UCollisionDebuggerDiffCommandlet()
+{
+    IsClient = false;
+    IsServer = false;
+    IsEditor = true;
+    LogToConsole = true;
+
+    HelpDescription = TEXT("Compares two sets of collision captures and reports what changed.");
+    HelpUsage = TEXT("-run=CollisionDebuggerDiff -Base=<dir> -Test=<dir> [-Output=<dir>] [-DepthTolerance=<units>] [-NormalTolerance=<dot>] [-FailOnChange]");
+}
+
+int32 UCollisionDebuggerDiffCommandlet::Main(const FString& Params)
+{
+    using namespace CollisionDebuggerDiffCommandlet;
+
+    TArray<FString> Tokens;
+    TArray<FString> Switches;
+    TMap<FString, FString> ParamValues;
+    ParseCommandLine(*Params, Tokens, Switches, ParamValues);
+
+    const FString* BaseParam = ParamValues.Find(TEXT("Base"));
+    const FString* TestParam = ParamValues.Find(TEXT("Test"));
+    if (!BaseParam || !TestParam)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Usage: %s"), *HelpUsage);
+        return 1;
+    }
+
+    const FString BaseDir = *BaseParam;
+    const FString TestDir = *TestParam;
+    const FString* OutputParam = ParamValues.Find(TEXT("Output"));
+    const FString OutputDir = OutputParam ? *OutputParam : FPaths::ProjectSavedDir() / TEXT("CollisionDiff");
+
+    FCollisionDebuggerDiffSettings Settings;
+    if (const FString* DepthParam = ParamValues.Find(TEXT("DepthTolerance")))
+    {
+        Settings.DepthTolerance = FCString::Atod(**DepthParam);
+    }
+    if (const FString* NormalParam = ParamValues.Find(TEXT("NormalTolerance")))
+    {
+        Settings.NormalTolerance = FCString::Atof(**NormalParam);
+    }
+
+    TSet<FString> BaseCaptures;
+    TSet<FString> TestCaptures;
+    FindCaptures(BaseDir, BaseCaptures);
+    FindCaptures(TestDir, TestCaptures);
+
+    TArray<FCapturePair> Pairs;
+    for (const FString& RelativePath : BaseCaptures.Union(TestCaptures))
+    {
+        FCapturePair& Pair = Pairs.AddDefaulted_GetRef();
+        Pair.RelativePath = RelativePath;
+        Pair.Status = !TestCaptures.Contains(RelativePath) ? EPairStatus::MissingInTest
+            : !BaseCaptures.Contains(RelativePath) ? EPairStatus::NewInTest
+            : EPairStatus::Unchanged;
+    }
+    Pairs.Sort([](const FCapturePair& A, const FCapturePair& B) { return A.RelativePath < B.RelativePath; });
+
+    // Pairs are independent, each one loads, compares and writes its own image.
+    const double StartTime = FPlatformTime::Seconds();
+    ParallelFor(Pairs.Num(), [&](int32 PairIndex)
+    {
+        FCapturePair& Pair = Pairs[PairIndex];
+        if (Pair.Status != EPairStatus::Unchanged)
+        {
+            return;
+        }
+
+        FCollisionDebuggerCapture Base;
+        FCollisionDebuggerCapture Test;
+        if (!Base.LoadFromFile(BaseDir / Pair.RelativePath) || !Test.LoadFromFile(TestDir / Pair.RelativePath)
+            || !FCollisionDebuggerCaptureDiff::Compare(Base, Test, Settings, Pair.Result))
+        {
+            Pair.Status = EPairStatus::Error;
+            return;
+        }
+
+        if (Pair.Result.HasChanges())
+        {
+            Pair.Status = EPairStatus::Changed;
+            FCollisionDebuggerCaptureDiff::SaveDiffImage(Base, Pair.Result, FPaths::ChangeExtension(OutputDir / Pair.RelativePath, TEXT(".diff.png")));
+        }
+
+        // The per pixel kinds are in the image now, the summary only needs the regions.
+        Pair.Result.PixelKinds.Empty();
+    });
+
+    int32 NumChanged = 0;
+    int32 NumErrors = 0;
+    for (const FCapturePair& Pair : Pairs)
+    {
+        if (Pair.Status == EPairStatus::Unchanged)
+        {
+            continue;
+        }
+
+        // A capture that appeared or went away is a change too.
+        NumChanged += Pair.Status != EPairStatus::Error ? 1 : 0;
+        NumErrors += Pair.Status == EPairStatus::Error ? 1 : 0;
+        UE_LOG(LogTemp, Display, TEXT("%s: %s, %d pixels in %d regions"), *Pair.RelativePath, GetStatusName(Pair.Status), Pair.Result.GetNumChangedPixels(), Pair.Result.Regions.Num());
+    }
+
+    WriteSummary(OutputDir / TEXT("CollisionDiff.json"), BaseDir, TestDir, Pairs);
+    UE_LOG(LogTemp, Display, TEXT("Compared %d captures in %.2f s, %d changed, %d failed"), Pairs.Num(), FPlatformTime::Seconds() - StartTime, NumChanged, NumErrors);
+
+    const bool FailOnChange = Switches.Contains(TEXT("FailOnChange"));
+    return (NumErrors > 0 || (FailOnChange && NumChanged > 0)) ? 1 : 0;
+}
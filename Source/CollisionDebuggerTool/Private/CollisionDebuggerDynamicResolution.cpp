@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerDynamicResolution.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<float> CVarCollisionDebugDynamicResolutionTargetMs(
+    TEXT("CollisionDebug.DynamicResolution.TargetMs"),
+    0.f,
+    TEXT("Time a full refresh of every debug view should take. Views that can't be traced in full in that time\n")
+    TEXT("at the measured rays per second trace every 2nd, 4th or 8th pixel and the widget upscales them.\n")
+    TEXT(" 0: off, always full resolution \n")
+    TEXT(">0: target in milliseconds, 250 refreshes the views four times a second \n"),
+    ECVF_Default);
+
+namespace CollisionDebuggerDynamicResolution
+{
+    /** Busy time gathered before it updates the rays per second, a few ticks are too noisy. */
+    static const double MinSampleSeconds = .25;
+
+    /** Weight of a new sample in the moving average of the rays per second. */
+    static const double ThroughputSmoothing = .3;
+
+    /** How far past the target a refresh may get before the stride changes, keeps it from flipping. */
+    static const double Hysteresis = 1.25;
+}
+
+bool FCollisionDebuggerDynamicResolution::IsEnabled()
+{
+    return CVarCollisionDebugDynamicResolutionTargetMs.GetValueOnGameThread() > 0.f;
+}
+
+void FCollisionDebuggerDynamicResolution::Update(int64 NumRays, bool Busy, int64 NumPixels)
+{
+    Update(NumRays, Busy, NumPixels, FPlatformTime::Seconds());
+}
+
+void FCollisionDebuggerDynamicResolution::Update(int64 NumRays, bool Busy, int64 NumPixels, double Now)
+{
+    using namespace CollisionDebuggerDynamicResolution;
+
+    const double Elapsed = LastUpdateTime >= 0.0 ? Now - LastUpdateTime : 0.0;
+    LastUpdateTime = Now;
+
+    // Idle views say nothing about how fast they could trace.
+    if (Busy)
+    {
+        PendingRays += NumRays;
+        PendingSeconds += Elapsed;
+    }
+    if (PendingSeconds >= MinSampleSeconds)
+    {
+        const double Sample = double(PendingRays) / PendingSeconds;
+        RaysPerSecond = RaysPerSecond > 0.0 ? FMath::Lerp(RaysPerSecond, Sample, ThroughputSmoothing) : Sample;
+        PendingRays = 0;
+        PendingSeconds = 0.0;
+    }
+
+    if (!IsEnabled() || RaysPerSecond <= 0.0 || NumPixels <= 0)
+    {
+        Stride = 1;
+        return;
+    }
+
+    const double TargetRays = RaysPerSecond * CVarCollisionDebugDynamicResolutionTargetMs.GetValueOnGameThread() * .001;
+    auto GetRefreshRays = [NumPixels](int32 InStride) { return double(NumPixels) / double(InStride * InStride); };
+    while (Stride < MaxStride && GetRefreshRays(Stride) > TargetRays * Hysteresis)
+    {
+        Stride *= 2;
+    }
+    while (Stride > 1 && GetRefreshRays(Stride / 2) * Hysteresis < TargetRays)
+    {
+        Stride /= 2;
+    }
+}
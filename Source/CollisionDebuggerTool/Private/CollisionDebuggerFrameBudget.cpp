@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerFrameBudget.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<float> CVarCollisionDebugFrameBudgetMs(
+    TEXT("CollisionDebug.FrameBudgetMs"),
+    0.f,
+    TEXT("Worker milliseconds the collision debugger may trace per frame, summed over the workers.\n")
+    TEXT(" 0: no budget \n")
+    TEXT(">0: tile size, tiles in flight and rays per frame adapt to the measured trace cost \n"),
+    ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugRayBudget(
+    TEXT("CollisionDebug.RayBudget"),
+    0,
+    TEXT("Rays the collision debugger submits per frame, shared by the debug views.\n")
+    TEXT(" 0: no budget, tiles are only capped by CollisionDebug.TilesInFlight \n")
+    TEXT(">0: rays per frame, tile size and tiles in flight adapt to it \n"),
+    ECVF_Default);
+
+namespace CollisionDebuggerFrameBudget
+{
+    /** Rays gathered before they update the cost per ray. */
+    static const int64 MinRaysPerSample = 1024;
+
+    /** Weight of a new sample in the moving average of the cost per ray. */
+    static const double CostSmoothing = .2;
+}
+
+bool FCollisionDebuggerFrameBudget::IsEnabled()
+{
+    return CVarCollisionDebugFrameBudgetMs.GetValueOnGameThread() > 0.f || CVarCollisionDebugRayBudget.GetValueOnGameThread() > 0;
+}
+
+void FCollisionDebuggerFrameBudget::Update(const FCollisionDebuggerTraceStats& Stats)
+{
+    using namespace CollisionDebuggerFrameBudget;
+
+    PendingRays += Stats.NumRays;
+    PendingSeconds += Stats.TraceSeconds;
+    if (PendingRays >= MinRaysPerSample)
+    {
+        const double Sample = PendingSeconds / double(PendingRays);
+        SecondsPerRay = SecondsPerRay > 0.0 ? FMath::Lerp(SecondsPerRay, Sample, CostSmoothing) : Sample;
+        PendingRays = 0;
+        PendingSeconds = 0.0;
+    }
+
+    const int64 RaysPerFrame = GetRaysPerFrame();
+    if (RaysPerFrame <= 0)
+    {
+        TileSize = MaxTileSize;
+        return;
+    }
+
+    // Tiles halve once they cost more than two frames and double once the doubled tile fits in half
+    // a frame, the gap keeps the tile grid from flipping back and forth every frame.
+    while (TileSize > MinTileSize && int64(TileSize) * TileSize > RaysPerFrame * 2)
+    {
+        TileSize /= 2;
+    }
+    while (TileSize < MaxTileSize && int64(TileSize) * TileSize * 8 <= RaysPerFrame)
+    {
+        TileSize *= 2;
+    }
+}
+
+int64 FCollisionDebuggerFrameBudget::GetRaysPerFrame() const
+{
+    int64 RaysPerFrame = FMath::Max(CVarCollisionDebugRayBudget.GetValueOnGameThread(), 0);
+
+    const float BudgetMs = CVarCollisionDebugFrameBudgetMs.GetValueOnGameThread();
+    if (BudgetMs > 0.f)
+    {
+        // Until the cost is known a single small tile per frame measures it.
+        const int64 TimeRays = SecondsPerRay > 0.0
+            ? FMath::Max<int64>(int64(BudgetMs * .001 / SecondsPerRay), 1)
+            : int64(MinTileSize) * MinTileSize;
+        RaysPerFrame = RaysPerFrame > 0 ? FMath::Min(RaysPerFrame, TimeRays) : TimeRays;
+    }
+    return RaysPerFrame;
+}
+
+int32 FCollisionDebuggerFrameBudget::GetMaxTilesInFlight() const
+{
+    const int32 MaxTilesInFlight = FCollisionDebuggerTraceEngine::GetMaxTilesInFlight();
+    const int64 RaysPerFrame = GetRaysPerFrame();
+    if (RaysPerFrame <= 0)
+    {
+        return MaxTilesInFlight;
+    }
+
+    const int64 RaysPerTile = int64(TileSize) * TileSize;
+    return int32(FMath::Clamp<int64>(FMath::DivideAndRoundUp(RaysPerFrame, RaysPerTile), 1, MaxTilesInFlight));
+}
@@ -0,0 +1,245 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerHitBuffer.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugHitFormat(
+    TEXT("CollisionDebug.HitFormat"),
+    0,
+    TEXT("Pixel format of the collision debugger hit buffer and render target. Applied when the tool starts.\n")
+    TEXT("Only 0 is used where the view material can't be built, M_ShowCollision does not decode packed pixels.\n")
+    TEXT(" 0: RGBA32f, 16 bytes per pixel \n")
+    TEXT(" 1: packed, 8 bit oct normal and 16 bit hit time, 4 bytes per pixel \n")
+    TEXT(" 2: packed, 16 bit oct normal and 32 bit hit time, 8 bytes per pixel \n"),
+    ECVF_Default);
+
+namespace CollisionDebuggerHitEncoding
+{
+    static const uint16 MissTime16 = 0xFFFF;
+    static const uint32 MissTime32 = 0xFFFFFFFF;
+
+    static float SignNotZero(float Value)
+    {
+        return Value >= 0.f ? 1.f : -1.f;
+    }
+
+    /** Octahedral normal encoding, returns a point in [-1, 1]^2. */
+    static FVector2f OctEncode(const FVector3f& Normal)
+    {
+        const float L1 = FMath::Abs(Normal.X) + FMath::Abs(Normal.Y) + FMath::Abs(Normal.Z);
+        if (L1 <= 0.f)
+        {
+            return FVector2f::ZeroVector;
+        }
+
+        const FVector3f N = Normal / L1;
+        if (N.Z >= 0.f)
+        {
+            return FVector2f(N.X, N.Y);
+        }
+        return FVector2f((1.f - FMath::Abs(N.Y)) * SignNotZero(N.X), (1.f - FMath::Abs(N.X)) * SignNotZero(N.Y));
+    }
+
+    static FVector3f OctDecode(const FVector2f& Oct)
+    {
+        FVector3f N(Oct.X, Oct.Y, 1.f - FMath::Abs(Oct.X) - FMath::Abs(Oct.Y));
+        if (N.Z < 0.f)
+        {
+            const float X = N.X;
+            N.X = (1.f - FMath::Abs(N.Y)) * SignNotZero(X);
+            N.Y = (1.f - FMath::Abs(X)) * SignNotZero(N.Y);
+        }
+        return N.GetSafeNormal();
+    }
+
+    template<typename T>
+    static T ToUnorm(float Value)
+    {
+        const double Max = double(TNumericLimits<T>::Max());
+        return T(FMath::Clamp(FMath::RoundToDouble((Value * .5 + .5) * Max), 0.0, Max));
+    }
+
+    template<typename T>
+    static float FromUnorm(T Value)
+    {
+        return float(double(Value) / double(TNumericLimits<T>::Max())) * 2.f - 1.f;
+    }
+}
+
+ECollisionDebuggerHitFormat FCollisionDebuggerHitBuffer::GetConfiguredFormat()
+{
+    switch (CVarCollisionDebugHitFormat.GetValueOnGameThread())
+    {
+    case 1: return ECollisionDebuggerHitFormat::Packed32;
+    case 2: return ECollisionDebuggerHitFormat::Packed64;
+    default: return ECollisionDebuggerHitFormat::Float32;
+    }
+}
+
+int32 FCollisionDebuggerHitBuffer::GetBytesPerPixel(ECollisionDebuggerHitFormat InFormat)
+{
+    switch (InFormat)
+    {
+    case ECollisionDebuggerHitFormat::Packed32: return 4;
+    case ECollisionDebuggerHitFormat::Packed64: return 8;
+    default: return 16;
+    }
+}
+
+EPixelFormat FCollisionDebuggerHitBuffer::GetPixelFormat(ECollisionDebuggerHitFormat InFormat)
+{
+    switch (InFormat)
+    {
+    case ECollisionDebuggerHitFormat::Packed32: return PF_R8G8B8A8;
+    case ECollisionDebuggerHitFormat::Packed64: return PF_R16G16B16A16_UNORM;
+    default: return PF_A32B32G32R32F;
+    }
+}
+
+void FCollisionDebuggerHitBuffer::Init(FIntPoint InSize, ECollisionDebuggerHitFormat InFormat)
+{
+    if (Size == InSize && Format == InFormat && Data.Num() == Num() * BytesPerPixel)
+    {
+        return;
+    }
+
+    Size = InSize;
+    Format = InFormat;
+    BytesPerPixel = GetBytesPerPixel(InFormat);
+    Data.SetNumUninitialized(Num() * BytesPerPixel);
+
+    uint8 Miss[16];
+    Encode(Format, FLinearColor(-1, -1, -1, -1), Miss);
+    for (int32 i = 0; i < Num(); i++)
+    {
+        FMemory::Memcpy(Data.GetData() + i * BytesPerPixel, Miss, BytesPerPixel);
+    }
+}
+
+void FCollisionDebuggerHitBuffer::Empty()
+{
+    Size = FIntPoint::ZeroValue;
+    Data.Empty();
+}
+
+void FCollisionDebuggerHitBuffer::Set(int32 Index, const FLinearColor& Value)
+{
+    Encode(Format, Value, Data.GetData() + Index * BytesPerPixel);
+}
+
+FLinearColor FCollisionDebuggerHitBuffer::Get(int32 Index) const
+{
+    return Decode(Format, Data.GetData() + Index * BytesPerPixel);
+}
+
+void FCollisionDebuggerHitBuffer::DecodeRange(int32 FirstIndex, int32 Count, FLinearColor* OutValues) const
+{
+    const uint8* Pixel = Data.GetData() + FirstIndex * BytesPerPixel;
+    if (Format == ECollisionDebuggerHitFormat::Float32)
+    {
+        FMemory::Memcpy(OutValues, Pixel, Count * sizeof(FLinearColor));
+        return;
+    }
+
+    for (int32 i = 0; i < Count; i++)
+    {
+        OutValues[i] = Decode(Format, Pixel + i * BytesPerPixel);
+    }
+}
+
+uint32 FCollisionDebuggerHitBuffer::HashRect(const FIntRect& Rect) const
+{
+    uint32 Hash = 0;
+    for (int32 y = Rect.Min.Y; y < Rect.Max.Y; y++)
+    {
+        Hash = FCrc::MemCrc32(Data.GetData() + (Rect.Min.X + y * Size.X) * BytesPerPixel, Rect.Width() * BytesPerPixel, Hash);
+    }
+    return Hash;
+}
+
+uint32 FCollisionDebuggerHitBuffer::PackNormal(const FVector3f& Normal)
+{
+    using namespace CollisionDebuggerHitEncoding;
+
+    const FVector2f Oct = OctEncode(Normal);
+    return (uint32(ToUnorm<uint16>(Oct.X)) << 16) | ToUnorm<uint16>(Oct.Y);
+}
+
+FVector3f FCollisionDebuggerHitBuffer::UnpackNormal(uint32 Packed)
+{
+    using namespace CollisionDebuggerHitEncoding;
+
+    return OctDecode(FVector2f(FromUnorm<uint16>(uint16(Packed >> 16)), FromUnorm<uint16>(uint16(Packed & 0xFFFF))));
+}
+
+void FCollisionDebuggerHitBuffer::Encode(ECollisionDebuggerHitFormat InFormat, const FLinearColor& Value, uint8* OutPixel)
+{
+    using namespace CollisionDebuggerHitEncoding;
+
+    const bool IsHit = Value.A >= 0.f;
+    switch (InFormat)
+    {
+    case ECollisionDebuggerHitFormat::Packed32:
+    {
+        const FVector2f Oct = IsHit ? OctEncode(FVector3f(Value.R, Value.G, Value.B)) : FVector2f(-1.f, -1.f);
+        const uint16 Time = IsHit ? uint16(FMath::Clamp(FMath::RoundToInt(Value.A * (MissTime16 - 1)), 0, MissTime16 - 1)) : MissTime16;
+        OutPixel[0] = ToUnorm<uint8>(Oct.X);
+        OutPixel[1] = ToUnorm<uint8>(Oct.Y);
+        OutPixel[2] = uint8(Time >> 8);
+        OutPixel[3] = uint8(Time & 0xFF);
+        break;
+    }
+    case ECollisionDebuggerHitFormat::Packed64:
+    {
+        const FVector2f Oct = IsHit ? OctEncode(FVector3f(Value.R, Value.G, Value.B)) : FVector2f(-1.f, -1.f);
+        const uint32 Time = IsHit ? uint32(FMath::Clamp(FMath::RoundToDouble(double(Value.A) * (MissTime32 - 1.0)), 0.0, MissTime32 - 1.0)) : MissTime32;
+        const uint16 Packed[4] = { ToUnorm<uint16>(Oct.X), ToUnorm<uint16>(Oct.Y), uint16(Time >> 16), uint16(Time & 0xFFFF) };
+        FMemory::Memcpy(OutPixel, Packed, sizeof(Packed));
+        break;
+    }
+    default:
+    {
+        const FLinearColor Stored = IsHit ? Value : FLinearColor(-1, -1, -1, -1);
+        FMemory::Memcpy(OutPixel, &Stored, sizeof(FLinearColor));
+        break;
+    }
+    }
+}
+
+FLinearColor FCollisionDebuggerHitBuffer::Decode(ECollisionDebuggerHitFormat InFormat, const uint8* Pixel)
+{
+    using namespace CollisionDebuggerHitEncoding;
+
+    switch (InFormat)
+    {
+    case ECollisionDebuggerHitFormat::Packed32:
+    {
+        const uint16 Time = uint16((Pixel[2] << 8) | Pixel[3]);
+        if (Time == MissTime16)
+        {
+            return FLinearColor(-1, -1, -1, -1);
+        }
+        const FVector3f Normal = OctDecode(FVector2f(FromUnorm<uint8>(Pixel[0]), FromUnorm<uint8>(Pixel[1])));
+        return FLinearColor(Normal.X, Normal.Y, Normal.Z, float(Time) / float(MissTime16 - 1));
+    }
+    case ECollisionDebuggerHitFormat::Packed64:
+    {
+        uint16 Packed[4];
+        FMemory::Memcpy(Packed, Pixel, sizeof(Packed));
+        const uint32 Time = (uint32(Packed[2]) << 16) | Packed[3];
+        if (Time == MissTime32)
+        {
+            return FLinearColor(-1, -1, -1, -1);
+        }
+        const FVector3f Normal = OctDecode(FVector2f(FromUnorm<uint16>(Packed[0]), FromUnorm<uint16>(Packed[1])));
+        return FLinearColor(Normal.X, Normal.Y, Normal.Z, float(double(Time) / (MissTime32 - 1.0)));
+    }
+    default:
+    {
+        FLinearColor Value;
+        FMemory::Memcpy(&Value, Pixel, sizeof(FLinearColor));
+        return Value;
+    }
+    }
+}
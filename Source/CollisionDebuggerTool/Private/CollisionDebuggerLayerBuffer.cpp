@@ -0,0 +1,169 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerLayerBuffer.h"
+#include "CollisionDebuggerViewMaterial.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugXRay(
+    TEXT("CollisionDebug.XRay"),
+    0,
+    TEXT("Keep every primitive the test blocks on along each pixel's ray, not only the first, so the widget\n")
+    TEXT("can step or blend through collision hidden behind other collision. Rays cost a multi trace in this mode.\n")
+    TEXT("Shown through the view material, off where it can't be built.\n")
+    TEXT(" 0: off \n")
+    TEXT(" 1: taken as 2, a single layer shows no more than the normal view \n")
+    TEXT(">1: layers kept per pixel, at most 15 \n"),
+    ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarCollisionDebugXRayPoolLayers(
+    TEXT("CollisionDebug.XRay.PoolLayers"),
+    2.f,
+    TEXT("Layers per pixel the x-ray pool starts with, it grows when it runs out. Applied when the layers are created.\n"),
+    ECVF_Default);
+
+
+bool FCollisionDebuggerLayerBuffer::IsEnabled()
+{
+    return CVarCollisionDebugXRay.GetValueOnGameThread() > 0 && FCollisionDebuggerViewMaterial::IsSupported();
+}
+
+int32 FCollisionDebuggerLayerBuffer::GetConfiguredLayers()
+{
+    return FMath::Clamp(CVarCollisionDebugXRay.GetValueOnGameThread(), 2, MaxLayersPerPixel);
+}
+
+void FCollisionDebuggerLayerBuffer::Init(FIntPoint InSize, int32 InMaxLayers, ECollisionDebuggerHitFormat InFormat)
+{
+    Size = InSize;
+    MaxLayers = FMath::Clamp(InMaxLayers, 1, MaxLayersPerPixel);
+    Entries.Init(0, Size.X * Size.Y);
+
+    const int64 PoolLayers = int64(double(Entries.Num()) * FMath::Max(CVarCollisionDebugXRayPoolLayers.GetValueOnGameThread(), .25f));
+    const int32 PoolRows = int32(FMath::Clamp<int64>(FMath::DivideAndRoundUp<int64>(PoolLayers, PoolWidth), 1, MaxPoolRows));
+    Pool.Init(FIntPoint(PoolWidth, PoolRows), InFormat);
+    NumUsed = 0;
+    NumCompacted = 0;
+    Overflowed = false;
+}
+
+void FCollisionDebuggerLayerBuffer::Empty()
+{
+    Size = FIntPoint::ZeroValue;
+    Entries.Empty();
+    Pool.Empty();
+    NumUsed = 0;
+    NumCompacted = 0;
+    Overflowed = false;
+}
+
+int32 FCollisionDebuggerLayerBuffer::Allocate(int32 NumLayers)
+{
+    const int32 First = NumUsed.fetch_add(NumLayers);
+    if (First + NumLayers > Pool.Num())
+    {
+        Overflowed = true;
+        return INDEX_NONE;
+    }
+    return First;
+}
+
+void FCollisionDebuggerLayerBuffer::Set(int32 Index, int32 First, const FCollisionDebuggerRayHit* InLayers, int32 InNumLayers)
+{
+    check(InNumLayers <= MaxLayers);
+    for (int32 i = 0; i < InNumLayers; i++)
+    {
+        const FCollisionDebuggerRayHit& Layer = InLayers[i];
+        Pool.Set(First + i, FLinearColor(Layer.Normal.X, Layer.Normal.Y, Layer.Normal.Z, Layer.Time));
+    }
+    Entries[Index] = InNumLayers > 0 ? (uint32(First) << CountBits) | uint32(InNumLayers) : 0;
+}
+
+FLinearColor FCollisionDebuggerLayerBuffer::GetLayer(int32 Index, int32 Layer) const
+{
+    check(Layer < GetNumLayers(Index));
+    return Pool.Get(int32(Entries[Index] >> CountBits) + Layer);
+}
+
+void FCollisionDebuggerLayerBuffer::Invalidate()
+{
+    FMemory::Memzero(Entries.GetData(), Entries.Num() * sizeof(uint32));
+}
+
+bool FCollisionDebuggerLayerBuffer::NeedsCompaction() const
+{
+    // Without the second test a pool full of live layers that can't grow would compact every tick.
+    const int64 Used = NumUsed.load();
+    return Overflowed.load() || (Used * 4 > int64(Pool.Num()) * 3 && (Used - NumCompacted) * 4 > int64(Pool.Num()));
+}
+
+int32 FCollisionDebuggerLayerBuffer::Compact()
+{
+    check(IsInGameThread());
+
+    int64 NumLive = 0;
+    int32 NumMissing = 0;
+    for (const uint32 Entry : Entries)
+    {
+        NumLive += Entry & CountMask;
+        NumMissing += Entry == OverflowEntry ? 1 : 0;
+    }
+
+    // Copied pixels share their layers, each gets its own copy here.
+    int32 PoolRows = Pool.GetSize().Y;
+    while (int64(PoolRows) * PoolWidth < NumLive * 2 && PoolRows < MaxPoolRows)
+    {
+        PoolRows = FMath::Min(PoolRows * 2, MaxPoolRows);
+    }
+
+    FCollisionDebuggerHitBuffer NewPool;
+    NewPool.Init(FIntPoint(PoolWidth, PoolRows), Pool.GetFormat());
+    const int32 BytesPerLayer = Pool.GetBytesPerPixel();
+
+    int32 Used = 0;
+    for (uint32& Entry : Entries)
+    {
+        const int32 Count = int32(Entry & CountMask);
+        if (Count == 0 || Used + Count > NewPool.Num())
+        {
+            NumMissing += Count > 0 ? 1 : 0;
+            Entry = 0;
+            continue;
+        }
+
+        FMemory::Memcpy(NewPool.GetData() + Used * BytesPerLayer, Pool.GetData() + int32(Entry >> CountBits) * BytesPerLayer, Count * BytesPerLayer);
+        Entry = (uint32(Used) << CountBits) | uint32(Count);
+        Used += Count;
+    }
+
+    Pool = MoveTemp(NewPool);
+    NumUsed = Used;
+    NumCompacted = Used;
+    Overflowed = false;
+    return Used + NumMissing <= Pool.Num() ? NumMissing : 0;
+}
+
+void FCollisionDebuggerLayerBuffer::GetPoolRects(int32 First, int32 End, TArray<FIntRect, TInlineAllocator<3>>& OutRects)
+{
+    OutRects.Reset();
+    if (End <= First)
+    {
+        return;
+    }
+
+    const int32 FirstRow = First / PoolWidth;
+    const int32 LastRow = (End - 1) / PoolWidth;
+    if (FirstRow == LastRow)
+    {
+        OutRects.Add(FIntRect(First % PoolWidth, FirstRow, (End - 1) % PoolWidth + 1, FirstRow + 1));
+        return;
+    }
+
+    // Only the layers in the range, other tiles may still be writing the rest of its first and last row.
+    OutRects.Add(FIntRect(First % PoolWidth, FirstRow, PoolWidth, FirstRow + 1));
+    if (LastRow > FirstRow + 1)
+    {
+        OutRects.Add(FIntRect(0, FirstRow + 1, PoolWidth, LastRow));
+    }
+    OutRects.Add(FIntRect(0, LastRow, (End - 1) % PoolWidth + 1, LastRow + 1));
+}
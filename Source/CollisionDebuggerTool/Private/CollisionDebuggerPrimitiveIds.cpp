@@ -0,0 +1,185 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerPrimitiveIds.h"
+#include "Components/PrimitiveComponent.h"
+#include "Async/ParallelFor.h"
+
+
+uint32 FCollisionDebuggerPrimitiveTable::FindOrAdd(const UPrimitiveComponent* Component)
+{
+    if (!Component)
+    {
+        return NoPrimitive;
+    }
+
+    const TWeakObjectPtr<const UPrimitiveComponent> Key(Component);
+    {
+        FReadScopeLock ReadLock(Lock);
+        if (const uint32* Id = Ids.Find(Key))
+        {
+            return *Id;
+        }
+    }
+
+    FWriteScopeLock WriteLock(Lock);
+    if (const uint32* Id = Ids.Find(Key))
+    {
+        return *Id;
+    }
+    Primitives.Add(Key);
+    return Ids.Add(Key, uint32(Primitives.Num()));
+}
+
+uint32 FCollisionDebuggerPrimitiveTable::Find(const UPrimitiveComponent* Component) const
+{
+    FReadScopeLock ReadLock(Lock);
+    const uint32* Id = Ids.Find(TWeakObjectPtr<const UPrimitiveComponent>(Component));
+    return Id ? *Id : NoPrimitive;
+}
+
+UPrimitiveComponent* FCollisionDebuggerPrimitiveTable::Get(uint32 Id) const
+{
+    FReadScopeLock ReadLock(Lock);
+    if (Id == NoPrimitive || Id > uint32(Primitives.Num()))
+    {
+        return nullptr;
+    }
+    return const_cast<UPrimitiveComponent*>(Primitives[Id - 1].Get());
+}
+
+int32 FCollisionDebuggerPrimitiveTable::Num() const
+{
+    FReadScopeLock ReadLock(Lock);
+    return Primitives.Num();
+}
+
+void FCollisionDebuggerPrimitiveTable::Reset()
+{
+    FWriteScopeLock WriteLock(Lock);
+    Ids.Reset();
+    Primitives.Reset();
+}
+
+void FCollisionDebuggerPrimitiveTable::Compact(const TBitArray<>& Live, TArray<uint32>& OutRemap)
+{
+    check(IsInGameThread());
+    FWriteScopeLock WriteLock(Lock);
+
+    OutRemap.Init(NoPrimitive, Primitives.Num() + 1);
+    TArray<TWeakObjectPtr<const UPrimitiveComponent>> Kept;
+    Ids.Reset();
+    for (int32 i = 0; i < Primitives.Num(); i++)
+    {
+        const int32 Id = i + 1;
+        if (Live.IsValidIndex(Id) && Live[Id] && Primitives[i].IsValid())
+        {
+            Kept.Add(Primitives[i]);
+            OutRemap[Id] = Ids.Add(Primitives[i], uint32(Kept.Num()));
+        }
+    }
+    Primitives = MoveTemp(Kept);
+}
+
+void FCollisionDebuggerPrimitiveIds::Init(FIntPoint InSize)
+{
+    Size = InSize;
+    Ids.Init(FCollisionDebuggerPrimitiveTable::NoPrimitive, Size.X * Size.Y);
+    Table.Reset();
+    NumCompacted = 0;
+}
+
+void FCollisionDebuggerPrimitiveIds::Empty()
+{
+    Size = FIntPoint::ZeroValue;
+    Ids.Empty();
+    Table.Reset();
+    NumCompacted = 0;
+}
+
+bool FCollisionDebuggerPrimitiveIds::NeedsCompaction() const
+{
+    const int32 Num = Table.Num();
+    return Num >= MinCompactionSize && Num >= NumCompacted * 2;
+}
+
+void FCollisionDebuggerPrimitiveIds::MarkLive(TBitArray<>& OutLive) const
+{
+    for (const uint32 Id : Ids)
+    {
+        if (OutLive.IsValidIndex(int32(Id)))
+        {
+            OutLive[Id] = true;
+        }
+    }
+}
+
+void FCollisionDebuggerPrimitiveIds::Compact(const TBitArray<>& Live, TArray<uint32>& OutRemap)
+{
+    Table.Compact(Live, OutRemap);
+    ParallelFor(Size.Y, [&](int32 y)
+    {
+        for (int32 Index = y * Size.X; Index < (y + 1) * Size.X; Index++)
+        {
+            Ids[Index] = OutRemap.IsValidIndex(int32(Ids[Index])) ? OutRemap[Ids[Index]] : FCollisionDebuggerPrimitiveTable::NoPrimitive;
+        }
+    });
+    NumCompacted = Table.Num();
+}
+
+bool FCollisionDebuggerPrimitiveIds::GetBounds(uint32 Id, FIntRect& OutRect) const
+{
+    if (Id == FCollisionDebuggerPrimitiveTable::NoPrimitive)
+    {
+        return false;
+    }
+
+    TArray<FIntRect> Rows;
+    Rows.SetNumUninitialized(Size.Y);
+    ParallelFor(Size.Y, [&](int32 y)
+    {
+        FIntRect& Row = Rows[y];
+        Row = FIntRect(Size.X, y, -1, y + 1);
+        const uint32* RowIds = Ids.GetData() + y * Size.X;
+        for (int32 x = 0; x < Size.X; x++)
+        {
+            if (RowIds[x] == Id)
+            {
+                Row.Min.X = FMath::Min(Row.Min.X, x);
+                Row.Max.X = x + 1;
+            }
+        }
+    });
+
+    bool Found = false;
+    for (const FIntRect& Row : Rows)
+    {
+        if (Row.Max.X < 0)
+        {
+            continue;
+        }
+        OutRect = Found ? FIntRect(FIntPoint::ComponentMin(OutRect.Min, Row.Min), FIntPoint::ComponentMax(OutRect.Max, Row.Max)) : Row;
+        Found = true;
+    }
+    return Found;
+}
+
+bool FCollisionDebuggerPrimitiveIds::GetMask(uint32 Id, FIntRect& OutRect, TArray<uint8>& OutMask) const
+{
+    if (!GetBounds(Id, OutRect))
+    {
+        return false;
+    }
+
+    OutMask.SetNumUninitialized(OutRect.Area());
+    for (int32 y = OutRect.Min.Y; y < OutRect.Max.Y; y++)
+    {
+        const uint32* RowIds = Ids.GetData() + y * Size.X;
+        uint8* RowMask = OutMask.GetData() + (y - OutRect.Min.Y) * OutRect.Width();
+        for (int32 x = OutRect.Min.X; x < OutRect.Max.X; x++)
+        {
+            RowMask[x - OutRect.Min.X] = RowIds[x] == Id ? 1 : 0;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerProgressive.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugProgressive(
+    TEXT("CollisionDebug.Progressive"),
+    0,
+    TEXT("Refine the debug view coarse to fine instead of sweeping it at full resolution.\n")
+    TEXT(" 0: off \n")
+    TEXT(" 1: on  \n"),
+    ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugProgressiveStride(
+    TEXT("CollisionDebug.Progressive.Stride"),
+    8,
+    TEXT("Pixel stride of the first, coarsest progressive pass. Rounded down to a power of two, max 64\n")
+    TEXT("and at most the tile size.\n"),
+    ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarCollisionDebugProgressiveNormalThreshold(
+    TEXT("CollisionDebug.Progressive.NormalThreshold"),
+    .95f,
+    TEXT("Neighbouring samples whose normals have a smaller dot product than this get refined.\n"),
+    ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarCollisionDebugProgressiveDepthThreshold(
+    TEXT("CollisionDebug.Progressive.DepthThreshold"),
+    .05f,
+    TEXT("Neighbouring samples whose hit distance differs by more than this fraction get refined.\n"),
+    ECVF_Default);
+
+
+bool FCollisionDebuggerProgressiveRefinement::IsEnabled()
+{
+    return CVarCollisionDebugProgressive.GetValueOnGameThread() > 0;
+}
+
+void FCollisionDebuggerProgressiveRefinement::Reset()
+{
+    Stride = 0;
+    ActiveBlocks.Reset();
+    NextBlocks.Reset();
+}
+
+void FCollisionDebuggerProgressiveRefinement::Begin(FIntPoint InSize, int32 TileSize, TArrayView<uint8> NeedsTrace)
+{
+    check(NeedsTrace.Num() == InSize.X * InSize.Y);
+
+    Size = InSize;
+    const int32 MaxStride = FMath::Max(FMath::Min(TileSize, 64), FinestStride);
+    Stride = FMath::RoundDownToPowerOfTwo(FMath::Clamp(CVarCollisionDebugProgressiveStride.GetValueOnGameThread(), FinestStride, MaxStride));
+    ActiveBlocks.Reset();
+
+    FMemory::Memzero(NeedsTrace.GetData(), NeedsTrace.Num());
+    for (int32 y = 0; y < Size.Y; y += Stride)
+    {
+        for (int32 x = 0; x < Size.X; x += Stride)
+        {
+            NeedsTrace[x + (y * Size.X)] = uint8(Stride);
+            ActiveBlocks.Add(FIntPoint(x, y));
+        }
+    }
+}
+
+bool FCollisionDebuggerProgressiveRefinement::BlockNeedsRefinement(const FCollisionDebuggerHitBuffer& Pixels, const FIntPoint& Block) const
+{
+    const float NormalThreshold = CVarCollisionDebugProgressiveNormalThreshold.GetValueOnGameThread();
+    const float DepthThreshold = CVarCollisionDebugProgressiveDepthThreshold.GetValueOnGameThread();
+
+    const int32 x1 = FMath::Min(Block.X + Stride, Size.X - 1);
+    const int32 y1 = FMath::Min(Block.Y + Stride, Size.Y - 1);
+    const FLinearColor Corner = Pixels.Get(Block.X + (Block.Y * Size.X));
+    const FLinearColor Neighbours[] = {
+        Pixels.Get(x1 + (Block.Y * Size.X)),
+        Pixels.Get(Block.X + (y1 * Size.X)),
+        Pixels.Get(x1 + (y1 * Size.X)),
+    };
+
+    for (const FLinearColor& Other : Neighbours)
+    {
+        const bool CornerHit = Corner.A >= 0.f;
+        if (CornerHit != (Other.A >= 0.f))
+        {
+            return true;
+        }
+        if (!CornerHit)
+        {
+            continue;
+        }
+
+        const float NormalDot = Corner.R * Other.R + Corner.G * Other.G + Corner.B * Other.B;
+        const float MaxDepth = FMath::Max3(Corner.A, Other.A, UE_KINDA_SMALL_NUMBER);
+        if (NormalDot < NormalThreshold || FMath::Abs(Corner.A - Other.A) / MaxDepth > DepthThreshold)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FCollisionDebuggerProgressiveRefinement::Advance(const FCollisionDebuggerHitBuffer& Pixels, TArrayView<uint8> NeedsTrace)
+{
+    check(Pixels.Num() == Size.X * Size.Y && NeedsTrace.Num() == Pixels.Num());
+
+    if (Stride <= FinestStride)
+    {
+        Reset();
+        return false;
+    }
+
+    const int32 Half = Stride / 2;
+    NextBlocks.Reset();
+    for (const FIntPoint& Block : ActiveBlocks)
+    {
+        if (!BlockNeedsRefinement(Pixels, Block))
+        {
+            continue;
+        }
+
+        // The block's own corner is already traced, the other three children are new samples.
+        const FIntPoint Children[] = { Block, Block + FIntPoint(Half, 0), Block + FIntPoint(0, Half), Block + FIntPoint(Half, Half) };
+        for (int32 i = 0; i < UE_ARRAY_COUNT(Children); i++)
+        {
+            const FIntPoint& Child = Children[i];
+            if (Child.X >= Size.X || Child.Y >= Size.Y)
+            {
+                continue;
+            }
+            if (i > 0)
+            {
+                NeedsTrace[Child.X + (Child.Y * Size.X)] = uint8(Half);
+            }
+            NextBlocks.Add(Child);
+        }
+    }
+
+    Stride = Half;
+    Swap(ActiveBlocks, NextBlocks);
+
+    if (ActiveBlocks.Num() == 0)
+    {
+        Reset();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,379 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerRayQuery.h"
+#include "CollisionDebuggerHitBuffer.h"
+#include "CollisionDebuggerSceneMirror.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "Engine/CollisionProfile.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "Physics/GenericPhysicsInterface.h"
+#include "Physics/PhysicsInterfaceCore.h"
+#include "UObject/GarbageCollection.h"
+
+namespace CollisionDebuggerRayQuery
+{
+    static const uint32 MaxTime24 = 0xFFFFFF;
+
+    /** Primitive table lookups for one batch, neighbouring rays mostly hit the same primitive. */
+    struct FPrimitiveIdCache
+    {
+        FCollisionDebuggerPrimitiveTable* Table = nullptr;
+        const UPrimitiveComponent* LastComponent = nullptr;
+        uint32 LastId = FCollisionDebuggerPrimitiveTable::NoPrimitive;
+
+        uint32 Get(const UPrimitiveComponent* Component)
+        {
+            if (!Table)
+            {
+                return FCollisionDebuggerPrimitiveTable::NoPrimitive;
+            }
+            if (Component != LastComponent)
+            {
+                LastComponent = Component;
+                LastId = Table->FindOrAdd(Component);
+            }
+            return LastId;
+        }
+    };
+
+    /** Channels a body blocks, one bit per channel, and the body's object type. */
+    struct FBodyResponse
+    {
+        uint32 BlockMask = 0;
+        ECollisionChannel ObjectType = ECC_WorldStatic;
+    };
+
+    /**
+     * Responses of the bodies hits land on for one batch. Bodies may override the responses of
+     * their component, the component's are only taken for hits without a body.
+     */
+    struct FBodyResponseCache
+    {
+        TMap<TTuple<const UPrimitiveComponent*, FName, int32>, FBodyResponse> Responses;
+
+        const FBodyResponse& Get(const UPrimitiveComponent& Component, const FHitResult& Hit)
+        {
+            const TTuple<const UPrimitiveComponent*, FName, int32> Key(&Component, Hit.BoneName, Hit.Item);
+            if (const FBodyResponse* Cached = Responses.Find(Key))
+            {
+                return *Cached;
+            }
+
+            const FBodyInstance* Body = Component.GetBodyInstance(Hit.BoneName, false, Hit.Item);
+            const FCollisionResponseContainer& Container = Body ? Body->GetResponseToChannels() : Component.GetCollisionResponseToChannels();
+            FBodyResponse Response;
+            for (int32 Channel = 0; Channel < 32; Channel++)
+            {
+                if (Container.GetResponse(ECollisionChannel(Channel)) == ECR_Block)
+                {
+                    Response.BlockMask |= 1u << Channel;
+                }
+            }
+            Response.ObjectType = Body ? Body->GetObjectType() : Component.GetCollisionObjectType();
+            return Responses.Add(Key, Response);
+        }
+    };
+}
+
+FCollisionDebuggerResponseLayer FCollisionDebuggerResponseLayer::Make(const FVector3f& InNormal, float InTime, ECollisionChannel InObjectType, uint32 InBlockMask, uint32 InPrimitiveId)
+{
+    using namespace CollisionDebuggerRayQuery;
+
+    FCollisionDebuggerResponseLayer Layer;
+    Layer.Normal = FCollisionDebuggerHitBuffer::PackNormal(InNormal);
+    const uint32 Time = uint32(FMath::Clamp(FMath::RoundToInt64(double(InTime) * MaxTime24), int64(0), int64(MaxTime24)));
+    Layer.TimeAndObjectType = (Time << 8) | (uint32(InObjectType) & 0xFF);
+    Layer.BlockMask = InBlockMask;
+    Layer.PrimitiveId = InPrimitiveId;
+    return Layer;
+}
+
+FVector3f FCollisionDebuggerResponseLayer::GetNormal() const
+{
+    return FCollisionDebuggerHitBuffer::UnpackNormal(Normal);
+}
+
+float FCollisionDebuggerResponseLayer::GetTime() const
+{
+    return float(double(TimeAndObjectType >> 8) / CollisionDebuggerRayQuery::MaxTime24);
+}
+
+FCollisionDebuggerResponseFilter FCollisionDebuggerResponseFilter::Make(const FInputRenderSettingsInternal& Settings)
+{
+    FCollisionDebuggerResponseFilter Filter;
+    if (Settings.bIsChannelTest)
+    {
+        Filter.ChannelBit = 1u << uint32(Settings.ChannelToTest.GetValue());
+        Filter.BlockedObjectTypes = ~0u;
+        return Filter;
+    }
+
+    ECollisionChannel Channel = ECC_WorldStatic;
+    FCollisionResponseParams ResponseParams;
+    if (UCollisionProfile::GetChannelAndResponseParams(Settings.ProfileNameToTest, Channel, ResponseParams))
+    {
+        Filter.ChannelBit = 1u << uint32(Channel);
+        for (int32 ObjectType = 0; ObjectType < 32; ObjectType++)
+        {
+            if (ResponseParams.CollisionResponse.GetResponse(ECollisionChannel(ObjectType)) == ECR_Block)
+            {
+                Filter.BlockedObjectTypes |= 1u << ObjectType;
+            }
+        }
+    }
+    return Filter;
+}
+
+FCollisionDebuggerRayHit FCollisionDebuggerResponseFilter::Resolve(const FCollisionDebuggerResponseLayer* Layers, int32 NumLayers) const
+{
+    FCollisionDebuggerRayHit Hit;
+    for (int32 i = 0; i < NumLayers; i++)
+    {
+        if (Blocks(Layers[i]))
+        {
+            Hit.Normal = Layers[i].GetNormal();
+            Hit.Time = Layers[i].GetTime();
+            Hit.PrimitiveId = Layers[i].PrimitiveId;
+            break;
+        }
+    }
+    return Hit;
+}
+
+
+FCollisionDebuggerRayQuery::FCollisionDebuggerRayQuery(const UWorld* InWorld, const FInputRenderSettingsInternal& Settings, FCollisionDebuggerPrimitiveTable* InPrimitives, FCollisionDebuggerMirrorScenePtr InMirror)
+    : World(InWorld)
+    , Primitives(InPrimitives)
+    , Mirror(MoveTemp(InMirror))
+    , QueryParams(SCENE_QUERY_STAT(CollisionDebuggerTrace), Settings.TraceComplex)
+    , ResponseParams(FCollisionResponseParams::DefaultResponseParam)
+    , Filter(FCollisionDebuggerResponseFilter::Make(Settings))
+{
+    QueryParams.bReturnPhysicalMaterial = false;
+    QueryParams.bReturnFaceIndex = false;
+
+    if (Settings.bIsChannelTest)
+    {
+        TraceChannel = Settings.ChannelToTest;
+    }
+    else if (!UCollisionProfile::GetChannelAndResponseParams(Settings.ProfileNameToTest, TraceChannel, ResponseParams))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Collision debugger: unknown collision profile %s"), *Settings.ProfileNameToTest.ToString());
+        World = nullptr;
+    }
+    else
+    {
+        ProfileName = Settings.ProfileNameToTest;
+    }
+}
+
+void FCollisionDebuggerRayQuery::TraceBatch(const FVector& Origin, TConstArrayView<FVector3f> Directions, double Length, TArrayView<FCollisionDebuggerRayHit> OutHits) const
+{
+    check(Directions.Num() == OutHits.Num());
+
+    // The mirror doesn't need the physics scene, only the queries below do.
+    if (!IsValid() || (!Mirror.IsValid() && !World->GetPhysicsScene()))
+    {
+        for (FCollisionDebuggerRayHit& Hit : OutHits)
+        {
+            Hit = FCollisionDebuggerRayHit();
+        }
+        return;
+    }
+
+    if (Mirror.IsValid())
+    {
+        // Tiles span frames, the components the mirror reads must not be collected while the row traces them.
+        TOptional<FGCScopeGuard> GCGuard;
+        if (!IsInGameThread())
+        {
+            GCGuard.Emplace();
+        }
+
+        CollisionDebuggerRayQuery::FPrimitiveIdCache PrimitiveIds{ Primitives };
+        for (int32 i = 0; i < Directions.Num(); i++)
+        {
+            const UPrimitiveComponent* Component = nullptr;
+            OutHits[i] = Mirror->Trace(Origin, Directions[i] * float(Length), QueryParams.bTraceComplex, Component);
+            OutHits[i].PrimitiveId = OutHits[i].IsHit() ? PrimitiveIds.Get(Component) : FCollisionDebuggerPrimitiveTable::NoPrimitive;
+        }
+        return;
+    }
+
+    FPhysicsCommand::ExecuteRead(World->GetPhysicsScene(), [&]()
+    {
+        CollisionDebuggerRayQuery::FPrimitiveIdCache PrimitiveIds{ Primitives };
+        FHitResult RV_Hit;
+        for (int32 i = 0; i < Directions.Num(); i++)
+        {
+            const FVector End = Origin + FVector(Directions[i]) * Length;
+            FCollisionDebuggerRayHit& OutHit = OutHits[i];
+
+            if (FPhysicsInterface::RaycastSingle(World, RV_Hit, Origin, End, TraceChannel, QueryParams, ResponseParams))
+            {
+                OutHit.Normal = FVector3f(RV_Hit.Normal);
+                OutHit.Time = RV_Hit.Time;
+                OutHit.PrimitiveId = PrimitiveIds.Get(RV_Hit.GetComponent());
+            }
+            else
+            {
+                OutHit = FCollisionDebuggerRayHit();
+            }
+        }
+    });
+}
+
+FTraceHandle FCollisionDebuggerRayQuery::TraceAsync(const FVector& Origin, const FVector3f& Direction, double Length, FTraceDelegate& Delegate, uint32 UserData) const
+{
+    check(IsInGameThread());
+    if (!IsValid())
+    {
+        return FTraceHandle();
+    }
+
+    // Queuing only appends to the world's async trace buffer, the world itself is not changed.
+    UWorld* AsyncWorld = const_cast<UWorld*>(World);
+    const FVector End = Origin + FVector(Direction) * Length;
+    if (!ProfileName.IsNone())
+    {
+        return AsyncWorld->AsyncLineTraceByProfile(EAsyncTraceType::Single, Origin, End, ProfileName, QueryParams, &Delegate, UserData);
+    }
+    return AsyncWorld->AsyncLineTraceByChannel(EAsyncTraceType::Single, Origin, End, TraceChannel, QueryParams, ResponseParams, &Delegate, UserData);
+}
+
+void FCollisionDebuggerRayQuery::TraceLayers(const FVector& Origin, TConstArrayView<FVector3f> Directions, double Length, int32 MaxLayers, TArrayView<FCollisionDebuggerRayHit> OutLayers, TArrayView<uint8> OutNumLayers) const
+{
+    using namespace CollisionDebuggerRayQuery;
+
+    check(Directions.Num() == OutNumLayers.Num());
+    check(OutLayers.Num() >= Directions.Num() * MaxLayers);
+
+    if (!IsValid() || !World->GetPhysicsScene())
+    {
+        for (uint8& NumLayers : OutNumLayers)
+        {
+            NumLayers = 0;
+        }
+        return;
+    }
+
+    FPhysicsCommand::ExecuteRead(World->GetPhysicsScene(), [&]()
+    {
+        // A blocking hit ends a channel query, only an object query sees what lies behind it.
+        const FCollisionObjectQueryParams ObjectParams(FCollisionObjectQueryParams::InitType::AllObjects);
+        FBodyResponseCache BodyResponses;
+        FPrimitiveIdCache PrimitiveIds{ Primitives };
+        TArray<FHitResult> RV_Hits;
+        for (int32 i = 0; i < Directions.Num(); i++)
+        {
+            const FVector End = Origin + FVector(Directions[i]) * Length;
+            FCollisionDebuggerRayHit* Layers = OutLayers.GetData() + i * MaxLayers;
+            int32 NumLayers = 0;
+
+            RV_Hits.Reset();
+            FPhysicsInterface::RaycastMulti(World, RV_Hits, Origin, End, TraceChannel, QueryParams, FCollisionResponseParams::DefaultResponseParam, ObjectParams);
+            RV_Hits.Sort([](const FHitResult& A, const FHitResult& B) { return A.Time < B.Time; });
+
+            for (const FHitResult& RV_Hit : RV_Hits)
+            {
+                const UPrimitiveComponent* Component = RV_Hit.GetComponent();
+                if (!Component)
+                {
+                    continue;
+                }
+
+                const FBodyResponse& Response = BodyResponses.Get(*Component, RV_Hit);
+                if (!Filter.Blocks(Response.BlockMask, uint32(Response.ObjectType)))
+                {
+                    continue;
+                }
+
+                FCollisionDebuggerRayHit& Layer = Layers[NumLayers++];
+                Layer.Normal = FVector3f(RV_Hit.Normal);
+                Layer.Time = RV_Hit.Time;
+                Layer.PrimitiveId = PrimitiveIds.Get(Component);
+                if (NumLayers == MaxLayers)
+                {
+                    break;
+                }
+            }
+            OutNumLayers[i] = uint8(NumLayers);
+        }
+    });
+}
+
+FCollisionDebuggerResponseQuery::FCollisionDebuggerResponseQuery(const UWorld* InWorld, const FInputRenderSettingsInternal& Settings, int32 InMaxLayers, FCollisionDebuggerPrimitiveTable* InPrimitives)
+    : World(InWorld)
+    , Primitives(InPrimitives)
+    , MaxLayers(FMath::Clamp(InMaxLayers, 1, 255))
+    , QueryParams(SCENE_QUERY_STAT(CollisionDebuggerResponseTrace), Settings.TraceComplex)
+    , ObjectParams(FCollisionObjectQueryParams::InitType::AllObjects)
+{
+    QueryParams.bReturnPhysicalMaterial = false;
+    QueryParams.bReturnFaceIndex = false;
+}
+
+void FCollisionDebuggerResponseQuery::TraceBatch(const FVector& Origin, TConstArrayView<FVector3f> Directions, double Length, TArrayView<FCollisionDebuggerResponseLayer> OutLayers, TArrayView<uint8> OutNumLayers) const
+{
+    using namespace CollisionDebuggerRayQuery;
+
+    check(Directions.Num() == OutNumLayers.Num());
+    check(OutLayers.Num() >= Directions.Num() * MaxLayers);
+
+    if (!World || !World->GetPhysicsScene())
+    {
+        for (uint8& NumLayers : OutNumLayers)
+        {
+            NumLayers = 0;
+        }
+        return;
+    }
+
+    FPhysicsCommand::ExecuteRead(World->GetPhysicsScene(), [&]()
+    {
+        // Neighbouring rays mostly hit the same few bodies.
+        FBodyResponseCache BodyResponses;
+        FPrimitiveIdCache PrimitiveIds{ Primitives };
+        TArray<FHitResult> RV_Hits;
+        for (int32 i = 0; i < Directions.Num(); i++)
+        {
+            const FVector End = Origin + FVector(Directions[i]) * Length;
+            FCollisionDebuggerResponseLayer* Layers = OutLayers.GetData() + i * MaxLayers;
+            int32 NumLayers = 0;
+
+            // Object queries report every primitive along the ray as a touch.
+            RV_Hits.Reset();
+            FPhysicsInterface::RaycastMulti(World, RV_Hits, Origin, End, ECC_WorldStatic, QueryParams, FCollisionResponseParams::DefaultResponseParam, ObjectParams);
+            RV_Hits.Sort([](const FHitResult& A, const FHitResult& B) { return A.Time < B.Time; });
+
+            uint32 Covered[32] = {};
+            for (const FHitResult& RV_Hit : RV_Hits)
+            {
+                const UPrimitiveComponent* Component = RV_Hit.GetComponent();
+                if (!Component)
+                {
+                    continue;
+                }
+
+                const FBodyResponse& Response = BodyResponses.Get(*Component, RV_Hit);
+                const uint32 BlockMask = Response.BlockMask;
+                const ECollisionChannel ObjectType = Response.ObjectType;
+                uint32& ObjectTypeCovered = Covered[uint32(ObjectType) & 31];
+                if ((BlockMask & ~ObjectTypeCovered) == 0)
+                {
+                    continue;
+                }
+
+                ObjectTypeCovered |= BlockMask;
+                Layers[NumLayers++] = FCollisionDebuggerResponseLayer::Make(FVector3f(RV_Hit.Normal), RV_Hit.Time, ObjectType, BlockMask, PrimitiveIds.Get(Component));
+                if (NumLayers == MaxLayers)
+                {
+                    break;
+                }
+            }
+            OutNumLayers[i] = uint8(NumLayers);
+        }
+    });
+}
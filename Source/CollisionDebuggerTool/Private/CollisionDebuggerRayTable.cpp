@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerRayTable.h"
+
+
+FCollisionDebuggerRayTable::FCollisionDebuggerRayTable(FIntPoint InSize, float InFovScale)
+    : Size(InSize)
+    , FovScale(InFovScale)
+    , Stride(Align(InSize.X, 4))
+{
+    const int32 Num = Stride * Size.Y;
+    DirX.SetNumZeroed(Num);
+    DirY.SetNumZeroed(Num);
+    DirZ.SetNumZeroed(Num);
+
+    for (int32 y = 0; y < Size.Y; y++)
+    {
+        const float yOff = ((y / (float)(Size.Y)) - .5f) * -2.f;
+        for (int32 x = 0; x < Size.X; x++)
+        {
+            const float xOff = ((x / (float)(Size.X)) - .5f) * 2.f;
+            const FVector3f dir = FVector3f(1.f, xOff * FovScale, yOff * FovScale).GetSafeNormal();
+
+            const int32 index = x + (y * Stride);
+            DirX[index] = dir.X;
+            DirY[index] = dir.Y;
+            DirZ[index] = dir.Z;
+        }
+    }
+}
+
+FVector3f FCollisionDebuggerRayTable::GetDirection(int32 X, int32 Y) const
+{
+    const int32 index = X + (Y * Stride);
+    return FVector3f(DirX[index], DirY[index], DirZ[index]);
+}
+
+void FCollisionDebuggerRayTable::TransformRow(int32 Row, int32 MinX, int32 Count, const FQuat& Rotation, FVector3f* OutDirections) const
+{
+    check(Row >= 0 && Row < Size.Y && MinX >= 0 && MinX + Count <= Size.X);
+
+    const FVector3f AxisX = FVector3f(Rotation.GetAxisX());
+    const FVector3f AxisY = FVector3f(Rotation.GetAxisY());
+    const FVector3f AxisZ = FVector3f(Rotation.GetAxisZ());
+
+    const int32 Base = MinX + (Row * Stride);
+    const float* SrcX = DirX.GetData() + Base;
+    const float* SrcY = DirY.GetData() + Base;
+    const float* SrcZ = DirZ.GetData() + Base;
+
+    // World = X * AxisX + Y * AxisY + Z * AxisZ, four rays per iteration.
+    const VectorRegister4Float XX = VectorSetFloat1(AxisX.X);
+    const VectorRegister4Float XY = VectorSetFloat1(AxisX.Y);
+    const VectorRegister4Float XZ = VectorSetFloat1(AxisX.Z);
+    const VectorRegister4Float YX = VectorSetFloat1(AxisY.X);
+    const VectorRegister4Float YY = VectorSetFloat1(AxisY.Y);
+    const VectorRegister4Float YZ = VectorSetFloat1(AxisY.Z);
+    const VectorRegister4Float ZX = VectorSetFloat1(AxisZ.X);
+    const VectorRegister4Float ZY = VectorSetFloat1(AxisZ.Y);
+    const VectorRegister4Float ZZ = VectorSetFloat1(AxisZ.Z);
+
+    alignas(16) float OutX[4];
+    alignas(16) float OutY[4];
+    alignas(16) float OutZ[4];
+
+    int32 i = 0;
+    for (; i + 4 <= Count; i += 4)
+    {
+        const VectorRegister4Float DX = VectorLoad(SrcX + i);
+        const VectorRegister4Float DY = VectorLoad(SrcY + i);
+        const VectorRegister4Float DZ = VectorLoad(SrcZ + i);
+
+        VectorStoreAligned(VectorMultiplyAdd(DZ, ZX, VectorMultiplyAdd(DY, YX, VectorMultiply(DX, XX))), OutX);
+        VectorStoreAligned(VectorMultiplyAdd(DZ, ZY, VectorMultiplyAdd(DY, YY, VectorMultiply(DX, XY))), OutY);
+        VectorStoreAligned(VectorMultiplyAdd(DZ, ZZ, VectorMultiplyAdd(DY, YZ, VectorMultiply(DX, XZ))), OutZ);
+
+        for (int32 j = 0; j < 4; j++)
+        {
+            OutDirections[i + j] = FVector3f(OutX[j], OutY[j], OutZ[j]);
+        }
+    }
+
+    for (; i < Count; i++)
+    {
+        OutDirections[i] = AxisX * SrcX[i] + AxisY * SrcY[i] + AxisZ * SrcZ[i];
+    }
+}
@@ -0,0 +1,228 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerReprojection.h"
+#include "CollisionDebuggerStats.h"
+#include "Async/ParallelFor.h"
+
+#include <atomic>
+
+namespace CollisionDebuggerReprojection
+{
+    // Depth in the high word so the smallest key is the closest hit, source index in the low word.
+    static const int64 EmptyKey = MAX_int64;
+    static const uint32 InfiniteDepthBits = 0x7F800000;
+
+    static int64 MakeKey(uint32 DepthBits, int32 SourceIndex)
+    {
+        return (int64(DepthBits) << 32) | uint32(SourceIndex);
+    }
+
+    // Positive floats keep their order when compared as integers.
+    static uint32 DepthToBits(float Depth)
+    {
+        uint32 Bits;
+        FMemory::Memcpy(&Bits, &Depth, sizeof(Bits));
+        return Bits;
+    }
+
+    static float BitsToDepth(uint32 Bits)
+    {
+        float Depth;
+        FMemory::Memcpy(&Depth, &Bits, sizeof(Depth));
+        return Depth;
+    }
+
+    static void AtomicMin(int64* Dest, int64 Key)
+    {
+        int64 Current = *Dest;
+        while (Key < Current)
+        {
+            const int64 Previous = FPlatformAtomics::InterlockedCompareExchange(Dest, Key, Current);
+            if (Previous == Current)
+            {
+                return;
+            }
+            Current = Previous;
+        }
+    }
+}
+
+bool FCollisionDebuggerReprojection::ProjectDirection(const FVector& LocalDirection, const FCollisionDebuggerRayTable& RayTable, FIntPoint& OutPixel)
+{
+    if (LocalDirection.X <= UE_KINDA_SMALL_NUMBER)
+    {
+        return false;
+    }
+
+    const FIntPoint Size = RayTable.GetSize();
+    const double xOff = LocalDirection.Y / (LocalDirection.X * RayTable.GetFovScale());
+    const double yOff = LocalDirection.Z / (LocalDirection.X * RayTable.GetFovScale());
+
+    OutPixel.X = FMath::RoundToInt((xOff * .5 + .5) * Size.X);
+    OutPixel.Y = FMath::RoundToInt((yOff * -.5 + .5) * Size.Y);
+    return OutPixel.X >= 0 && OutPixel.X < Size.X && OutPixel.Y >= 0 && OutPixel.Y < Size.Y;
+}
+
+bool FCollisionDebuggerReprojection::ProjectBounds(const FBox& Bounds, const FTransform& Camera, const FCollisionDebuggerRayTable& RayTable, FIntRect& OutRect)
+{
+    if (!Bounds.IsValid)
+    {
+        return false;
+    }
+
+    const FIntPoint Size = RayTable.GetSize();
+    const double FovScale = RayTable.GetFovScale();
+    const FVector2D Unbounded(TNumericLimits<double>::Max());
+    FVector2D Min = Unbounded;
+    FVector2D Max = -Unbounded;
+    int32 NumInFront = 0;
+
+    for (int32 Corner = 0; Corner < 8; Corner++)
+    {
+        const FVector WorldCorner(
+            (Corner & 1) ? Bounds.Max.X : Bounds.Min.X,
+            (Corner & 2) ? Bounds.Max.Y : Bounds.Min.Y,
+            (Corner & 4) ? Bounds.Max.Z : Bounds.Min.Z);
+        const FVector Local = Camera.GetRotation().UnrotateVector(WorldCorner - Camera.GetLocation());
+        if (Local.X <= UE_KINDA_SMALL_NUMBER)
+        {
+            continue;
+        }
+
+        const FVector2D Pixel(
+            (Local.Y / (Local.X * FovScale) * .5 + .5) * Size.X,
+            (Local.Z / (Local.X * FovScale) * -.5 + .5) * Size.Y);
+        Min = FVector2D::Min(Min, Pixel);
+        Max = FVector2D::Max(Max, Pixel);
+        NumInFront++;
+    }
+
+    if (NumInFront == 0)
+    {
+        return false;
+    }
+
+    const FIntRect View(FIntPoint::ZeroValue, Size);
+    if (NumInFront < 8)
+    {
+        OutRect = View;
+        return true;
+    }
+
+    // Clamp before converting, far off screen corners don't fit an int.
+    Min = FVector2D::Max(Min, FVector2D::ZeroVector);
+    Max = FVector2D::Min(Max, FVector2D(Size));
+    OutRect = FIntRect(FMath::FloorToInt(Min.X), FMath::FloorToInt(Min.Y), FMath::CeilToInt(Max.X) + 1, FMath::CeilToInt(Max.Y) + 1);
+    OutRect.Clip(View);
+    return !OutRect.IsEmpty();
+}
+
+int32 FCollisionDebuggerReprojection::Reproject(
+    FCollisionDebuggerHitBuffer& Pixels,
+    TArrayView<uint8> NeedsTrace,
+    const FCollisionDebuggerRayTable& RayTable,
+    const FTransform& OldCamera,
+    const FTransform& NewCamera,
+    double TraceLength,
+    TArrayView<uint32> PrimitiveIds)
+{
+    using namespace CollisionDebuggerReprojection;
+    COLLISIONDEBUGGER_SCOPE(Reproject);
+
+    const FIntPoint Size = RayTable.GetSize();
+    check(Pixels.Num() == Size.X * Size.Y && NeedsTrace.Num() == Pixels.Num());
+    check(PrimitiveIds.Num() == 0 || PrimitiveIds.Num() == Pixels.Num());
+
+    const ECollisionDebuggerHitFormat Format = Pixels.GetFormat();
+    const int32 Bpp = Pixels.GetBytesPerPixel();
+    SourcePixels.Reset(Pixels.Num() * Bpp);
+    SourcePixels.Append(Pixels.GetData(), Pixels.Num() * Bpp);
+    DepthKeys.Init(EmptyKey, Pixels.Num());
+    SourceIds.Reset(PrimitiveIds.Num());
+    SourceIds.Append(PrimitiveIds.GetData(), PrimitiveIds.Num());
+    const bool MoveIds = PrimitiveIds.Num() > 0;
+
+    const FQuat OldRotation = OldCamera.GetRotation();
+    const FVector OldPosition = OldCamera.GetLocation();
+    const FQuat ToNewLocal = NewCamera.GetRotation().Inverse() * OldRotation;
+    const FVector OldToNewLocal = NewCamera.GetRotation().UnrotateVector(OldPosition - NewCamera.GetLocation());
+
+    // Scatter every valid source pixel into the new view, keeping the closest per target pixel.
+    ParallelFor(Size.Y, [&](int32 y)
+    {
+        for (int32 x = 0; x < Size.X; x++)
+        {
+            const int32 index = x + (y * Size.X);
+            if (NeedsTrace[index])
+            {
+                continue;
+            }
+
+            const FLinearColor Source = FCollisionDebuggerHitBuffer::Decode(Format, SourcePixels.GetData() + index * Bpp);
+            const FVector Direction = ToNewLocal.RotateVector(FVector(RayTable.GetDirection(x, y)));
+
+            FIntPoint Target;
+            if (Source.A < 0.f)
+            {
+                if (ProjectDirection(Direction, RayTable, Target))
+                {
+                    AtomicMin(&DepthKeys[Target.X + (Target.Y * Size.X)], MakeKey(InfiniteDepthBits, index));
+                }
+                continue;
+            }
+
+            const FVector LocalHit = OldToNewLocal + Direction * (Source.A * TraceLength);
+            const double Depth = LocalHit.Size();
+            if (Depth < TraceLength && ProjectDirection(LocalHit, RayTable, Target))
+            {
+                AtomicMin(&DepthKeys[Target.X + (Target.Y * Size.X)], MakeKey(DepthToBits(float(Depth)), index));
+            }
+        }
+    });
+
+    // Resolve: take the winning source, or flag the pixel as disoccluded.
+    std::atomic<int32> NumFlagged{ 0 };
+    ParallelFor(Size.Y, [&](int32 y)
+    {
+        int32 RowFlagged = 0;
+        for (int32 x = 0; x < Size.X; x++)
+        {
+            const int32 index = x + (y * Size.X);
+            const int64 Key = DepthKeys[index];
+            if (Key == EmptyKey)
+            {
+                NeedsTrace[index] = 1;
+                RowFlagged++;
+                if (MoveIds)
+                {
+                    PrimitiveIds[index] = 0;
+                }
+                continue;
+            }
+
+            const uint32 DepthBits = uint32(uint64(Key) >> 32);
+            if (DepthBits == InfiniteDepthBits)
+            {
+                Pixels.SetMiss(index);
+                if (MoveIds)
+                {
+                    PrimitiveIds[index] = 0;
+                }
+            }
+            else
+            {
+                const FLinearColor Source = FCollisionDebuggerHitBuffer::Decode(Format, SourcePixels.GetData() + int32(uint32(Key)) * Bpp);
+                Pixels.Set(index, FLinearColor(Source.R, Source.G, Source.B, float(BitsToDepth(DepthBits) / TraceLength)));
+                if (MoveIds)
+                {
+                    PrimitiveIds[index] = SourceIds[int32(uint32(Key))];
+                }
+            }
+            NeedsTrace[index] = 0;
+        }
+        NumFlagged += RowFlagged;
+    });
+
+    return NumFlagged.load();
+}
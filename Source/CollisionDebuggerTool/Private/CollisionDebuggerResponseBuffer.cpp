@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerResponseBuffer.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugResponseMask(
+    TEXT("CollisionDebug.ResponseMask"),
+    0,
+    TEXT("Trace every pixel once against all object types and keep the block responses of what it hits,\n")
+    TEXT("so switching the tested channel or profile needs no new traces. Rays cost more in this mode.\n")
+    TEXT(" 0: off, every channel switch retraces the view \n")
+    TEXT(" 1: on  \n"),
+    ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugResponseMaskLayers(
+    TEXT("CollisionDebug.ResponseMask.Layers"),
+    4,
+    TEXT("Primitives kept per pixel by the response mask, 16 bytes each. Applied when the mask is created.\n"),
+    ECVF_Default);
+
+
+bool FCollisionDebuggerResponseBuffer::IsEnabled()
+{
+    return CVarCollisionDebugResponseMask.GetValueOnGameThread() > 0;
+}
+
+int32 FCollisionDebuggerResponseBuffer::GetConfiguredLayers()
+{
+    return FMath::Clamp(CVarCollisionDebugResponseMaskLayers.GetValueOnGameThread(), 1, 16);
+}
+
+void FCollisionDebuggerResponseBuffer::Init(FIntPoint InSize, int32 InMaxLayers)
+{
+    Size = InSize;
+    MaxLayers = InMaxLayers;
+    Layers.SetNumZeroed(Size.X * Size.Y * MaxLayers);
+    NumLayers.Init(Unknown, Size.X * Size.Y);
+}
+
+void FCollisionDebuggerResponseBuffer::Empty()
+{
+    Size = FIntPoint::ZeroValue;
+    Layers.Empty();
+    NumLayers.Empty();
+}
+
+void FCollisionDebuggerResponseBuffer::Set(int32 Index, const FCollisionDebuggerResponseLayer* InLayers, int32 InNumLayers)
+{
+    check(InNumLayers <= MaxLayers);
+    FMemory::Memcpy(Layers.GetData() + Index * MaxLayers, InLayers, InNumLayers * sizeof(FCollisionDebuggerResponseLayer));
+    NumLayers[Index] = uint8(InNumLayers);
+}
+
+void FCollisionDebuggerResponseBuffer::CopyPixel(int32 DestIndex, int32 SourceIndex)
+{
+    if (NumLayers[SourceIndex] != Unknown)
+    {
+        FMemory::Memcpy(Layers.GetData() + DestIndex * MaxLayers, Layers.GetData() + SourceIndex * MaxLayers, NumLayers[SourceIndex] * sizeof(FCollisionDebuggerResponseLayer));
+    }
+    NumLayers[DestIndex] = NumLayers[SourceIndex];
+}
+
+void FCollisionDebuggerResponseBuffer::Invalidate()
+{
+    FMemory::Memset(NumLayers.GetData(), Unknown, NumLayers.Num());
+}
+
+void FCollisionDebuggerResponseBuffer::Resolve(const FCollisionDebuggerResponseFilter& Filter, FCollisionDebuggerHitBuffer& OutPixels, FCollisionDebuggerPrimitiveIds* OutPrimitiveIds) const
+{
+    check(OutPixels.GetSize() == Size);
+    check(!OutPrimitiveIds || OutPrimitiveIds->GetSize() == Size);
+
+    ParallelFor(Size.Y, [&](int32 y)
+    {
+        for (int32 Index = y * Size.X; Index < (y + 1) * Size.X; Index++)
+        {
+            if (NumLayers[Index] == Unknown)
+            {
+                continue;
+            }
+
+            const FCollisionDebuggerRayHit Hit = Filter.Resolve(Layers.GetData() + Index * MaxLayers, NumLayers[Index]);
+            OutPixels.Set(Index, Hit.IsHit() ? FLinearColor(Hit.Normal.X, Hit.Normal.Y, Hit.Normal.Z, Hit.Time) : FLinearColor(-1, -1, -1, -1));
+            if (OutPrimitiveIds)
+            {
+                OutPrimitiveIds->Set(Index, Hit.PrimitiveId);
+            }
+        }
+    });
+}
+
+void FCollisionDebuggerResponseBuffer::MarkLivePrimitives(TBitArray<>& OutLive) const
+{
+    for (int32 Index = 0; Index < NumLayers.Num(); Index++)
+    {
+        if (NumLayers[Index] == Unknown)
+        {
+            continue;
+        }
+        for (int32 i = 0; i < NumLayers[Index]; i++)
+        {
+            const uint32 Id = Layers[Index * MaxLayers + i].PrimitiveId;
+            if (OutLive.IsValidIndex(int32(Id)))
+            {
+                OutLive[Id] = true;
+            }
+        }
+    }
+}
+
+void FCollisionDebuggerResponseBuffer::RemapPrimitives(TConstArrayView<uint32> Remap)
+{
+    ParallelFor(Size.Y, [&](int32 y)
+    {
+        for (int32 Index = y * Size.X; Index < (y + 1) * Size.X; Index++)
+        {
+            if (NumLayers[Index] == Unknown)
+            {
+                continue;
+            }
+            for (int32 i = 0; i < NumLayers[Index]; i++)
+            {
+                uint32& Id = Layers[Index * MaxLayers + i].PrimitiveId;
+                Id = Remap.IsValidIndex(int32(Id)) ? Remap[Id] : FCollisionDebuggerPrimitiveTable::NoPrimitive;
+            }
+        }
+    });
+}
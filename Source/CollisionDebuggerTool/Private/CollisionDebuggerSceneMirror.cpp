@@ -0,0 +1,848 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerSceneMirror.h"
+#include "Async/ParallelFor.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Components/SkinnedMeshComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "Interfaces/Interface_CollisionDataProvider.h"
+#include "PhysicsEngine/BodySetup.h"
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugBackend(
+    TEXT("CollisionDebug.Backend"),
+    0,
+    TEXT("What the collision debugger traces against. Response masks always use the physics scene.\n")
+    TEXT(" 0: physics scene queries \n")
+    TEXT(" 1: a BVH mirror of the collision the tested channel or profile blocks on, only while CollisionDebug.Invalidation tracks changes \n"),
+    ECVF_Default);
+
+namespace CollisionDebuggerSceneMirror
+{
+    static bool HitInside(const FVector3f& Direction, float& InOutTime, FVector3f& OutNormal)
+    {
+        InOutTime = 0.f;
+        OutNormal = -Direction.GetSafeNormal();
+        return true;
+    }
+
+    static bool IntersectSphere(const FVector3f& Center, float Radius, const FVector3f& Origin, const FVector3f& Direction, float& InOutTime, FVector3f& OutNormal)
+    {
+        const FVector3f ToOrigin = Origin - Center;
+        const float C = ToOrigin.SizeSquared() - Radius * Radius;
+        if (C <= 0.f)
+        {
+            return HitInside(Direction, InOutTime, OutNormal);
+        }
+
+        const float B = FVector3f::DotProduct(ToOrigin, Direction);
+        if (B >= 0.f)
+        {
+            return false;
+        }
+
+        const float A = Direction.SizeSquared();
+        const float Discriminant = B * B - A * C;
+        if (Discriminant < 0.f)
+        {
+            return false;
+        }
+
+        const float Time = (-B - FMath::Sqrt(Discriminant)) / A;
+        if (Time >= InOutTime)
+        {
+            return false;
+        }
+        InOutTime = FMath::Max(Time, 0.f);
+        OutNormal = (ToOrigin + Direction * Time).GetSafeNormal();
+        return true;
+    }
+
+    static bool IntersectBox(const FCollisionDebuggerMirrorMesh::FBoxShape& Box, const FVector3f& Origin, const FVector3f& Direction, float& InOutTime, FVector3f& OutNormal)
+    {
+        const FVector3f LocalOrigin = Box.Rotation.UnrotateVector(Origin - Box.Center);
+        const FVector3f LocalDirection = Box.Rotation.UnrotateVector(Direction);
+
+        float Entry = -MAX_flt;
+        float Exit = MAX_flt;
+        int32 EntryAxis = INDEX_NONE;
+        for (int32 Axis = 0; Axis < 3; Axis++)
+        {
+            if (FMath::Abs(LocalDirection[Axis]) < UE_SMALL_NUMBER)
+            {
+                if (FMath::Abs(LocalOrigin[Axis]) > Box.Extent[Axis])
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            float Near = (-Box.Extent[Axis] - LocalOrigin[Axis]) / LocalDirection[Axis];
+            float Far = (Box.Extent[Axis] - LocalOrigin[Axis]) / LocalDirection[Axis];
+            if (Near > Far)
+            {
+                Swap(Near, Far);
+            }
+            if (Near > Entry)
+            {
+                Entry = Near;
+                EntryAxis = Axis;
+            }
+            Exit = FMath::Min(Exit, Far);
+        }
+
+        if (Entry > Exit || Exit < 0.f)
+        {
+            return false;
+        }
+        if (Entry < 0.f || EntryAxis == INDEX_NONE)
+        {
+            return HitInside(Direction, InOutTime, OutNormal);
+        }
+        if (Entry >= InOutTime)
+        {
+            return false;
+        }
+
+        FVector3f Normal = FVector3f::ZeroVector;
+        Normal[EntryAxis] = LocalDirection[EntryAxis] > 0.f ? -1.f : 1.f;
+        InOutTime = Entry;
+        OutNormal = Box.Rotation.RotateVector(Normal);
+        return true;
+    }
+
+    static bool IntersectCapsule(const FCollisionDebuggerMirrorMesh::FCapsuleShape& Capsule, const FVector3f& Origin, const FVector3f& Direction, float& InOutTime, FVector3f& OutNormal)
+    {
+        const FVector3f LocalOrigin = Capsule.Rotation.UnrotateVector(Origin - Capsule.Center);
+        const FVector3f LocalDirection = Capsule.Rotation.UnrotateVector(Direction);
+        const float RadiusSquared = Capsule.Radius * Capsule.Radius;
+
+        const FVector3f ClosestOnSegment(0.f, 0.f, FMath::Clamp(LocalOrigin.Z, -Capsule.HalfLength, Capsule.HalfLength));
+        if ((LocalOrigin - ClosestOnSegment).SizeSquared() <= RadiusSquared)
+        {
+            return HitInside(Direction, InOutTime, OutNormal);
+        }
+
+        bool Hit = false;
+        FVector3f LocalNormal;
+
+        // The cylinder between the two spheres.
+        const float A = LocalDirection.X * LocalDirection.X + LocalDirection.Y * LocalDirection.Y;
+        if (A > UE_SMALL_NUMBER)
+        {
+            const float B = LocalOrigin.X * LocalDirection.X + LocalOrigin.Y * LocalDirection.Y;
+            const float C = LocalOrigin.X * LocalOrigin.X + LocalOrigin.Y * LocalOrigin.Y - RadiusSquared;
+            const float Discriminant = B * B - A * C;
+            if (Discriminant >= 0.f)
+            {
+                const float Time = (-B - FMath::Sqrt(Discriminant)) / A;
+                const FVector3f Point = LocalOrigin + LocalDirection * Time;
+                if (Time >= 0.f && Time < InOutTime && FMath::Abs(Point.Z) <= Capsule.HalfLength)
+                {
+                    InOutTime = Time;
+                    LocalNormal = FVector3f(Point.X, Point.Y, 0.f).GetSafeNormal();
+                    Hit = true;
+                }
+            }
+        }
+
+        for (const float Side : { -1.f, 1.f })
+        {
+            Hit |= IntersectSphere(FVector3f(0.f, 0.f, Side * Capsule.HalfLength), Capsule.Radius, LocalOrigin, LocalDirection, InOutTime, LocalNormal);
+        }
+
+        if (Hit)
+        {
+            OutNormal = Capsule.Rotation.RotateVector(LocalNormal);
+        }
+        return Hit;
+    }
+
+    static bool GatherSimpleShapes(const FKAggregateGeom& AggGeom, const FVector& Scale, FCollisionDebuggerMirrorMesh& OutMesh)
+    {
+        // Tapered capsules and level sets are left to the physics scene.
+        if (AggGeom.GetElementCount() != AggGeom.SphereElems.Num() + AggGeom.BoxElems.Num() + AggGeom.SphylElems.Num() + AggGeom.ConvexElems.Num())
+        {
+            return false;
+        }
+
+        for (const FKSphereElem& Sphere : AggGeom.SphereElems)
+        {
+            const FKSphereElem Scaled = Sphere.GetFinalScaled(Scale, FTransform::Identity);
+            OutMesh.AddSphere(FVector3f(Scaled.Center), Scaled.Radius);
+        }
+        for (const FKBoxElem& Box : AggGeom.BoxElems)
+        {
+            const FKBoxElem Scaled = Box.GetFinalScaled(Scale, FTransform::Identity);
+            OutMesh.AddBox(FVector3f(Scaled.Center), FQuat4f(Scaled.Rotation.Quaternion()), FVector3f(Scaled.X, Scaled.Y, Scaled.Z) * .5f);
+        }
+        for (const FKSphylElem& Sphyl : AggGeom.SphylElems)
+        {
+            const FKSphylElem Scaled = Sphyl.GetFinalScaled(Scale, FTransform::Identity);
+            OutMesh.AddCapsule(FVector3f(Scaled.Center), FQuat4f(Scaled.Rotation.Quaternion()), Scaled.Radius, Scaled.Length * .5f);
+        }
+        for (const FKConvexElem& Convex : AggGeom.ConvexElems)
+        {
+            // Cooked hulls may come without their faces.
+            if (Convex.IndexData.Num() < 3)
+            {
+                return false;
+            }
+
+            const FTransform HullTransform = Convex.GetTransform();
+            TArray<FVector3f> Vertices;
+            Vertices.Reserve(Convex.VertexData.Num());
+            for (const FVector& Vertex : Convex.VertexData)
+            {
+                Vertices.Add(FVector3f(HullTransform.TransformPosition(Vertex) * Scale));
+            }
+            OutMesh.AddHull(Vertices, TConstArrayView<int32>(Convex.IndexData.GetData(), Convex.IndexData.Num() / 3 * 3));
+        }
+        return true;
+    }
+
+    static bool GatherTriangles(const UBodySetup& BodySetup, const FVector& Scale, FCollisionDebuggerMirrorMesh& OutMesh)
+    {
+        // Only meshes with CPU side collision data can be mirrored, cooked static meshes mostly lack it.
+        IInterface_CollisionDataProvider* DataProvider = Cast<IInterface_CollisionDataProvider>(BodySetup.GetOuter());
+        if (!DataProvider || !DataProvider->ContainsPhysicsTriMeshData(BodySetup.bMeshCollideAll))
+        {
+            return false;
+        }
+
+        FTriMeshCollisionData TriMesh;
+        if (!DataProvider->GetPhysicsTriMeshData(&TriMesh, BodySetup.bMeshCollideAll))
+        {
+            return false;
+        }
+
+        const FVector3f Scale3f(Scale);
+        for (const FTriIndices& Triangle : TriMesh.Indices)
+        {
+            OutMesh.AddTriangle(TriMesh.Vertices[Triangle.v0] * Scale3f, TriMesh.Vertices[Triangle.v1] * Scale3f, TriMesh.Vertices[Triangle.v2] * Scale3f);
+        }
+        return true;
+    }
+}
+
+void FCollisionDebuggerMirrorMesh::AddSphere(const FVector3f& Center, float Radius)
+{
+    Spheres.Add({ Center, Radius });
+    Bounds += FBox3f(Center - FVector3f(Radius), Center + FVector3f(Radius));
+}
+
+void FCollisionDebuggerMirrorMesh::AddBox(const FVector3f& Center, const FQuat4f& Rotation, const FVector3f& Extent)
+{
+    Boxes.Add({ Center, Rotation, Extent });
+    Bounds += FBox3f(-Extent, Extent).TransformBy(FTransform3f(Rotation, Center));
+}
+
+void FCollisionDebuggerMirrorMesh::AddCapsule(const FVector3f& Center, const FQuat4f& Rotation, float Radius, float HalfLength)
+{
+    Capsules.Add({ Center, Rotation, Radius, HalfLength });
+    const FVector3f Axis = Rotation.RotateVector(FVector3f(0.f, 0.f, HalfLength));
+    Bounds += FBox3f(Center - Axis - FVector3f(Radius), Center - Axis + FVector3f(Radius));
+    Bounds += FBox3f(Center + Axis - FVector3f(Radius), Center + Axis + FVector3f(Radius));
+}
+
+void FCollisionDebuggerMirrorMesh::AddTriangle(const FVector3f& V0, const FVector3f& V1, const FVector3f& V2)
+{
+    const FVector3f E1 = V1 - V0;
+    const FVector3f E2 = V2 - V0;
+    const float Components[9] = { V0.X, V0.Y, V0.Z, E1.X, E1.Y, E1.Z, E2.X, E2.Y, E2.Z };
+    for (int32 i = 0; i < 9; i++)
+    {
+        Triangles[i].Add(Components[i]);
+    }
+    NumTriangles++;
+
+    Bounds += V0;
+    Bounds += V1;
+    Bounds += V2;
+}
+
+void FCollisionDebuggerMirrorMesh::AddHull(TConstArrayView<FVector3f> Vertices, TConstArrayView<int32> Indices)
+{
+    FVector3f Centroid = FVector3f::ZeroVector;
+    FBox3f HullBounds(ForceInit);
+    for (const FVector3f& Vertex : Vertices)
+    {
+        Centroid += Vertex;
+        HullBounds += Vertex;
+    }
+    Centroid /= float(FMath::Max(Vertices.Num(), 1));
+
+    FHullShape& Hull = Hulls.AddDefaulted_GetRef();
+    Hull.Bounds = HullBounds;
+    Hull.FirstPlane = HullPlanes.Num();
+    for (int32 i = 0; i + 2 < Indices.Num(); i += 3)
+    {
+        const FVector3f& V0 = Vertices[Indices[i]];
+        const FVector3f& V1 = Vertices[Indices[i + 1]];
+        const FVector3f& V2 = Vertices[Indices[i + 2]];
+        AddTriangle(V0, V1, V2);
+
+        // Winding isn't reliable, the centroid tells which side is out.
+        FVector3f Normal = FVector3f::CrossProduct(V1 - V0, V2 - V0).GetSafeNormal();
+        if (Normal.IsZero())
+        {
+            continue;
+        }
+        if (FVector3f::DotProduct(Normal, Centroid - V0) > 0.f)
+        {
+            Normal = -Normal;
+        }
+        HullPlanes.Add(FPlane4f(V0, Normal));
+    }
+    Hull.NumPlanes = HullPlanes.Num() - Hull.FirstPlane;
+}
+
+bool FCollisionDebuggerMirrorMesh::IsInsideHull(const FHullShape& Hull, const FVector3f& Point) const
+{
+    if (Hull.NumPlanes == 0 || !Hull.Bounds.IsInsideOrOn(Point))
+    {
+        return false;
+    }
+    for (int32 i = Hull.FirstPlane; i < Hull.FirstPlane + Hull.NumPlanes; i++)
+    {
+        if (HullPlanes[i].PlaneDot(Point) > 0.f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FCollisionDebuggerMirrorMesh::Build()
+{
+    TArray<FBox3f> TriangleBounds;
+    TriangleBounds.SetNumUninitialized(NumTriangles);
+    for (int32 i = 0; i < NumTriangles; i++)
+    {
+        const FVector3f V0(Triangles[0][i], Triangles[1][i], Triangles[2][i]);
+        const FVector3f V1 = V0 + FVector3f(Triangles[3][i], Triangles[4][i], Triangles[5][i]);
+        const FVector3f V2 = V0 + FVector3f(Triangles[6][i], Triangles[7][i], Triangles[8][i]);
+        TriangleBounds[i] = FBox3f(ForceInit);
+        TriangleBounds[i] += V0;
+        TriangleBounds[i] += V1;
+        TriangleBounds[i] += V2;
+    }
+    TriangleBVH.Build(TriangleBounds);
+
+    // Leaves address the triangles directly once they are in BVH order. The padding lets the
+    // last leaf load four triangles, degenerate ones never hit.
+    const TArray<int32>& Order = TriangleBVH.GetItemOrder();
+    for (TArray<float>& Component : Triangles)
+    {
+        TArray<float> Sorted;
+        Sorted.SetNumZeroed(NumTriangles + 3);
+        for (int32 i = 0; i < NumTriangles; i++)
+        {
+            Sorted[i] = Component[Order[i]];
+        }
+        Component = MoveTemp(Sorted);
+    }
+}
+
+bool FCollisionDebuggerMirrorMesh::Trace(const FVector3f& Origin, const FVector3f& Direction, float& InOutTime, FVector3f& OutNormal) const
+{
+    using namespace CollisionDebuggerSceneMirror;
+
+    bool Hit = false;
+    for (const FSphereShape& Sphere : Spheres)
+    {
+        Hit |= IntersectSphere(Sphere.Center, Sphere.Radius, Origin, Direction, InOutTime, OutNormal);
+    }
+    for (const FBoxShape& Box : Boxes)
+    {
+        Hit |= IntersectBox(Box, Origin, Direction, InOutTime, OutNormal);
+    }
+    for (const FCapsuleShape& Capsule : Capsules)
+    {
+        Hit |= IntersectCapsule(Capsule, Origin, Direction, InOutTime, OutNormal);
+    }
+    for (const FHullShape& Hull : Hulls)
+    {
+        if (IsInsideHull(Hull, Origin))
+        {
+            Hit |= HitInside(Direction, InOutTime, OutNormal);
+        }
+    }
+
+    if (NumTriangles > 0)
+    {
+        const FCollisionDebuggerBVHRay Ray(Origin, Direction);
+        TriangleBVH.Traverse(Ray, InOutTime, [&](int32 First, int32 Count, float& InOutLeafTime)
+        {
+            Hit |= TraceTriangles(Ray, First, Count, InOutLeafTime, OutNormal);
+        });
+    }
+    return Hit;
+}
+
+bool FCollisionDebuggerMirrorMesh::TraceTriangles(const FCollisionDebuggerBVHRay& Ray, int32 First, int32 Count, float& InOutTime, FVector3f& OutNormal) const
+{
+    // Two sided Moller-Trumbore over four triangles at once.
+    const VectorRegister4Float V0X = VectorLoad(Triangles[0].GetData() + First);
+    const VectorRegister4Float V0Y = VectorLoad(Triangles[1].GetData() + First);
+    const VectorRegister4Float V0Z = VectorLoad(Triangles[2].GetData() + First);
+    const VectorRegister4Float E1X = VectorLoad(Triangles[3].GetData() + First);
+    const VectorRegister4Float E1Y = VectorLoad(Triangles[4].GetData() + First);
+    const VectorRegister4Float E1Z = VectorLoad(Triangles[5].GetData() + First);
+    const VectorRegister4Float E2X = VectorLoad(Triangles[6].GetData() + First);
+    const VectorRegister4Float E2Y = VectorLoad(Triangles[7].GetData() + First);
+    const VectorRegister4Float E2Z = VectorLoad(Triangles[8].GetData() + First);
+
+    const VectorRegister4Float DX = VectorSetFloat1(Ray.Direction.X);
+    const VectorRegister4Float DY = VectorSetFloat1(Ray.Direction.Y);
+    const VectorRegister4Float DZ = VectorSetFloat1(Ray.Direction.Z);
+
+    const VectorRegister4Float PX = VectorSubtract(VectorMultiply(DY, E2Z), VectorMultiply(DZ, E2Y));
+    const VectorRegister4Float PY = VectorSubtract(VectorMultiply(DZ, E2X), VectorMultiply(DX, E2Z));
+    const VectorRegister4Float PZ = VectorSubtract(VectorMultiply(DX, E2Y), VectorMultiply(DY, E2X));
+    const VectorRegister4Float Det = VectorMultiplyAdd(E1X, PX, VectorMultiplyAdd(E1Y, PY, VectorMultiply(E1Z, PZ)));
+    const VectorRegister4Float InvDet = VectorDivide(VectorOneFloat(), Det);
+
+    const VectorRegister4Float TX = VectorSubtract(Ray.OriginX, V0X);
+    const VectorRegister4Float TY = VectorSubtract(Ray.OriginY, V0Y);
+    const VectorRegister4Float TZ = VectorSubtract(Ray.OriginZ, V0Z);
+    const VectorRegister4Float U = VectorMultiply(VectorMultiplyAdd(TX, PX, VectorMultiplyAdd(TY, PY, VectorMultiply(TZ, PZ))), InvDet);
+
+    const VectorRegister4Float QX = VectorSubtract(VectorMultiply(TY, E1Z), VectorMultiply(TZ, E1Y));
+    const VectorRegister4Float QY = VectorSubtract(VectorMultiply(TZ, E1X), VectorMultiply(TX, E1Z));
+    const VectorRegister4Float QZ = VectorSubtract(VectorMultiply(TX, E1Y), VectorMultiply(TY, E1X));
+    const VectorRegister4Float V = VectorMultiply(VectorMultiplyAdd(DX, QX, VectorMultiplyAdd(DY, QY, VectorMultiply(DZ, QZ))), InvDet);
+    const VectorRegister4Float Time = VectorMultiply(VectorMultiplyAdd(E2X, QX, VectorMultiplyAdd(E2Y, QY, VectorMultiply(E2Z, QZ))), InvDet);
+
+    // Parallel and degenerate triangles divide by zero, their NaNs fail every compare.
+    const VectorRegister4Float Zero = VectorZeroFloat();
+    VectorRegister4Float Mask = VectorCompareGT(VectorAbs(Det), Zero);
+    Mask = VectorBitwiseAnd(Mask, VectorCompareGE(U, Zero));
+    Mask = VectorBitwiseAnd(Mask, VectorCompareGE(V, Zero));
+    Mask = VectorBitwiseAnd(Mask, VectorCompareLE(VectorAdd(U, V), VectorOneFloat()));
+    Mask = VectorBitwiseAnd(Mask, VectorCompareGE(Time, Zero));
+    Mask = VectorBitwiseAnd(Mask, VectorCompareLT(Time, VectorSetFloat1(InOutTime)));
+
+    int32 HitMask = VectorMaskBits(Mask) & ((1 << Count) - 1);
+    if (HitMask == 0)
+    {
+        return false;
+    }
+
+    alignas(16) float Times[4];
+    VectorStoreAligned(Time, Times);
+    int32 Nearest = INDEX_NONE;
+    while (HitMask)
+    {
+        const int32 Lane = FMath::CountTrailingZeros(uint32(HitMask));
+        HitMask &= HitMask - 1;
+        if (Nearest == INDEX_NONE || Times[Lane] < Times[Nearest])
+        {
+            Nearest = Lane;
+        }
+    }
+
+    const int32 Index = First + Nearest;
+    const FVector3f E1(Triangles[3][Index], Triangles[4][Index], Triangles[5][Index]);
+    const FVector3f E2(Triangles[6][Index], Triangles[7][Index], Triangles[8][Index]);
+    FVector3f Normal = FVector3f::CrossProduct(E1, E2).GetSafeNormal();
+    if (FVector3f::DotProduct(Normal, Ray.Direction) > 0.f)
+    {
+        Normal = -Normal;
+    }
+
+    InOutTime = Times[Nearest];
+    OutNormal = Normal;
+    return true;
+}
+
+FCollisionDebuggerRayHit FCollisionDebuggerMirrorScene::Trace(const FVector& Origin, const FVector3f& Direction, bool TraceComplex, const UPrimitiveComponent*& OutComponent) const
+{
+    FCollisionDebuggerRayHit Hit;
+    OutComponent = nullptr;
+
+    float BestTime = 1.f;
+    FVector3f BestNormal = FVector3f::ZeroVector;
+    const FCollisionDebuggerMirrorInstance* BestInstance = nullptr;
+    TOptional<FCollisionQueryParams> ProxyParams;
+
+    // The instance BVH is in world space, the meshes are traced relative to their instance in double.
+    const FCollisionDebuggerBVHRay Ray(FVector3f(Origin), Direction);
+    const TArray<int32>& Order = InstanceBVH.GetItemOrder();
+    InstanceBVH.Traverse(Ray, BestTime, [&](int32 First, int32 Count, float& InOutTime)
+    {
+        for (int32 i = First; i < First + Count; i++)
+        {
+            const FCollisionDebuggerMirrorInstance& Instance = Instances[Order[i]];
+            if (Instance.Mesh)
+            {
+                FVector3f Normal;
+                const FVector3f LocalOrigin = Instance.Rotation.UnrotateVector(FVector3f(Origin - Instance.Location));
+                if (Instance.Mesh->Trace(LocalOrigin, Instance.Rotation.UnrotateVector(Direction), InOutTime, Normal))
+                {
+                    BestNormal = Instance.Rotation.RotateVector(Normal);
+                    BestInstance = &Instance;
+                }
+            }
+            else if (Instance.IsProxy)
+            {
+                UPrimitiveComponent* Component = Instance.Component.Get();
+                if (!Component)
+                {
+                    continue;
+                }
+                if (!ProxyParams.IsSet())
+                {
+                    ProxyParams.Emplace(SCENE_QUERY_STAT(CollisionDebuggerMirrorProxy), TraceComplex);
+                    ProxyParams->bReturnPhysicalMaterial = false;
+                    ProxyParams->bReturnFaceIndex = false;
+                }
+
+                FHitResult RV_Hit;
+                const FVector End = Origin + FVector(Direction) * InOutTime;
+                if (Component->LineTraceComponent(RV_Hit, Origin, End, *ProxyParams))
+                {
+                    InOutTime *= RV_Hit.Time;
+                    BestNormal = FVector3f(RV_Hit.Normal);
+                    BestInstance = &Instance;
+                }
+            }
+        }
+    });
+
+    if (BestInstance)
+    {
+        Hit.Normal = BestNormal;
+        Hit.Time = BestTime;
+        OutComponent = BestInstance->Component.Get();
+    }
+    return Hit;
+}
+
+bool FCollisionDebuggerSceneMirror::IsEnabled()
+{
+    return CVarCollisionDebugBackend.GetValueOnGameThread() == 1;
+}
+
+void FCollisionDebuggerSceneMirror::Reset()
+{
+    HasSettings = false;
+    Instances.Empty();
+    ComponentInstances.Empty();
+    InstanceBVH.Reset();
+    TopologyChanged = false;
+    BoundsChanged = false;
+    Meshes.Empty();
+    PendingMeshes.Empty();
+    Scene.Reset();
+}
+
+void FCollisionDebuggerSceneMirror::Update(UWorld* World, const FInputRenderSettingsInternal& InSettings, TConstArrayView<TWeakObjectPtr<UPrimitiveComponent>> ChangedPrimitives, bool IsTracking)
+{
+    check(IsInGameThread());
+
+    // Without change tracking the mirror would have to read the whole world again and again,
+    // rays go to the physics scene instead.
+    if (!IsEnabled() || !World || !IsTracking)
+    {
+        if (Scene.IsValid())
+        {
+            Reset();
+        }
+        return;
+    }
+
+    const bool SettingsChanged = !HasSettings
+        || Settings.bIsChannelTest != InSettings.bIsChannelTest
+        || Settings.ChannelToTest != InSettings.ChannelToTest
+        || Settings.ProfileNameToTest != InSettings.ProfileNameToTest
+        || Settings.TraceComplex != InSettings.TraceComplex;
+
+    if (SettingsChanged)
+    {
+        Settings = InSettings;
+        Filter = FCollisionDebuggerResponseFilter::Make(Settings);
+        HasSettings = true;
+        Rebuild(World);
+        return;
+    }
+
+    for (const TWeakObjectPtr<UPrimitiveComponent>& Primitive : ChangedPrimitives)
+    {
+        UpdateComponent(Primitive);
+    }
+
+    if (TopologyChanged || BoundsChanged)
+    {
+        BuildPendingMeshes();
+        if (TopologyChanged)
+        {
+            RebuildInstanceBVH();
+        }
+        else
+        {
+            RefitInstanceBVH();
+        }
+        Publish();
+    }
+}
+
+void FCollisionDebuggerSceneMirror::Rebuild(UWorld* World)
+{
+    Instances.Reset();
+    ComponentInstances.Reset();
+
+    TArray<FCollisionDebuggerMirrorInstance> ComponentBodies;
+    for (TActorIterator<AActor> It(World); It; ++It)
+    {
+        It->ForEachComponent<UPrimitiveComponent>(false, [&](UPrimitiveComponent* Component)
+        {
+            if (!IsRelevant(Component))
+            {
+                return;
+            }
+
+            ComponentBodies.Reset();
+            AddInstances(Component, ComponentBodies);
+            if (ComponentBodies.Num() > 0)
+            {
+                TArray<int32>& Indices = ComponentInstances.Add(Component);
+                for (const FCollisionDebuggerMirrorInstance& Instance : ComponentBodies)
+                {
+                    Indices.Add(Instances.Add(Instance));
+                }
+            }
+        });
+    }
+
+    // Meshes no body uses anymore only stay alive in the snapshots that still reference them.
+    TSet<const FCollisionDebuggerMirrorMesh*> UsedMeshes;
+    for (const FCollisionDebuggerMirrorInstance& Instance : Instances)
+    {
+        UsedMeshes.Add(Instance.Mesh);
+    }
+    for (auto It = Meshes.CreateIterator(); It; ++It)
+    {
+        if (It->Value.IsValid() && !UsedMeshes.Contains(It->Value.Get()))
+        {
+            It.RemoveCurrent();
+        }
+    }
+
+    BuildPendingMeshes();
+    RebuildInstanceBVH();
+    Publish();
+}
+
+void FCollisionDebuggerSceneMirror::UpdateComponent(const TWeakObjectPtr<UPrimitiveComponent>& Primitive)
+{
+    TArray<FCollisionDebuggerMirrorInstance> NewInstances;
+    UPrimitiveComponent* Component = Primitive.Get();
+    if (Component && IsRelevant(Component))
+    {
+        AddInstances(Component, NewInstances);
+    }
+
+    // Destroyed components are still found through their stale pointer.
+    TArray<int32>* Indices = ComponentInstances.Find(Primitive);
+    if (!Indices && NewInstances.Num() == 0)
+    {
+        return;
+    }
+
+    // A body that only moved keeps its slots, the BVH is refit around it.
+    if (Indices && Indices->Num() == NewInstances.Num())
+    {
+        for (int32 i = 0; i < NewInstances.Num(); i++)
+        {
+            Instances[(*Indices)[i]] = NewInstances[i];
+        }
+        BoundsChanged = true;
+        return;
+    }
+
+    if (Indices)
+    {
+        for (int32 Index : *Indices)
+        {
+            Instances[Index] = FCollisionDebuggerMirrorInstance();
+        }
+        ComponentInstances.Remove(Primitive);
+    }
+    if (NewInstances.Num() > 0)
+    {
+        TArray<int32>& NewIndices = ComponentInstances.Add(Primitive);
+        for (const FCollisionDebuggerMirrorInstance& Instance : NewInstances)
+        {
+            NewIndices.Add(Instances.Add(Instance));
+        }
+    }
+    TopologyChanged = true;
+}
+
+void FCollisionDebuggerSceneMirror::AddInstances(UPrimitiveComponent* Component, TArray<FCollisionDebuggerMirrorInstance>& OutInstances)
+{
+    auto AddBody = [&](const FMeshPtr& Mesh, const FTransform& Transform)
+    {
+        FCollisionDebuggerMirrorInstance& Instance = OutInstances.AddDefaulted_GetRef();
+        Instance.Component = Component;
+        if (Mesh.IsValid())
+        {
+            Instance.Mesh = Mesh.Get();
+            Instance.Rotation = FQuat4f(Transform.GetRotation());
+            Instance.Location = Transform.GetLocation();
+            Instance.Bounds = Mesh->GetBounds().TransformBy(FTransform3f(Instance.Rotation, FVector3f(Instance.Location)));
+        }
+        else
+        {
+            Instance.IsProxy = true;
+            Instance.Bounds = FBox3f(Component->Bounds.GetBox());
+        }
+    };
+
+    // Every instance is a body of its own. Instances the mirror can't hold are left out, tracing
+    // the component would only trace its unused main body.
+    if (UInstancedStaticMeshComponent* InstancedMesh = Cast<UInstancedStaticMeshComponent>(Component))
+    {
+        const UBodySetup* BodySetup = InstancedMesh->GetBodySetup();
+        for (int32 i = 0; BodySetup && i < InstancedMesh->GetInstanceCount(); i++)
+        {
+            FTransform Transform;
+            if (InstancedMesh->GetInstanceTransform(i, Transform, true))
+            {
+                const FMeshPtr Mesh = FindOrAddMesh(BodySetup, Transform.GetScale3D());
+                if (Mesh.IsValid() && !Mesh->IsEmpty())
+                {
+                    AddBody(Mesh, Transform);
+                }
+            }
+        }
+        return;
+    }
+
+    // Skinned meshes are made of many bodies, they are traced through the physics scene.
+    const UBodySetup* BodySetup = Component->IsA<USkinnedMeshComponent>() ? nullptr : Component->GetBodySetup();
+    const FTransform& Transform = Component->GetComponentTransform();
+    const FMeshPtr Mesh = BodySetup ? FindOrAddMesh(BodySetup, Transform.GetScale3D()) : nullptr;
+    if (!Mesh.IsValid() || !Mesh->IsEmpty())
+    {
+        AddBody(Mesh, Transform);
+    }
+}
+
+FCollisionDebuggerSceneMirror::FMeshPtr FCollisionDebuggerSceneMirror::FindOrAddMesh(const UBodySetup* BodySetup, const FVector& Scale)
+{
+    using namespace CollisionDebuggerSceneMirror;
+
+    const ECollisionTraceFlag TraceFlag = BodySetup->GetCollisionTraceFlag();
+    FMeshKey Key;
+    Key.BodySetup = BodySetup;
+    Key.Scale = FVector3f(Scale);
+    Key.Complex = TraceFlag == CTF_UseComplexAsSimple || (Settings.TraceComplex && TraceFlag != CTF_UseSimpleAsComplex);
+
+    if (const FMeshPtr* Found = Meshes.Find(Key))
+    {
+        return *Found;
+    }
+
+    FMeshPtr Mesh = MakeShared<FCollisionDebuggerMirrorMesh, ESPMode::ThreadSafe>();
+    const bool Gathered = Key.Complex ? GatherTriangles(*BodySetup, Scale, *Mesh) : GatherSimpleShapes(BodySetup->AggGeom, Scale, *Mesh);
+    if (!Gathered)
+    {
+        Mesh.Reset();
+    }
+    else if (!Mesh->IsEmpty())
+    {
+        PendingMeshes.Add(Mesh.Get());
+    }
+
+    Meshes.Add(Key, Mesh);
+    return Mesh;
+}
+
+bool FCollisionDebuggerSceneMirror::IsRelevant(const UPrimitiveComponent* Component) const
+{
+    if (!Component->IsRegistered() || !Component->IsPhysicsStateCreated() || !Component->IsQueryCollisionEnabled() || Filter.ChannelBit == 0)
+    {
+        return false;
+    }
+
+    const ECollisionChannel Channel = ECollisionChannel(FMath::CountTrailingZeros(Filter.ChannelBit));
+    const uint32 ObjectTypeBit = 1u << (uint32(Component->GetCollisionObjectType()) & 31);
+    return Component->GetCollisionResponseToChannel(Channel) == ECR_Block && (Filter.BlockedObjectTypes & ObjectTypeBit) != 0;
+}
+
+void FCollisionDebuggerSceneMirror::BuildPendingMeshes()
+{
+    ParallelFor(PendingMeshes.Num(), [this](int32 i)
+    {
+        PendingMeshes[i]->Build();
+    });
+    PendingMeshes.Reset();
+}
+
+void FCollisionDebuggerSceneMirror::RebuildInstanceBVH()
+{
+    // Removed bodies left dead slots behind, they are dropped with the old topology.
+    TArray<int32> Remap;
+    Remap.Init(INDEX_NONE, Instances.Num());
+    TArray<FCollisionDebuggerMirrorInstance> LiveInstances;
+    LiveInstances.Reserve(Instances.Num());
+    for (int32 i = 0; i < Instances.Num(); i++)
+    {
+        if (Instances[i].Mesh || Instances[i].IsProxy)
+        {
+            Remap[i] = LiveInstances.Add(Instances[i]);
+        }
+    }
+    for (TPair<TWeakObjectPtr<UPrimitiveComponent>, TArray<int32>>& Pair : ComponentInstances)
+    {
+        for (int32& Index : Pair.Value)
+        {
+            Index = Remap[Index];
+        }
+    }
+    Instances = MoveTemp(LiveInstances);
+
+    TArray<FBox3f> Bounds;
+    Bounds.Reserve(Instances.Num());
+    for (const FCollisionDebuggerMirrorInstance& Instance : Instances)
+    {
+        Bounds.Add(Instance.Bounds);
+    }
+    InstanceBVH.Build(Bounds);
+    TopologyChanged = false;
+    BoundsChanged = false;
+}
+
+void FCollisionDebuggerSceneMirror::RefitInstanceBVH()
+{
+    TArray<FBox3f> Bounds;
+    Bounds.Reserve(Instances.Num());
+    for (const FCollisionDebuggerMirrorInstance& Instance : Instances)
+    {
+        Bounds.Add(Instance.Bounds);
+    }
+    InstanceBVH.Refit(Bounds);
+    BoundsChanged = false;
+}
+
+void FCollisionDebuggerSceneMirror::Publish()
+{
+    // Tiles in flight keep tracing the snapshot they were submitted with, so every change copies.
+    TSharedRef<FCollisionDebuggerMirrorScene, ESPMode::ThreadSafe> NewScene = MakeShared<FCollisionDebuggerMirrorScene, ESPMode::ThreadSafe>();
+    NewScene->Instances = Instances;
+    NewScene->InstanceBVH = InstanceBVH;
+    NewScene->Meshes.Reserve(Meshes.Num());
+    for (const TPair<FMeshKey, FMeshPtr>& Pair : Meshes)
+    {
+        if (Pair.Value.IsValid())
+        {
+            NewScene->Meshes.Add(Pair.Value);
+        }
+    }
+    Scene = NewScene;
+}
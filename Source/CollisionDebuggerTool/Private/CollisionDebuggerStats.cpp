@@ -0,0 +1,29 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerStats.h"
+
+DEFINE_STAT(STAT_CollisionDebugger_Tick);
+DEFINE_STAT(STAT_CollisionDebugger_Submit);
+DEFINE_STAT(STAT_CollisionDebugger_Invalidate);
+DEFINE_STAT(STAT_CollisionDebugger_Reproject);
+DEFINE_STAT(STAT_CollisionDebugger_TraceRow);
+DEFINE_STAT(STAT_CollisionDebugger_Encode);
+DEFINE_STAT(STAT_CollisionDebugger_Upload);
+DEFINE_STAT(STAT_CollisionDebugger_AsyncTraces);
+DEFINE_STAT(STAT_CollisionDebugger_SurfelCache);
+
+DEFINE_STAT(STAT_CollisionDebugger_RaysTraced);
+DEFINE_STAT(STAT_CollisionDebugger_TilesTraced);
+DEFINE_STAT(STAT_CollisionDebugger_TilesDropped);
+DEFINE_STAT(STAT_CollisionDebugger_BytesUploaded);
+DEFINE_STAT(STAT_CollisionDebugger_TilesInFlight);
+DEFINE_STAT(STAT_CollisionDebugger_RowsQueued);
+DEFINE_STAT(STAT_CollisionDebugger_TileSize);
+DEFINE_STAT(STAT_CollisionDebugger_TraceStride);
+DEFINE_STAT(STAT_CollisionDebugger_RayBudget);
+DEFINE_STAT(STAT_CollisionDebugger_HitRatio);
+DEFINE_STAT(STAT_CollisionDebugger_MsPerTile);
+DEFINE_STAT(STAT_CollisionDebugger_RefreshLatency);
+
+UE_TRACE_CHANNEL_DEFINE(CollisionDebuggerChannel);
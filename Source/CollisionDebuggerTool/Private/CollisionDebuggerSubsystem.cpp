@@ -2,7 +2,14 @@
 
 
 #include "CollisionDebuggerSubsystem.h"
+#include "CollisionDebuggerStats.h"
+#include "CollisionDebuggerViewMaterial.h"
 #include "Engine/TextureRenderTarget2D.h"
+#include "Engine/CollisionProfile.h"
+#include "GameFramework/PlayerController.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "Blueprint/WidgetTree.h"
+#include "Components/Image.h"
 
 #include "Kismet/GameplayStatics.h"
 #include "DrawDebugHelpers.h"
@@ -17,7 +24,6 @@
 #if WITH_EDITOR
     #include "Editor.h"
     #include "LevelEditor.h"
-    #include "EditorViewportClient.h"
     #include "SLevelViewport.h"
 #endif
 
@@ -29,6 +35,33 @@ static TAutoConsoleVariable<int32> CVarCollisionDebugEnable(
     TEXT(" 1: on  \n"),
     ECVF_Scalability | ECVF_RenderThreadSafe);
 
+static TAutoConsoleVariable<int32> CVarCollisionDebugResolutionX(
+    TEXT("CollisionDebug.ResolutionX"),
+    1024,
+    TEXT("Width of the debug view render targets and hit buffers. Applied when a view is created, the\n")
+    TEXT("format follows CollisionDebug.HitFormat.\n"),
+    ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugResolutionY(
+    TEXT("CollisionDebug.ResolutionY"),
+    769,
+    TEXT("Height of the debug view render targets and hit buffers, see CollisionDebug.ResolutionX.\n"),
+    ECVF_Default);
+
+namespace CollisionDebuggerSubsystem
+{
+    static const TCHAR* WidgetClassPath = TEXT("/CollisionDebuggerTool/UI_CollisionDebugView.UI_CollisionDebugView_C");
+    static const TCHAR* WidgetMaterialPath = TEXT("/CollisionDebuggerTool/M_ShowCollision.M_ShowCollision");
+
+    /** Render target M_ShowCollision samples, the view material's default texture and the first view's target without it. */
+    static const TCHAR* WidgetTexturePath = TEXT("/CollisionDebuggerTool/RT_CollisionDebugger_PhyCap.RT_CollisionDebugger_PhyCap");
+
+    static FIntPoint GetConfiguredResolution()
+    {
+        return FIntPoint(FMath::Clamp(CVarCollisionDebugResolutionX.GetValueOnGameThread(), 16, 8192), FMath::Clamp(CVarCollisionDebugResolutionY.GetValueOnGameThread(), 16, 8192));
+    }
+}
+
 
 void UCollisionDebuggerSubsystem::CheckState()
 {
@@ -57,70 +90,351 @@ void UCollisionDebuggerSubsystem::Tick(float DeltaTime)
 
     if (!StopHasStarted) 
     {
-        if (!Task.IsValid() && ShouldRun)
+        if (ShouldRun)
         {
-            UWorld* world = GetWorld();
-            FTransform trans;
+            DestroyRetiredViews(false);
+            UpdateViews();
+
+            TArray<FBox> DirtyBounds;
+            InvalidateChangedTiles(DirtyBounds);
 
-            if (world)
+            TArray<FCollisionDebuggerView*> ReadyViews;
+            for (int32 i = 0; i < Views.Num(); i++)
             {
-                APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(GetWorld(), 0);
-                if (CameraManager)
+                // Rotate the start so no view always gets the first tile of a tick.
+                FCollisionDebuggerView& View = *Views[(i + FirstViewToSubmit) % Views.Num()];
+                const int32 OldStride = View.GetFullTraceStride();
+                const FIntRect OldFocusRect = View.GetFocusRect();
+                View.SetTileSize(FrameBudget.GetTileSize());
+                View.SetTraceStride(DynamicResolution.GetStride());
+                View.SetSceneMirror(SceneMirror.GetScene());
+                View.SetSurfelCache(SurfelCache.IsOpen() ? &SurfelCache : nullptr);
+                if (View.BeginTick(CurrentRenderSettings, DirtyBounds))
                 {
-                    trans = CameraManager->GetTransform();
+                    ReadyViews.Add(&View);
                 }
-                else
+                if (View.ConsumeXRayTargetsChanged() || View.GetFullTraceStride() != OldStride || View.GetFocusRect() != OldFocusRect)
                 {
-#if WITH_EDITOR
-                    FViewport* ViewPort = GEditor->GetActiveViewport();
-                    if (ViewPort->IsPlayInEditorViewport())
-                    {
-                        return;
-                    }
-                    FEditorViewportClient* client = (FEditorViewportClient*)ViewPort->GetClient();
-                    FVector CamPos = client->GetViewLocation();
-                    trans = FTransform(client->GetViewRotation(), CamPos, FVector::OneVector);
-#endif // WITH_EDITOR
+                    BindWidgetTexture(View);
                 }
             }
-            else
+            FirstViewToSubmit = Views.Num() > 0 ? (FirstViewToSubmit + 1) % Views.Num() : 0;
+
+            SubmitTiles(ReadyViews);
+            UpdateStats();
+        }
+    }
+    else
+    {
+        // Stopping cancelled the tiles in flight, they only finish the row they are on.
+        bool AllIdle = true;
+        for (const TUniquePtr<FCollisionDebuggerView>& View : Views)
+        {
+            AllIdle &= View->IsIdle();
+        }
+        for (const TUniquePtr<FCollisionDebuggerView>& View : RetiringViews)
+        {
+            AllIdle &= View->IsIdle();
+        }
+
+        if (AllIdle)
+        {
+            ShouldRun = false;
+            CleanupAndClear();
+        }
+    }
+}
+
+void UCollisionDebuggerSubsystem::SubmitTiles(TArray<FCollisionDebuggerView*>& ReadyViews)
+{
+    const int64 RayBudget = FrameBudget.GetRaysPerFrame();
+    const int32 MaxTilesInFlight = FrameBudget.GetMaxTilesInFlight();
+    const bool ChangedOnly = ChangeTracker.IsTracking();
+
+    TArray<int64, TInlineAllocator<8>> RaysSubmitted;
+    RaysSubmitted.SetNumZeroed(ReadyViews.Num());
+    int64 TotalRays = 0;
+
+    while (ReadyViews.Num() > 0 && FCollisionDebuggerTraceEngine::CanAcceptTile(MaxTilesInFlight) && (RayBudget <= 0 || TotalRays < RayBudget))
+    {
+        // The view that got the fewest rays this tick goes next, views without work leave their share to the others.
+        int32 Next = 0;
+        for (int32 i = 1; i < ReadyViews.Num(); i++)
+        {
+            if (RaysSubmitted[i] < RaysSubmitted[Next])
             {
-                return;
+                Next = i;
             }
+        }
 
-            FUpdateTextureRegion2D region = FUpdateTextureRegion2D(IndexX, IndexY, IndexX, IndexY, UpdateSize, UpdateSize);
-            if (IsValid(DebugRenderTarget) && !StopHasStarted && ShouldRun)
-            {
-                Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, trans, region] {UpdateTexture(trans, region, CurrentRenderSettings); });
+        const int32 NumRays = ReadyViews[Next]->SubmitNextTile(CurrentRenderSettings, ChangedOnly);
+        if (NumRays == 0)
+        {
+            ReadyViews.RemoveAt(Next);
+            RaysSubmitted.RemoveAt(Next);
+            continue;
+        }
+        RaysSubmitted[Next] += NumRays;
+        TotalRays += NumRays;
+    }
+}
 
-                IndexX += UpdateSize;
-                if (IndexX >= DebugRenderTarget->SizeX)
-                {
-                    IndexX = 0;
-                    IndexY += UpdateSize;
-                }
+void UCollisionDebuggerSubsystem::UpdateViews()
+{
+    UWorld* World = GetWorld();
 
-                if (IndexY >= DebugRenderTarget->SizeY)
-                {
-                    IndexY = 0;
-                }
+    // Game worlds get a view per local player, split screen included. Everything else follows the editor viewport.
+    TArray<APlayerController*> LocalPlayers;
+    if (World->IsGameWorld())
+    {
+        for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+        {
+            APlayerController* PlayerController = It->Get();
+            if (PlayerController && PlayerController->IsLocalController())
+            {
+                LocalPlayers.Add(PlayerController);
             }
+        }
+    }
 
+    for (int32 i = Views.Num() - 1; i >= 0; i--)
+    {
+        const FCollisionDebuggerView& View = *Views[i];
+        const bool Keep = View.IsPlayerView() ? LocalPlayers.Contains(View.GetPlayer()) : LocalPlayers.Num() == 0;
+        if (!Keep)
+        {
+            RetireView(i);
         }
-        else if (Task.IsCompleted())
+    }
+
+    for (APlayerController* PlayerController : LocalPlayers)
+    {
+        if (FindViewIndex(PlayerController) == INDEX_NONE)
         {
-            Task = {};
+            CreateView(PlayerController);
         }
     }
-    else
+    if (LocalPlayers.Num() == 0 && Views.Num() == 0)
+    {
+        CreateView(nullptr);
+    }
+}
+
+void UCollisionDebuggerSubsystem::CreateView(APlayerController* PlayerController)
+{
+    if (TUniquePtr<FCollisionDebuggerView> Parked = UnparkView(PlayerController))
+    {
+        SetupWidget(*Views.Add_GetRef(MoveTemp(Parked)));
+        return;
+    }
+
+    UTextureRenderTarget2D* RenderTarget = AcquireRenderTarget();
+    if (!RenderTarget)
     {
-        if (Task.IsCompleted())
+        return;
+    }
+
+    TUniquePtr<FCollisionDebuggerView>& View = Views.Add_GetRef(MakeUnique<FCollisionDebuggerView>(GetWorld(), PlayerController, RenderTarget, FrameBudget.GetTileSize()));
+    SetupWidget(*View);
+}
+
+void UCollisionDebuggerSubsystem::RetireView(int32 ViewIndex)
+{
+    // The view is hidden right away, its cancelled tiles are left to drain without blocking the tick.
+    FCollisionDebuggerView& View = *Views[ViewIndex];
+    RemoveWidget(View);
+    View.Cancel();
+    RetiringViews.Add(MoveTemp(Views[ViewIndex]));
+    Views.RemoveAt(ViewIndex);
+}
+
+void UCollisionDebuggerSubsystem::ParkView(int32 ViewIndex)
+{
+    // Only what was in flight is dropped, the buffers and the render target keep the last picture.
+    // The cancelled tiles drain while the view is parked, as for a retiring view, so parking never
+    // blocks the tick. A view unparked before they did gets them back as dropped tiles.
+    FCollisionDebuggerView& View = *Views[ViewIndex];
+    RemoveWidget(View);
+    View.Cancel();
+    ParkedViews.Add(MoveTemp(Views[ViewIndex]));
+    Views.RemoveAt(ViewIndex);
+}
+
+TUniquePtr<FCollisionDebuggerView> UCollisionDebuggerSubsystem::UnparkView(APlayerController* PlayerController)
+{
+    // Views of players that left or with a size or format that is no longer wanted can't come back.
+    const FIntPoint Resolution = CollisionDebuggerSubsystem::GetConfiguredResolution();
+    const EPixelFormat Format = FCollisionDebuggerHitBuffer::GetPixelFormat(FCollisionDebuggerViewMaterial::GetHitFormat());
+    for (int32 i = ParkedViews.Num() - 1; i >= 0; i--)
+    {
+        const FCollisionDebuggerView& View = *ParkedViews[i];
+        const UTextureRenderTarget2D* RenderTarget = View.GetRenderTarget();
+        if ((View.IsPlayerView() && !View.GetPlayer()) || !IsValid(RenderTarget) || View.GetSize() != Resolution || RenderTarget->GetFormat() != Format)
         {
-            ShouldRun = false;
-            Task = {};
-            CleanupAndClear();
+            // Retired rather than destroyed, it may still be draining.
+            RetiringViews.Add(MoveTemp(ParkedViews[i]));
+            ParkedViews.RemoveAt(i);
+        }
+    }
+
+    const int32 ParkedIndex = ParkedViews.IndexOfByPredicate([PlayerController](const TUniquePtr<FCollisionDebuggerView>& View)
+    {
+        return View->IsPlayerView() == (PlayerController != nullptr) && View->GetPlayer() == PlayerController;
+    });
+    if (ParkedIndex == INDEX_NONE)
+    {
+        return nullptr;
+    }
+
+    // Nothing tracked the world while the view was parked.
+    TUniquePtr<FCollisionDebuggerView> View = MoveTemp(ParkedViews[ParkedIndex]);
+    ParkedViews.RemoveAt(ParkedIndex);
+    View->MarkAllDirty();
+    return View;
+}
+
+void UCollisionDebuggerSubsystem::DestroyRetiredViews(bool Wait)
+{
+    for (int32 i = RetiringViews.Num() - 1; i >= 0; i--)
+    {
+        if (Wait || RetiringViews[i]->IsIdle())
+        {
+            // Destroying the view waits for its uploads, only then can another view draw into the render target.
+            UTextureRenderTarget2D* RenderTarget = RetiringViews[i]->GetRenderTarget();
+            RetiringViews.RemoveAt(i);
+            ReleaseRenderTarget(RenderTarget);
+        }
+    }
+}
+
+int32 UCollisionDebuggerSubsystem::FindViewIndex(const APlayerController* PlayerController) const
+{
+    return Views.IndexOfByPredicate([PlayerController](const TUniquePtr<FCollisionDebuggerView>& View)
+    {
+        return View->IsPlayerView() && View->GetPlayer() == PlayerController;
+    });
+}
+
+UTextureRenderTarget2D* UCollisionDebuggerSubsystem::AcquireRenderTarget()
+{
+    using namespace CollisionDebuggerSubsystem;
+
+    const FIntPoint Resolution = GetConfiguredResolution();
+    const EPixelFormat TargetFormat = FCollisionDebuggerHitBuffer::GetPixelFormat(FCollisionDebuggerViewMaterial::GetHitFormat());
+    UTextureRenderTarget2D* RenderTarget = nullptr;
+
+    // Without the view material the widgets keep M_ShowCollision, which only shows its own render
+    // target. The first view draws into that one, the others have nothing to show them.
+    if (!FCollisionDebuggerViewMaterial::IsSupported())
+    {
+        UTextureRenderTarget2D* AssetTarget = LoadObject<UTextureRenderTarget2D>(nullptr, WidgetTexturePath);
+        auto UsesAsset = [AssetTarget](const TUniquePtr<FCollisionDebuggerView>& View) { return View->GetRenderTarget() == AssetTarget; };
+        if (AssetTarget && !Views.ContainsByPredicate(UsesAsset) && !ParkedViews.ContainsByPredicate(UsesAsset) && !RetiringViews.ContainsByPredicate(UsesAsset))
+        {
+            RenderTarget = AssetTarget;
+        }
+        else
+        {
+            UE_LOG(LogTemp, Warning, TEXT("Collision debugger: only the first view is shown without the view material"));
+        }
+    }
+
+    if (!RenderTarget)
+    {
+        RenderTarget = RenderTargetPool.Num() > 0 ? RenderTargetPool.Pop(false).Get() : NewObject<UTextureRenderTarget2D>(this);
+    }
+    if (RenderTarget->SizeX != Resolution.X || RenderTarget->SizeY != Resolution.Y || RenderTarget->GetFormat() != TargetFormat)
+    {
+        RenderTarget->InitCustomFormat(Resolution.X, Resolution.Y, TargetFormat, true);
+    }
+    return RenderTarget;
+}
+
+void UCollisionDebuggerSubsystem::ReleaseRenderTarget(UTextureRenderTarget2D* RenderTarget)
+{
+    // The asset's render target is never pooled, it is only for the first view without the view material.
+    if (IsValid(RenderTarget) && RenderTarget->GetOuter() == this)
+    {
+        RenderTargetPool.Add(RenderTarget);
+    }
+}
+
+void UCollisionDebuggerSubsystem::UpdateStats()
+{
+    FCollisionDebuggerTraceStats Stats;
+    int32 NumTilesInFlight = 0;
+    int64 NumPixels = 0;
+    bool RefreshPending = false;
+    for (const TUniquePtr<FCollisionDebuggerView>& View : Views)
+    {
+        const FCollisionDebuggerTraceStats ViewStats = View->ConsumeStats();
+        Stats.NumRays += ViewStats.NumRays;
+        Stats.NumHits += ViewStats.NumHits;
+        Stats.NumTiles += ViewStats.NumTiles;
+        Stats.TileSeconds += ViewStats.TileSeconds;
+        RefreshPending |= View->IsRefreshing();
+        NumTilesInFlight += View->GetNumTilesInFlight();
+        NumPixels += int64(View->GetSize().X) * View->GetSize().Y;
+    }
+
+    if (Stats.NumRays > 0)
+    {
+        SET_FLOAT_STAT(STAT_CollisionDebugger_HitRatio, float(double(Stats.NumHits) / double(Stats.NumRays)));
+    }
+    if (Stats.NumTiles > 0)
+    {
+        SET_FLOAT_STAT(STAT_CollisionDebugger_MsPerTile, float(Stats.TileSeconds * 1000.0 / Stats.NumTiles));
+    }
+    FrameBudget.Update(Stats);
+    DynamicResolution.Update(Stats.NumRays, RefreshPending, NumPixels);
+    SET_DWORD_STAT(STAT_CollisionDebugger_TraceStride, DynamicResolution.GetStride());
+    SET_DWORD_STAT(STAT_CollisionDebugger_TileSize, FrameBudget.GetTileSize());
+    SET_DWORD_STAT(STAT_CollisionDebugger_RayBudget, uint32(FMath::Min<int64>(FrameBudget.GetRaysPerFrame(), MAX_uint32)));
+    SET_DWORD_STAT(STAT_CollisionDebugger_TilesInFlight, NumTilesInFlight);
+    SET_DWORD_STAT(STAT_CollisionDebugger_RowsQueued, FCollisionDebuggerTraceEngine::GetNumQueuedRows());
+
+    // A refresh runs from the first tile that needs a trace until no view holds anything stale.
+    const double Now = FPlatformTime::Seconds();
+    if (RefreshPending && RefreshStartTime < 0.0)
+    {
+        RefreshStartTime = Now;
+    }
+    else if (!RefreshPending && RefreshStartTime >= 0.0)
+    {
+        SET_FLOAT_STAT(STAT_CollisionDebugger_RefreshLatency, float((Now - RefreshStartTime) * 1000.0));
+        RefreshStartTime = -1.0;
+    }
+}
+
+void UCollisionDebuggerSubsystem::InvalidateChangedTiles(TArray<FBox>& OutDirtyBounds)
+{
+    COLLISIONDEBUGGER_SCOPE(Invalidate);
+
+    if (FCollisionDebuggerChangeTracker::IsEnabled() != ChangeTracker.IsTracking())
+    {
+        if (ChangeTracker.IsTracking())
+        {
+            ChangeTracker.Stop();
+        }
+        else
+        {
+            // Changes made while nothing was tracking are unknown.
+            ChangeTracker.Start(GetWorld());
+            for (const TUniquePtr<FCollisionDebuggerView>& View : Views)
+            {
+                View->MarkAllDirty();
+            }
         }
     }
+
+    ChangeTracker.ConsumeDirtyBounds(OutDirtyBounds);
+    SurfelCache.Update(GetWorld(), CurrentRenderSettings);
+    SurfelCache.Invalidate(OutDirtyBounds);
+
+    // The mirror follows the same changes, before any tile of this tick traces it.
+    TArray<TWeakObjectPtr<UPrimitiveComponent>> ChangedPrimitives;
+    ChangeTracker.ConsumeChangedPrimitives(ChangedPrimitives);
+    SceneMirror.Update(GetWorld(), CurrentRenderSettings, ChangedPrimitives, ChangeTracker.IsTracking());
 }
 
 void UCollisionDebuggerSubsystem::OnPreEndPIE(const bool bIsSimulating)
@@ -130,7 +444,7 @@ void UCollisionDebuggerSubsystem::OnPreEndPIE(const bool bIsSimulating)
 
 TStatId UCollisionDebuggerSubsystem::GetStatId() const
 {
-	RETURN_QUICK_DECLARE_CYCLE_STAT(UCollisionDebuggerSubsystem, STATGROUP_Tickables);
+	return GET_STATID(STAT_CollisionDebugger_Tick);
 }
 
 void UCollisionDebuggerSubsystem::Deinitialize()
@@ -138,6 +452,14 @@ void UCollisionDebuggerSubsystem::Deinitialize()
     ShouldRun = false;
     StopHasStarted = true;
     CleanupAndClear();
+
+    ParkedViews.Empty();
+    RenderTargetPool.Empty();
+    if (AssetLoadHandle.IsValid())
+    {
+        AssetLoadHandle->CancelHandle();
+        AssetLoadHandle.Reset();
+    }
 }
 
 bool UCollisionDebuggerSubsystem::IsTickable() const
@@ -147,31 +469,79 @@ bool UCollisionDebuggerSubsystem::IsTickable() const
 
 void UCollisionDebuggerSubsystem::SetupAssets()
 {
+    using namespace CollisionDebuggerSubsystem;
+
     PIECallbackHandle = FEditorDelegates::BeginPIE.AddUObject(this, &UCollisionDebuggerSubsystem::OnPreEndPIE);
-    DebugRenderTarget = Cast<UTextureRenderTarget2D>(StaticLoadObject(UTextureRenderTarget2D::StaticClass(), NULL, TEXT("/Script/Engine.TextureRenderTarget2D'/CollisionDebuggerTool/RT_CollisionDebugger_PhyCap.RT_CollisionDebugger_PhyCap'")));
+    if (CollisionDebugMainWidgetClass || AssetLoadHandle.IsValid())
+    {
+        return;
+    }
+
+    // Views trace right away, their widgets are added once the widget and its material streamed in.
+    FStreamableManager& AssetLoader = UAssetManager::GetStreamableManager();
+    const TArray<FSoftObjectPath> Assets = { FSoftObjectPath(WidgetClassPath), FSoftObjectPath(WidgetMaterialPath), FSoftObjectPath(WidgetTexturePath) };
+    AssetLoadHandle = AssetLoader.RequestAsyncLoad(Assets, FStreamableDelegate::CreateUObject(this, &UCollisionDebuggerSubsystem::OnAssetsLoaded), FStreamableManager::AsyncLoadHighPriority);
+}
+
+void UCollisionDebuggerSubsystem::OnAssetsLoaded()
+{
+    using namespace CollisionDebuggerSubsystem;
+
+    CollisionDebugMainWidgetClass = Cast<UClass>(FSoftObjectPath(WidgetClassPath).ResolveObject());
+    if (!CollisionDebugMainWidgetClass)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Collision debugger: could not load %s"), WidgetClassPath);
+        return;
+    }
+
+    if (!ViewMaterial && FCollisionDebuggerViewMaterial::IsSupported())
+    {
+        ViewMaterial = FCollisionDebuggerViewMaterial::Create(this, Cast<UTexture>(FSoftObjectPath(WidgetTexturePath).ResolveObject()));
+    }
 
-    if (PixelColors.Num() != DebugRenderTarget->SizeX * DebugRenderTarget->SizeY)
+    for (const TUniquePtr<FCollisionDebuggerView>& View : Views)
     {
-        PixelColors.SetNumZeroed(DebugRenderTarget->SizeX * DebugRenderTarget->SizeY);
+        if (!View->Widget)
+        {
+            SetupWidget(*View);
+        }
     }
-  
-    SetupWidget();
 }
 
 void UCollisionDebuggerSubsystem::CleanupAndClear()
 {
     StopHasStarted = true;
     ShouldRun = false;
-    RemoveEditorWidget();
 
-    if (Task.IsValid())
+    for (int32 i = Views.Num() - 1; i >= 0; i--)
     {
-        Task.Wait();
+        ParkView(i);
     }
+    DestroyRetiredViews(true);
+    ChangeTracker.Stop();
+    SceneMirror.Reset();
+    SurfelCache.Close();
 
     FEditorDelegates::BeginPIE.Remove(PIECallbackHandle);
-    DebugRenderTarget = nullptr;
-    PixelColors.Empty();
+}
+
+void UCollisionDebuggerSubsystem::AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector)
+{
+    Super::AddReferencedObjects(InThis, Collector);
+
+    UCollisionDebuggerSubsystem* This = CastChecked<UCollisionDebuggerSubsystem>(InThis);
+    for (const TUniquePtr<FCollisionDebuggerView>& View : This->Views)
+    {
+        View->AddReferencedObjects(Collector);
+    }
+    for (const TUniquePtr<FCollisionDebuggerView>& View : This->RetiringViews)
+    {
+        View->AddReferencedObjects(Collector);
+    }
+    for (const TUniquePtr<FCollisionDebuggerView>& View : This->ParkedViews)
+    {
+        View->AddReferencedObjects(Collector);
+    }
 }
 
 ETickableTickType UCollisionDebuggerSubsystem::GetTickableTickType() const
@@ -184,10 +554,10 @@ bool UCollisionDebuggerSubsystem::ShouldCreateSubsystem(UObject* Outer) const
 	return true;
 }
 
-void UCollisionDebuggerSubsystem::RemoveEditorWidget()
+void UCollisionDebuggerSubsystem::RemoveWidget(FCollisionDebuggerView& View)
 {
 #if WITH_EDITOR
-    if (CreatedSlateWidget)
+    if (View.SlateWidget)
     {
         FLevelEditorModule& LevelEditor = FModuleManager::GetModuleChecked<FLevelEditorModule>(TEXT("LevelEditor"));
         TWeakPtr<ILevelEditor> editor = LevelEditor.GetLevelEditorInstance();
@@ -196,43 +566,45 @@ void UCollisionDebuggerSubsystem::RemoveEditorWidget()
         if (PinnedEditor.IsValid())
         {
             TSharedPtr<SLevelViewport> LevelViewport = PinnedEditor->GetActiveViewportInterface();
-            if (CreatedSlateWidget)
+            if (View.SlateWidget)
             {
-                LevelViewport->RemoveOverlayWidget(CreatedSlateWidget.ToSharedRef());
+                LevelViewport->RemoveOverlayWidget(View.SlateWidget.ToSharedRef());
             }
         }
 
-        CreatedSlateWidget.Reset();
-        CreatedSlateWidget = nullptr;
+        View.SlateWidget.Reset();
+        View.SlateWidget = nullptr;
     }
 #endif// WITH_EDITOR
 
-    if (CollisionDebugMainWidget)
+    if (View.Widget)
     {
-        CollisionDebugMainWidget->RemoveFromParent();
-        CollisionDebugMainWidget->MarkAsGarbage();
-        CollisionDebugMainWidget = nullptr;
+        View.Widget->RemoveFromParent();
+        View.Widget->MarkAsGarbage();
+        View.Widget = nullptr;
     }
-
-    CollisionDebugMainWidgetClass = nullptr;
 }
 
-void UCollisionDebuggerSubsystem::SetupWidget()
+void UCollisionDebuggerSubsystem::SetupWidget(FCollisionDebuggerView& View)
 {
-    FStreamableManager& AssetLoader = UAssetManager::GetStreamableManager();
-    CollisionDebugMainWidgetClass = AssetLoader.LoadSynchronous<UClass>(FSoftObjectPath("/CollisionDebuggerTool/UI_CollisionDebugView.UI_CollisionDebugView_C"));
-
     if (CollisionDebugMainWidgetClass)
     {
         UWorld* World = GetWorld();
-        CollisionDebugMainWidget = CreateWidget<UUserWidget>(World, CollisionDebugMainWidgetClass);
 
-        if (World->IsGameWorld())
+        if (APlayerController* PlayerController = View.GetPlayer())
+        {
+            // Player views show in their own part of a split screen.
+            View.Widget = CreateWidget<UUserWidget>(PlayerController, CollisionDebugMainWidgetClass);
+            View.Widget->AddToPlayerScreen();
+        }
+        else if (World->IsGameWorld())
         {
-            CollisionDebugMainWidget->AddToViewport();
+            View.Widget = CreateWidget<UUserWidget>(World, CollisionDebugMainWidgetClass);
+            View.Widget->AddToViewport();
         }
         else
         {
+            View.Widget = CreateWidget<UUserWidget>(World, CollisionDebugMainWidgetClass);
 #if WITH_EDITOR
 
             FLevelEditorModule& LevelEditor = FModuleManager::GetModuleChecked<FLevelEditorModule>(TEXT("LevelEditor"));
@@ -245,109 +617,75 @@ void UCollisionDebuggerSubsystem::SetupWidget()
                 FChildren* childrenSlot = slevelviewport->GetChildren();
                 if (childrenSlot)
                 {
-                    TSharedRef<SWidget> InternalCreatedSlateWidget = CollisionDebugMainWidget->TakeWidget();
-                    CreatedSlateWidget = InternalCreatedSlateWidget.ToSharedPtr();
-                    slevelviewport->AddOverlayWidget(CreatedSlateWidget.ToSharedRef());
+                    TSharedRef<SWidget> InternalCreatedSlateWidget = View.Widget->TakeWidget();
+                    View.SlateWidget = InternalCreatedSlateWidget.ToSharedPtr();
+                    slevelviewport->AddOverlayWidget(View.SlateWidget.ToSharedRef());
                 }
             }
 #endif // WITH_EDITOR
         }
-    }
-}
-
-
-void UCollisionDebuggerSubsystem::UpdateTextureRegion(
-    FTexture2DRHIRef TextureRHI,
-    int32 MipIndex,
-    uint32 NumRegions,
-    FUpdateTextureRegion2D Region,
-    uint32 SrcPitch,
-    uint32 SrcBpp,
-    uint8* SrcData,
-    TFunction<void(uint8* SrcData)> DataCleanupFunc
-)
-{
-    FTaskTagScope Scope(ETaskTag::EParallelRenderingThread);
-    ENQUEUE_RENDER_COMMAND(UpdateTextureRegionsData)(
-        [=](FRHICommandListImmediate& RHICmdList)
-        {
-            if (!TextureRHI.IsValid())
-            {
-                UE_LOG(LogTemp, Error, TEXT("Invalid Texture2DRHIRef"));
-                return;
-            }
 
-    RHIUpdateTexture2D(
-        TextureRHI,
-        MipIndex,
-        Region,
-        SrcPitch,
-        SrcData
-        + Region.SrcY * SrcPitch
-        + Region.SrcX * SrcBpp
-    );
-
-    DataCleanupFunc(SrcData);
-        });
+        BindWidgetTexture(View);
+    }
 }
 
-
-void UCollisionDebuggerSubsystem::UpdateTexture(FTransform trans, FUpdateTextureRegion2D region, FInputRenderSettingsInternal TileRenderSettings)
+void UCollisionDebuggerSubsystem::BindWidgetTexture(FCollisionDebuggerView& View)
 {
-    UWorld* world = GetWorld();
-    if (!IsValid(world)) { return; }
+    using namespace CollisionDebuggerSubsystem;
 
-    FlushPersistentDebugLines(world);
-    FVector CamPos = trans.GetLocation();
+    if (!View.Widget || !View.Widget->WidgetTree)
+    {
+        return;
+    }
 
-    for (int32 y = region.SrcY; y < region.SrcY + UpdateSize; y++)
+    // The view's render target and the x-ray textures reach the widget through a dynamic instance
+    // of every material it draws, made the first time and updated after that. Images get the view
+    // material in place of M_ShowCollision, which only ever shows its own render target.
+    UMaterialInterface* Parent = ViewMaterial;
+    const bool UsesXRay = View.GetXRayEntryTarget() != nullptr;
+    const int32 Layer = XRayLayer;
+    const float TraceStride = float(View.GetFullTraceStride());
+    const FVector2D Size = FVector2D(View.GetSize());
+    const FIntRect Focus = View.GetFocusRect();
+    const FLinearColor FocusRect(Focus.Min.X / Size.X, Focus.Min.Y / Size.Y, Focus.Max.X / Size.X, Focus.Max.Y / Size.Y);
+    View.Widget->WidgetTree->ForEachWidget([&View, Parent, UsesXRay, Layer, TraceStride, &FocusRect](UWidget* Widget)
     {
-        for (int32 x = region.SrcX; x < region.SrcX + UpdateSize; x++)
+        UImage* Image = Cast<UImage>(Widget);
+        UMaterialInterface* Material = Image ? Cast<UMaterialInterface>(Image->GetBrush().GetResourceObject()) : nullptr;
+        if (!Material)
         {
-            float xOff = ((x / (float)(DebugRenderTarget->SizeX)) - .5) * 2;
-            float yOff = ((y / (float)(DebugRenderTarget->SizeY)) - .5) * -2;
-            float FovHack = .7;
-            FVector dir = trans.TransformVector(FVector(1, xOff * FovHack, yOff * FovHack)).GetSafeNormal();
-
-            FHitResult RV_Hit;
-
-            FCollisionQueryParams RV_TraceParams;
-            RV_TraceParams.bTraceComplex = TileRenderSettings.TraceComplex;
-            RV_TraceParams.bReturnPhysicalMaterial = false;
-
-            bool DidTrace = false;
-            if (TileRenderSettings.bIsChannelTest)
-            {
-                DidTrace = world->LineTraceSingleByChannel(RV_Hit, CamPos, CamPos + (dir * 100000), TileRenderSettings.ChannelToTest, RV_TraceParams);
-            }
-            else
-            {
-                DidTrace = world->LineTraceSingleByProfile(RV_Hit, CamPos, CamPos + (dir * 100000), TileRenderSettings.ProfileNameToTest, RV_TraceParams);
-            }
-            
-
-            const int32 index = x + (y * DebugRenderTarget->SizeX);
-            if (!PixelColors.IsValidIndex(index)) { return; }
-            if (DidTrace)
-            {
-                PixelColors[index] = FLinearColor(RV_Hit.Normal.X, RV_Hit.Normal.Y, RV_Hit.Normal.Z, RV_Hit.Time);
-            }
-            else
-            {
-                PixelColors[index] = FLinearColor(-1, -1, -1, -1);
-
-            }
-
+            return;
         }
-    }
-
 
+        UMaterialInstanceDynamic* Instance = Cast<UMaterialInstanceDynamic>(Material);
+        if (!Instance || (Parent && Instance->Parent != Parent))
+        {
+            Instance = UMaterialInstanceDynamic::Create(Parent ? Parent : Material, View.Widget);
+            Image->SetBrushFromMaterial(Instance);
+        }
 
-    FTaskTagScope scope(ETaskTag::EParallelRenderingThread);
-    UpdateTextureRegion(DebugRenderTarget->GetResource()->GetTexture2DRHI(), 0, 1, region, DebugRenderTarget->SizeX * 16, 16, reinterpret_cast<uint8*>(PixelColors.GetData()));
-
+        Instance->SetTextureParameterValue(FCollisionDebuggerViewMaterial::TextureParameter, View.GetRenderTarget());
+        Instance->SetScalarParameterValue(FCollisionDebuggerViewMaterial::HitFormatParameter, float(View.GetHitFormat()));
+        Instance->SetScalarParameterValue(FCollisionDebuggerViewMaterial::XRayParameter, UsesXRay ? 1.f : 0.f);
+        Instance->SetScalarParameterValue(FCollisionDebuggerViewMaterial::XRayLayerParameter, float(Layer));
+        Instance->SetScalarParameterValue(FCollisionDebuggerViewMaterial::TraceStrideParameter, TraceStride);
+        Instance->SetVectorParameterValue(FCollisionDebuggerViewMaterial::FocusRectParameter, FocusRect);
+        if (UsesXRay)
+        {
+            Instance->SetTextureParameterValue(FCollisionDebuggerViewMaterial::XRayEntriesParameter, View.GetXRayEntryTarget());
+            Instance->SetTextureParameterValue(FCollisionDebuggerViewMaterial::XRayLayersParameter, View.GetXRayLayerTarget());
+        }
+    });
 }
 
+void UCollisionDebuggerSubsystem::SetXRayLayer(int32 Layer)
+{
+    XRayLayer = FMath::Max(Layer, -1);
+    for (const TUniquePtr<FCollisionDebuggerView>& View : Views)
+    {
+        BindWidgetTexture(*View);
+    }
+}
 
 void UCollisionDebuggerSubsystem::StartCollisionDebug()
 {
@@ -359,6 +697,10 @@ void UCollisionDebuggerSubsystem::StartCollisionDebug()
 void UCollisionDebuggerSubsystem::StopCollisionDebug()
 {
     StopHasStarted = true;
+    for (const TUniquePtr<FCollisionDebuggerView>& View : Views)
+    {
+        View->Cancel();
+    }
 }
 
 bool UCollisionDebuggerSubsystem::ShouldTickOrRun()
@@ -385,6 +727,55 @@ bool UCollisionDebuggerSubsystem::ShouldTickOrRun()
 }
 
 TArray<FString> UCollisionDebuggerSubsystem::GetCollisionProfiles()
+{
+    return GetCollisionProfileNames();
+}
+
+TArray<FString> UCollisionDebuggerSubsystem::GetCollisionChannels()
+{
+    return GetCollisionChannelNames();
+}
+
+int32 UCollisionDebuggerSubsystem::GetNumViews() const
+{
+    return Views.Num();
+}
+
+int32 UCollisionDebuggerSubsystem::GetViewForPlayer(APlayerController* PlayerController) const
+{
+    const int32 ViewIndex = FindViewIndex(PlayerController);
+    return ViewIndex != INDEX_NONE ? ViewIndex : (Views.Num() > 0 ? 0 : INDEX_NONE);
+}
+
+UTextureRenderTarget2D* UCollisionDebuggerSubsystem::GetViewRenderTarget(int32 ViewIndex) const
+{
+    return Views.IsValidIndex(ViewIndex) ? Views[ViewIndex]->GetRenderTarget() : nullptr;
+}
+
+bool UCollisionDebuggerSubsystem::GetHitAtPixel(int32 ViewIndex, int32 X, int32 Y, FCollisionDebuggerHitInfo& OutHit) const
+{
+    OutHit = FCollisionDebuggerHitInfo();
+    return Views.IsValidIndex(ViewIndex) && Views[ViewIndex]->GetHitAtPixel(X, Y, OutHit);
+}
+
+bool UCollisionDebuggerSubsystem::GetHitAtUV(int32 ViewIndex, FVector2D UV, FCollisionDebuggerHitInfo& OutHit) const
+{
+    OutHit = FCollisionDebuggerHitInfo();
+    if (!Views.IsValidIndex(ViewIndex))
+    {
+        return false;
+    }
+
+    const FIntPoint Size = Views[ViewIndex]->GetSize();
+    return Views[ViewIndex]->GetHitAtPixel(FMath::FloorToInt(UV.X * Size.X), FMath::FloorToInt(UV.Y * Size.Y), OutHit);
+}
+
+bool UCollisionDebuggerSubsystem::GetPrimitiveBoundsUV(int32 ViewIndex, UPrimitiveComponent* Component, FVector2D& OutMin, FVector2D& OutMax) const
+{
+    return Views.IsValidIndex(ViewIndex) && Views[ViewIndex]->GetPrimitiveBoundsUV(Component, OutMin, OutMax);
+}
+
+TArray<FString> UCollisionDebuggerSubsystem::GetCollisionProfileNames()
 {
     TArray<TSharedPtr<FName>> OutNameList;
     UCollisionProfile::Get()->GetProfileNames(OutNameList);
@@ -396,7 +787,7 @@ TArray<FString> UCollisionDebuggerSubsystem::GetCollisionProfiles()
     return result;
 }
 
-TArray<FString> UCollisionDebuggerSubsystem::GetCollisionChannels()
+TArray<FString> UCollisionDebuggerSubsystem::GetCollisionChannelNames()
 {
     UEnum* Enum = StaticEnum<ECollisionChannel>();
     int32 NumEnum = Enum->NumEnums();
@@ -411,31 +802,34 @@ TArray<FString> UCollisionDebuggerSubsystem::GetCollisionChannels()
 
 }
 
-void UCollisionDebuggerSubsystem::SetRenderSettings(FInputRenderSettings NewSettings)
+FInputRenderSettingsInternal UCollisionDebuggerSubsystem::ResolveRenderSettings(const FInputRenderSettings& NewSettings)
 {
+    FInputRenderSettingsInternal Resolved;
+
     // Test type
-    CurrentRenderSettings.bIsChannelTest = NewSettings.IsChannelTest;
+    Resolved.bIsChannelTest = NewSettings.IsChannelTest;
     
     {// channels
-        TArray<FString> Channels = GetCollisionChannels();
+        TArray<FString> Channels = GetCollisionChannelNames();
         bool Channelfound = false;
         for (int32 i = 0; i < Channels.Num() && !Channelfound; i++)
         {
             if (Channels[i] == NewSettings.ChannelName)
             {
-                CurrentRenderSettings.ChannelToTest = (ECollisionChannel)i;
+                Resolved.ChannelToTest = (ECollisionChannel)i;
+                Channelfound = true;
                 break;
             }
         }
         if (!Channelfound) 
         {
-            CurrentRenderSettings.ChannelToTest = ECollisionChannel::ECC_WorldStatic;
+            Resolved.ChannelToTest = ECollisionChannel::ECC_WorldStatic;
         }
     }
 
     { // Profile
 
-        TArray<FString> Profiles = GetCollisionProfiles();
+        TArray<FString> Profiles = GetCollisionProfileNames();
 
         bool Profilefound = false;
         FName TestProfile = FName(NewSettings.ProfileName);
@@ -449,15 +843,36 @@ void UCollisionDebuggerSubsystem::SetRenderSettings(FInputRenderSettings NewSett
         }
         if (!Profilefound)
         {
-            CurrentRenderSettings.ProfileNameToTest = FName(Profiles[0]);
+            Resolved.ProfileNameToTest = FName(Profiles[0]);
         }
         else
         {
-            CurrentRenderSettings.ProfileNameToTest = TestProfile;
+            Resolved.ProfileNameToTest = TestProfile;
         }
     }
 
 
-    CurrentRenderSettings.TraceComplex = NewSettings.TraceComplex;
+    Resolved.TraceComplex = NewSettings.TraceComplex;
+    return Resolved;
+}
+
+void UCollisionDebuggerSubsystem::SetRenderSettings(FInputRenderSettings NewSettings)
+{
+    const FInputRenderSettingsInternal PreviousSettings = CurrentRenderSettings;
+    CurrentRenderSettings = ResolveRenderSettings(NewSettings);
 
+    const bool TestChanged = PreviousSettings.bIsChannelTest != CurrentRenderSettings.bIsChannelTest
+        || PreviousSettings.ChannelToTest != CurrentRenderSettings.ChannelToTest
+        || PreviousSettings.ProfileNameToTest != CurrentRenderSettings.ProfileNameToTest;
+    for (const TUniquePtr<FCollisionDebuggerView>& View : Views)
+    {
+        if (PreviousSettings.TraceComplex != CurrentRenderSettings.TraceComplex)
+        {
+            View->OnTraceComplexChanged();
+        }
+        else if (TestChanged)
+        {
+            View->OnTestChanged();
+        }
+    }
 }
@@ -0,0 +1,801 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerSurfelCache.h"
+#include "CollisionDebuggerStats.h"
+#include "CollisionDebuggerHitBuffer.h"
+#include "CollisionDebuggerPrimitiveIds.h"
+#include "CollisionDebuggerRayTable.h"
+#include "CollisionDebuggerReprojection.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/Sort.h"
+#include "Async/ParallelFor.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "UObject/SoftObjectPath.h"
+#include "HAL/IConsoleManager.h"
+
+#include <atomic>
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugSurfelCache(
+    TEXT("CollisionDebug.SurfelCache"),
+    0,
+    TEXT("Keep what the debug views traced as surfels in a world space grid saved per level, and splat new\n")
+    TEXT("views from it so they only trace where the cache has nothing.\n")
+    TEXT(" 0: off \n")
+    TEXT(" 1: on  \n"),
+    ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugSurfelCacheMaxCells(
+    TEXT("CollisionDebug.SurfelCache.MaxCells"),
+    1000000,
+    TEXT("Cells the surfel cache copies into memory at most, about 170 bytes each. Hits in new cells are dropped beyond it,\n")
+    TEXT("cells that are invalidated are always emptied.\n"),
+    ECVF_Default);
+
+namespace CollisionDebuggerSurfelCache
+{
+    static const uint32 FileMagic = 0x53444343; // "CCDS"
+    /** 2 only keeps static primitives loaded with the level, older files may hold anything. */
+    static const uint32 FileVersion = 2;
+    static const uint32 NoPrimitive = MAX_uint32;
+
+    /** Cell coordinates are stored in 21 bits each, about 50 km either way of the origin. */
+    static const int32 CellBits = 21;
+    static const int32 CellBias = 1 << (CellBits - 1);
+    static const uint64 CellMask = (uint64(1) << CellBits) - 1;
+
+    /** Pixels a splat reaches from its center at most, and rows splatted by one task. */
+    static const double MaxSplatRadius = 8.0;
+    static const int32 SplatBandRows = 32;
+
+    struct FFileHeader
+    {
+        uint32 Magic = FileMagic;
+        uint32 Version = FileVersion;
+
+        /** Save time of the level when the file was written, the cache is stale once it differs. */
+        int64 MapTimeStamp = 0;
+        double CellSize = FCollisionDebuggerSurfelCache::CellSize;
+        uint32 NumCells = 0;
+        uint32 NumSurfels = 0;
+        uint32 NumPrimitives = 0;
+        uint32 Padding = 0;
+    };
+
+    static int64 GetMapTimeStamp(const FString& MapFilePath)
+    {
+        return IFileManager::Get().GetTimeStamp(*MapFilePath).GetTicks();
+    }
+
+    /**
+     * Only collision that is there again in the next session is kept: static bodies of actors that
+     * were loaded with the level. Spawned, moving or simulated ones would be splatted where nothing is.
+     */
+    static bool IsCacheable(const UPrimitiveComponent* Component)
+    {
+        const AActor* Owner = Component ? Component->GetOwner() : nullptr;
+        return Owner && Component->Mobility == EComponentMobility::Static && Owner->HasAnyFlags(RF_WasLoaded) && !Owner->HasAnyFlags(RF_Transient);
+    }
+}
+
+
+bool FCollisionDebuggerSurfelCache::IsEnabled()
+{
+    return CVarCollisionDebugSurfelCache.GetValueOnGameThread() > 0;
+}
+
+FCollisionDebuggerSurfelCache::~FCollisionDebuggerSurfelCache()
+{
+    Close();
+}
+
+uint64 FCollisionDebuggerSurfelCache::GetCellKey(const FIntVector& Cell)
+{
+    using namespace CollisionDebuggerSurfelCache;
+    const uint64 X = uint64(FMath::Clamp(Cell.X + CellBias, 0, int32(CellMask)));
+    const uint64 Y = uint64(FMath::Clamp(Cell.Y + CellBias, 0, int32(CellMask)));
+    const uint64 Z = uint64(FMath::Clamp(Cell.Z + CellBias, 0, int32(CellMask)));
+    return (X << (CellBits * 2)) | (Y << CellBits) | Z;
+}
+
+FIntVector FCollisionDebuggerSurfelCache::GetCell(uint64 Key)
+{
+    using namespace CollisionDebuggerSurfelCache;
+    return FIntVector(
+        int32((Key >> (CellBits * 2)) & CellMask) - CellBias,
+        int32((Key >> CellBits) & CellMask) - CellBias,
+        int32(Key & CellMask) - CellBias);
+}
+
+FVector FCollisionDebuggerSurfelCache::GetCellMin(uint64 Key)
+{
+    return FVector(GetCell(Key)) * CellSize;
+}
+
+void FCollisionDebuggerSurfelCache::Update(UWorld* InWorld, const FInputRenderSettingsInternal& Settings)
+{
+    if (!IsEnabled() || !InWorld)
+    {
+        Close();
+        World.Reset();
+        return;
+    }
+
+    const FString TestName = Settings.bIsChannelTest ? FString::Printf(TEXT("Channel%d"), int32(Settings.ChannelToTest.GetValue())) : Settings.ProfileNameToTest.ToString();
+    const uint32 InTestHash = HashCombine(FCrc::StrCrc32(*TestName), Settings.TraceComplex ? 1u : 0u);
+    if (World.Get() == InWorld && TestHash == InTestHash)
+    {
+        return;
+    }
+
+    Close();
+    World = InWorld;
+    TestHash = InTestHash;
+
+    // Levels that were never saved have nothing to tie the cache to.
+    const FString PackageName = UWorld::RemovePIEPrefix(InWorld->GetOutermost()->GetName());
+    FString MapFile;
+    if (!FPackageName::TryConvertLongPackageNameToFilename(PackageName, MapFile, FPackageName::GetMapPackageExtension())
+        || !IFileManager::Get().FileExists(*MapFile))
+    {
+        return;
+    }
+
+    const FString FileName = FString::Printf(TEXT("%s_%08x.surfels"), *FPaths::MakeValidFileName(PackageName.Replace(TEXT("/"), TEXT("_"))), TestHash);
+    Open(FPaths::ProjectSavedDir() / TEXT("CollisionDebugger") / FileName, MapFile, InWorld->GetOutermost()->GetPIEInstanceID());
+}
+
+void FCollisionDebuggerSurfelCache::Open(const FString& InFilePath, const FString& InMapFilePath, int32 InPIEInstance)
+{
+    Close();
+    FilePath = InFilePath;
+    MapFilePath = InMapFilePath;
+    PIEInstance = InPIEInstance;
+
+    if (Load())
+    {
+        UE_LOG(LogTemp, Log, TEXT("Collision debugger: %d surfel cells from %s"), NumBaseCells, *FilePath);
+    }
+    else
+    {
+        Unmap();
+        PrimitivePaths.Empty();
+        PrimitiveIndices.Empty();
+    }
+}
+
+void FCollisionDebuggerSurfelCache::Close()
+{
+    if (IsOpen() && Dirty)
+    {
+        Save();
+    }
+
+    Unmap();
+    SlotIndices.Empty();
+    Slots.Empty();
+    PrimitivePaths.Empty();
+    PrimitiveIndices.Empty();
+    ComponentPrimitives.Empty();
+    ResolvedPrimitives.Empty();
+    TriedToResolve.Empty();
+    FilePath.Empty();
+    MapFilePath.Empty();
+    PIEInstance = INDEX_NONE;
+    Dirty = false;
+}
+
+bool FCollisionDebuggerSurfelCache::Load()
+{
+    using namespace CollisionDebuggerSurfelCache;
+
+    if (!IFileManager::Get().FileExists(*FilePath))
+    {
+        return false;
+    }
+
+    MappedFile = FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FilePath);
+    MappedRegion = MappedFile ? MappedFile->MapRegion(0, MappedFile->GetFileSize()) : nullptr;
+    if (!MappedRegion || MappedRegion->GetMappedSize() < int64(sizeof(FFileHeader)))
+    {
+        return false;
+    }
+
+    const uint8* Data = MappedRegion->GetMappedPtr();
+    const int64 Size = MappedRegion->GetMappedSize();
+    FFileHeader Header;
+    FMemory::Memcpy(&Header, Data, sizeof(FFileHeader));
+
+    const int64 CellsOffset = sizeof(FFileHeader);
+    const int64 SurfelsOffset = CellsOffset + int64(Header.NumCells) * sizeof(FFileCell);
+    const int64 PrimitivesOffset = SurfelsOffset + int64(Header.NumSurfels) * sizeof(FCollisionDebuggerSurfel);
+    if (Header.Magic != FileMagic || Header.Version != FileVersion || Header.CellSize != CellSize || PrimitivesOffset > Size)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Collision debugger: ignoring surfel cache %s, it is from another version or damaged"), *FilePath);
+        return false;
+    }
+    if (Header.MapTimeStamp != GetMapTimeStamp(MapFilePath))
+    {
+        UE_LOG(LogTemp, Log, TEXT("Collision debugger: ignoring surfel cache %s, the level was saved since"), *FilePath);
+        return false;
+    }
+
+    const FFileCell* Cells = reinterpret_cast<const FFileCell*>(Data + CellsOffset);
+    for (uint32 i = 0; i < Header.NumCells; i++)
+    {
+        if (Cells[i].Count > uint32(MaxSurfelsPerCell) || uint64(Cells[i].First) + Cells[i].Count > Header.NumSurfels)
+        {
+            UE_LOG(LogTemp, Warning, TEXT("Collision debugger: ignoring surfel cache %s, it is damaged"), *FilePath);
+            return false;
+        }
+    }
+
+    int64 Offset = PrimitivesOffset;
+    for (uint32 i = 0; i < Header.NumPrimitives; i++)
+    {
+        int32 Length = 0;
+        if (Offset + int64(sizeof(int32)) > Size)
+        {
+            return false;
+        }
+        FMemory::Memcpy(&Length, Data + Offset, sizeof(int32));
+        Offset += sizeof(int32);
+        if (Length < 0 || Offset + Length > Size)
+        {
+            return false;
+        }
+
+        const FUTF8ToTCHAR Path(reinterpret_cast<const ANSICHAR*>(Data + Offset), Length);
+        PrimitiveIndices.Add(FString(Path.Length(), Path.Get()), i);
+        PrimitivePaths.Emplace(Path.Length(), Path.Get());
+        Offset += Length;
+    }
+
+    BaseCells = Cells;
+    BaseSurfels = reinterpret_cast<const FCollisionDebuggerSurfel*>(Data + SurfelsOffset);
+    NumBaseCells = int32(Header.NumCells);
+    ResolvedPrimitives.SetNum(PrimitivePaths.Num());
+    TriedToResolve.Init(false, PrimitivePaths.Num());
+    return true;
+}
+
+void FCollisionDebuggerSurfelCache::Save()
+{
+    using namespace CollisionDebuggerSurfelCache;
+    COLLISIONDEBUGGER_SCOPE(SurfelCache);
+
+    // Cells in key order, the copies in memory replace those of the file.
+    struct FOutCell
+    {
+        uint64 Key;
+        const FCollisionDebuggerSurfel* Surfels;
+        int32 Num;
+    };
+    TArray<FOutCell> Cells;
+    ForEachCell([&Cells](uint64 Key, const FCollisionDebuggerSurfel* Surfels, int32 Num)
+    {
+        if (Num > 0)
+        {
+            Cells.Add({ Key, Surfels, Num });
+        }
+    });
+    Cells.Sort([](const FOutCell& A, const FOutCell& B) { return A.Key < B.Key; });
+
+    const FString TempPath = FilePath + TEXT(".tmp");
+    TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*TempPath));
+    if (!Writer)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Collision debugger: can't write the surfel cache %s"), *TempPath);
+        return;
+    }
+
+    FFileHeader Header;
+    Header.MapTimeStamp = GetMapTimeStamp(MapFilePath);
+    Header.NumCells = uint32(Cells.Num());
+    for (const FOutCell& Cell : Cells)
+    {
+        Header.NumSurfels += uint32(Cell.Num);
+    }
+    Header.NumPrimitives = uint32(PrimitivePaths.Num());
+    Writer->Serialize(&Header, sizeof(Header));
+
+    uint32 First = 0;
+    for (const FOutCell& Cell : Cells)
+    {
+        FFileCell FileCell{ Cell.Key, First, uint32(Cell.Num) };
+        Writer->Serialize(&FileCell, sizeof(FileCell));
+        First += uint32(Cell.Num);
+    }
+    for (const FOutCell& Cell : Cells)
+    {
+        Writer->Serialize(const_cast<FCollisionDebuggerSurfel*>(Cell.Surfels), Cell.Num * sizeof(FCollisionDebuggerSurfel));
+    }
+    for (const FString& Path : PrimitivePaths)
+    {
+        FTCHARToUTF8 Utf8(*Path);
+        int32 Length = Utf8.Length();
+        Writer->Serialize(&Length, sizeof(Length));
+        Writer->Serialize(const_cast<ANSICHAR*>(Utf8.Get()), Length);
+    }
+
+    const bool Written = Writer->Close() && !Writer->IsError();
+    Writer.Reset();
+
+    // The file can only be replaced once nothing maps it.
+    Unmap();
+    if (!Written || !IFileManager::Get().Move(*FilePath, *TempPath, true, true))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Collision debugger: can't write the surfel cache %s"), *FilePath);
+        IFileManager::Get().Delete(*TempPath);
+    }
+    Dirty = false;
+}
+
+void FCollisionDebuggerSurfelCache::Unmap()
+{
+    delete MappedRegion;
+    MappedRegion = nullptr;
+    delete MappedFile;
+    MappedFile = nullptr;
+    BaseCells = nullptr;
+    BaseSurfels = nullptr;
+    NumBaseCells = 0;
+}
+
+int32 FCollisionDebuggerSurfelCache::LowerBoundFileCell(uint64 Key) const
+{
+    int32 Min = 0;
+    int32 Max = NumBaseCells;
+    while (Min < Max)
+    {
+        const int32 Mid = (Min + Max) / 2;
+        if (BaseCells[Mid].Key < Key)
+        {
+            Min = Mid + 1;
+        }
+        else
+        {
+            Max = Mid;
+        }
+    }
+    return Min;
+}
+
+const FCollisionDebuggerSurfelCache::FFileCell* FCollisionDebuggerSurfelCache::FindFileCell(uint64 Key) const
+{
+    const int32 Index = LowerBoundFileCell(Key);
+    return Index < NumBaseCells && BaseCells[Index].Key == Key ? &BaseCells[Index] : nullptr;
+}
+
+FCollisionDebuggerSurfelCache::FSlot* FCollisionDebuggerSurfelCache::FindOrAddSlot(uint64 Key)
+{
+    if (const int32* Index = SlotIndices.Find(Key))
+    {
+        return &Slots[*Index];
+    }
+    if (Slots.Num() >= CVarCollisionDebugSurfelCacheMaxCells.GetValueOnGameThread())
+    {
+        return nullptr;
+    }
+
+    const int32 Index = Slots.AddDefaulted();
+    SlotIndices.Add(Key, Index);
+    FSlot& Slot = Slots[Index];
+    if (const FFileCell* Cell = FindFileCell(Key))
+    {
+        Slot.Num = uint8(Cell->Count);
+        FMemory::Memcpy(Slot.Surfels, BaseSurfels + Cell->First, Cell->Count * sizeof(FCollisionDebuggerSurfel));
+    }
+    return &Slot;
+}
+
+TConstArrayView<FCollisionDebuggerSurfel> FCollisionDebuggerSurfelCache::FindCell(const FVector& Position) const
+{
+    const uint64 Key = GetCellKey(FIntVector(FMath::FloorToInt(Position.X / CellSize), FMath::FloorToInt(Position.Y / CellSize), FMath::FloorToInt(Position.Z / CellSize)));
+    if (const int32* Index = SlotIndices.Find(Key))
+    {
+        return TConstArrayView<FCollisionDebuggerSurfel>(Slots[*Index].Surfels, Slots[*Index].Num);
+    }
+    if (const FFileCell* Cell = FindFileCell(Key))
+    {
+        return TConstArrayView<FCollisionDebuggerSurfel>(BaseSurfels + Cell->First, int32(Cell->Count));
+    }
+    return TConstArrayView<FCollisionDebuggerSurfel>();
+}
+
+template<typename FunctionType>
+void FCollisionDebuggerSurfelCache::ForEachCell(FunctionType&& Function) const
+{
+    for (int32 i = 0; i < NumBaseCells; i++)
+    {
+        const FFileCell& Cell = BaseCells[i];
+        if (!SlotIndices.Contains(Cell.Key))
+        {
+            Function(Cell.Key, BaseSurfels + Cell.First, int32(Cell.Count));
+        }
+    }
+    for (const TPair<uint64, int32>& Pair : SlotIndices)
+    {
+        const FSlot& Slot = Slots[Pair.Value];
+        Function(Pair.Key, Slot.Surfels, int32(Slot.Num));
+    }
+}
+
+template<typename FunctionType>
+void FCollisionDebuggerSurfelCache::ForEachCellIn(const FIntVector& MinCell, const FIntVector& MaxCell, FunctionType&& Function) const
+{
+    const auto IsInside = [&MinCell, &MaxCell](uint64 Key)
+    {
+        const FIntVector Cell = GetCell(Key);
+        return Cell.X >= MinCell.X && Cell.Y >= MinCell.Y && Cell.Z >= MinCell.Z && Cell.X <= MaxCell.X && Cell.Y <= MaxCell.Y && Cell.Z <= MaxCell.Z;
+    };
+
+    // Keys sort by x first, so the file cells of the box lie between the keys of its corners.
+    const uint64 MaxKey = GetCellKey(MaxCell);
+    for (int32 i = LowerBoundFileCell(GetCellKey(MinCell)); i < NumBaseCells && BaseCells[i].Key <= MaxKey; i++)
+    {
+        const FFileCell& Cell = BaseCells[i];
+        if (IsInside(Cell.Key) && !SlotIndices.Contains(Cell.Key))
+        {
+            Function(Cell.Key, BaseSurfels + Cell.First, int32(Cell.Count));
+        }
+    }
+    for (const TPair<uint64, int32>& Pair : SlotIndices)
+    {
+        if (IsInside(Pair.Key))
+        {
+            const FSlot& Slot = Slots[Pair.Value];
+            Function(Pair.Key, Slot.Surfels, int32(Slot.Num));
+        }
+    }
+}
+
+uint32 FCollisionDebuggerSurfelCache::FindOrAddPrimitive(UPrimitiveComponent* Component)
+{
+    if (const uint32* Primitive = ComponentPrimitives.Find(Component))
+    {
+        return *Primitive;
+    }
+
+    const FString Path = UWorld::RemovePIEPrefix(FSoftObjectPath(Component).ToString());
+    uint32 Primitive = 0;
+    if (const uint32* Existing = PrimitiveIndices.Find(Path))
+    {
+        Primitive = *Existing;
+    }
+    else
+    {
+        Primitive = uint32(PrimitivePaths.Add(Path));
+        PrimitiveIndices.Add(Path, Primitive);
+        ResolvedPrimitives.Add(nullptr);
+        TriedToResolve.Add(false);
+    }
+
+    ResolvedPrimitives[Primitive] = Component;
+    TriedToResolve[Primitive] = true;
+    ComponentPrimitives.Add(Component, Primitive);
+    return Primitive;
+}
+
+UPrimitiveComponent* FCollisionDebuggerSurfelCache::ResolvePrimitive(uint32 Primitive)
+{
+    if (!ResolvedPrimitives.IsValidIndex(int32(Primitive)))
+    {
+        return nullptr;
+    }
+    if (!TriedToResolve[Primitive])
+    {
+        TriedToResolve[Primitive] = true;
+        FSoftObjectPath Path(PrimitivePaths[Primitive]);
+        if (PIEInstance != INDEX_NONE)
+        {
+            Path.FixupForPIE(PIEInstance);
+        }
+        ResolvedPrimitives[Primitive] = Cast<UPrimitiveComponent>(Path.ResolveObject());
+    }
+    return ResolvedPrimitives[Primitive].Get();
+}
+
+void FCollisionDebuggerSurfelCache::AddSurfel(const FVector& Position, const FVector3f& Normal, uint32 Primitive)
+{
+    const FIntVector Cell(FMath::FloorToInt(Position.X / CellSize), FMath::FloorToInt(Position.Y / CellSize), FMath::FloorToInt(Position.Z / CellSize));
+    const uint64 Key = GetCellKey(Cell);
+    FSlot* Slot = FindOrAddSlot(Key);
+    if (!Slot)
+    {
+        return;
+    }
+
+    const FCollisionDebuggerSurfel Surfel{ FVector3f(Position - GetCellMin(Key)), FCollisionDebuggerHitBuffer::PackNormal(Normal), Primitive };
+    Dirty = true;
+
+    // A hit close to a surfel of the same primitive and facing refreshes it instead of adding another.
+    const float MergeDistanceSquared = float(FMath::Square(CellSize * .35));
+    for (int32 i = 0; i < Slot->Num; i++)
+    {
+        FCollisionDebuggerSurfel& Existing = Slot->Surfels[i];
+        if (Existing.Primitive == Primitive && FVector3f::DistSquared(Existing.Offset, Surfel.Offset) < MergeDistanceSquared
+            && (FCollisionDebuggerHitBuffer::UnpackNormal(Existing.Normal) | Normal) > .8f)
+        {
+            Existing = Surfel;
+            return;
+        }
+    }
+
+    if (Slot->Num < MaxSurfelsPerCell)
+    {
+        Slot->Surfels[Slot->Num++] = Surfel;
+    }
+    else
+    {
+        Slot->Surfels[Slot->NextReplace] = Surfel;
+        Slot->NextReplace = uint8((Slot->NextReplace + 1) % MaxSurfelsPerCell);
+    }
+}
+
+void FCollisionDebuggerSurfelCache::AddHits(const FCollisionDebuggerHitBuffer& Pixels, const FCollisionDebuggerPrimitiveIds& PrimitiveIds, const FIntRect& Rect,
+    const TArray<uint8>* Mask, const FTransform& Camera, const FCollisionDebuggerRayTable& RayTable, double TraceLength)
+{
+    COLLISIONDEBUGGER_SCOPE(SurfelCache);
+
+    const int32 SizeX = Pixels.GetSize().X;
+    const int32 Width = Rect.Width();
+    const FVector Origin = Camera.GetLocation();
+    const FQuat Rotation = Camera.GetRotation();
+
+    TArray<FLinearColor> Row;
+    Row.SetNumUninitialized(Width);
+    uint32 LastId = MAX_uint32;
+    uint32 LastPrimitive = CollisionDebuggerSurfelCache::NoPrimitive;
+    bool LastCacheable = false;
+    for (int32 y = Rect.Min.Y; y < Rect.Max.Y; y++)
+    {
+        Pixels.DecodeRange(Rect.Min.X + y * SizeX, Width, Row.GetData());
+        for (int32 x = 0; x < Width; x++)
+        {
+            const FLinearColor& Hit = Row[x];
+            if (Hit.A < 0.f || (Mask && (*Mask)[(y - Rect.Min.Y) * Width + x] == 0))
+            {
+                continue;
+            }
+
+            const uint32 Id = PrimitiveIds.Get(Rect.Min.X + x + y * SizeX);
+            if (Id != LastId)
+            {
+                UPrimitiveComponent* Component = PrimitiveIds.GetTable().Get(Id);
+                LastId = Id;
+                LastCacheable = CollisionDebuggerSurfelCache::IsCacheable(Component);
+                LastPrimitive = LastCacheable ? FindOrAddPrimitive(Component) : CollisionDebuggerSurfelCache::NoPrimitive;
+            }
+            if (!LastCacheable)
+            {
+                continue;
+            }
+
+            const FVector Direction = Rotation.RotateVector(FVector(RayTable.GetDirection(Rect.Min.X + x, y)));
+            AddSurfel(Origin + Direction * (double(Hit.A) * TraceLength), FVector3f(Hit.R, Hit.G, Hit.B), LastPrimitive);
+        }
+    }
+}
+
+void FCollisionDebuggerSurfelCache::Invalidate(TConstArrayView<FBox> Bounds)
+{
+    if (IsEmpty())
+    {
+        return;
+    }
+
+    TArray<uint64> Keys;
+    for (const FBox& Box : Bounds)
+    {
+        const FIntVector Min(FMath::FloorToInt(Box.Min.X / CellSize), FMath::FloorToInt(Box.Min.Y / CellSize), FMath::FloorToInt(Box.Min.Z / CellSize));
+        const FIntVector Max(FMath::FloorToInt(Box.Max.X / CellSize), FMath::FloorToInt(Box.Max.Y / CellSize), FMath::FloorToInt(Box.Max.Z / CellSize));
+        const int64 NumBoxCells = int64(Max.X - Min.X + 1) * (Max.Y - Min.Y + 1) * (Max.Z - Min.Z + 1);
+
+        // Large boxes test every cell of the cache instead of every cell of the box.
+        if (NumBoxCells > NumBaseCells + Slots.Num())
+        {
+            ForEachCell([&](uint64 Key, const FCollisionDebuggerSurfel*, int32 Num)
+            {
+                const FIntVector Cell = GetCell(Key);
+                if (Num > 0 && Cell.X >= Min.X && Cell.Y >= Min.Y && Cell.Z >= Min.Z && Cell.X <= Max.X && Cell.Y <= Max.Y && Cell.Z <= Max.Z)
+                {
+                    Keys.Add(Key);
+                }
+            });
+            continue;
+        }
+
+        for (int32 z = Min.Z; z <= Max.Z; z++)
+        {
+            for (int32 y = Min.Y; y <= Max.Y; y++)
+            {
+                for (int32 x = Min.X; x <= Max.X; x++)
+                {
+                    const uint64 Key = GetCellKey(FIntVector(x, y, z));
+                    if (SlotIndices.Contains(Key) || FindFileCell(Key))
+                    {
+                        Keys.Add(Key);
+                    }
+                }
+            }
+        }
+    }
+
+    // Past CollisionDebug.SurfelCache.MaxCells too, the file's surfels would splat collision that is gone.
+    for (const uint64 Key : Keys)
+    {
+        const int32* Index = SlotIndices.Find(Key);
+        FSlot& Slot = Index ? Slots[*Index] : Slots[SlotIndices.Add(Key, Slots.AddDefaulted())];
+        Slot.Num = 0;
+        Slot.NextReplace = 0;
+        Dirty = true;
+    }
+}
+
+int32 FCollisionDebuggerSurfelCache::Splat(FCollisionDebuggerHitBuffer& Pixels, FCollisionDebuggerPrimitiveIds& PrimitiveIds, TArrayView<uint8> NeedsTrace,
+    const FTransform& Camera, const FCollisionDebuggerRayTable& RayTable, double TraceLength)
+{
+    using namespace CollisionDebuggerSurfelCache;
+    COLLISIONDEBUGGER_SCOPE(SurfelCache);
+
+    const FIntPoint Size = RayTable.GetSize();
+    const double FovScale = RayTable.GetFovScale();
+    const FVector Origin = Camera.GetLocation();
+    const FQuat Rotation = Camera.GetRotation();
+    const double TraceLengthSquared = FMath::Square(TraceLength);
+
+    // Large enough that the surfels of a fully covered cell leave no holes between them.
+    const double SurfelRadius = CellSize * .6;
+
+    // Only the cells within trace length of the camera, the rest of the cache is never looked at.
+    TArray<FSplatCell> Cells;
+    const FVector BoxMin = Origin - FVector(TraceLength);
+    const FVector BoxMax = Origin + FVector(TraceLength);
+    const FIntVector MinCell(FMath::FloorToInt(BoxMin.X / CellSize), FMath::FloorToInt(BoxMin.Y / CellSize), FMath::FloorToInt(BoxMin.Z / CellSize));
+    const FIntVector MaxCell(FMath::FloorToInt(BoxMax.X / CellSize), FMath::FloorToInt(BoxMax.Y / CellSize), FMath::FloorToInt(BoxMax.Z / CellSize));
+    ForEachCellIn(MinCell, MaxCell, [&](uint64 Key, const FCollisionDebuggerSurfel* Surfels, int32 Num)
+    {
+        const FVector CellMin = GetCellMin(Key);
+        if (Num > 0 && FBox(CellMin, CellMin + FVector(CellSize)).ComputeSquaredDistanceToPoint(Origin) <= TraceLengthSquared)
+        {
+            Cells.Add({ Key, Surfels, Num });
+        }
+    });
+
+    // Surfels are projected on the task graph, each cell into its own range of Splats.
+    TArray<FSplat> Splats;
+    Splats.SetNumUninitialized(Cells.Num() * MaxSurfelsPerCell);
+    ParallelFor(Cells.Num(), [&](int32 CellIndex)
+    {
+        const FSplatCell& Cell = Cells[CellIndex];
+        FSplat* CellSplats = Splats.GetData() + CellIndex * MaxSurfelsPerCell;
+        for (int32 i = 0; i < MaxSurfelsPerCell; i++)
+        {
+            CellSplats[i].MinY = INDEX_NONE;
+        }
+
+        const FVector CellMin = GetCellMin(Cell.Key);
+        FIntRect CellRect;
+        if (!FCollisionDebuggerReprojection::ProjectBounds(FBox(CellMin, CellMin + FVector(CellSize)), Camera, RayTable, CellRect))
+        {
+            return;
+        }
+
+        for (int32 i = 0; i < Cell.Num; i++)
+        {
+            const FCollisionDebuggerSurfel& Surfel = Cell.Surfels[i];
+            const FVector ToSurfel = CellMin + FVector(Surfel.Offset) - Origin;
+            const FVector Local = Rotation.UnrotateVector(ToSurfel);
+            const FVector3f Normal = FCollisionDebuggerHitBuffer::UnpackNormal(Surfel.Normal);
+            const double Distance = ToSurfel.Size();
+            if (Local.X <= 1.0 || Distance > TraceLength || (FVector(Normal) | ToSurfel) > 0.0)
+            {
+                continue;
+            }
+
+            const double CenterX = (Local.Y / (Local.X * FovScale) * .5 + .5) * Size.X;
+            const double CenterY = (Local.Z / (Local.X * FovScale) * -.5 + .5) * Size.Y;
+            const double Radius = FMath::Clamp(SurfelRadius / (Local.X * FovScale) * .5 * Size.X, .5, MaxSplatRadius);
+            FSplat& Splat = CellSplats[i];
+            Splat.MinX = FMath::Max(FMath::FloorToInt(CenterX - Radius), 0);
+            Splat.MinY = FMath::Max(FMath::FloorToInt(CenterY - Radius), 0);
+            Splat.MaxX = FMath::Min(FMath::FloorToInt(CenterX + Radius), Size.X - 1);
+            Splat.MaxY = FMath::Min(FMath::FloorToInt(CenterY + Radius), Size.Y - 1);
+            if (Splat.MinX > Splat.MaxX || Splat.MinY > Splat.MaxY)
+            {
+                Splat.MinY = INDEX_NONE;
+                continue;
+            }
+            Splat.Distance = float(Distance);
+            Splat.Color = FLinearColor(Normal.X, Normal.Y, Normal.Z, float(Distance / TraceLength));
+            Splat.Id = Surfel.Primitive;
+        }
+    });
+
+    // Primitives resolve to UObjects, so their ids are looked up here on the game thread.
+    TArray<uint32> Ids;
+    Ids.Init(MAX_uint32, PrimitivePaths.Num());
+    int32 NumSplats = 0;
+    for (const FSplat& Splat : Splats)
+    {
+        if (Splat.MinY == INDEX_NONE)
+        {
+            continue;
+        }
+
+        uint32 Id = FCollisionDebuggerPrimitiveTable::NoPrimitive;
+        if (Ids.IsValidIndex(int32(Splat.Id)))
+        {
+            uint32& CachedId = Ids[Splat.Id];
+            if (CachedId == MAX_uint32)
+            {
+                UPrimitiveComponent* Component = ResolvePrimitive(Splat.Id);
+                CachedId = Component ? PrimitiveIds.GetTable().FindOrAdd(Component) : FCollisionDebuggerPrimitiveTable::NoPrimitive;
+            }
+            Id = CachedId;
+        }
+        Splats[NumSplats] = Splat;
+        Splats[NumSplats].Id = Id;
+        NumSplats++;
+    }
+    Splats.SetNum(NumSplats, false);
+    Algo::SortBy(Splats, &FSplat::MinY);
+
+    // Bands of rows are splatted in parallel, a band only takes the splats reaching into it and only writes its own rows.
+    const int32 MaxSplatRows = FMath::CeilToInt(MaxSplatRadius * 2.0) + 1;
+    const int32 NumBands = FMath::DivideAndRoundUp(Size.Y, SplatBandRows);
+    SplatDepths.SetNumUninitialized(Size.X * Size.Y, false);
+    std::atomic<int32> NumFlagged{ 0 };
+    ParallelFor(NumBands, [&](int32 Band)
+    {
+        const int32 BandMinY = Band * SplatBandRows;
+        const int32 BandMaxY = FMath::Min(BandMinY + SplatBandRows, Size.Y) - 1;
+        float* Depths = SplatDepths.GetData();
+        for (int32 Index = BandMinY * Size.X; Index < (BandMaxY + 1) * Size.X; Index++)
+        {
+            Depths[Index] = MAX_flt;
+        }
+
+        const int32 First = Algo::LowerBoundBy(Splats, BandMinY - MaxSplatRows, &FSplat::MinY);
+        for (int32 SplatIndex = First; SplatIndex < Splats.Num() && Splats[SplatIndex].MinY <= BandMaxY; SplatIndex++)
+        {
+            const FSplat& Splat = Splats[SplatIndex];
+            for (int32 y = FMath::Max(Splat.MinY, BandMinY); y <= FMath::Min(Splat.MaxY, BandMaxY); y++)
+            {
+                for (int32 x = Splat.MinX; x <= Splat.MaxX; x++)
+                {
+                    const int32 Index = x + y * Size.X;
+                    if (Splat.Distance < Depths[Index])
+                    {
+                        Depths[Index] = Splat.Distance;
+                        Pixels.Set(Index, Splat.Color);
+                        PrimitiveIds.Set(Index, Splat.Id);
+                    }
+                }
+            }
+        }
+
+        int32 BandFlagged = 0;
+        for (int32 Index = BandMinY * Size.X; Index < (BandMaxY + 1) * Size.X; Index++)
+        {
+            const bool Covered = Depths[Index] < MAX_flt;
+            NeedsTrace[Index] = Covered ? 0 : 1;
+            if (!Covered)
+            {
+                Pixels.SetMiss(Index);
+                PrimitiveIds.Set(Index, FCollisionDebuggerPrimitiveTable::NoPrimitive);
+                BandFlagged++;
+            }
+        }
+        NumFlagged += BandFlagged;
+    });
+    return NumFlagged;
+}
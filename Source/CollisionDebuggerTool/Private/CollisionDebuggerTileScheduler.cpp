@@ -0,0 +1,347 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerTileScheduler.h"
+#include "HAL/IConsoleManager.h"
+#include "Algo/StableSort.h"
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugSchedulerPolicy(
+    TEXT("CollisionDebug.Scheduler.Policy"),
+    1,
+    TEXT("Order the collision debugger traces its tiles in.\n")
+    TEXT(" 0: stalest first (raster sweep) \n")
+    TEXT(" 1: screen center first \n")
+    TEXT(" 2: most frequently changing first \n")
+    TEXT(" 3: foveated, used whenever CollisionDebug.Foveated is on \n"),
+    ECVF_Default);
+
+namespace CollisionDebuggerTileScheduler
+{
+    /** Age given to tiles that were never traced, so they always beat traced ones. */
+    static const double NeverTracedAge = 1.0e6;
+
+    /** Policy a foveated view uses whatever CollisionDebug.Scheduler.Policy says. */
+    static const int32 FoveatedPolicy = 3;
+
+    static double GetAge(const FCollisionDebuggerTileState& Tile, const FCollisionDebuggerSchedulerContext& Context)
+    {
+        return Tile.LastTraceTime < 0.0 ? NeverTracedAge : FMath::Max(Context.Now - Tile.LastTraceTime, 0.0);
+    }
+
+    class FStalestFirst : public ICollisionDebuggerTilePriority
+    {
+    public:
+        double GetPriority(const FCollisionDebuggerTileState& Tile, const FCollisionDebuggerSchedulerContext& Context) const override
+        {
+            return GetAge(Tile, Context);
+        }
+    };
+
+    static double GetFocusPriority(const FCollisionDebuggerTileState& Tile, const FCollisionDebuggerSchedulerContext& Context)
+    {
+        const FVector2D Center = FVector2D(Tile.Rect.Min + Tile.Rect.Max) * .5;
+        const double Distance = FVector2D::Distance(Center, Context.Focus) / FMath::Max(FVector2D(Context.ViewSize).Size(), 1.0);
+        return GetAge(Tile, Context) / (1.0 + 4.0 * Distance);
+    }
+
+    class FFocusFirst : public ICollisionDebuggerTilePriority
+    {
+    public:
+        double GetPriority(const FCollisionDebuggerTileState& Tile, const FCollisionDebuggerSchedulerContext& Context) const override
+        {
+            return GetFocusPriority(Tile, Context);
+        }
+    };
+
+    class FMostChangingFirst : public ICollisionDebuggerTilePriority
+    {
+    public:
+        double GetPriority(const FCollisionDebuggerTileState& Tile, const FCollisionDebuggerSchedulerContext& Context) const override
+        {
+            return GetAge(Tile, Context) * (.25 + Tile.ChangeRate);
+        }
+    };
+
+    class FFoveated : public ICollisionDebuggerTilePriority
+    {
+    public:
+        double GetPriority(const FCollisionDebuggerTileState& Tile, const FCollisionDebuggerSchedulerContext& Context) const override
+        {
+            // The focus window is retraced on its own every tick, the periphery only has to keep up slowly.
+            if (GetAge(Tile, Context) < Context.PeripheryInterval)
+            {
+                return -1.0;
+            }
+            return GetFocusPriority(Tile, Context);
+        }
+    };
+}
+
+FCollisionDebuggerTileScheduler::FCollisionDebuggerTileScheduler()
+{
+    using namespace CollisionDebuggerTileScheduler;
+    RegisterPolicy(0, MakeUnique<FStalestFirst>());
+    RegisterPolicy(1, MakeUnique<FFocusFirst>());
+    RegisterPolicy(2, MakeUnique<FMostChangingFirst>());
+    RegisterPolicy(FoveatedPolicy, MakeUnique<FFoveated>());
+}
+
+void FCollisionDebuggerTileScheduler::RegisterPolicy(int32 PolicyIndex, TUniquePtr<ICollisionDebuggerTilePriority> Policy)
+{
+    check(PolicyIndex >= 0);
+    if (Policies.Num() <= PolicyIndex)
+    {
+        Policies.SetNum(PolicyIndex + 1);
+    }
+    Policies[PolicyIndex] = MoveTemp(Policy);
+}
+
+void FCollisionDebuggerTileScheduler::Reset(FIntPoint InViewSize, int32 InTileSize)
+{
+    TileSize = FMath::Max(InTileSize, 1);
+    Context.ViewSize = InViewSize;
+    Context.Focus = FVector2D(InViewSize) * .5;
+    NumTiles = FIntPoint(FMath::DivideAndRoundUp(InViewSize.X, TileSize), FMath::DivideAndRoundUp(InViewSize.Y, TileSize));
+
+    Tiles.Reset();
+    for (int32 TileY = 0; TileY < NumTiles.Y; TileY++)
+    {
+        for (int32 TileX = 0; TileX < NumTiles.X; TileX++)
+        {
+            FCollisionDebuggerTileState& Tile = Tiles.AddDefaulted_GetRef();
+            const FIntPoint Min = FIntPoint(TileX, TileY) * TileSize;
+            Tile.Rect = FIntRect(Min, Min + FIntPoint(TileSize));
+            Tile.Rect.Clip(FIntRect(FIntPoint::ZeroValue, InViewSize));
+        }
+    }
+
+    TracedTiles.Empty();
+}
+
+void FCollisionDebuggerTileScheduler::SetTileSize(int32 InTileSize)
+{
+    InTileSize = FMath::Max(InTileSize, 1);
+    if (InTileSize == TileSize)
+    {
+        return;
+    }
+
+    // Traced tiles still queued belong to the old grid.
+    Update();
+    check(!Tiles.ContainsByPredicate([](const FCollisionDebuggerTileState& Tile) { return Tile.NumInFlight > 0; }));
+
+    const TArray<FCollisionDebuggerTileState> OldTiles = MoveTemp(Tiles);
+    const int32 OldTileSize = TileSize;
+    const FIntPoint OldNumTiles = NumTiles;
+    const FVector2D Focus = Context.Focus;
+    Reset(Context.ViewSize, InTileSize);
+    Context.Focus = Focus;
+
+    for (FCollisionDebuggerTileState& Tile : Tiles)
+    {
+        // Never traced is -1 and so the stalest of all.
+        Tile.LastTraceTime = MAX_dbl;
+        Tile.Dirty = false;
+        Tile.ChangeRate = 0.f;
+
+        const FIntPoint MinTile = Tile.Rect.Min / OldTileSize;
+        const FIntPoint MaxTile = (Tile.Rect.Max - FIntPoint(1)) / OldTileSize;
+        for (int32 TileY = MinTile.Y; TileY <= MaxTile.Y; TileY++)
+        {
+            for (int32 TileX = MinTile.X; TileX <= MaxTile.X; TileX++)
+            {
+                const FCollisionDebuggerTileState& OldTile = OldTiles[TileX + TileY * OldNumTiles.X];
+                Tile.Dirty |= OldTile.Dirty;
+                Tile.ChangeRate = FMath::Max(Tile.ChangeRate, OldTile.ChangeRate);
+                Tile.LastTraceTime = FMath::Min(Tile.LastTraceTime, OldTile.LastTraceTime);
+            }
+        }
+    }
+}
+
+FCollisionDebuggerTileState* FCollisionDebuggerTileScheduler::FindTile(const FIntPoint& Pixel)
+{
+    return const_cast<FCollisionDebuggerTileState*>(AsConst(*this).FindTile(Pixel));
+}
+
+const FCollisionDebuggerTileState* FCollisionDebuggerTileScheduler::FindTile(const FIntPoint& Pixel) const
+{
+    if (Pixel.X < 0 || Pixel.Y < 0)
+    {
+        return nullptr;
+    }
+
+    const FIntPoint TileCoord = FIntPoint(Pixel.X / TileSize, Pixel.Y / TileSize);
+    if (TileCoord.X >= NumTiles.X || TileCoord.Y >= NumTiles.Y)
+    {
+        return nullptr;
+    }
+    return &Tiles[TileCoord.X + TileCoord.Y * NumTiles.X];
+}
+
+const ICollisionDebuggerTilePriority& FCollisionDebuggerTileScheduler::GetActivePolicy() const
+{
+    using namespace CollisionDebuggerTileScheduler;
+
+    const int32 PolicyIndex = Context.PeripheryInterval > 0.0 ? FoveatedPolicy : CVarCollisionDebugSchedulerPolicy.GetValueOnGameThread();
+    if (Policies.IsValidIndex(PolicyIndex) && Policies[PolicyIndex].IsValid())
+    {
+        return *Policies[PolicyIndex];
+    }
+    return *Policies[0];
+}
+
+void FCollisionDebuggerTileScheduler::Update()
+{
+    Context.Now = FPlatformTime::Seconds();
+
+    TPair<FIntPoint, uint32> Traced;
+    while (TracedTiles.Dequeue(Traced))
+    {
+        FCollisionDebuggerTileState* Tile = FindTile(Traced.Key);
+        if (!Tile)
+        {
+            continue;
+        }
+
+        const bool Changed = Tile->ContentHash != Traced.Value;
+        Tile->ChangeRate = FMath::Lerp(Tile->ChangeRate, Changed ? 1.f : 0.f, .25f);
+        Tile->ContentHash = Traced.Value;
+        Tile->NumInFlight = FMath::Max(Tile->NumInFlight - 1, 0);
+    }
+}
+
+bool FCollisionDebuggerTileScheduler::PickNextTile(FIntRect& OutRect, bool OnlyDirty) const
+{
+    return PickNextTile(OutRect, OnlyDirty, [](const FIntRect&) { return false; });
+}
+
+bool FCollisionDebuggerTileScheduler::PickNextTile(FIntRect& OutRect, bool OnlyDirty, TFunctionRef<bool(const FIntRect&)> IsBlocked) const
+{
+    const ICollisionDebuggerTilePriority& Policy = GetActivePolicy();
+
+    // Strictly greater keeps the first of equal tiles, so equal priorities fall back to raster order.
+    const FCollisionDebuggerTileState* Best = nullptr;
+    double BestPriority = 0.0;
+    for (const FCollisionDebuggerTileState& Tile : Tiles)
+    {
+        if (Tile.NumInFlight > 0 || (OnlyDirty && !Tile.Dirty))
+        {
+            continue;
+        }
+
+        // Only tiles that are due are asked about, IsBlocked may note what held them back.
+        const double Priority = Policy.GetPriority(Tile, Context);
+        if (Priority < 0.0 || IsBlocked(Tile.Rect))
+        {
+            continue;
+        }
+        if (!Best || Priority > BestPriority)
+        {
+            Best = &Tile;
+            BestPriority = Priority;
+        }
+    }
+
+    if (Best)
+    {
+        OutRect = Best->Rect;
+    }
+    return Best != nullptr;
+}
+
+void FCollisionDebuggerTileScheduler::SortByPriority(TArray<FIntPoint>& TileMins) const
+{
+    const ICollisionDebuggerTilePriority& Policy = GetActivePolicy();
+
+    TArray<TPair<double, FIntPoint>> Scored;
+    Scored.Reserve(TileMins.Num());
+    for (const FIntPoint& Min : TileMins)
+    {
+        const FCollisionDebuggerTileState* Tile = FindTile(Min);
+        Scored.Add({ Tile ? Policy.GetPriority(*Tile, Context) : 0.0, Min });
+    }
+
+    Algo::StableSortBy(Scored, [](const TPair<double, FIntPoint>& Entry) { return -Entry.Key; });
+
+    for (int32 i = 0; i < Scored.Num(); i++)
+    {
+        TileMins[i] = Scored[i].Value;
+    }
+}
+
+void FCollisionDebuggerTileScheduler::OnTileSubmitted(const FIntRect& Rect, bool FullTrace)
+{
+    if (FCollisionDebuggerTileState* Tile = FindTile(Rect.Min))
+    {
+        Tile->LastTraceTime = Context.Now;
+        Tile->NumInFlight++;
+        Tile->Dirty = Tile->Dirty && !FullTrace;
+    }
+}
+
+void FCollisionDebuggerTileScheduler::MarkDirty(const FIntRect& PixelRect)
+{
+    FIntRect Rect = PixelRect;
+    Rect.Clip(FIntRect(FIntPoint::ZeroValue, Context.ViewSize));
+    if (Rect.IsEmpty())
+    {
+        return;
+    }
+
+    const FIntPoint MinTile = Rect.Min / TileSize;
+    const FIntPoint MaxTile = (Rect.Max - FIntPoint(1)) / TileSize;
+    for (int32 TileY = MinTile.Y; TileY <= MaxTile.Y; TileY++)
+    {
+        for (int32 TileX = MinTile.X; TileX <= MaxTile.X; TileX++)
+        {
+            Tiles[TileX + TileY * NumTiles.X].Dirty = true;
+        }
+    }
+}
+
+void FCollisionDebuggerTileScheduler::MarkAllDirty()
+{
+    for (FCollisionDebuggerTileState& Tile : Tiles)
+    {
+        Tile.Dirty = true;
+    }
+}
+
+void FCollisionDebuggerTileScheduler::MarkAllEstimated()
+{
+    // Their age starts over, so tiles the estimate missed and real changes are traced first.
+    Context.Now = FPlatformTime::Seconds();
+    for (FCollisionDebuggerTileState& Tile : Tiles)
+    {
+        Tile.Dirty = true;
+        Tile.LastTraceTime = Context.Now;
+    }
+}
+
+void FCollisionDebuggerTileScheduler::ClearDirty()
+{
+    for (FCollisionDebuggerTileState& Tile : Tiles)
+    {
+        Tile.Dirty = false;
+    }
+}
+
+bool FCollisionDebuggerTileScheduler::HasDirtyTiles() const
+{
+    return Tiles.ContainsByPredicate([](const FCollisionDebuggerTileState& Tile) { return Tile.Dirty; });
+}
+
+void FCollisionDebuggerTileScheduler::OnTileTraced(const FIntRect& Rect, uint32 ContentHash)
+{
+    TracedTiles.Enqueue(TPair<FIntPoint, uint32>(Rect.Min, ContentHash));
+}
+
+void FCollisionDebuggerTileScheduler::OnTileDropped(const FIntRect& Rect)
+{
+    if (FCollisionDebuggerTileState* Tile = FindTile(Rect.Min))
+    {
+        Tile->NumInFlight = FMath::Max(Tile->NumInFlight - 1, 0);
+        Tile->Dirty = true;
+    }
+}
@@ -0,0 +1,636 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerTraceEngine.h"
+#include "CollisionDebuggerStats.h"
+#include "Engine/World.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugMaxWorkers(
+    TEXT("CollisionDebug.MaxWorkers"),
+    0,
+    TEXT("Maximum number of task workers the collision debugger traces on.\n")
+    TEXT(" 0: all task workers \n")
+    TEXT(">0: at most this many workers \n"),
+    ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugTilesInFlight(
+    TEXT("CollisionDebug.TilesInFlight"),
+    4,
+    TEXT("Number of debug view tiles that are traced at the same time, over all debug views.\n"),
+    ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugAsyncTraces(
+    TEXT("CollisionDebug.AsyncTraces"),
+    0,
+    TEXT("Trace debug view tiles as async line traces in the world's async trace phase, next to physics,\n")
+    TEXT("instead of on the task workers against the live scene. Their results land one frame later.\n")
+    TEXT("Response mask, x-ray and mirror tiles always trace on the workers.\n")
+    TEXT(" 0: off \n")
+    TEXT(" 1: on \n"),
+    ECVF_Default);
+
+
+/** The row queue and worker tasks every trace engine shares. */
+class FCollisionDebuggerTracePool
+{
+public:
+    typedef FCollisionDebuggerTraceEngine::FTileWork FTileWork;
+    typedef FCollisionDebuggerTraceEngine::FRowWorkItem FRowWorkItem;
+
+    static FCollisionDebuggerTracePool& Get()
+    {
+        static FCollisionDebuggerTracePool Pool;
+        return Pool;
+    }
+
+    /** Game thread. Queues every row of a tile and launches workers up to the cap. */
+    void Enqueue(const TSharedPtr<FTileWork, ESPMode::ThreadSafe>& Work, const FIntRect& Rect);
+
+    /**
+     * Game thread. Takes the queued rows of the engine's cancelled tiles off the queue and counts them
+     * down, so the engine doesn't have to wait for the rows of other engines queued before them.
+     */
+    void RemoveCancelledRows(FCollisionDebuggerTraceEngine& Engine);
+
+    int32 GetNumQueuedRows() const
+    {
+        FScopeLock Lock(&QueueLock);
+        return RowQueue.Num() - QueueHead;
+    }
+
+    /** Tiles of every engine that have not completed yet. */
+    std::atomic<int32> NumTilesInFlight{ 0 };
+
+private:
+    void WorkerLoop();
+    bool PopRow(FRowWorkItem& OutItem);
+
+    mutable FCriticalSection QueueLock;
+    TArray<FRowWorkItem> RowQueue;
+    int32 QueueHead = 0;
+    int32 NumActiveWorkers = 0;
+};
+
+void FCollisionDebuggerTracePool::Enqueue(const TSharedPtr<FTileWork, ESPMode::ThreadSafe>& Work, const FIntRect& Rect)
+{
+    check(IsInGameThread());
+    NumTilesInFlight++;
+
+    int32 WorkersToLaunch = 0;
+    {
+        FScopeLock Lock(&QueueLock);
+        for (int32 Row = Rect.Min.Y; Row < Rect.Max.Y; Row++)
+        {
+            RowQueue.Add({ Work, Row });
+        }
+
+        const int32 QueuedRows = RowQueue.Num() - QueueHead;
+        WorkersToLaunch = FMath::Clamp(FCollisionDebuggerTraceEngine::GetMaxWorkers() - NumActiveWorkers, 0, QueuedRows);
+        NumActiveWorkers += WorkersToLaunch;
+    }
+
+    for (int32 i = 0; i < WorkersToLaunch; i++)
+    {
+        UE::Tasks::Launch(UE_SOURCE_LOCATION, [this] { WorkerLoop(); });
+    }
+}
+
+void FCollisionDebuggerTracePool::RemoveCancelledRows(FCollisionDebuggerTraceEngine& Engine)
+{
+    check(IsInGameThread());
+    TArray<TSharedPtr<FTileWork, ESPMode::ThreadSafe>> Removed;
+    {
+        FScopeLock Lock(&QueueLock);
+        const uint32 Epoch = Engine.Epoch.load();
+        int32 Kept = QueueHead;
+        for (int32 i = QueueHead; i < RowQueue.Num(); i++)
+        {
+            FRowWorkItem& Item = RowQueue[i];
+            if (Item.Work->Engine == &Engine && Item.Work->Epoch != Epoch)
+            {
+                Removed.Add(MoveTemp(Item.Work));
+            }
+            else
+            {
+                if (Kept != i)
+                {
+                    RowQueue[Kept] = MoveTemp(Item);
+                }
+                Kept++;
+            }
+        }
+        RowQueue.SetNum(Kept, false);
+    }
+
+    for (const TSharedPtr<FTileWork, ESPMode::ThreadSafe>& Work : Removed)
+    {
+        if (--Work->RowsRemaining == 0)
+        {
+            Engine.FinishTile(*Work);
+        }
+    }
+}
+
+bool FCollisionDebuggerTracePool::PopRow(FRowWorkItem& OutItem)
+{
+    FScopeLock Lock(&QueueLock);
+    if (QueueHead >= RowQueue.Num())
+    {
+        // The worker retires under the lock so a concurrent submit knows to launch a new one.
+        RowQueue.Reset();
+        QueueHead = 0;
+        NumActiveWorkers--;
+        return false;
+    }
+
+    OutItem = MoveTemp(RowQueue[QueueHead++]);
+    return true;
+}
+
+void FCollisionDebuggerTracePool::WorkerLoop()
+{
+    FCollisionDebuggerTraceEngine::FRowScratch Scratch;
+    FRowWorkItem Item;
+    while (PopRow(Item))
+    {
+        FCollisionDebuggerTraceEngine& Engine = *Item.Work->Engine;
+
+        // Rows of a cancelled tile are skipped, they only have to be counted down.
+        if (Item.Work->Epoch == Engine.Epoch.load())
+        {
+            const uint64 StartCycles = FPlatformTime::Cycles64();
+            Engine.TraceRow(*Item.Work, Item.Row, Scratch);
+            const uint64 TraceCycles = FPlatformTime::Cycles64() - StartCycles;
+
+            if (Scratch.XRayCount > 0)
+            {
+                FTileWork& Work = *Item.Work;
+                for (int32 Begin = Work.LayersBegin.load(); Scratch.XRayFirst < Begin && !Work.LayersBegin.compare_exchange_weak(Begin, Scratch.XRayFirst);) {}
+                const int32 End = Scratch.XRayFirst + Scratch.XRayCount;
+                for (int32 Last = Work.LayersEnd.load(); End > Last && !Work.LayersEnd.compare_exchange_weak(Last, End);) {}
+                Scratch.XRayCount = 0;
+            }
+
+            Engine.StatRays += Scratch.NumRays;
+            Engine.StatHits += Scratch.NumHits;
+            Engine.StatTraceCycles += TraceCycles;
+            INC_DWORD_STAT_BY(STAT_CollisionDebugger_RaysTraced, Scratch.NumRays);
+            Scratch.NumRays = 0;
+            Scratch.NumHits = 0;
+        }
+
+        if (--Item.Work->RowsRemaining == 0)
+        {
+            Engine.FinishTile(*Item.Work);
+        }
+        Item.Work.Reset();
+    }
+}
+
+
+FCollisionDebuggerTraceEngine::~FCollisionDebuggerTraceEngine()
+{
+    Cancel();
+    Wait();
+    AsyncTraces.Reset();
+}
+
+bool FCollisionDebuggerTraceEngine::IsAsyncEnabled()
+{
+    return CVarCollisionDebugAsyncTraces.GetValueOnGameThread() > 0;
+}
+
+void FCollisionDebuggerTraceEngine::SetTarget(UWorld* InWorld, FCollisionDebuggerHitBuffer* InPixels, FCollisionDebuggerPrimitiveIds* InPrimitiveIds)
+{
+    check(IsIdle());
+    check(!InPrimitiveIds || !InPixels || InPrimitiveIds->GetSize() == InPixels->GetSize());
+    World = InWorld;
+    Pixels = InPixels;
+    PrimitiveIds = InPrimitiveIds;
+    Responses = nullptr;
+    Layers = nullptr;
+    Size = InPixels ? InPixels->GetSize() : FIntPoint::ZeroValue;
+
+    if (!RayTable.IsValid() || !RayTable->Matches(Size, FCollisionDebuggerRayTable::DefaultFovScale))
+    {
+        RayTable = MakeShared<const FCollisionDebuggerRayTable, ESPMode::ThreadSafe>(Size);
+    }
+}
+
+void FCollisionDebuggerTraceEngine::SetResponseTarget(FCollisionDebuggerResponseBuffer* InResponses)
+{
+    check(IsIdle());
+    check(!InResponses || InResponses->GetSize() == Size);
+    Responses = InResponses;
+}
+
+void FCollisionDebuggerTraceEngine::SetLayerTarget(FCollisionDebuggerLayerBuffer* InLayers)
+{
+    check(IsIdle());
+    check(!InLayers || InLayers->GetSize() == Size);
+    Layers = InLayers;
+}
+
+int32 FCollisionDebuggerTraceEngine::GetMaxWorkers()
+{
+    const int32 NumWorkers = FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads());
+    const int32 Cap = CVarCollisionDebugMaxWorkers.GetValueOnAnyThread();
+    return Cap > 0 ? FMath::Min(Cap, NumWorkers) : NumWorkers;
+}
+
+int32 FCollisionDebuggerTraceEngine::GetMaxTilesInFlight()
+{
+    return FMath::Max(1, CVarCollisionDebugTilesInFlight.GetValueOnAnyThread());
+}
+
+bool FCollisionDebuggerTraceEngine::CanAcceptTile(int32 MaxTilesInFlight)
+{
+    return FCollisionDebuggerTracePool::Get().NumTilesInFlight.load() < FMath::Min(GetMaxTilesInFlight(), MaxTilesInFlight);
+}
+
+void FCollisionDebuggerTraceEngine::SubmitTile(const FCollisionDebuggerTile& Tile, FOnTileComplete OnComplete)
+{
+    check(IsInGameThread());
+
+    FIntRect Rect = Tile.Rect;
+    Rect.Clip(FIntRect(FIntPoint::ZeroValue, Size));
+    if (Rect.IsEmpty() || !Pixels)
+    {
+        return;
+    }
+
+    TSharedPtr<FTileWork, ESPMode::ThreadSafe> Work = MakeShared<FTileWork, ESPMode::ThreadSafe>();
+    Work->Engine = this;
+    Work->Tile = Tile;
+    Work->Tile.Rect = Rect;
+    FCollisionDebuggerPrimitiveTable* Primitives = PrimitiveIds ? &PrimitiveIds->GetTable() : nullptr;
+    if (Responses)
+    {
+        Work->ResponseQuery.Emplace(World, Tile.Settings, Responses->GetMaxLayers(), Primitives);
+        Work->ResponseFilter = FCollisionDebuggerResponseFilter::Make(Tile.Settings);
+    }
+    if (Layers)
+    {
+        // The mirror only finds the nearest hit, x-ray layers need the physics scene.
+        Work->Query.Emplace(World, Tile.Settings, Primitives);
+    }
+    else if (!Responses)
+    {
+        Work->Query.Emplace(World, Tile.Settings, Primitives, Tile.Mirror);
+    }
+    Work->RayTable = RayTable;
+    Work->OnComplete = MoveTemp(OnComplete);
+    Work->RowsRemaining = Rect.Height();
+    Work->SubmitCycles = FPlatformTime::Cycles64();
+    Work->Epoch = Epoch.load();
+    NumTilesInFlight++;
+    TileEvents.RemoveAll([](const UE::Tasks::FTaskEvent& Event) { return Event.IsCompleted(); });
+    TileEvents.Add(Work->Finished);
+
+    if (!UseAsyncTraces || !SubmitAsyncTile(Work))
+    {
+        FCollisionDebuggerTracePool::Get().Enqueue(Work, Rect);
+    }
+}
+
+void FCollisionDebuggerTraceEngine::Wait()
+{
+    check(IsInGameThread());
+    DropAsyncTiles();
+
+    // Only this engine's tiles are waited for, the rows other views queued keep the workers busy.
+    FCollisionDebuggerTracePool::Get().RemoveCancelledRows(*this);
+    UE::Tasks::Wait(TileEvents);
+    TileEvents.Reset();
+    check(IsIdle());
+}
+
+void FCollisionDebuggerTraceEngine::FinishTile(FTileWork& Work, bool Drop)
+{
+    if (Drop || Work.Epoch != Epoch.load())
+    {
+        StatDropped++;
+        INC_DWORD_STAT(STAT_CollisionDebugger_TilesDropped);
+        DroppedTiles.Enqueue(Work.Tile);
+    }
+    else
+    {
+        StatTiles++;
+        StatTileCycles += FPlatformTime::Cycles64() - Work.SubmitCycles;
+        INC_DWORD_STAT(STAT_CollisionDebugger_TilesTraced);
+
+        if (Work.LayersEnd.load() > 0)
+        {
+            Work.Tile.LayersBegin = Work.LayersBegin.load();
+            Work.Tile.LayersEnd = Work.LayersEnd.load();
+        }
+        if (Work.OnComplete)
+        {
+            Work.OnComplete(Work.Tile);
+        }
+    }
+    FCollisionDebuggerTracePool::Get().NumTilesInFlight--;
+    NumTilesInFlight--;
+
+    // Last, whoever waits on it may destroy the engine right away.
+    Work.Finished.Trigger();
+}
+
+bool FCollisionDebuggerTraceEngine::SubmitAsyncTile(const TSharedPtr<FTileWork, ESPMode::ThreadSafe>& Work)
+{
+    COLLISIONDEBUGGER_SCOPE(AsyncTraces);
+
+    // Ray numbers and pixel coordinates are packed into 16 bits each.
+    const FCollisionDebuggerTile& Tile = Work->Tile;
+    const int32 Width = Tile.Rect.Width();
+    if (Responses || Layers || Tile.Mirror.IsValid() || !World || !Work->Query->IsValid() || int64(Width) * Tile.Rect.Height() > 0x10000)
+    {
+        return false;
+    }
+
+    if (!AsyncTraces.IsValid())
+    {
+        AsyncTraces = MakeShared<FAsyncTraces>();
+        AsyncTraces->Delegate.BindLambda([this, WeakTraces = TWeakPtr<FAsyncTraces>(AsyncTraces)](const FTraceHandle& Handle, FTraceDatum& Datum)
+        {
+            if (WeakTraces.IsValid())
+            {
+                OnAsyncTrace(Handle, Datum);
+            }
+        });
+    }
+
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+    const uint32 TileKey = AsyncTraces->NextTile++ & 0xFFFF;
+    const FVector Origin = Tile.Camera.GetLocation();
+    TArray<FVector3f> Directions;
+    Directions.SetNumUninitialized(Width);
+    Work->AsyncPixels.Reserve(Tile.TraceMask.IsValid() ? 0 : Width * Tile.Rect.Height());
+    for (int32 y = Tile.Rect.Min.Y; y < Tile.Rect.Max.Y; y++)
+    {
+        Work->RayTable->TransformRow(y, Tile.Rect.Min.X, Width, Tile.Camera.GetRotation(), Directions.GetData());
+        const uint8* RowMask = Tile.TraceMask.IsValid() ? Tile.TraceMask->GetData() + (y - Tile.Rect.Min.Y) * Width : nullptr;
+        for (int32 i = 0; i < Width; i++)
+        {
+            if (RowMask && !RowMask[i])
+            {
+                continue;
+            }
+            const uint32 Ray = uint32(Work->AsyncPixels.Add(uint32(i) | (uint32(y - Tile.Rect.Min.Y) << 16)));
+            Work->Query->TraceAsync(Origin, Directions[i], TraceLength, AsyncTraces->Delegate, (TileKey << 16) | Ray);
+        }
+    }
+    StatTraceCycles += FPlatformTime::Cycles64() - StartCycles;
+
+    FCollisionDebuggerTracePool::Get().NumTilesInFlight++;
+    Work->AsyncRaysRemaining = Work->AsyncPixels.Num();
+    if (Work->AsyncRaysRemaining == 0)
+    {
+        FinishTile(*Work);
+        return true;
+    }
+    AsyncTraces->Tiles.Add(TileKey, Work);
+    return true;
+}
+
+void FCollisionDebuggerTraceEngine::OnAsyncTrace(const FTraceHandle& Handle, FTraceDatum& Datum)
+{
+    const uint32 TileKey = Datum.UserData >> 16;
+    const TSharedPtr<FTileWork, ESPMode::ThreadSafe>* Found = AsyncTraces->Tiles.Find(TileKey);
+    if (!Found)
+    {
+        // The tile was dropped by Wait.
+        return;
+    }
+
+    FTileWork& Work = **Found;
+    if (Work.Epoch == Epoch.load())
+    {
+        const uint32 Pixel = Work.AsyncPixels[Datum.UserData & 0xFFFF];
+        const int32 Column = int32(Pixel & 0xFFFF);
+        const int32 y = Work.Tile.Rect.Min.Y + int32(Pixel >> 16);
+        const int32 Index = Work.Tile.Rect.Min.X + Column + (y * Size.X);
+
+        const FHitResult* RV_Hit = FHitResult::GetFirstBlockingHit(Datum.OutHits);
+        Pixels->Set(Index, RV_Hit ? FLinearColor(RV_Hit->Normal.X, RV_Hit->Normal.Y, RV_Hit->Normal.Z, RV_Hit->Time) : FLinearColor(-1, -1, -1, -1));
+        if (PrimitiveIds)
+        {
+            PrimitiveIds->Set(Index, RV_Hit ? PrimitiveIds->GetTable().FindOrAdd(RV_Hit->GetComponent()) : FCollisionDebuggerPrimitiveTable::NoPrimitive);
+        }
+        FillFootprint(Work, Column, y);
+
+        StatRays++;
+        StatHits += RV_Hit ? 1 : 0;
+        INC_DWORD_STAT(STAT_CollisionDebugger_RaysTraced);
+    }
+
+    if (--Work.AsyncRaysRemaining == 0)
+    {
+        const TSharedPtr<FTileWork, ESPMode::ThreadSafe> Finished = *Found;
+        AsyncTraces->Tiles.Remove(TileKey);
+        FinishTile(*Finished);
+    }
+}
+
+void FCollisionDebuggerTraceEngine::DropAsyncTiles()
+{
+    if (!AsyncTraces.IsValid() || AsyncTraces->Tiles.Num() == 0)
+    {
+        return;
+    }
+
+    // Results of traces already queued come in after the tiles are gone and are ignored.
+    check(IsInGameThread());
+    TArray<TSharedPtr<FTileWork, ESPMode::ThreadSafe>> Tiles;
+    AsyncTraces->Tiles.GenerateValueArray(Tiles);
+    AsyncTraces->Tiles.Reset();
+    for (const TSharedPtr<FTileWork, ESPMode::ThreadSafe>& Work : Tiles)
+    {
+        FinishTile(*Work, true);
+    }
+}
+
+void FCollisionDebuggerTraceEngine::ConsumeDroppedTiles(TArray<FCollisionDebuggerTile>& OutTiles)
+{
+    check(IsInGameThread());
+    FCollisionDebuggerTile Tile;
+    while (DroppedTiles.Dequeue(Tile))
+    {
+        OutTiles.Add(MoveTemp(Tile));
+    }
+}
+
+FCollisionDebuggerTraceStats FCollisionDebuggerTraceEngine::ConsumeStats()
+{
+    FCollisionDebuggerTraceStats Stats;
+    Stats.NumRays = StatRays.exchange(0);
+    Stats.NumHits = StatHits.exchange(0);
+    Stats.NumTiles = StatTiles.exchange(0);
+    Stats.NumDropped = StatDropped.exchange(0);
+    Stats.TileSeconds = FPlatformTime::ToSeconds64(StatTileCycles.exchange(0));
+    Stats.TraceSeconds = FPlatformTime::ToSeconds64(StatTraceCycles.exchange(0));
+    return Stats;
+}
+
+int32 FCollisionDebuggerTraceEngine::GetNumQueuedRows()
+{
+    return FCollisionDebuggerTracePool::Get().GetNumQueuedRows();
+}
+
+void FCollisionDebuggerTraceEngine::TraceRow(const FTileWork& Work, int32 Row, FRowScratch& Scratch) const
+{
+    COLLISIONDEBUGGER_SCOPE(TraceRow);
+
+    const FCollisionDebuggerTile& Tile = Work.Tile;
+    const FTransform& trans = Tile.Camera;
+    const int32 Width = Tile.Rect.Width();
+
+    Scratch.Directions.SetNumUninitialized(Width, false);
+    Scratch.Columns.Reset();
+
+    const int32 y = Row;
+    Work.RayTable->TransformRow(y, Tile.Rect.Min.X, Width, trans.GetRotation(), Scratch.Directions.GetData());
+
+    // Masked tiles only retrace the flagged pixels, packed to the front of the batch.
+    int32 NumRays = Width;
+    if (Tile.TraceMask.IsValid())
+    {
+        const uint8* RowMask = Tile.TraceMask->GetData() + (y - Tile.Rect.Min.Y) * Width;
+        NumRays = 0;
+        for (int32 i = 0; i < Width; i++)
+        {
+            if (RowMask[i])
+            {
+                Scratch.Directions[NumRays++] = Scratch.Directions[i];
+                Scratch.Columns.Add(i);
+            }
+        }
+        if (NumRays == 0)
+        {
+            return;
+        }
+    }
+
+    const int32 RowStart = Tile.Rect.Min.X + (y * Size.X);
+    Scratch.Hits.SetNumUninitialized(NumRays, false);
+    if (Work.ResponseQuery.IsSet())
+    {
+        // Every primitive any test could stop on is kept, the tile's own test is resolved from them.
+        const int32 MaxLayers = Work.ResponseQuery->GetMaxLayers();
+        Scratch.Layers.SetNumUninitialized(NumRays * MaxLayers, false);
+        Scratch.NumLayers.SetNumUninitialized(NumRays, false);
+        Work.ResponseQuery->TraceBatch(trans.GetLocation(), MakeArrayView(Scratch.Directions.GetData(), NumRays), TraceLength, Scratch.Layers, Scratch.NumLayers);
+
+        for (int32 i = 0; i < NumRays; i++)
+        {
+            const FCollisionDebuggerResponseLayer* Layers = Scratch.Layers.GetData() + i * MaxLayers;
+            const int32 Column = Tile.TraceMask.IsValid() ? Scratch.Columns[i] : i;
+            Responses->Set(RowStart + Column, Layers, Scratch.NumLayers[i]);
+            Scratch.Hits[i] = Work.ResponseFilter.Resolve(Layers, Scratch.NumLayers[i]);
+        }
+    }
+    else if (!Layers)
+    {
+        Work.Query->TraceBatch(trans.GetLocation(), MakeArrayView(Scratch.Directions.GetData(), NumRays), TraceLength, Scratch.Hits);
+    }
+
+    // X-ray rows reserve the pool for all their layers at once, the nearest layer doubles as the hit.
+    const int32 MaxXRayLayers = Layers ? Layers->GetMaxLayers() : 0;
+    int32 XRayNext = 0;
+    if (Layers)
+    {
+        Scratch.XRayLayers.SetNumUninitialized(NumRays * MaxXRayLayers, false);
+        Scratch.NumXRayLayers.SetNumUninitialized(NumRays, false);
+        Work.Query->TraceLayers(trans.GetLocation(), MakeArrayView(Scratch.Directions.GetData(), NumRays), TraceLength, MaxXRayLayers, Scratch.XRayLayers, Scratch.NumXRayLayers);
+
+        int32 RowLayers = 0;
+        for (int32 i = 0; i < NumRays; i++)
+        {
+            RowLayers += Scratch.NumXRayLayers[i];
+            if (!Work.ResponseQuery.IsSet())
+            {
+                Scratch.Hits[i] = Scratch.NumXRayLayers[i] > 0 ? Scratch.XRayLayers[i * MaxXRayLayers] : FCollisionDebuggerRayHit();
+            }
+        }
+
+        XRayNext = RowLayers > 0 ? Layers->Allocate(RowLayers) : 0;
+        Scratch.XRayFirst = XRayNext;
+        Scratch.XRayCount = XRayNext != INDEX_NONE ? RowLayers : 0;
+    }
+
+    Scratch.NumRays += NumRays;
+
+    for (int32 i = 0; i < NumRays; i++)
+    {
+        const FCollisionDebuggerRayHit& RV_Hit = Scratch.Hits[i];
+        const int32 Column = Tile.TraceMask.IsValid() ? Scratch.Columns[i] : i;
+
+        FLinearColor Color = FLinearColor(-1, -1, -1, -1);
+        if (RV_Hit.IsHit())
+        {
+            Scratch.NumHits++;
+            Color = FLinearColor(RV_Hit.Normal.X, RV_Hit.Normal.Y, RV_Hit.Normal.Z, RV_Hit.Time);
+        }
+        Pixels->Set(RowStart + Column, Color);
+        if (PrimitiveIds)
+        {
+            PrimitiveIds->Set(RowStart + Column, RV_Hit.PrimitiveId);
+        }
+        if (Layers)
+        {
+            const int32 NumXRayLayers = Scratch.NumXRayLayers[i];
+            if (NumXRayLayers > 0 && XRayNext == INDEX_NONE)
+            {
+                Layers->SetOverflow(RowStart + Column);
+            }
+            else if (NumXRayLayers == 0)
+            {
+                Layers->Set(RowStart + Column, 0, nullptr, 0);
+            }
+            else
+            {
+                Layers->Set(RowStart + Column, XRayNext, Scratch.XRayLayers.GetData() + i * MaxXRayLayers, NumXRayLayers);
+                XRayNext += NumXRayLayers;
+            }
+        }
+
+        FillFootprint(Work, Column, y);
+    }
+}
+
+void FCollisionDebuggerTraceEngine::FillFootprint(const FTileWork& Work, int32 Column, int32 Row) const
+{
+    // Coarse samples cover their whole block until a finer pass replaces them.
+    const FCollisionDebuggerTile& Tile = Work.Tile;
+    const int32 Width = Tile.Rect.Width();
+    const int32 Footprint = Tile.TraceMask.IsValid() ? (*Tile.TraceMask)[(Row - Tile.Rect.Min.Y) * Width + Column] : 1;
+    if (Footprint <= 1)
+    {
+        return;
+    }
+
+    const int32 Source = Tile.Rect.Min.X + Column + (Row * Size.X);
+    const int32 MaxX = FMath::Min(Tile.Rect.Min.X + Column + Footprint, Tile.Rect.Max.X);
+    const int32 MaxY = FMath::Min(Row + Footprint, Tile.Rect.Max.Y);
+    for (int32 FillY = Row; FillY < MaxY; FillY++)
+    {
+        for (int32 FillX = Tile.Rect.Min.X + Column; FillX < MaxX; FillX++)
+        {
+            Pixels->CopyPixel(FillX + (FillY * Size.X), Source);
+            if (Work.ResponseQuery.IsSet())
+            {
+                Responses->CopyPixel(FillX + (FillY * Size.X), Source);
+            }
+            if (PrimitiveIds)
+            {
+                PrimitiveIds->CopyPixel(FillX + (FillY * Size.X), Source);
+            }
+            if (Layers)
+            {
+                Layers->CopyPixel(FillX + (FillY * Size.X), Source);
+            }
+        }
+    }
+}
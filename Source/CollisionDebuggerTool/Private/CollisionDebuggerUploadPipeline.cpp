@@ -0,0 +1,154 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerUploadPipeline.h"
+#include "CollisionDebuggerStats.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "TextureResource.h"
+#include "RenderingThread.h"
+#include "RHICommandList.h"
+
+
+FCollisionDebuggerUploadPipeline::~FCollisionDebuggerUploadPipeline()
+{
+    Wait();
+}
+
+void FCollisionDebuggerUploadPipeline::SetTarget(UTextureRenderTarget2D* InTarget, const FCollisionDebuggerHitBuffer* InSource)
+{
+    check(IsInGameThread());
+    Wait();
+
+    TargetResource = InTarget ? InTarget->GetResource() : nullptr;
+    Source = InSource;
+    RawSource = FCollisionDebuggerUploadSource();
+}
+
+void FCollisionDebuggerUploadPipeline::SetTarget(UTextureRenderTarget2D* InTarget, const FCollisionDebuggerUploadSource& InSource)
+{
+    check(IsInGameThread());
+    Wait();
+
+    TargetResource = InTarget ? InTarget->GetResource() : nullptr;
+    Source = nullptr;
+    RawSource = InSource;
+}
+
+FCollisionDebuggerUploadSource FCollisionDebuggerUploadPipeline::GetSource() const
+{
+    if (Source)
+    {
+        return { Source->GetData(), Source->GetSize().X, Source->GetBytesPerPixel() };
+    }
+    return RawSource;
+}
+
+int32 FCollisionDebuggerUploadPipeline::GetNumPooledBlocks() const
+{
+    FScopeLock Lock(&PoolLock);
+    return Blocks.Num();
+}
+
+FCollisionDebuggerUploadPipeline::FStagingBlock* FCollisionDebuggerUploadPipeline::AcquireBlock()
+{
+    FScopeLock Lock(&PoolLock);
+    if (FreeBlocks.Num() > 0)
+    {
+        return FreeBlocks.Pop(false);
+    }
+    return Blocks.Add_GetRef(MakeUnique<FStagingBlock>()).Get();
+}
+
+void FCollisionDebuggerUploadPipeline::ReleaseBlock(FStagingBlock* Block)
+{
+    FScopeLock Lock(&PoolLock);
+    FreeBlocks.Add(Block);
+}
+
+bool FCollisionDebuggerUploadPipeline::Submit(const FIntRect& Rect, FOnStaged OnStaged)
+{
+    if (!TargetResource || (!Source && !RawSource.Data) || Rect.IsEmpty())
+    {
+        return false;
+    }
+
+    FStagingBlock* Block = AcquireBlock();
+    NumEncoding++;
+
+    // Encode: snapshot the rectangle so later traces can't tear the upload.
+    UE::Tasks::FTask EncodeTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, Block, Rect, OnStaged = MoveTemp(OnStaged)]
+    {
+        COLLISIONDEBUGGER_SCOPE(Encode);
+
+        const FCollisionDebuggerUploadSource Pixels = GetSource();
+        const int32 Bpp = Pixels.BytesPerPixel;
+        Block->Rect = Rect;
+        Block->Pitch = uint32(Rect.Width() * Bpp);
+        Block->Data.SetNumUninitialized(Block->Pitch * Rect.Height(), false);
+
+        for (int32 y = Rect.Min.Y; y < Rect.Max.Y; y++)
+        {
+            const uint8* Row = Pixels.Data + (Rect.Min.X + y * Pixels.Width) * Bpp;
+            FMemory::Memcpy(Block->Data.GetData() + (y - Rect.Min.Y) * Block->Pitch, Row, Block->Pitch);
+        }
+
+        if (OnStaged)
+        {
+            OnStaged(Rect, FCrc::MemCrc32(Block->Data.GetData(), Block->Data.Num()));
+        }
+        NumEncoding--;
+    });
+
+    // Upload: the render thread owns the block until the texture update has copied it.
+    UE::Tasks::FTask UploadTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, Block]
+    {
+        FTextureResource* Resource = TargetResource;
+        ENQUEUE_RENDER_COMMAND(CollisionDebuggerUploadBlock)(
+            [this, Resource, Block](FRHICommandListImmediate& RHICmdList)
+            {
+                COLLISIONDEBUGGER_SCOPE(Upload);
+
+                FTexture2DRHIRef TextureRHI = Resource ? Resource->GetTexture2DRHI() : nullptr;
+                if (TextureRHI.IsValid())
+                {
+                    const FUpdateTextureRegion2D Region(Block->Rect.Min.X, Block->Rect.Min.Y, 0, 0, Block->Rect.Width(), Block->Rect.Height());
+                    RHICmdList.UpdateTexture2D(TextureRHI, 0, Region, Block->Pitch, Block->Data.GetData());
+                    INC_DWORD_STAT_BY(STAT_CollisionDebugger_BytesUploaded, Block->Data.Num());
+                }
+                else
+                {
+                    UE_LOG(LogTemp, Error, TEXT("Invalid Texture2DRHIRef"));
+                }
+                ReleaseBlock(Block);
+            });
+    }, UE::Tasks::Prerequisites(EncodeTask));
+
+    FScopeLock Lock(&TaskLock);
+    PendingUploads.RemoveAll([](const UE::Tasks::FTask& Task) { return Task.IsCompleted(); });
+    PendingUploads.Add(UploadTask);
+    return true;
+}
+
+void FCollisionDebuggerUploadPipeline::Wait()
+{
+    check(IsInGameThread());
+
+    TArray<UE::Tasks::FTask> Tasks;
+    {
+        FScopeLock Lock(&TaskLock);
+        Tasks = MoveTemp(PendingUploads);
+    }
+
+    UE::Tasks::Wait(Tasks);
+
+    bool HasBlocksInFlight = false;
+    {
+        FScopeLock Lock(&PoolLock);
+        HasBlocksInFlight = FreeBlocks.Num() != Blocks.Num();
+    }
+
+    if (HasBlocksInFlight)
+    {
+        FlushRenderingCommands();
+    }
+}
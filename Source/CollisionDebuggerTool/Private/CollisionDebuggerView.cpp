@@ -0,0 +1,929 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerView.h"
+#include "CollisionDebuggerStats.h"
+#include "CollisionDebuggerViewMaterial.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Engine/CollisionProfile.h"
+#include "Components/PrimitiveComponent.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Blueprint/UserWidget.h"
+#include "Kismet/GameplayStatics.h"
+#include "HAL/IConsoleManager.h"
+
+#if WITH_EDITOR
+    #include "Editor.h"
+    #include "EditorViewportClient.h"
+#endif
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugReprojection(
+    TEXT("CollisionDebug.Reprojection"),
+    1,
+    TEXT("Reproject the traced view when the camera moves and only retrace disoccluded pixels.\n")
+    TEXT(" 0: off, camera moves wait for the sweep \n")
+    TEXT(" 1: on  \n"),
+    ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugFoveated(
+    TEXT("CollisionDebug.Foveated"),
+    0,
+    TEXT("Retrace a window around the mouse cursor in the editor, or the screen center in game, at full resolution\n")
+    TEXT("every tick. The rest of the view is traced at CollisionDebug.Foveated.PeripheryStride, each tile at most every\n")
+    TEXT("CollisionDebug.Foveated.PeripheryInterval seconds. With a CollisionDebug.RayBudget above 0 the window's rays\n")
+    TEXT("come out of the same budget, without one they are traced on top of the rest.\n")
+    TEXT(" 0: off \n")
+    TEXT(">0: side of the window in pixels, 128 is a good start \n"),
+    ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarCollisionDebugFoveatedPeripheryStride(
+    TEXT("CollisionDebug.Foveated.PeripheryStride"),
+    4,
+    TEXT("Pixel stride the periphery of a foveated view is traced at, 1, 2, 4 or 8. A coarser dynamic resolution wins.\n"),
+    ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarCollisionDebugFoveatedPeripheryInterval(
+    TEXT("CollisionDebug.Foveated.PeripheryInterval"),
+    .5f,
+    TEXT("Seconds a periphery tile of a foveated view waits between two traces.\n"),
+    ECVF_Default);
+
+
+FCollisionDebuggerView::FCollisionDebuggerView(UWorld* InWorld, APlayerController* InPlayer, UTextureRenderTarget2D* InRenderTarget, int32 InTileSize)
+    : World(InWorld)
+    , Player(InPlayer)
+    , FollowsPlayer(InPlayer != nullptr)
+    , RenderTarget(InRenderTarget)
+    , TileSize(InTileSize)
+    , WantedTileSize(InTileSize)
+{
+    const FIntPoint Size(RenderTarget->SizeX, RenderTarget->SizeY);
+    PixelColors.Init(Size, FCollisionDebuggerViewMaterial::GetHitFormat());
+    PrimitiveIds.Init(Size);
+    PixelNeedsTrace.Init(1, PixelColors.Num());
+    Scheduler.Reset(Size, TileSize);
+    TraceEngine.SetTarget(InWorld, &PixelColors, &PrimitiveIds);
+    UploadPipeline.SetTarget(RenderTarget, &PixelColors);
+}
+
+FCollisionDebuggerView::~FCollisionDebuggerView()
+{
+    Cancel();
+    Wait();
+}
+
+void FCollisionDebuggerView::Wait()
+{
+    TraceEngine.Wait();
+    UploadPipeline.Wait();
+    XRayEntryUpload.Wait();
+    XRayLayerUpload.Wait();
+}
+
+void FCollisionDebuggerView::AddReferencedObjects(FReferenceCollector& Collector)
+{
+    Collector.AddReferencedObject(RenderTarget);
+    Collector.AddReferencedObject(XRayEntryTarget);
+    Collector.AddReferencedObject(XRayLayerTarget);
+    Collector.AddReferencedObject(Widget);
+}
+
+bool FCollisionDebuggerView::BeginTick(const FInputRenderSettingsInternal& Settings, TConstArrayView<FBox> DirtyBounds)
+{
+    if (!IsValid(RenderTarget) || !GetCameraTransform(Camera))
+    {
+        return false;
+    }
+
+    Scheduler.Update();
+    UpdateFocus();
+    TraceEngine.SetUseAsyncTraces(FCollisionDebuggerTraceEngine::IsAsyncEnabled());
+    RestoreDroppedTiles();
+    AddTracedTilesToCache();
+    ApplyTileSize();
+    CompactPrimitiveIds();
+    if (!ReprojectToCamera(Camera))
+    {
+        return false;
+    }
+    InvalidateBounds(DirtyBounds);
+    return UpdateXRayLayers() && UpdateResponseMasks(Settings);
+}
+
+bool FCollisionDebuggerView::IsRefreshing() const
+{
+    return Scheduler.HasDirtyTiles() || RetraceTiles.Num() > 0 || Progressive.IsActive() || !TraceEngine.IsIdle();
+}
+
+bool FCollisionDebuggerView::GetCameraTransform(FTransform& OutTransform) const
+{
+    if (FollowsPlayer)
+    {
+        const APlayerController* PlayerController = Player.Get();
+        if (!PlayerController || !PlayerController->PlayerCameraManager)
+        {
+            return false;
+        }
+        OutTransform = PlayerController->PlayerCameraManager->GetTransform();
+        return true;
+    }
+
+    UWorld* world = World.Get();
+    if (!world)
+    {
+        return false;
+    }
+
+    APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(world, 0);
+    if (CameraManager)
+    {
+        OutTransform = CameraManager->GetTransform();
+        return true;
+    }
+
+#if WITH_EDITOR
+    FViewport* ViewPort = GEditor->GetActiveViewport();
+    if (ViewPort->IsPlayInEditorViewport())
+    {
+        return false;
+    }
+    FEditorViewportClient* client = (FEditorViewportClient*)ViewPort->GetClient();
+    FVector CamPos = client->GetViewLocation();
+    OutTransform = FTransform(client->GetViewRotation(), CamPos, FVector::OneVector);
+#endif // WITH_EDITOR
+    return true;
+}
+
+FVector2D FCollisionDebuggerView::GetFocusPixel() const
+{
+    const FIntPoint Size = PixelColors.GetSize();
+    FVector2D Focus = FVector2D(Size) * .5;
+
+#if WITH_EDITOR
+    // In the editor the cursor over the viewport the view follows, in game the crosshair.
+    const UWorld* world = World.Get();
+    if (FollowsPlayer || !GEditor || (world && world->IsGameWorld()))
+    {
+        return Focus;
+    }
+    const FViewport* ViewPort = GEditor->GetActiveViewport();
+    if (!ViewPort || ViewPort->IsPlayInEditorViewport())
+    {
+        return Focus;
+    }
+    const FIntPoint ViewportSize = ViewPort->GetSizeXY();
+    const FIntPoint Mouse(ViewPort->GetMouseX(), ViewPort->GetMouseY());
+    if (ViewportSize.X > 0 && ViewportSize.Y > 0 && FIntRect(FIntPoint::ZeroValue, ViewportSize).Contains(Mouse))
+    {
+        Focus = FVector2D(Mouse) * FVector2D(Size) / FVector2D(ViewportSize);
+    }
+#endif // WITH_EDITOR
+    return Focus;
+}
+
+void FCollisionDebuggerView::UpdateFocus()
+{
+    const int32 OldStride = GetFullTraceStride();
+    const int32 WindowSize = CVarCollisionDebugFoveated.GetValueOnGameThread();
+    const FVector2D Focus = GetFocusPixel();
+    Scheduler.SetFocus(Focus);
+
+    if (WindowSize <= 0)
+    {
+        FocusRect = FIntRect();
+        FocusPending = false;
+        Scheduler.SetPeripheryInterval(0.0);
+    }
+    else
+    {
+        const FIntPoint Min = FIntPoint(FMath::RoundToInt(Focus.X), FMath::RoundToInt(Focus.Y)) - FIntPoint(WindowSize / 2);
+        FocusRect = FIntRect(Min, Min + FIntPoint(WindowSize));
+        FocusRect.Clip(FIntRect(FIntPoint::ZeroValue, PixelColors.GetSize()));
+        FocusPending = !FocusRect.IsEmpty();
+        // Never 0, that would turn the foveated policy off.
+        Scheduler.SetPeripheryInterval(FMath::Max(CVarCollisionDebugFoveatedPeripheryInterval.GetValueOnGameThread(), .001f));
+    }
+
+    if (GetFullTraceStride() < OldStride)
+    {
+        Scheduler.MarkAllDirty();
+    }
+}
+
+int32 FCollisionDebuggerView::GetFullTraceStride() const
+{
+    if (!IsFoveated())
+    {
+        return TraceStride;
+    }
+    const int32 PeripheryStride = FMath::RoundUpToPowerOfTwo(FMath::Clamp(CVarCollisionDebugFoveatedPeripheryStride.GetValueOnGameThread(), 1, 8));
+    return FMath::Max(TraceStride, PeripheryStride);
+}
+
+bool FCollisionDebuggerView::ReprojectToCamera(const FTransform& trans)
+{
+    if (CVarCollisionDebugReprojection.GetValueOnGameThread() <= 0 || !HasBufferCamera)
+    {
+        if (HasBufferCamera && !trans.Equals(BufferCamera, UE_KINDA_SMALL_NUMBER))
+        {
+            TraceEngine.Cancel();
+            if (!SplatFromCache(trans))
+            {
+                Scheduler.MarkAllDirty();
+            }
+        }
+        else if (!HasBufferCamera)
+        {
+            SplatFromCache(trans);
+        }
+        BufferCamera = trans;
+        HasBufferCamera = true;
+        return true;
+    }
+
+    if (trans.Equals(BufferCamera, UE_KINDA_SMALL_NUMBER))
+    {
+        return true;
+    }
+
+    // Tiles still tracing the old camera have to land before the buffer can move, they stop at
+    // their next row and what they did trace is reprojected with the rest.
+    if (!TraceEngine.IsIdle() || IsEncoding())
+    {
+        TraceEngine.Cancel();
+        return false;
+    }
+
+    const int32 NumFlagged = Reprojection.Reproject(PixelColors, PixelNeedsTrace, *TraceEngine.GetRayTable(), BufferCamera, trans, FCollisionDebuggerTraceEngine::TraceLength, PrimitiveIds.GetIds());
+    BufferCamera = trans;
+
+    // The layers stay where they were traced, they are only valid again once retraced.
+    ResponseMasks.Invalidate();
+    InvalidateXRayLayers();
+
+    // Reprojected pixels are only an estimate, every tile gets a real trace once the camera settles.
+    Scheduler.MarkAllDirty();
+
+    if (NumFlagged > 0)
+    {
+        QueueRetraceTiles();
+    }
+    UploadRect(FIntRect(FIntPoint::ZeroValue, PixelColors.GetSize()));
+    return true;
+}
+
+bool FCollisionDebuggerView::SplatFromCache(const FTransform& trans)
+{
+    // Response masks and x-ray layers need more per pixel than the cache keeps.
+    if (!SurfelCache || SurfelCache->IsEmpty() || !ResponseMasks.IsEmpty() || !XRayLayers.IsEmpty() || !TraceEngine.IsIdle() || IsEncoding())
+    {
+        return false;
+    }
+
+    // What the cache does not cover is traced first, the splatted tiles stay dirty behind it so
+    // they still get a real trace.
+    const int32 NumFlagged = SurfelCache->Splat(PixelColors, PrimitiveIds, PixelNeedsTrace, trans, *TraceEngine.GetRayTable(), FCollisionDebuggerTraceEngine::TraceLength);
+    Scheduler.MarkAllEstimated();
+    Progressive.Reset();
+    RetraceTiles.Reset();
+    if (NumFlagged > 0)
+    {
+        QueueRetraceTiles();
+    }
+    UploadRect(FIntRect(FIntPoint::ZeroValue, PixelColors.GetSize()));
+    return true;
+}
+
+void FCollisionDebuggerView::AddTracedTilesToCache()
+{
+    FCollisionDebuggerTile Tile;
+    while (TracedTiles.Dequeue(Tile))
+    {
+        if (SurfelCache && SurfelCache->IsOpen())
+        {
+            SurfelCache->AddHits(PixelColors, PrimitiveIds, Tile.Rect, Tile.TraceMask.Get(), Tile.Camera, *TraceEngine.GetRayTable(), FCollisionDebuggerTraceEngine::TraceLength);
+        }
+    }
+}
+
+void FCollisionDebuggerView::InvalidateBounds(TConstArrayView<FBox> DirtyBounds)
+{
+    const FCollisionDebuggerRayTable* RayTable = TraceEngine.GetRayTable().Get();
+    const double TraceLengthSquared = FMath::Square(FCollisionDebuggerTraceEngine::TraceLength);
+    for (const FBox& Bounds : DirtyBounds)
+    {
+        FIntRect Rect;
+        if (RayTable && Bounds.ComputeSquaredDistanceToPoint(BufferCamera.GetLocation()) < TraceLengthSquared
+            && FCollisionDebuggerReprojection::ProjectBounds(Bounds, BufferCamera, *RayTable, Rect))
+        {
+            Scheduler.MarkDirty(Rect);
+        }
+    }
+}
+
+bool FCollisionDebuggerView::UpdateResponseMasks(const FInputRenderSettingsInternal& Settings)
+{
+    const bool WantsMasks = FCollisionDebuggerResponseBuffer::IsEnabled();
+    if (WantsMasks == ResponseMasks.IsEmpty() || ResolvePending)
+    {
+        // Tiles in flight write the layers and resolve the old test, they have to land first.
+        if (!TraceEngine.IsIdle() || IsEncoding())
+        {
+            return false;
+        }
+
+        if (WantsMasks && ResponseMasks.IsEmpty())
+        {
+            ResponseMasks.Init(PixelColors.GetSize(), FCollisionDebuggerResponseBuffer::GetConfiguredLayers());
+            TraceEngine.SetResponseTarget(&ResponseMasks);
+            Scheduler.MarkAllDirty();
+        }
+        else if (!WantsMasks && !ResponseMasks.IsEmpty())
+        {
+            TraceEngine.SetResponseTarget(nullptr);
+            ResponseMasks.Empty();
+        }
+
+        if (ResolvePending)
+        {
+            ResolvePending = false;
+            if (ResponseMasks.IsEmpty())
+            {
+                Scheduler.MarkAllDirty();
+            }
+            else
+            {
+                ResponseMasks.Resolve(FCollisionDebuggerResponseFilter::Make(Settings), PixelColors, &PrimitiveIds);
+                UploadRect(FIntRect(FIntPoint::ZeroValue, PixelColors.GetSize()));
+            }
+        }
+    }
+    return true;
+}
+
+bool FCollisionDebuggerView::UpdateXRayLayers()
+{
+    const bool WantsLayers = FCollisionDebuggerLayerBuffer::IsEnabled();
+    const bool Resize = WantsLayers && XRayLayers.GetMaxLayers() != FCollisionDebuggerLayerBuffer::GetConfiguredLayers();
+    const bool Compact = !XRayLayers.IsEmpty() && XRayLayers.NeedsCompaction();
+    if (WantsLayers != XRayLayers.IsEmpty() && !Resize && !Compact)
+    {
+        return true;
+    }
+
+    // Tiles in flight allocate from the pool and uploads read it, they have to land first.
+    if (!TraceEngine.IsIdle() || IsEncoding())
+    {
+        return false;
+    }
+
+    if (!WantsLayers)
+    {
+        TraceEngine.SetLayerTarget(nullptr);
+        XRayEntryUpload.SetTarget(nullptr, FCollisionDebuggerUploadSource());
+        XRayLayerUpload.SetTarget(nullptr, nullptr);
+        XRayLayers.Empty();
+        XRayEntryTarget = nullptr;
+        XRayLayerTarget = nullptr;
+        XRayTargetsChanged = true;
+        return true;
+    }
+
+    if (XRayLayers.IsEmpty() || Resize)
+    {
+        XRayLayers.Init(PixelColors.GetSize(), FCollisionDebuggerLayerBuffer::GetConfiguredLayers(), PixelColors.GetFormat());
+        TraceEngine.SetLayerTarget(&XRayLayers);
+        Scheduler.MarkAllDirty();
+    }
+    else if (XRayLayers.Compact() > 0)
+    {
+        // Pixels traced while the pool was full have no layers, the repacked pool has room for them.
+        Scheduler.MarkAllDirty();
+    }
+    UpdateXRayTargets();
+    return true;
+}
+
+void FCollisionDebuggerView::UpdateXRayTargets()
+{
+    const FIntPoint EntrySize = XRayLayers.GetSize();
+    const FCollisionDebuggerHitBuffer& Pool = XRayLayers.GetPool();
+    const EPixelFormat PoolFormat = FCollisionDebuggerHitBuffer::GetPixelFormat(Pool.GetFormat());
+
+    if (!XRayEntryTarget)
+    {
+        XRayEntryTarget = NewObject<UTextureRenderTarget2D>();
+        XRayEntryTarget->ClearColor = FLinearColor::Transparent;
+        XRayEntryTarget->InitCustomFormat(EntrySize.X, EntrySize.Y, FCollisionDebuggerLayerBuffer::EntryFormat, true);
+        XRayTargetsChanged = true;
+    }
+
+    // The pool grows on compaction, the target is resized in place so the widget keeps it.
+    if (!XRayLayerTarget)
+    {
+        XRayLayerTarget = NewObject<UTextureRenderTarget2D>();
+        XRayLayerTarget->ClearColor = FLinearColor(-1, -1, -1, -1);
+        XRayTargetsChanged = true;
+    }
+    if (XRayLayerTarget->SizeX != Pool.GetSize().X || XRayLayerTarget->SizeY != Pool.GetSize().Y || XRayLayerTarget->GetFormat() != PoolFormat)
+    {
+        XRayLayerTarget->InitCustomFormat(Pool.GetSize().X, Pool.GetSize().Y, PoolFormat, true);
+    }
+
+    XRayEntryUpload.SetTarget(XRayEntryTarget, FCollisionDebuggerUploadSource{ XRayLayers.GetEntryData(), EntrySize.X, int32(sizeof(uint32)) });
+    XRayLayerUpload.SetTarget(XRayLayerTarget, &Pool);
+    XRayEntryUpload.Submit(FIntRect(FIntPoint::ZeroValue, EntrySize));
+    XRayLayerUpload.Submit(FIntRect(FIntPoint::ZeroValue, Pool.GetSize()));
+}
+
+void FCollisionDebuggerView::InvalidateXRayLayers()
+{
+    if (!XRayLayers.IsEmpty())
+    {
+        XRayLayers.Invalidate();
+        XRayEntryUpload.Submit(FIntRect(FIntPoint::ZeroValue, XRayLayers.GetSize()));
+    }
+}
+
+void FCollisionDebuggerView::OnTestChanged()
+{
+    // With response masks the new test is resolved from the traced layers, without tracing.
+    // X-ray layers only hold what the old test blocked on and always need a new trace.
+    if (ResponseMasks.IsEmpty() || !XRayLayers.IsEmpty())
+    {
+        TraceEngine.Cancel();
+        Scheduler.MarkAllDirty();
+    }
+    else
+    {
+        ResolvePending = true;
+    }
+}
+
+void FCollisionDebuggerView::OnTraceComplexChanged()
+{
+    TraceEngine.Cancel();
+    ResponseMasks.Invalidate();
+    InvalidateXRayLayers();
+    Scheduler.MarkAllDirty();
+}
+
+void FCollisionDebuggerView::RestoreDroppedTiles()
+{
+    TArray<FCollisionDebuggerTile> DroppedTiles;
+    TraceEngine.ConsumeDroppedTiles(DroppedTiles);
+    if (DroppedTiles.Num() == 0)
+    {
+        return;
+    }
+
+    // Submitting cleared the tile's flags, put them back so the pixels it did not get to are traced again.
+    const int32 SizeX = PixelColors.GetSize().X;
+    for (const FCollisionDebuggerTile& Tile : DroppedTiles)
+    {
+        InFlightRects.RemoveSingleSwap(Tile.Rect, false);
+
+        // The window never counted as in flight on the grid, the grid tiles under it are only flagged again.
+        if (Tile.Focus)
+        {
+            NumFocusTilesInFlight--;
+            Scheduler.MarkDirty(Tile.Rect);
+        }
+        else
+        {
+            Scheduler.OnTileDropped(Tile.Rect);
+        }
+
+        const int32 Width = Tile.Rect.Width();
+        for (int32 y = Tile.Rect.Min.Y; y < Tile.Rect.Max.Y; y++)
+        {
+            uint8* Row = PixelNeedsTrace.GetData() + Tile.Rect.Min.X + y * SizeX;
+            if (Tile.TraceMask.IsValid())
+            {
+                const uint8* MaskRow = Tile.TraceMask->GetData() + (y - Tile.Rect.Min.Y) * Width;
+                for (int32 x = 0; x < Width; x++)
+                {
+                    Row[x] = FMath::Max(Row[x], MaskRow[x]);
+                }
+            }
+            else
+            {
+                FMemory::Memset(Row, 1, Width);
+            }
+        }
+    }
+    QueueRetraceTiles();
+}
+
+void FCollisionDebuggerView::SetTraceStride(int32 InStride)
+{
+    // Tiles are only as fine as the stride they were traced at.
+    if (InStride < TraceStride)
+    {
+        Scheduler.MarkAllDirty();
+    }
+    TraceStride = InStride;
+    Progressive.SetFinestStride(InStride);
+}
+
+void FCollisionDebuggerView::CompactPrimitiveIds()
+{
+    // Tiles in flight add primitives and write ids, they have to land first.
+    if (!PrimitiveIds.NeedsCompaction() || !TraceEngine.IsIdle())
+    {
+        return;
+    }
+
+    // Primitives hidden behind the nearest hit still live on in the response layers.
+    TBitArray<> Live(false, PrimitiveIds.GetTable().Num() + 1);
+    PrimitiveIds.MarkLive(Live);
+    ResponseMasks.MarkLivePrimitives(Live);
+
+    TArray<uint32> Remap;
+    PrimitiveIds.Compact(Live, Remap);
+    ResponseMasks.RemapPrimitives(Remap);
+}
+
+void FCollisionDebuggerView::ApplyTileSize()
+{
+    if (WantedTileSize == TileSize || !TraceEngine.IsIdle() || IsEncoding())
+    {
+        return;
+    }
+
+    TileSize = WantedTileSize;
+    Scheduler.SetTileSize(TileSize);
+
+    // Coarse samples would splat past the smaller tiles, the refinement starts over at a stride that fits.
+    if (Progressive.GetStride() > TileSize)
+    {
+        Progressive.Reset();
+        Scheduler.MarkAllDirty();
+    }
+    if (RetraceTiles.Num() > 0)
+    {
+        QueueRetraceTiles();
+    }
+}
+
+void FCollisionDebuggerView::QueueRetraceTiles()
+{
+    RetraceTiles.Reset();
+
+    const FIntPoint Size = PixelColors.GetSize();
+    for (int32 TileY = 0; TileY < Size.Y; TileY += TileSize)
+    {
+        for (int32 TileX = 0; TileX < Size.X; TileX += TileSize)
+        {
+            bool HasFlagged = false;
+            for (int32 y = TileY; y < FMath::Min(TileY + TileSize, Size.Y) && !HasFlagged; y++)
+            {
+                const uint8* Row = PixelNeedsTrace.GetData() + y * Size.X;
+                for (int32 x = TileX; x < FMath::Min(TileX + TileSize, Size.X); x++)
+                {
+                    if (Row[x])
+                    {
+                        HasFlagged = true;
+                        break;
+                    }
+                }
+            }
+
+            if (HasFlagged)
+            {
+                RetraceTiles.Add(FIntPoint(TileX, TileY));
+            }
+        }
+    }
+    Scheduler.SortByPriority(RetraceTiles);
+}
+
+int32 FCollisionDebuggerView::SubmitNextTile(const FInputRenderSettingsInternal& Settings, bool ChangedOnly)
+{
+    COLLISIONDEBUGGER_SCOPE(Submit);
+
+    ApplyLandedRects();
+
+    // Tiles in flight have to land before the tile grid can change.
+    if (WantedTileSize != TileSize)
+    {
+        return 0;
+    }
+
+    if (FocusPending)
+    {
+        FocusPending = false;
+        if (FocusHeldTileBack)
+        {
+            FocusHeldTileBack = false;
+        }
+        else if (const int32 NumFocusRays = SubmitFocusTile(Settings))
+        {
+            return NumFocusRays;
+        }
+    }
+
+    const int32 SizeX = PixelColors.GetSize().X;
+    const int32 SizeY = PixelColors.GetSize().Y;
+
+    // The focus window keeps the engine busy every tick, so progressive passes would never get to
+    // advance. The periphery of a foveated view is coarse already.
+    const bool UseProgressive = FCollisionDebuggerProgressiveRefinement::IsEnabled() && !IsFoveated();
+    if (RetraceTiles.Num() == 0 && UseProgressive)
+    {
+        // The next pass is picked from the results of the current one, so it has to land first.
+        if (!TraceEngine.IsIdle())
+        {
+            return 0;
+        }
+
+        if (!Progressive.IsActive() || !Progressive.Advance(PixelColors, PixelNeedsTrace))
+        {
+            // A new coarse to fine cycle retraces the whole view, so it waits for something to change.
+            if (ChangedOnly && !Scheduler.HasDirtyTiles())
+            {
+                Progressive.Reset();
+                return 0;
+            }
+            Progressive.Begin(FIntPoint(SizeX, SizeY), TileSize, PixelNeedsTrace);
+            Scheduler.ClearDirty();
+        }
+        QueueRetraceTiles();
+
+        if (RetraceTiles.Num() == 0)
+        {
+            return 0;
+        }
+    }
+    else if (Progressive.IsActive() && !UseProgressive)
+    {
+        Progressive.Reset();
+    }
+
+    FCollisionDebuggerTile Tile;
+    Tile.Camera = Camera;
+    Tile.Settings = Settings;
+    Tile.Mirror = Mirror;
+    int32 NumRays = 0;
+    bool FullTrace = true;
+
+    if (RetraceTiles.Num() > 0)
+    {
+        // Disoccluded pixels first, and only those. A tile still in flight is retraced once it landed.
+        auto GetRetraceRect = [this, SizeX, SizeY](const FIntPoint& TileMin)
+        {
+            FIntRect Rect(TileMin, TileMin + FIntPoint(TileSize));
+            Rect.Clip(FIntRect(0, 0, SizeX, SizeY));
+            return Rect;
+        };
+        const int32 Index = RetraceTiles.IndexOfByPredicate([this, &GetRetraceRect](const FIntPoint& TileMin) { return !IsHeldBack(GetRetraceRect(TileMin)); });
+        if (Index == INDEX_NONE)
+        {
+            return 0;
+        }
+        Tile.Rect = GetRetraceRect(RetraceTiles[Index]);
+        RetraceTiles.RemoveAt(Index, 1, false);
+
+        TSharedRef<TArray<uint8>, ESPMode::ThreadSafe> Mask = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>();
+        Mask->SetNumUninitialized(Tile.Rect.Area());
+        for (int32 y = Tile.Rect.Min.Y; y < Tile.Rect.Max.Y; y++)
+        {
+            uint8* Row = PixelNeedsTrace.GetData() + Tile.Rect.Min.X + y * SizeX;
+            FMemory::Memcpy(Mask->GetData() + (y - Tile.Rect.Min.Y) * Tile.Rect.Width(), Row, Tile.Rect.Width());
+            FMemory::Memzero(Row, Tile.Rect.Width());
+        }
+        for (uint8 Footprint : *Mask)
+        {
+            NumRays += Footprint ? 1 : 0;
+        }
+        Tile.TraceMask = Mask;
+        FullTrace = false;
+    }
+    else
+    {
+        if (!Scheduler.PickNextTile(Tile.Rect, ChangedOnly, [this](const FIntRect& Rect) { return IsHeldBack(Rect); }))
+        {
+            return 0;
+        }
+
+        for (int32 y = Tile.Rect.Min.Y; y < Tile.Rect.Max.Y; y++)
+        {
+            FMemory::Memzero(PixelNeedsTrace.GetData() + Tile.Rect.Min.X + y * SizeX, Tile.Rect.Width());
+        }
+        NumRays = Tile.Rect.Area();
+
+        const int32 Stride = GetFullTraceStride();
+        if (Stride > 1 || (IsFoveated() && FocusRect.Intersect(Tile.Rect)))
+        {
+            // Tiles start on multiples of the tile size, so the samples line up across tiles.
+            TSharedRef<TArray<uint8>, ESPMode::ThreadSafe> Mask = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>();
+            Mask->SetNumZeroed(Tile.Rect.Area());
+            NumRays = 0;
+            for (int32 y = 0; y < Tile.Rect.Height(); y += Stride)
+            {
+                for (int32 x = 0; x < Tile.Rect.Width(); x += Stride)
+                {
+                    const FIntPoint Sample = Tile.Rect.Min + FIntPoint(x, y);
+                    const FIntRect Square(Sample, Sample + FIntPoint(Stride));
+                    if (!IsFoveated() || !FocusRect.Intersect(Square))
+                    {
+                        (*Mask)[x + y * Tile.Rect.Width()] = uint8(Stride);
+                        NumRays++;
+                        continue;
+                    }
+
+                    // A coarse square would splat over the focus window, its pixels outside the window are traced one by one.
+                    for (int32 SquareY = y; SquareY < FMath::Min(y + Stride, Tile.Rect.Height()); SquareY++)
+                    {
+                        for (int32 SquareX = x; SquareX < FMath::Min(x + Stride, Tile.Rect.Width()); SquareX++)
+                        {
+                            if (!FocusRect.Contains(Tile.Rect.Min + FIntPoint(SquareX, SquareY)))
+                            {
+                                (*Mask)[SquareX + SquareY * Tile.Rect.Width()] = 1;
+                                NumRays++;
+                            }
+                        }
+                    }
+                }
+            }
+            Tile.TraceMask = Mask;
+        }
+    }
+
+    Scheduler.OnTileSubmitted(Tile.Rect, FullTrace);
+    InFlightRects.Add(Tile.Rect);
+    TraceEngine.SubmitTile(Tile, [this](const FCollisionDebuggerTile& TracedTile) { UploadTile(TracedTile); });
+
+    // An empty mask still used up the tile, report it as one ray so the caller keeps going.
+    return FMath::Max(NumRays, 1);
+}
+
+int32 FCollisionDebuggerView::SubmitFocusTile(const FInputRenderSettingsInternal& Settings)
+{
+    // Grid and retrace tiles write the same pixels, the window waits until the ones it overlaps landed.
+    if (NumFocusTilesInFlight > 0 || OverlapsInFlight(FocusRect))
+    {
+        return 0;
+    }
+
+    FCollisionDebuggerTile Tile;
+    Tile.Camera = Camera;
+    Tile.Settings = Settings;
+    Tile.Mirror = Mirror;
+    Tile.Rect = FocusRect;
+    Tile.Focus = true;
+
+    const int32 SizeX = PixelColors.GetSize().X;
+    for (int32 y = Tile.Rect.Min.Y; y < Tile.Rect.Max.Y; y++)
+    {
+        FMemory::Memzero(PixelNeedsTrace.GetData() + Tile.Rect.Min.X + y * SizeX, Tile.Rect.Width());
+    }
+
+    NumFocusTilesInFlight++;
+    InFlightRects.Add(Tile.Rect);
+    TraceEngine.SubmitTile(Tile, [this](const FCollisionDebuggerTile& TracedTile) { UploadTile(TracedTile); });
+    return Tile.Rect.Area();
+}
+
+bool FCollisionDebuggerView::OverlapsInFlight(const FIntRect& Rect) const
+{
+    return InFlightRects.ContainsByPredicate([&Rect](const FIntRect& InFlight) { return InFlight.Intersect(Rect); });
+}
+
+bool FCollisionDebuggerView::IsHeldBack(const FIntRect& Rect)
+{
+    if (!OverlapsInFlight(Rect))
+    {
+        return false;
+    }
+    FocusHeldTileBack |= IsFoveated() && InFlightRects.Contains(FocusRect) && FocusRect.Intersect(Rect);
+    return true;
+}
+
+void FCollisionDebuggerView::ApplyLandedRects()
+{
+    FIntRect Rect;
+    while (LandedRects.Dequeue(Rect))
+    {
+        InFlightRects.RemoveSingleSwap(Rect, false);
+    }
+}
+
+void FCollisionDebuggerView::UploadTile(const FCollisionDebuggerTile& Tile)
+{
+    // The tile lands once the hit buffer and the x-ray entries, when there are any, are both staged.
+    const bool UsesXRay = !XRayLayers.IsEmpty();
+    TSharedRef<std::atomic<int32>, ESPMode::ThreadSafe> NumStaging = MakeShared<std::atomic<int32>, ESPMode::ThreadSafe>(UsesXRay ? 2 : 1);
+    auto OnStaged = [this, NumStaging](const FIntRect& Rect)
+    {
+        if (--(*NumStaging) == 0)
+        {
+            LandedRects.Enqueue(Rect);
+        }
+    };
+
+    const bool Focus = Tile.Focus;
+    if (Focus)
+    {
+        NumFocusTilesInFlight--;
+    }
+    auto OnTileStaged = [this, Focus, OnStaged](const FIntRect& Rect, uint32 ContentHash)
+    {
+        if (!Focus)
+        {
+            Scheduler.OnTileTraced(Rect, ContentHash);
+        }
+        OnStaged(Rect);
+    };
+    if (!UploadPipeline.Submit(Tile.Rect, OnTileStaged))
+    {
+        OnTileStaged(Tile.Rect, 0);
+    }
+    TracedTiles.Enqueue(Tile);
+
+    if (UsesXRay)
+    {
+        if (!XRayEntryUpload.Submit(Tile.Rect, [OnStaged](const FIntRect& Rect, uint32 ContentHash) { OnStaged(Rect); }))
+        {
+            OnStaged(Tile.Rect);
+        }
+
+        TArray<FIntRect, TInlineAllocator<3>> PoolRects;
+        FCollisionDebuggerLayerBuffer::GetPoolRects(Tile.LayersBegin, Tile.LayersEnd, PoolRects);
+        for (const FIntRect& PoolRect : PoolRects)
+        {
+            XRayLayerUpload.Submit(PoolRect);
+        }
+    }
+}
+
+void FCollisionDebuggerView::UploadRect(const FIntRect& Rect)
+{
+    UploadPipeline.Submit(Rect);
+    if (!XRayLayers.IsEmpty())
+    {
+        XRayEntryUpload.Submit(Rect);
+    }
+}
+
+bool FCollisionDebuggerView::IsEncoding() const
+{
+    return UploadPipeline.IsEncoding() || XRayEntryUpload.IsEncoding() || XRayLayerUpload.IsEncoding();
+}
+
+bool FCollisionDebuggerView::GetHitAtPixel(int32 X, int32 Y, FCollisionDebuggerHitInfo& OutHit) const
+{
+    OutHit = FCollisionDebuggerHitInfo();
+
+    const FIntPoint Pixel(X, Y);
+    const FCollisionDebuggerRayTable* RayTable = TraceEngine.GetRayTable().Get();
+    if (!HasBufferCamera || !RayTable || !PrimitiveIds.IsValidPixel(Pixel))
+    {
+        return false;
+    }
+
+    const int32 Index = X + (Y * PixelColors.GetSize().X);
+    if (PixelNeedsTrace[Index])
+    {
+        return false;
+    }
+
+    const FLinearColor Hit = PixelColors.Get(Index);
+    if (Hit.A < 0.f)
+    {
+        return false;
+    }
+
+    OutHit.IsHit = true;
+    OutHit.Distance = float(Hit.A * FCollisionDebuggerTraceEngine::TraceLength);
+    OutHit.Normal = FVector(Hit.R, Hit.G, Hit.B);
+    OutHit.Location = BufferCamera.GetLocation() + BufferCamera.GetRotation().RotateVector(FVector(RayTable->GetDirection(X, Y))) * OutHit.Distance;
+
+    UPrimitiveComponent* Component = PrimitiveIds.GetTable().Get(PrimitiveIds.Get(Index));
+    if (Component)
+    {
+        OutHit.Component = Component;
+        OutHit.Actor = Component->GetOwner();
+        OutHit.ProfileName = Component->GetCollisionProfileName();
+        OutHit.ObjectType = UCollisionProfile::Get()->ReturnChannelNameFromContainerIndex(Component->GetCollisionObjectType());
+        OutHit.Description = FString::Printf(TEXT("%s's %s, profile %s"),
+            OutHit.Actor ? *OutHit.Actor->GetActorNameOrLabel() : TEXT("None"), *Component->GetName(), *OutHit.ProfileName.ToString());
+    }
+    return true;
+}
+
+bool FCollisionDebuggerView::GetPrimitiveBoundsUV(const UPrimitiveComponent* Component, FVector2D& OutMin, FVector2D& OutMax) const
+{
+    FIntRect Rect;
+    if (!Component || !PrimitiveIds.GetBounds(PrimitiveIds.GetTable().Find(Component), Rect))
+    {
+        return false;
+    }
+
+    const FVector2D Size(PixelColors.GetSize());
+    OutMin = FVector2D(Rect.Min) / Size;
+    OutMax = FVector2D(Rect.Max) / Size;
+    return true;
+}
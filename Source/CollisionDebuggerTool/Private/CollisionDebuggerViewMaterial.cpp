@@ -0,0 +1,126 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerViewMaterial.h"
+#include "Materials/Material.h"
+#include "Engine/Texture.h"
+
+#if WITH_EDITORONLY_DATA
+    #include "Materials/MaterialExpressionCustom.h"
+    #include "Materials/MaterialExpressionScalarParameter.h"
+    #include "Materials/MaterialExpressionTextureCoordinate.h"
+    #include "Materials/MaterialExpressionTextureObjectParameter.h"
+    #include "Materials/MaterialExpressionVectorParameter.h"
+#endif
+
+const FName FCollisionDebuggerViewMaterial::TextureParameter(TEXT("CollisionDebugTexture"));
+const FName FCollisionDebuggerViewMaterial::HitFormatParameter(TEXT("CollisionDebugHitFormat"));
+const FName FCollisionDebuggerViewMaterial::XRayParameter(TEXT("CollisionDebugXRay"));
+const FName FCollisionDebuggerViewMaterial::XRayLayerParameter(TEXT("CollisionDebugXRayLayer"));
+const FName FCollisionDebuggerViewMaterial::XRayEntriesParameter(TEXT("CollisionDebugXRayEntries"));
+const FName FCollisionDebuggerViewMaterial::XRayLayersParameter(TEXT("CollisionDebugXRayLayers"));
+const FName FCollisionDebuggerViewMaterial::TraceStrideParameter(TEXT("CollisionDebugTraceStride"));
+const FName FCollisionDebuggerViewMaterial::FocusRectParameter(TEXT("CollisionDebugFocusRect"));
+
+#if WITH_EDITORONLY_DATA
+namespace CollisionDebuggerViewMaterial
+{
+    static const TCHAR* ShaderPath = TEXT("/Plugin/CollisionDebuggerTool/Private/CollisionDebuggerView.ush");
+
+    template<typename ExpressionType>
+    static ExpressionType* AddExpression(UMaterial* Material)
+    {
+        ExpressionType* Expression = NewObject<ExpressionType>(Material);
+        Expression->Material = Material;
+        Material->GetExpressionCollection().AddExpression(Expression);
+        return Expression;
+    }
+
+    static UMaterialExpressionTextureObjectParameter* AddTextureParameter(UMaterial* Material, FName Name, UTexture* DefaultTexture)
+    {
+        UMaterialExpressionTextureObjectParameter* Parameter = AddExpression<UMaterialExpressionTextureObjectParameter>(Material);
+        Parameter->ParameterName = Name;
+        Parameter->Texture = DefaultTexture;
+        Parameter->SamplerType = SAMPLERTYPE_LinearColor;
+        return Parameter;
+    }
+
+    static UMaterialExpressionScalarParameter* AddScalarParameter(UMaterial* Material, FName Name, float DefaultValue)
+    {
+        UMaterialExpressionScalarParameter* Parameter = AddExpression<UMaterialExpressionScalarParameter>(Material);
+        Parameter->ParameterName = Name;
+        Parameter->DefaultValue = DefaultValue;
+        return Parameter;
+    }
+
+    static void AddInput(UMaterialExpressionCustom* Custom, const TCHAR* Name, UMaterialExpression* Expression)
+    {
+        FCustomInput& Input = Custom->Inputs.AddDefaulted_GetRef();
+        Input.InputName = Name;
+        Input.Input.Connect(0, Expression);
+    }
+
+    /** A vector parameter's first output is RGB, the node gets all four channels. */
+    static void AddVectorInput(UMaterialExpressionCustom* Custom, const TCHAR* Name, UMaterial* Material, FName ParameterName)
+    {
+        UMaterialExpressionVectorParameter* Parameter = AddExpression<UMaterialExpressionVectorParameter>(Material);
+        Parameter->ParameterName = ParameterName;
+        Parameter->DefaultValue = FLinearColor::Transparent;
+        AddInput(Custom, Name, Parameter);
+        Custom->Inputs.Last().Input.SetMask(1, 1, 1, 1, 1);
+    }
+}
+#endif
+
+bool FCollisionDebuggerViewMaterial::IsSupported()
+{
+#if WITH_EDITORONLY_DATA
+    return true;
+#else
+    return false;
+#endif
+}
+
+ECollisionDebuggerHitFormat FCollisionDebuggerViewMaterial::GetHitFormat()
+{
+    return IsSupported() ? FCollisionDebuggerHitBuffer::GetConfiguredFormat() : ECollisionDebuggerHitFormat::Float32;
+}
+
+UMaterialInterface* FCollisionDebuggerViewMaterial::Create(UObject* Outer, UTexture* DefaultTexture)
+{
+#if WITH_EDITORONLY_DATA
+    using namespace CollisionDebuggerViewMaterial;
+
+    if (!DefaultTexture)
+    {
+        return nullptr;
+    }
+
+    UMaterial* Material = NewObject<UMaterial>(Outer, TEXT("M_CollisionDebugView"), RF_Transient);
+    Material->MaterialDomain = MD_UI;
+
+    UMaterialExpressionTextureCoordinate* UV = AddExpression<UMaterialExpressionTextureCoordinate>(Material);
+
+    // Texture objects reach the node as Texture2D, the shader loads texels rather than sampling them.
+    UMaterialExpressionCustom* Custom = AddExpression<UMaterialExpressionCustom>(Material);
+    Custom->Inputs.Reset();
+    AddInput(Custom, TEXT("Hits"), AddTextureParameter(Material, TextureParameter, DefaultTexture));
+    AddInput(Custom, TEXT("UV"), UV);
+    AddInput(Custom, TEXT("HitFormat"), AddScalarParameter(Material, HitFormatParameter, 0.f));
+    AddInput(Custom, TEXT("XRay"), AddScalarParameter(Material, XRayParameter, 0.f));
+    AddInput(Custom, TEXT("XRayLayer"), AddScalarParameter(Material, XRayLayerParameter, -1.f));
+    AddInput(Custom, TEXT("XRayEntries"), AddTextureParameter(Material, XRayEntriesParameter, DefaultTexture));
+    AddInput(Custom, TEXT("XRayLayers"), AddTextureParameter(Material, XRayLayersParameter, DefaultTexture));
+    AddInput(Custom, TEXT("Stride"), AddScalarParameter(Material, TraceStrideParameter, 1.f));
+    AddVectorInput(Custom, TEXT("FocusRect"), Material, FocusRectParameter);
+    Custom->OutputType = CMOT_Float3;
+    Custom->IncludeFilePaths.Add(ShaderPath);
+    Custom->Code = TEXT("return CollisionDebuggerShowView(Hits, UV, int(HitFormat), XRay, int(XRayLayer), XRayEntries, XRayLayers, Stride, FocusRect);");
+
+    Material->GetEditorOnlyData()->EmissiveColor.Connect(0, Custom);
+    Material->PostEditChange();
+    return Material;
+#else
+    return nullptr;
+#endif
+}
@@ -0,0 +1,150 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerBVH.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace CollisionDebuggerBVHTest
+{
+    /** Entry time of the segment Origin + Direction * [0, MaxTime] into Box, or a negative value on a miss. */
+    static float IntersectBox(const FBox3f& Box, const FVector3f& Origin, const FVector3f& Direction, float MaxTime)
+    {
+        float Near = 0.f;
+        float Far = MaxTime;
+        for (int32 Axis = 0; Axis < 3; Axis++)
+        {
+            if (FMath::IsNearlyZero(Direction[Axis]))
+            {
+                if (Origin[Axis] < Box.Min[Axis] || Origin[Axis] > Box.Max[Axis])
+                {
+                    return -1.f;
+                }
+                continue;
+            }
+            const float T0 = (Box.Min[Axis] - Origin[Axis]) / Direction[Axis];
+            const float T1 = (Box.Max[Axis] - Origin[Axis]) / Direction[Axis];
+            Near = FMath::Max(Near, FMath::Min(T0, T1));
+            Far = FMath::Min(Far, FMath::Max(T0, T1));
+        }
+        return Near <= Far ? Near : -1.f;
+    }
+
+    static TArray<FBox3f> MakeBoxes(FRandomStream& Random, int32 Count)
+    {
+        TArray<FBox3f> Boxes;
+        for (int32 i = 0; i < Count; i++)
+        {
+            const FVector3f Center(Random.FRandRange(-5000.f, 5000.f), Random.FRandRange(-5000.f, 5000.f), Random.FRandRange(-1000.f, 1000.f));
+            const FVector3f Extent(Random.FRandRange(10.f, 300.f), Random.FRandRange(10.f, 300.f), Random.FRandRange(10.f, 300.f));
+            Boxes.Add(FBox3f(Center - Extent, Center + Extent));
+        }
+        return Boxes;
+    }
+
+    /**
+     * Traces random rays through the BVH and through every box, and counts the rays on which the
+     * nearest hit differs. Entry times are compared, not items, boxes may overlap.
+     */
+    static int32 CountMismatches(const FCollisionDebuggerBVH& BVH, TConstArrayView<FBox3f> Boxes, FRandomStream& Random, int32 NumRays)
+    {
+        const TArray<int32>& ItemOrder = BVH.GetItemOrder();
+        int32 NumMismatches = 0;
+        for (int32 i = 0; i < NumRays; i++)
+        {
+            // Some rays start inside a box, some along an axis.
+            const FVector3f Origin = i % 8 == 0 ? Boxes[Random.RandHelper(Boxes.Num())].GetCenter()
+                : FVector3f(Random.FRandRange(-6000.f, 6000.f), Random.FRandRange(-6000.f, 6000.f), Random.FRandRange(-2000.f, 2000.f));
+            const FVector3f Direction = i % 16 == 1 ? FVector3f::UnitX() : FVector3f(Random.GetUnitVector());
+            const FVector3f Segment = Direction * 20000.f;
+
+            float BruteTime = 1.f;
+            bool BruteHit = false;
+            for (const FBox3f& Box : Boxes)
+            {
+                const float Time = IntersectBox(Box, Origin, Segment, BruteTime);
+                if (Time >= 0.f)
+                {
+                    BruteTime = Time;
+                    BruteHit = true;
+                }
+            }
+
+            float Time = 1.f;
+            bool Hit = false;
+            BVH.Traverse(FCollisionDebuggerBVHRay(Origin, Segment), Time, [&](int32 First, int32 Count, float& InOutTime)
+            {
+                for (int32 Item = First; Item < First + Count; Item++)
+                {
+                    const float ItemTime = IntersectBox(Boxes[ItemOrder[Item]], Origin, Segment, InOutTime);
+                    if (ItemTime >= 0.f)
+                    {
+                        InOutTime = ItemTime;
+                        Hit = true;
+                    }
+                }
+            });
+
+            if (Hit != BruteHit || (Hit && !FMath::IsNearlyEqual(Time, BruteTime, 1e-5f)))
+            {
+                NumMismatches++;
+            }
+        }
+        return NumMismatches;
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCollisionDebuggerBVHTest, "CollisionDebugger.BVH.TraceMatchesBruteForce", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCollisionDebuggerBVHTest::RunTest(const FString& Parameters)
+{
+    using namespace CollisionDebuggerBVHTest;
+
+    FRandomStream Random(0xB74);
+    for (const int32 NumBoxes : { 1, 3, 5, 17, 1000 })
+    {
+        TArray<FBox3f> Boxes = MakeBoxes(Random, NumBoxes);
+
+        FCollisionDebuggerBVH BVH;
+        BVH.Build(Boxes);
+        TestFalse(FString::Printf(TEXT("%d boxes: built"), NumBoxes), BVH.IsEmpty());
+
+        TArray<int32> SortedOrder = BVH.GetItemOrder();
+        SortedOrder.Sort();
+        bool IsPermutation = SortedOrder.Num() == NumBoxes;
+        for (int32 i = 0; IsPermutation && i < NumBoxes; i++)
+        {
+            IsPermutation = SortedOrder[i] == i;
+        }
+        TestTrue(FString::Printf(TEXT("%d boxes: item order is a permutation"), NumBoxes), IsPermutation);
+
+        FBox3f AllBounds(ForceInit);
+        for (const FBox3f& Box : Boxes)
+        {
+            AllBounds += Box;
+        }
+        TestTrue(FString::Printf(TEXT("%d boxes: bounds"), NumBoxes), BVH.GetBounds().IsInsideOrOn(AllBounds.Min) && BVH.GetBounds().IsInsideOrOn(AllBounds.Max));
+
+        TestEqual(FString::Printf(TEXT("%d boxes: built, rays that disagree with brute force"), NumBoxes), CountMismatches(BVH, Boxes, Random, 2000), 0);
+
+        // Move every box a little, and some a lot, without rebuilding.
+        for (int32 i = 0; i < Boxes.Num(); i++)
+        {
+            const FVector3f Offset = i % 10 == 0 ? FVector3f(Random.FRandRange(-3000.f, 3000.f), 0.f, 0.f) : FVector3f(Random.GetUnitVector()) * 50.f;
+            Boxes[i] = Boxes[i].ShiftBy(Offset);
+        }
+        BVH.Refit(Boxes);
+        TestEqual(FString::Printf(TEXT("%d boxes: refit, rays that disagree with brute force"), NumBoxes), CountMismatches(BVH, Boxes, Random, 2000), 0);
+    }
+
+    FCollisionDebuggerBVH Empty;
+    Empty.Build(TConstArrayView<FBox3f>());
+    bool Visited = false;
+    float Time = 1.f;
+    Empty.Traverse(FCollisionDebuggerBVHRay(FVector3f::ZeroVector, FVector3f::UnitX()), Time, [&](int32, int32, float&) { Visited = true; });
+    TestFalse(TEXT("An empty BVH visits no leaf"), Visited);
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
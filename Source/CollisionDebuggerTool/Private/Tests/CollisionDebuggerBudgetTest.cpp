@@ -0,0 +1,127 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerDynamicResolution.h"
+#include "CollisionDebuggerFrameBudget.h"
+#include "CollisionDebuggerTestUtils.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCollisionDebuggerFrameBudgetTest, "CollisionDebugger.Budget.FrameBudget", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCollisionDebuggerFrameBudgetTest::RunTest(const FString& Parameters)
+{
+    FCollisionDebuggerScopedConsoleVariable FrameBudgetMs(TEXT("CollisionDebug.FrameBudgetMs"), TEXT("0"));
+    FCollisionDebuggerScopedConsoleVariable RayBudget(TEXT("CollisionDebug.RayBudget"), TEXT("0"));
+    FCollisionDebuggerScopedConsoleVariable TilesInFlight(TEXT("CollisionDebug.TilesInFlight"), TEXT("8"));
+
+    FCollisionDebuggerFrameBudget Budget;
+    Budget.Update(FCollisionDebuggerTraceStats());
+    TestFalse(TEXT("No budget"), FCollisionDebuggerFrameBudget::IsEnabled());
+    TestEqual(TEXT("No budget: tile size"), Budget.GetTileSize(), FCollisionDebuggerFrameBudget::MaxTileSize);
+    TestEqual(TEXT("No budget: tiles in flight"), Budget.GetMaxTilesInFlight(), 8);
+
+    // Tiles halve past two frames of rays and double once the doubled tile fits in half a frame.
+    struct FStep
+    {
+        const TCHAR* Rays;
+        int32 TileSize;
+        int32 TilesInFlight;
+    };
+    const FStep Steps[] =
+    {
+        { TEXT("20000"), 128, 2 },
+        { TEXT("10000"), 128, 1 },
+        { TEXT("8000"), 64, 2 },
+        { TEXT("40000"), 128, 3 },
+        { TEXT("1000000"), 256, 8 },
+        { TEXT("100"), FCollisionDebuggerFrameBudget::MinTileSize, 1 },
+    };
+    for (const FStep& Step : Steps)
+    {
+        RayBudget.Set(Step.Rays);
+        Budget.Update(FCollisionDebuggerTraceStats());
+        TestEqual(FString::Printf(TEXT("%s rays per frame: tile size"), Step.Rays), Budget.GetTileSize(), Step.TileSize);
+        TestEqual(FString::Printf(TEXT("%s rays per frame: tiles in flight"), Step.Rays), Budget.GetMaxTilesInFlight(), Step.TilesInFlight);
+    }
+
+    // A time budget turns into rays once the cost per ray is measured.
+    RayBudget.Set(TEXT("0"));
+    FrameBudgetMs.Set(TEXT("10"));
+    FCollisionDebuggerFrameBudget TimeBudget;
+    TimeBudget.Update(FCollisionDebuggerTraceStats());
+    TestEqual(TEXT("Unknown cost: one small tile per frame"), TimeBudget.GetRaysPerFrame(), int64(FCollisionDebuggerFrameBudget::MinTileSize * FCollisionDebuggerFrameBudget::MinTileSize));
+
+    FCollisionDebuggerTraceStats Stats;
+    Stats.NumRays = 100;
+    Stats.TraceSeconds = 100 * 1e-6;
+    TimeBudget.Update(Stats);
+    TestEqual(TEXT("Too few rays to measure the cost"), TimeBudget.GetSecondsPerRay(), 0.0);
+
+    Stats.NumRays = 4000;
+    Stats.TraceSeconds = 4000 * 1e-6;
+    TimeBudget.Update(Stats);
+    TestEqual(TEXT("Measured cost per ray"), TimeBudget.GetSecondsPerRay(), 1e-6, 1e-12);
+    TestTrue(TEXT("Rays per frame of the time budget"), FMath::Abs(TimeBudget.GetRaysPerFrame() - 10000) <= 1);
+
+    RayBudget.Set(TEXT("5000"));
+    TestEqual(TEXT("The smaller budget wins"), TimeBudget.GetRaysPerFrame(), int64(5000));
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCollisionDebuggerDynamicResolutionTest, "CollisionDebugger.Budget.DynamicResolution", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCollisionDebuggerDynamicResolutionTest::RunTest(const FString& Parameters)
+{
+    FCollisionDebuggerScopedConsoleVariable TargetMs(TEXT("CollisionDebug.DynamicResolution.TargetMs"), TEXT("250"));
+    const int64 NumPixels = 1000000;
+
+    FCollisionDebuggerDynamicResolution Resolution;
+    double Now = 0.0;
+    Resolution.Update(0, true, NumPixels, Now);
+    TestEqual(TEXT("Full resolution until the throughput is measured"), Resolution.GetStride(), 1);
+
+    // One second ticks, enough of them for the moving average to settle.
+    auto Feed = [&](double RaysPerSecond, int32 NumTicks)
+    {
+        for (int32 i = 0; i < NumTicks; i++)
+        {
+            Now += 1.0;
+            Resolution.Update(int64(RaysPerSecond), true, NumPixels, Now);
+        }
+    };
+
+    // A refresh takes NumPixels / Stride^2 rays, the target allows RaysPerSecond / 4.
+    Feed(1e6, 1);
+    TestEqual(TEXT("1M rays per second: throughput"), Resolution.GetRaysPerSecond(), 1e6, 1.0);
+    TestEqual(TEXT("1M rays per second"), Resolution.GetStride(), 2);
+
+    // Full resolution fits from 4M rays per second on, but only changes 25% past it.
+    Feed(4.5e6, 30);
+    TestEqual(TEXT("4.5M rays per second, stays"), Resolution.GetStride(), 2);
+    Feed(6e6, 30);
+    TestEqual(TEXT("6M rays per second"), Resolution.GetStride(), 1);
+    Feed(3.5e6, 30);
+    TestEqual(TEXT("3.5M rays per second, stays"), Resolution.GetStride(), 1);
+    Feed(2.5e6, 30);
+    TestEqual(TEXT("2.5M rays per second"), Resolution.GetStride(), 2);
+    Feed(1e5, 30);
+    TestEqual(TEXT("100k rays per second"), Resolution.GetStride(), FCollisionDebuggerDynamicResolution::MaxStride);
+
+    // Idle ticks don't count as slow ones.
+    const double RaysPerSecond = Resolution.GetRaysPerSecond();
+    for (int32 i = 0; i < 10; i++)
+    {
+        Now += 1.0;
+        Resolution.Update(0, false, NumPixels, Now);
+    }
+    TestEqual(TEXT("Idle ticks keep the throughput"), Resolution.GetRaysPerSecond(), RaysPerSecond);
+
+    TargetMs.Set(TEXT("0"));
+    Feed(1e5, 1);
+    TestEqual(TEXT("Disabled"), Resolution.GetStride(), 1);
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
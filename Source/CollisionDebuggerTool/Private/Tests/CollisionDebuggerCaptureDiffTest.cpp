@@ -0,0 +1,113 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerCaptureDiff.h"
+#include "CollisionDebuggerTraceEngine.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace CollisionDebuggerCaptureDiffTest
+{
+    static const FIntPoint Size(128, 128);
+    static const int32 TileSize = 32;
+
+    /** A floor straight below the camera, halfway down the trace. */
+    static void InitCapture(FCollisionDebuggerCapture& Capture, ECollisionDebuggerHitFormat Format)
+    {
+        Capture.Pixels.Init(Size, Format);
+        for (int32 i = 0; i < Capture.Pixels.Num(); i++)
+        {
+            Capture.Pixels.Set(i, FLinearColor(0.f, 0.f, 1.f, .5f));
+        }
+    }
+
+    static FLinearColor Tilted(float Degrees, float Time)
+    {
+        const FVector3f Normal = FVector3f::UnitZ().RotateAngleAxis(Degrees, FVector3f::UnitX());
+        return FLinearColor(Normal.X, Normal.Y, Normal.Z, Time);
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCollisionDebuggerCaptureDiffTest, "CollisionDebugger.CaptureDiff.Classify", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCollisionDebuggerCaptureDiffTest::RunTest(const FString& Parameters)
+{
+    using namespace CollisionDebuggerCaptureDiffTest;
+
+    const float UnitTime = float(1.0 / FCollisionDebuggerTraceEngine::TraceLength);
+    const FLinearColor Miss(-1.f, -1.f, -1.f, -1.f);
+
+    struct FChange
+    {
+        FIntPoint Pixel;
+        FLinearColor Base;
+        FLinearColor Test;
+        ECollisionDebuggerDiffKind Kind;
+    };
+    const FChange Changes[] =
+    {
+        { FIntPoint(1, 1), Miss, Tilted(0.f, .5f), ECollisionDebuggerDiffKind::Added },
+        { FIntPoint(2, 1), Tilted(0.f, .5f), Miss, ECollisionDebuggerDiffKind::Removed },
+        { FIntPoint(3, 1), Tilted(0.f, .5f), Tilted(180.f, .5f), ECollisionDebuggerDiffKind::Flipped },
+        { FIntPoint(4, 1), Tilted(0.f, .5f), Tilted(0.f, .5f + 100.f * UnitTime), ECollisionDebuggerDiffKind::Moved },
+        { FIntPoint(5, 1), Tilted(0.f, .5f), Tilted(20.f, .5f), ECollisionDebuggerDiffKind::Rotated },
+        { FIntPoint(6, 1), Tilted(0.f, .5f), Tilted(5.f, .5f + UnitTime), ECollisionDebuggerDiffKind::None },
+        { FIntPoint(7, 1), Miss, Miss, ECollisionDebuggerDiffKind::None },
+        { FIntPoint(100, 100), Miss, Tilted(0.f, .25f), ECollisionDebuggerDiffKind::Added },
+    };
+
+    for (const ECollisionDebuggerHitFormat TestFormat : { ECollisionDebuggerHitFormat::Float32, ECollisionDebuggerHitFormat::Packed64 })
+    {
+        const TCHAR* FormatName = TestFormat == ECollisionDebuggerHitFormat::Float32 ? TEXT("same format") : TEXT("mixed formats");
+
+        FCollisionDebuggerCapture Base;
+        FCollisionDebuggerCapture Test;
+        InitCapture(Base, ECollisionDebuggerHitFormat::Float32);
+        InitCapture(Test, TestFormat);
+        for (const FChange& Change : Changes)
+        {
+            const int32 Index = Change.Pixel.X + Change.Pixel.Y * Size.X;
+            Base.Pixels.Set(Index, Change.Base);
+            Test.Pixels.Set(Index, Change.Test);
+        }
+        Base.ComputeTileHashes(TileSize);
+        Test.ComputeTileHashes(TileSize);
+
+        FCollisionDebuggerDiffResult Result;
+        if (!TestTrue(FString::Printf(TEXT("%s: compared"), FormatName), FCollisionDebuggerCaptureDiff::Compare(Base, Test, FCollisionDebuggerDiffSettings(), Result)))
+        {
+            continue;
+        }
+
+        for (const FChange& Change : Changes)
+        {
+            const ECollisionDebuggerDiffKind Kind = ECollisionDebuggerDiffKind(Result.PixelKinds[Change.Pixel.X + Change.Pixel.Y * Size.X]);
+            TestEqual(FString::Printf(TEXT("%s: pixel %s"), FormatName, *Change.Pixel.ToString()),
+                FCollisionDebuggerCaptureDiff::GetKindName(Kind), FCollisionDebuggerCaptureDiff::GetKindName(Change.Kind));
+        }
+        TestEqual(FString::Printf(TEXT("%s: changed pixels"), FormatName), Result.GetNumChangedPixels(), 6);
+        TestEqual(FString::Printf(TEXT("%s: added pixels"), FormatName), Result.NumPixels[int32(ECollisionDebuggerDiffKind::Added)], 2);
+
+        // Tiles are only skipped on matching hashes, which needs both captures stored alike.
+        const bool SameFormat = TestFormat == ECollisionDebuggerHitFormat::Float32;
+        TestEqual(FString::Printf(TEXT("%s: skipped tiles"), FormatName), Result.NumTilesSkipped, SameFormat ? 14 : 0);
+
+        TestEqual(FString::Printf(TEXT("%s: regions"), FormatName), Result.Regions.Num(), 2);
+        if (Result.Regions.Num() == 2)
+        {
+            TestTrue(FString::Printf(TEXT("%s: first region"), FormatName), Result.Regions[0].Rect == FIntRect(1, 1, 6, 2));
+            TestTrue(FString::Printf(TEXT("%s: second region"), FormatName), Result.Regions[1].Rect == FIntRect(100, 100, 101, 101));
+        }
+    }
+
+    FCollisionDebuggerCapture Small;
+    FCollisionDebuggerCapture Large;
+    Small.Pixels.Init(FIntPoint(16, 16), ECollisionDebuggerHitFormat::Float32);
+    Large.Pixels.Init(FIntPoint(32, 16), ECollisionDebuggerHitFormat::Float32);
+    FCollisionDebuggerDiffResult Result;
+    TestFalse(TEXT("Captures of different sizes are not compared"), FCollisionDebuggerCaptureDiff::Compare(Small, Large, FCollisionDebuggerDiffSettings(), Result));
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
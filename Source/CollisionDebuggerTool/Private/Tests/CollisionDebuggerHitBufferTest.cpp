@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerHitBuffer.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace CollisionDebuggerHitBufferTest
+{
+    struct FFormatCase
+    {
+        ECollisionDebuggerHitFormat Format;
+        const TCHAR* Name;
+
+        /** Smallest dot product between a normal and its round trip. */
+        float MinNormalDot;
+
+        /** Largest hit time error of a round trip. */
+        float TimeTolerance;
+    };
+
+    static const FFormatCase Formats[] =
+    {
+        { ECollisionDebuggerHitFormat::Float32, TEXT("Float32"), 1.f - UE_KINDA_SMALL_NUMBER, 0.f },
+        { ECollisionDebuggerHitFormat::Packed32, TEXT("Packed32"), .995f, 1.f / 65534.f },
+        { ECollisionDebuggerHitFormat::Packed64, TEXT("Packed64"), .9999f, 1e-6f },
+    };
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCollisionDebuggerHitBufferTest, "CollisionDebugger.HitBuffer.RoundTrip", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCollisionDebuggerHitBufferTest::RunTest(const FString& Parameters)
+{
+    using namespace CollisionDebuggerHitBufferTest;
+
+    // Axes and the octahedron's fold are where oct encodings tend to break.
+    TArray<FVector3f> Normals = { FVector3f::UnitX(), -FVector3f::UnitX(), FVector3f::UnitY(), -FVector3f::UnitY(), FVector3f::UnitZ(), -FVector3f::UnitZ(),
+        FVector3f(1.f, 1.f, 0.f).GetSafeNormal(), FVector3f(-1.f, 1.f, -1.f).GetSafeNormal() };
+    FRandomStream Random(0x5EED);
+    for (int32 i = 0; i < 256; i++)
+    {
+        Normals.Add(FVector3f(Random.GetUnitVector()));
+    }
+    const float Times[] = { 0.f, 1e-4f, .25f, .5f, .999f, 1.f };
+
+    for (const FFormatCase& Case : Formats)
+    {
+        float WorstDot = 1.f;
+        float WorstTime = 0.f;
+        bool MissedHit = false;
+        uint8 Pixel[16];
+        for (const FVector3f& Normal : Normals)
+        {
+            for (const float Time : Times)
+            {
+                FCollisionDebuggerHitBuffer::Encode(Case.Format, FLinearColor(Normal.X, Normal.Y, Normal.Z, Time), Pixel);
+                const FLinearColor Decoded = FCollisionDebuggerHitBuffer::Decode(Case.Format, Pixel);
+                MissedHit |= Decoded.A < 0.f;
+                WorstDot = FMath::Min(WorstDot, FVector3f::DotProduct(Normal, FVector3f(Decoded.R, Decoded.G, Decoded.B)));
+                WorstTime = FMath::Max(WorstTime, FMath::Abs(Decoded.A - Time));
+            }
+        }
+        TestFalse(FString::Printf(TEXT("%s: a hit decodes as a miss"), Case.Name), MissedHit);
+        TestTrue(FString::Printf(TEXT("%s: normal error, worst dot %f"), Case.Name, WorstDot), WorstDot >= Case.MinNormalDot);
+        TestTrue(FString::Printf(TEXT("%s: hit time error, worst %g"), Case.Name, WorstTime), WorstTime <= Case.TimeTolerance);
+
+        FCollisionDebuggerHitBuffer::Encode(Case.Format, FLinearColor(-1, -1, -1, -1), Pixel);
+        TestTrue(FString::Printf(TEXT("%s: a miss decodes as a miss"), Case.Name), FCollisionDebuggerHitBuffer::Decode(Case.Format, Pixel).A < 0.f);
+
+        // Through the buffer, which starts out as misses and decodes ranges.
+        FCollisionDebuggerHitBuffer Buffer;
+        Buffer.Init(FIntPoint(4, 2), Case.Format);
+        TestEqual(FString::Printf(TEXT("%s: bytes per pixel"), Case.Name), Buffer.GetBytesPerPixel(), FCollisionDebuggerHitBuffer::GetBytesPerPixel(Case.Format));
+        TestTrue(FString::Printf(TEXT("%s: new pixels are misses"), Case.Name), Buffer.Get(7).A < 0.f);
+
+        const FLinearColor Hit(0.f, 0.f, 1.f, .5f);
+        Buffer.Set(1, Hit);
+        Buffer.SetMiss(2);
+        FLinearColor Range[3];
+        Buffer.DecodeRange(1, 3, Range);
+        TestTrue(FString::Printf(TEXT("%s: set pixel"), Case.Name), FMath::Abs(Range[0].A - Hit.A) <= Case.TimeTolerance && Range[0].B > Case.MinNormalDot);
+        TestTrue(FString::Printf(TEXT("%s: missed pixels"), Case.Name), Range[1].A < 0.f && Range[2].A < 0.f);
+    }
+
+    float WorstPackedDot = 1.f;
+    for (const FVector3f& Normal : Normals)
+    {
+        WorstPackedDot = FMath::Min(WorstPackedDot, FVector3f::DotProduct(Normal, FCollisionDebuggerHitBuffer::UnpackNormal(FCollisionDebuggerHitBuffer::PackNormal(Normal))));
+    }
+    TestTrue(FString::Printf(TEXT("PackNormal: worst dot %f"), WorstPackedDot), WorstPackedDot >= 1.f - 1e-6f);
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
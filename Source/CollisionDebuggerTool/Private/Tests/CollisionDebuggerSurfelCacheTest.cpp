@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionDebuggerSurfelCache.h"
+#include "CollisionDebuggerHitBuffer.h"
+#include "CollisionDebuggerTestUtils.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCollisionDebuggerSurfelCacheTest, "CollisionDebugger.SurfelCache.SaveLoadInvalidate", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FCollisionDebuggerSurfelCacheTest::RunTest(const FString& Parameters)
+{
+    const FString Directory = FPaths::AutomationTransientDir() / TEXT("CollisionDebugger");
+    const FString FilePath = Directory / TEXT("SurfelCacheTest.surfels");
+    const FString MapFilePath = Directory / TEXT("SurfelCacheTest.umap");
+    IFileManager::Get().Delete(*FilePath);
+    if (!TestTrue(TEXT("Writes the stand-in level file"), FFileHelper::SaveStringToFile(TEXT("level"), *MapFilePath)))
+    {
+        return false;
+    }
+
+    // Two surfels too far apart to merge in the cell of A, one in the cells of B and C.
+    const FVector A0(10.0, 10.0, 10.0);
+    const FVector A1(40.0, 40.0, 40.0);
+    const FVector B(1025.0, 25.0, 25.0);
+    const FVector C(-2025.0, -25.0, 25.0);
+    const FVector3f Normal = FVector3f::UnitZ();
+
+    {
+        FCollisionDebuggerSurfelCache Cache;
+        Cache.Open(FilePath, MapFilePath);
+        TestTrue(TEXT("Opens without a file"), Cache.IsOpen());
+        TestTrue(TEXT("Starts empty"), Cache.IsEmpty());
+
+        Cache.AddSurfel(A0, Normal, 0);
+        Cache.AddSurfel(A1, Normal, 0);
+        Cache.AddSurfel(A1 + FVector(1.0, 0.0, 0.0), Normal, 0);
+        Cache.AddSurfel(B, Normal, 0);
+        Cache.AddSurfel(C, Normal, 0);
+        TestEqual(TEXT("Close hits of a primitive merge"), Cache.FindCell(A0).Num(), 2);
+        Cache.Close();
+        TestFalse(TEXT("Closed"), Cache.IsOpen());
+    }
+    TestTrue(TEXT("Close saves the cache"), IFileManager::Get().FileExists(*FilePath));
+
+    {
+        FCollisionDebuggerSurfelCache Cache;
+        Cache.Open(FilePath, MapFilePath);
+        TestFalse(TEXT("Loads the saved cells"), Cache.IsEmpty());
+        TestEqual(TEXT("Surfels of A"), Cache.FindCell(A0).Num(), 2);
+        TestEqual(TEXT("Surfels of B"), Cache.FindCell(B).Num(), 1);
+        TestEqual(TEXT("Surfels of C"), Cache.FindCell(C).Num(), 1);
+        TestEqual(TEXT("No surfels elsewhere"), Cache.FindCell(FVector(500.0)).Num(), 0);
+
+        const TConstArrayView<FCollisionDebuggerSurfel> Surfels = Cache.FindCell(C);
+        if (Surfels.Num() == 1)
+        {
+            TestTrue(TEXT("Surfel position"), (FVector(Surfels[0].Offset) + FVector(-2050.0, -50.0, 0.0)).Equals(C, 1e-3));
+            TestTrue(TEXT("Surfel normal"), (FCollisionDebuggerHitBuffer::UnpackNormal(Surfels[0].Normal) | Normal) > .9999f);
+        }
+
+        Cache.Invalidate({ FBox(B - FVector(5.0), B + FVector(5.0)) });
+        TestEqual(TEXT("Invalidate drops the cell of B"), Cache.FindCell(B).Num(), 0);
+        TestEqual(TEXT("Invalidate keeps A"), Cache.FindCell(A0).Num(), 2);
+
+        // Cells of the file are dropped even when no cell may be copied into memory.
+        {
+            FCollisionDebuggerScopedConsoleVariable MaxCells(TEXT("CollisionDebug.SurfelCache.MaxCells"), TEXT("0"));
+            Cache.Invalidate({ FBox(A0, A1) });
+            TestEqual(TEXT("Invalidate past the cell cap drops the cell of A"), Cache.FindCell(A0).Num(), 0);
+
+            Cache.AddSurfel(FVector(500.0), Normal, 0);
+            TestEqual(TEXT("No new cell past the cell cap"), Cache.FindCell(FVector(500.0)).Num(), 0);
+        }
+    }
+
+    {
+        FCollisionDebuggerSurfelCache Cache;
+        Cache.Open(FilePath, MapFilePath);
+        TestEqual(TEXT("Invalidated A stays dropped"), Cache.FindCell(A0).Num(), 0);
+        TestEqual(TEXT("Invalidated B stays dropped"), Cache.FindCell(B).Num(), 0);
+        TestEqual(TEXT("C is kept"), Cache.FindCell(C).Num(), 1);
+    }
+
+    // A level saved after the cache makes it stale.
+    IFileManager::Get().SetTimeStamp(*MapFilePath, IFileManager::Get().GetTimeStamp(*MapFilePath) + FTimespan::FromHours(1.0));
+    {
+        FCollisionDebuggerSurfelCache Cache;
+        Cache.Open(FilePath, MapFilePath);
+        TestTrue(TEXT("Open, stale"), Cache.IsOpen());
+        TestTrue(TEXT("A stale cache is discarded"), Cache.IsEmpty());
+    }
+
+    IFileManager::Get().Delete(*FilePath);
+    IFileManager::Get().Delete(*MapFilePath);
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
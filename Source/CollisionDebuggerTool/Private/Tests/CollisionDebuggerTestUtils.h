@@ -0,0 +1,34 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/** Sets a console variable for as long as a test runs, then puts the old value back. */
+class FCollisionDebuggerScopedConsoleVariable
+{
+public:
+	FCollisionDebuggerScopedConsoleVariable(const TCHAR* Name, const TCHAR* Value)
+		: Variable(IConsoleManager::Get().FindConsoleVariable(Name))
+	{
+		check(Variable);
+		OldValue = Variable->GetString();
+		Variable->Set(Value, ECVF_SetByConsole);
+	}
+
+	~FCollisionDebuggerScopedConsoleVariable()
+	{
+		Variable->Set(*OldValue, ECVF_SetByConsole);
+	}
+
+	void Set(const TCHAR* Value) { Variable->Set(Value, ECVF_SetByConsole); }
+
+private:
+	IConsoleVariable* Variable;
+	FString OldValue;
+};
+
+#endif // WITH_DEV_AUTOMATION_TESTS
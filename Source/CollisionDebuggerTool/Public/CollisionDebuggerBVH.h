@@ -0,0 +1,140 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Four children of a wide BVH node, bounds stored as SoA so one ray tests all four at once.
+ *
+ * A child is an inner node when Child >= 0. Otherwise it is a leaf over Count items starting at
+ * ~Child in the item order. Unused children are a point far outside any world and never hit.
+ */
+struct alignas(16) FCollisionDebuggerBVHNode
+{
+	float MinX[4];
+	float MinY[4];
+	float MinZ[4];
+	float MaxX[4];
+	float MaxY[4];
+	float MaxZ[4];
+	int32 Child[4];
+	int32 Count[4];
+
+	static bool IsLeaf(int32 InChild) { return InChild < 0; }
+	void SetBounds(int32 Slot, const FBox3f& Bounds);
+	FBox3f GetBounds(int32 Slot) const;
+};
+
+/** A ray prepared for box tests, P = Origin + Direction * Time. */
+struct FCollisionDebuggerBVHRay
+{
+	FCollisionDebuggerBVHRay(const FVector3f& InOrigin, const FVector3f& InDirection);
+
+	FVector3f Origin;
+	FVector3f Direction;
+	VectorRegister4Float OriginX;
+	VectorRegister4Float OriginY;
+	VectorRegister4Float OriginZ;
+	VectorRegister4Float InvDirX;
+	VectorRegister4Float InvDirY;
+	VectorRegister4Float InvDirZ;
+};
+
+/**
+ * 4-wide bounding volume hierarchy over boxes.
+ *
+ * Built top down with a binned surface area heuristic into a binary tree, which is then
+ * collapsed so every node holds up to four children. Items are not stored, the owner keeps them
+ * in GetItemOrder order so leaves address contiguous ranges. Node 0 is the root, even when the
+ * whole tree is a single leaf. Refit recomputes the bounds of an unchanged topology bottom up,
+ * for items that moved.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerBVH
+{
+public:
+	static constexpr int32 MaxLeafItems = 4;
+
+	void Build(TConstArrayView<FBox3f> ItemBounds);
+	void Refit(TConstArrayView<FBox3f> ItemBounds);
+	void Reset();
+
+	bool IsEmpty() const { return Nodes.Num() == 0; }
+	FBox3f GetBounds() const { return Bounds; }
+
+	/** Position of every item in the leaves, ItemOrder[i] is the index passed to Build. */
+	const TArray<int32>& GetItemOrder() const { return ItemOrder; }
+
+	/**
+	 * Visits the leaves the ray passes through, near to far. Leaf(First, Count, InOutTime) tests
+	 * the items GetItemOrder()[First .. First + Count) and lowers InOutTime on a hit, which prunes
+	 * everything behind it.
+	 */
+	template<typename LeafFunctionType>
+	void Traverse(const FCollisionDebuggerBVHRay& Ray, float& InOutTime, LeafFunctionType&& Leaf) const;
+
+private:
+	/** Bitmask of the children the ray enters before MaxTime, with their entry times. OutEntry is 16 byte aligned. */
+	static int32 IntersectNode(const FCollisionDebuggerBVHNode& Node, const FCollisionDebuggerBVHRay& Ray, float MaxTime, float OutEntry[4]);
+
+	TArray<FCollisionDebuggerBVHNode> Nodes;
+	TArray<int32> ItemOrder;
+	FBox3f Bounds = FBox3f(ForceInit);
+};
+
+template<typename LeafFunctionType>
+void FCollisionDebuggerBVH::Traverse(const FCollisionDebuggerBVHRay& Ray, float& InOutTime, LeafFunctionType&& Leaf) const
+{
+	if (Nodes.Num() == 0)
+	{
+		return;
+	}
+
+	struct FStackEntry
+	{
+		int32 Child;
+		int32 Count;
+		float Entry;
+	};
+	TArray<FStackEntry, TInlineAllocator<64>> Stack;
+	Stack.Add({ 0, 0, 0.f });
+
+	while (Stack.Num() > 0)
+	{
+		const FStackEntry Entry = Stack.Pop(false);
+		if (Entry.Entry > InOutTime)
+		{
+			continue;
+		}
+		if (FCollisionDebuggerBVHNode::IsLeaf(Entry.Child))
+		{
+			Leaf(~Entry.Child, Entry.Count, InOutTime);
+			continue;
+		}
+
+		const FCollisionDebuggerBVHNode& Node = Nodes[Entry.Child];
+		alignas(16) float EntryTimes[4];
+		int32 HitMask = IntersectNode(Node, Ray, InOutTime, EntryTimes);
+
+		// Pushed far to near so the nearest child is popped first.
+		FStackEntry Hits[4];
+		int32 NumHits = 0;
+		while (HitMask)
+		{
+			const int32 Slot = FMath::CountTrailingZeros(uint32(HitMask));
+			HitMask &= HitMask - 1;
+
+			int32 Insert = NumHits++;
+			while (Insert > 0 && Hits[Insert - 1].Entry < EntryTimes[Slot])
+			{
+				Hits[Insert] = Hits[Insert - 1];
+				Insert--;
+			}
+			Hits[Insert] = { Node.Child[Slot], Node.Count[Slot], EntryTimes[Slot] };
+		}
+		for (int32 i = 0; i < NumHits; i++)
+		{
+			Stack.Add(Hits[i]);
+		}
+	}
+}
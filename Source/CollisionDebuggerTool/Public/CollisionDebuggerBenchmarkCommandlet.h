@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+
+// Reflection
+#include "CollisionDebuggerBenchmarkCommandlet.generated.h"
+
+/**
+ * Measures trace throughput of the collision debugger on real maps, headless.
+ *
+ * UnrealEditor-Cmd <Project> -run=CollisionDebuggerBenchmark [-Map=<map>[+<map>]] [-Size=512x512]
+ *     [-TileSizes=32+64+128+256] [-Workers=1+2+4+0] [-Channel=Visibility] [-Profile=BlockAll]
+ *     [-Iterations=3] [-Output=<file>]
+ *
+ * Every combination of map, channel or profile test, simple or complex collision, tile size and
+ * worker count traces the full view the way the subsystem does, with the tiles in flight capped
+ * by CollisionDebug.TilesInFlight. Rays per second, milliseconds per tile and the latency of a
+ * full refresh are written as JSON, by default to Saved/CollisionBenchmark. The default map is
+ * the plugin's example level, worker count 0 means every task worker.
+ */
+UCLASS()
+class COLLISIONDEBUGGERTOOL_API UCollisionDebuggerBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCollisionDebuggerBenchmarkCommandlet();
+
+	//------- UCommandlet--------
+	int32 Main(const FString& Params) override;
+	//------- UCommandlet--------
+};
@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionDebuggerTypes.h"
+#include "CollisionDebuggerHitBuffer.h"
+
+/**
+ * One traced view of a level saved to disk, as written by the capture commandlet.
+ *
+ * The binary file keeps the hit buffer in its storage format next to a CRC per tile, so two
+ * captures can be compared tile by tile without decoding them. EXR export decodes every pixel to
+ * RGBA32f with the same layout as the debug render target.
+ */
+struct COLLISIONDEBUGGERTOOL_API FCollisionDebuggerCapture
+{
+	static const TCHAR* const FileExtension;
+
+	FString MapName;
+	FTransform Camera;
+	FInputRenderSettingsInternal Settings;
+	FCollisionDebuggerHitBuffer Pixels;
+
+	/** CRC of every tile in raster order, see ComputeTileHashes. */
+	int32 TileSize = 64;
+	TArray<uint32> TileHashes;
+
+	void ComputeTileHashes(int32 InTileSize);
+	FIntPoint GetNumTiles() const;
+	FIntRect GetTileRect(int32 TileIndex) const;
+
+	bool SaveToFile(const FString& Path) const;
+	bool LoadFromFile(const FString& Path);
+	bool SaveToExr(const FString& Path) const;
+};
@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CollisionDebuggerTypes.h"
+#include "CollisionDebuggerHitBuffer.h"
+
+// Reflection
+#include "CollisionDebuggerCaptureCommandlet.generated.h"
+
+/**
+ * Traces collision snapshots of maps without a viewport, for build machines running -nullrhi.
+ *
+ * UnrealEditor-Cmd <Project> -run=CollisionDebuggerCapture -Map=/Game/Maps/A+/Game/Maps/B
+ *     [-Cameras=<file>] [-Channel=Visibility+Camera] [-Profile=BlockAll] [-TraceComplex]
+ *     [-Size=1024x1024] [-HitFormat=2] [-Output=<dir>] [-Exr] [-NoBinary]
+ *
+ * Cameras are read from a text file with one "X Y Z Pitch Yaw Roll" per line, and default to
+ * every player start of the map. Every camera is captured once per channel and profile, into
+ * <Output>/<Map>/<Camera>_<Test>.cdcap and optionally .exr.
+ */
+UCLASS()
+class COLLISIONDEBUGGERTOOL_API UCollisionDebuggerCaptureCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCollisionDebuggerCaptureCommandlet();
+
+	//------- UCommandlet--------
+	int32 Main(const FString& Params) override;
+	//------- UCommandlet--------
+
+	/** Traces one view of a loaded world on every task worker and blocks until it is done. */
+	static void TraceView(UWorld* World, const FTransform& Camera, const FInputRenderSettingsInternal& Settings, FCollisionDebuggerHitBuffer& OutPixels, int32 TileSize);
+
+	/** Loads a map with collision only, no rendering or gameplay. Release with UnloadWorld. */
+	static UWorld* LoadWorld(const FString& MapName);
+	static void UnloadWorld(UWorld* World);
+
+private:
+	struct FCaptureTest
+	{
+		FString Name;
+		FInputRenderSettingsInternal Settings;
+	};
+
+	static bool ParseCameras(const FString& Path, TArray<FTransform>& OutCameras);
+	static void GatherPlayerStarts(UWorld* World, TArray<FTransform>& OutCameras);
+};
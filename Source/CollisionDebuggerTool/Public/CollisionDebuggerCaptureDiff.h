@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionDebuggerCapture.h"
+
+/** How a pixel changed between two captures, in order of precedence. */
+enum class ECollisionDebuggerDiffKind : uint8
+{
+	None,
+
+	/** Missed before, hits now: a new blocker. */
+	Added,
+
+	/** Hit before, misses now: a missing wall. */
+	Removed,
+
+	/** The normal turned around. */
+	Flipped,
+
+	/** Hits at a different distance. */
+	Moved,
+
+	/** Hits at the same distance with a different normal. */
+	Rotated,
+
+	Num
+};
+
+struct FCollisionDebuggerDiffSettings
+{
+	/** Distance a hit may move, in world units, before it counts as changed. */
+	double DepthTolerance = 5.0;
+
+	/** Smallest normal dot product that still counts as the same surface. */
+	float NormalTolerance = .98f;
+};
+
+/** Connected changed tiles, with the pixel bounds of the changes inside them. */
+struct FCollisionDebuggerDiffRegion
+{
+	FIntRect Rect;
+	int32 NumPixels[int32(ECollisionDebuggerDiffKind::Num)] = {};
+};
+
+struct FCollisionDebuggerDiffResult
+{
+	FIntPoint Size = FIntPoint::ZeroValue;
+	int32 NumTilesSkipped = 0;
+	int32 NumTilesCompared = 0;
+	int32 NumPixels[int32(ECollisionDebuggerDiffKind::Num)] = {};
+
+	/** One ECollisionDebuggerDiffKind per pixel. */
+	TArray<uint8> PixelKinds;
+	TArray<FCollisionDebuggerDiffRegion> Regions;
+
+	int32 GetNumChangedPixels() const;
+	bool HasChanges() const { return Regions.Num() > 0; }
+};
+
+/**
+ * Compares two captures of the same view.
+ *
+ * Tiles whose CRCs match are skipped without touching their pixels, which is the common case
+ * between two builds. The rest is compared a row at a time, rows with identical bytes are skipped
+ * and the remaining pixels are classified with one vector register per pixel. Captures in
+ * different hit formats are compared on their decoded values.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerCaptureDiff
+{
+public:
+	static const TCHAR* GetKindName(ECollisionDebuggerDiffKind Kind);
+
+	/** False if the captures have different sizes and can't be compared. */
+	static bool Compare(const FCollisionDebuggerCapture& Base, const FCollisionDebuggerCapture& Test, const FCollisionDebuggerDiffSettings& Settings, FCollisionDebuggerDiffResult& OutResult);
+
+	/** The base capture shaded by distance, changed pixels colored by kind. */
+	static void MakeDiffImage(const FCollisionDebuggerCapture& Base, const FCollisionDebuggerDiffResult& Result, TArray<FColor>& OutImage);
+	static bool SaveDiffImage(const FCollisionDebuggerCapture& Base, const FCollisionDebuggerDiffResult& Result, const FString& Path);
+};
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+
+class AActor;
+class ULevel;
+class UPrimitiveComponent;
+class USceneComponent;
+class UWorld;
+enum class EUpdateTransformFlags : int32;
+
+/**
+ * Collects the world space bounds whose collision may have changed.
+ *
+ * Every primitive of the world is watched for transform and collision setting changes, and the
+ * world for spawned, destroyed and streamed actors. A changed primitive reports the bounds it had
+ * before the change as well as the new ones, so the space it left gets retraced too. Primitives
+ * that don't block queries report nothing. Game thread only.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerChangeTracker
+{
+public:
+	~FCollisionDebuggerChangeTracker();
+
+	/** True if CollisionDebug.Invalidation limits traces to tiles something changed in. */
+	static bool IsEnabled();
+
+	void Start(UWorld* InWorld);
+	void Stop();
+	bool IsTracking() const { return World.IsValid(); }
+
+	/** Moves the bounds collected since the last call into OutBounds. */
+	void ConsumeDirtyBounds(TArray<FBox>& OutBounds);
+
+	/** Moves the primitives that were added, removed or changed since the last call into OutPrimitives. */
+	void ConsumeChangedPrimitives(TArray<TWeakObjectPtr<UPrimitiveComponent>>& OutPrimitives);
+
+private:
+	struct FTrackedPrimitive
+	{
+		TWeakObjectPtr<UPrimitiveComponent> Component;
+
+		/** Bounds at the last change, invalid while the primitive has no query collision. */
+		FBox Bounds = FBox(ForceInit);
+	};
+
+	static FBox GetCollisionBounds(const UPrimitiveComponent* Component);
+
+	void TrackActor(AActor* Actor);
+	void ForgetActor(AActor* Actor);
+	void ForgetPrimitives(const TArray<FTrackedPrimitive>& Primitives);
+	void RefreshComponent(UPrimitiveComponent* Component);
+	void MarkDirty(const FBox& Bounds);
+
+	void OnActorSpawned(AActor* Actor);
+	void OnActorDestroyed(AActor* Actor);
+	void OnLevelAdded(ULevel* Level, UWorld* InWorld);
+	void OnLevelRemoved(ULevel* Level, UWorld* InWorld);
+	void OnTransformUpdated(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+	void OnCollisionSettingsChanged(UPrimitiveComponent* Component);
+#if WITH_EDITOR
+	void OnActorMoved(AActor* Actor);
+	void OnObjectPropertyChanged(UObject* Object, struct FPropertyChangedEvent& PropertyChangedEvent);
+#endif // WITH_EDITOR
+
+	TWeakObjectPtr<UWorld> World;
+	TMap<TWeakObjectPtr<AActor>, TArray<FTrackedPrimitive>> TrackedActors;
+	TArray<FBox> DirtyBounds;
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> ChangedPrimitives;
+
+	FDelegateHandle ActorSpawnedHandle;
+	FDelegateHandle ActorDestroyedHandle;
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
+#if WITH_EDITOR
+	FDelegateHandle ActorMovedHandle;
+	FDelegateHandle PropertyChangedHandle;
+#endif // WITH_EDITOR
+};
@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+
+// Reflection
+#include "CollisionDebuggerDiffCommandlet.generated.h"
+
+/**
+ * Compares two sets of captures written by CollisionDebuggerCapture, typically two builds.
+ *
+ * UnrealEditor-Cmd <Project> -run=CollisionDebuggerDiff -Base=<dir> -Test=<dir> [-Output=<dir>]
+ *     [-DepthTolerance=5] [-NormalTolerance=0.98] [-FailOnChange]
+ *
+ * Captures are paired by their path below Base and Test. Every changed pair gets a diff image
+ * next to its relative path in Output, and Output/CollisionDiff.json lists the changed regions
+ * of every pair. With -FailOnChange the commandlet fails when anything changed.
+ */
+UCLASS()
+class COLLISIONDEBUGGERTOOL_API UCollisionDebuggerDiffCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCollisionDebuggerDiffCommandlet();
+
+	//------- UCommandlet--------
+	int32 Main(const FString& Params) override;
+	//------- UCommandlet--------
+};
@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Picks the resolution the debug views are traced at so a full refresh takes about
+ * CollisionDebug.DynamicResolution.TargetMs, whatever a level costs to trace.
+ *
+ * Throughput is measured in rays per second of wall time while any view had work, so it includes
+ * everything that caps it, workers, budgets and tiles in flight alike. The resolution is a
+ * stride: full traces take one sample per Stride by Stride square and splat it over the square,
+ * the widget upscales them with CollisionDebuggerUpscale.ush. Game thread only.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerDynamicResolution
+{
+public:
+	static constexpr int32 MaxStride = 8;
+
+	static bool IsEnabled();
+
+	/**
+	 * Once per tick with the rays every view traced since the last call, whether any view still
+	 * had work and the pixels of all views together.
+	 */
+	void Update(int64 NumRays, bool Busy, int64 NumPixels);
+
+	/** Same, at a given time in seconds instead of now. */
+	void Update(int64 NumRays, bool Busy, int64 NumPixels, double Now);
+
+	/** 1 for full resolution, else a power of two up to MaxStride. */
+	int32 GetStride() const { return Stride; }
+
+	/** Measured rays per second, 0 until enough were traced. */
+	double GetRaysPerSecond() const { return RaysPerSecond; }
+
+private:
+	double RaysPerSecond = 0.0;
+	int32 Stride = 1;
+
+	double LastUpdateTime = -1.0;
+
+	/** Rays and busy time not yet folded into RaysPerSecond. */
+	int64 PendingRays = 0;
+	double PendingSeconds = 0.0;
+};
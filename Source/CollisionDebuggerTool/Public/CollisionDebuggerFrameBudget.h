@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionDebuggerTraceEngine.h"
+
+/**
+ * Holds what the collision debugger traces each frame to a fixed envelope.
+ *
+ * CollisionDebug.FrameBudgetMs caps the worker time spent tracing per frame, summed over the
+ * workers, and CollisionDebug.RayBudget caps the rays. The measured cost per ray turns the time
+ * budget into rays. Those set how many rays are submitted each frame, how large the tiles are
+ * and how many tiles are in flight, so no single tile costs much more than a frame's budget.
+ * Without a budget tiles stay at MaxTileSize and only CollisionDebug.TilesInFlight caps them.
+ * Game thread only.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerFrameBudget
+{
+public:
+	static constexpr int32 MinTileSize = 32;
+	static constexpr int32 MaxTileSize = 256;
+
+	static bool IsEnabled();
+
+	/** Feeds the stats of every trace engine since the last call, once per tick. */
+	void Update(const FCollisionDebuggerTraceStats& Stats);
+
+	/** Rays to submit this frame over all views, 0 without a budget. */
+	int64 GetRaysPerFrame() const;
+
+	/** Tile size that fits the budget, a power of two between MinTileSize and MaxTileSize. */
+	int32 GetTileSize() const { return TileSize; }
+
+	/** Enough tiles to keep a frame's rays queued, never more than CollisionDebug.TilesInFlight. */
+	int32 GetMaxTilesInFlight() const;
+
+	/** Measured worker seconds per ray, 0 until enough rays were traced. */
+	double GetSecondsPerRay() const { return SecondsPerRay; }
+
+private:
+	double SecondsPerRay = 0.0;
+	int32 TileSize = MaxTileSize;
+
+	/** Rays and time not yet folded into SecondsPerRay, single tiny tiles are too noisy. */
+	int64 PendingRays = 0;
+	double PendingSeconds = 0.0;
+};
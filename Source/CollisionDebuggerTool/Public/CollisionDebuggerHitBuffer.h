@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+
+/** Layout of one pixel of the hit buffer, on the CPU and in the debug render target. */
+enum class ECollisionDebuggerHitFormat : uint8
+{
+	/** RGBA32f, normal in RGB and hit time in A, -1 on a miss. 16 bytes. */
+	Float32,
+
+	/** RGBA8, oct encoded normal in RG and 16 bit hit time in BA (high, low). 4 bytes. */
+	Packed32,
+
+	/** RGBA16 unorm, oct encoded normal in RG and 32 bit hit time in BA (high, low). 8 bytes. */
+	Packed64,
+};
+
+/**
+ * Per pixel hit results of a debug view, stored in the format that is uploaded to the GPU.
+ *
+ * Every packed format keeps an all ones hit time as the miss sentinel. Pixels are read and written
+ * as FLinearColor(Normal, Time) with a negative time for a miss, whatever the storage format.
+ * Writes to different pixels may happen from different threads.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerHitBuffer
+{
+public:
+	static ECollisionDebuggerHitFormat GetConfiguredFormat();
+	static int32 GetBytesPerPixel(ECollisionDebuggerHitFormat InFormat);
+	static EPixelFormat GetPixelFormat(ECollisionDebuggerHitFormat InFormat);
+
+	/** Resizes the buffer, every pixel starts as a miss. Keeps the contents if nothing changed. */
+	void Init(FIntPoint InSize, ECollisionDebuggerHitFormat InFormat);
+	void Empty();
+
+	FIntPoint GetSize() const { return Size; }
+	int32 Num() const { return Size.X * Size.Y; }
+	ECollisionDebuggerHitFormat GetFormat() const { return Format; }
+	int32 GetBytesPerPixel() const { return BytesPerPixel; }
+	uint32 GetPitch() const { return uint32(Size.X * BytesPerPixel); }
+
+	uint8* GetData() { return Data.GetData(); }
+	const uint8* GetData() const { return Data.GetData(); }
+	SIZE_T GetAllocatedSize() const { return Data.GetAllocatedSize(); }
+
+	void Set(int32 Index, const FLinearColor& Value);
+	void SetMiss(int32 Index) { Set(Index, FLinearColor(-1, -1, -1, -1)); }
+	FLinearColor Get(int32 Index) const;
+
+	/** Decodes Count consecutive pixels starting at FirstIndex. */
+	void DecodeRange(int32 FirstIndex, int32 Count, FLinearColor* OutValues) const;
+
+	void CopyPixel(int32 DestIndex, int32 SourceIndex)
+	{
+		FMemory::Memcpy(Data.GetData() + DestIndex * BytesPerPixel, Data.GetData() + SourceIndex * BytesPerPixel, BytesPerPixel);
+	}
+
+	/** CRC of the raw bytes of a rectangle. */
+	uint32 HashRect(const FIntRect& Rect) const;
+
+	static void Encode(ECollisionDebuggerHitFormat InFormat, const FLinearColor& Value, uint8* OutPixel);
+	static FLinearColor Decode(ECollisionDebuggerHitFormat InFormat, const uint8* Pixel);
+
+	/** Oct encoded unit normal, 16 bits per component. */
+	static uint32 PackNormal(const FVector3f& Normal);
+	static FVector3f UnpackNormal(uint32 Packed);
+
+private:
+	FIntPoint Size = FIntPoint::ZeroValue;
+	ECollisionDebuggerHitFormat Format = ECollisionDebuggerHitFormat::Float32;
+	int32 BytesPerPixel = 16;
+	TArray<uint8> Data;
+};
@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionDebuggerHitBuffer.h"
+#include "CollisionDebuggerRayQuery.h"
+
+#include <atomic>
+
+/**
+ * X-ray layers of a debug view: every primitive the tested channel or profile blocks on along a
+ * pixel's ray, nearest first, so collision hidden behind other collision shows too.
+ *
+ * Pixels hold a variable number of layers. A 32 bit entry per pixel has the offset of the
+ * pixel's layers in one shared pool and their count, the pool packs the layers in the hit
+ * buffer's format, PoolWidth to a row. Both upload to textures as they are, see
+ * CollisionDebuggerXRay.ush. Traces append to the pool and the layers a retraced pixel leaves
+ * behind are only reclaimed by Compact. Pixels traced while the pool is full keep no layers.
+ * Writes to different pixels may happen from different threads.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerLayerBuffer
+{
+public:
+	static constexpr int32 PoolWidth = 1024;
+	static constexpr int32 MaxLayersPerPixel = 15;
+
+	/** Texture format of the entries, the low 16 bits of an entry in R and the high ones in G. */
+	static constexpr EPixelFormat EntryFormat = PF_G16R16;
+
+	static bool IsEnabled();
+	static int32 GetConfiguredLayers();
+
+	/** Resizes the buffer, every pixel starts without layers. */
+	void Init(FIntPoint InSize, int32 InMaxLayers, ECollisionDebuggerHitFormat InFormat);
+	void Empty();
+	bool IsEmpty() const { return Entries.Num() == 0; }
+
+	FIntPoint GetSize() const { return Size; }
+	int32 GetMaxLayers() const { return MaxLayers; }
+
+	/** Reserves NumLayers consecutive layers of the pool, INDEX_NONE once it is full. */
+	int32 Allocate(int32 NumLayers);
+
+	/** Writes the layers of a pixel at First, a pool offset reserved with Allocate. */
+	void Set(int32 Index, int32 First, const FCollisionDebuggerRayHit* InLayers, int32 InNumLayers);
+
+	/** The pixel's layers did not fit, it shows none until Compact made room and it was traced again. */
+	void SetOverflow(int32 Index) { Entries[Index] = OverflowEntry; }
+
+	/** The pixels share their layers from then on. */
+	void CopyPixel(int32 DestIndex, int32 SourceIndex) { Entries[DestIndex] = Entries[SourceIndex]; }
+
+	int32 GetNumLayers(int32 Index) const { return int32(Entries[Index] & CountMask); }
+
+	/** FLinearColor(Normal, Time) of one layer of a pixel. */
+	FLinearColor GetLayer(int32 Index, int32 Layer) const;
+
+	/** Drops the layers of every pixel. */
+	void Invalidate();
+
+	/** Most of the pool is used up, a quarter of it since the last compaction, or a trace ran out of it. */
+	bool NeedsCompaction() const;
+
+	/**
+	 * Game thread, nothing may read or write the buffer. Repacks the pool in pixel order and grows
+	 * it when the live layers would fill more than half of it.
+	 * @return number of pixels that are missing layers because the pool was full, 0 if the
+	 *         pool has no room for them anyway
+	 */
+	int32 Compact();
+
+	/** Entries of every pixel, laid out as EntryFormat. */
+	const uint8* GetEntryData() const { return reinterpret_cast<const uint8*>(Entries.GetData()); }
+	const FCollisionDebuggerHitBuffer& GetPool() const { return Pool; }
+
+	/** Pool texels of the layers [First, End), as at most three rectangles. */
+	static void GetPoolRects(int32 First, int32 End, TArray<FIntRect, TInlineAllocator<3>>& OutRects);
+
+	SIZE_T GetAllocatedSize() const { return Entries.GetAllocatedSize() + Pool.GetAllocatedSize(); }
+
+private:
+	static constexpr uint32 CountBits = 4;
+	static constexpr uint32 CountMask = (1u << CountBits) - 1;
+	static constexpr uint32 OverflowEntry = ~CountMask;
+
+	/** Largest pool, the height of a texture. */
+	static constexpr int32 MaxPoolRows = 16384;
+
+	FIntPoint Size = FIntPoint::ZeroValue;
+	int32 MaxLayers = 1;
+	TArray<uint32> Entries;
+	FCollisionDebuggerHitBuffer Pool;
+	std::atomic<int32> NumUsed{ 0 };
+	std::atomic<bool> Overflowed{ false };
+
+	/** Layers in use right after the last compaction. */
+	int32 NumCompacted = 0;
+};
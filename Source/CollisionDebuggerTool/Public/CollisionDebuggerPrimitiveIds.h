@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UPrimitiveComponent;
+
+/**
+ * Table of the primitives the debug view has hit, 0 means nothing. Ids stay put until Compact
+ * renumbers the table. Any thread may add primitives, lookups by id are game thread only.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerPrimitiveTable
+{
+public:
+	static constexpr uint32 NoPrimitive = 0;
+
+	/** Call from inside the physics query that returned the component. */
+	uint32 FindOrAdd(const UPrimitiveComponent* Component);
+
+	/** Id of a primitive that was hit this session, 0 if it never was. */
+	uint32 Find(const UPrimitiveComponent* Component) const;
+
+	/** Null if the id is unknown or the primitive was destroyed. */
+	UPrimitiveComponent* Get(uint32 Id) const;
+
+	int32 Num() const;
+	void Reset();
+
+	/**
+	 * Game thread, nothing may add primitives meanwhile. Drops the primitives whose id is not set
+	 * in Live and the destroyed ones, the others are renumbered in order. OutRemap maps every old
+	 * id to its new one, NoPrimitive for the dropped ones.
+	 */
+	void Compact(const TBitArray<>& Live, TArray<uint32>& OutRemap);
+
+private:
+	mutable FRWLock Lock;
+	TMap<TWeakObjectPtr<const UPrimitiveComponent>, uint32> Ids;
+	TArray<TWeakObjectPtr<const UPrimitiveComponent>> Primitives;
+};
+
+/**
+ * Which primitive every pixel of the debug view hit, next to the hit buffer.
+ *
+ * Lets hover, picking and highlighting answer from memory instead of tracing on the game thread.
+ * Writes to different pixels may happen from different threads.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerPrimitiveIds
+{
+public:
+	void Init(FIntPoint InSize);
+	void Empty();
+
+	FIntPoint GetSize() const { return Size; }
+	bool IsValidPixel(const FIntPoint& Pixel) const { return Pixel.X >= 0 && Pixel.Y >= 0 && Pixel.X < Size.X && Pixel.Y < Size.Y; }
+
+	void Set(int32 Index, uint32 Id) { Ids[Index] = Id; }
+	uint32 Get(int32 Index) const { return Ids[Index]; }
+	void CopyPixel(int32 DestIndex, int32 SourceIndex) { Ids[DestIndex] = Ids[SourceIndex]; }
+	TArrayView<uint32> GetIds() { return Ids; }
+
+	FCollisionDebuggerPrimitiveTable& GetTable() { return Table; }
+	const FCollisionDebuggerPrimitiveTable& GetTable() const { return Table; }
+
+	/** Pixel bounds of everything showing a primitive, false if it is not visible. */
+	bool GetBounds(uint32 Id, FIntRect& OutRect) const;
+
+	/** One byte per pixel of OutRect, set where the primitive shows. */
+	bool GetMask(uint32 Id, FIntRect& OutRect, TArray<uint8>& OutMask) const;
+
+	/** The table doubled since the last compaction, primitives no pixel shows anymore pile up in it. */
+	bool NeedsCompaction() const;
+
+	/** Sets the id of every pixel in OutLive, which is indexed by id. */
+	void MarkLive(TBitArray<>& OutLive) const;
+
+	/**
+	 * Game thread, nothing may write ids meanwhile. Compacts the table down to the ids in Live and
+	 * renumbers the pixels, OutRemap is for other buffers holding ids, see the table's Compact.
+	 */
+	void Compact(const TBitArray<>& Live, TArray<uint32>& OutRemap);
+
+private:
+	/** Primitives the table holds before it is worth compacting at all. */
+	static constexpr int32 MinCompactionSize = 1024;
+
+	FIntPoint Size = FIntPoint::ZeroValue;
+	TArray<uint32> Ids;
+	FCollisionDebuggerPrimitiveTable Table;
+
+	/** Primitives left in the table by the last compaction. */
+	int32 NumCompacted = 0;
+};
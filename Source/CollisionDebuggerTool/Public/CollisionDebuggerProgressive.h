@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionDebuggerHitBuffer.h"
+
+/**
+ * Coarse to fine refinement of a debug view.
+ *
+ * A pass first traces every Stride-th pixel and splats each sample over its block. Every
+ * following pass halves the stride, but only inside blocks whose corner samples disagree in
+ * hit/miss, normal or depth. Flat walls and open sky stay at the coarse samples.
+ * Passes are expressed as footprints in the per pixel NeedsTrace buffer, so the regular
+ * masked tile path traces them.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerProgressiveRefinement
+{
+public:
+	static bool IsEnabled();
+
+	/**
+	 * Flags the coarse grid of a new refinement, clearing anything else in NeedsTrace.
+	 * The stride is kept at or below TileSize, a sample only splats inside its own tile.
+	 */
+	void Begin(FIntPoint InSize, int32 TileSize, TArrayView<uint8> NeedsTrace);
+
+	/**
+	 * Call once the current pass has landed in Pixels. Flags the samples of the next finer pass.
+	 * @return false once the refinement is complete
+	 */
+	bool Advance(const FCollisionDebuggerHitBuffer& Pixels, TArrayView<uint8> NeedsTrace);
+
+	bool IsActive() const { return Stride > 0; }
+	int32 GetStride() const { return Stride; }
+	void Reset();
+
+	/** Refinement stops at this stride, the dynamic resolution's. Takes effect with the next pass. */
+	void SetFinestStride(int32 InStride) { FinestStride = FMath::Max(InStride, 1); }
+
+private:
+	bool BlockNeedsRefinement(const FCollisionDebuggerHitBuffer& Pixels, const FIntPoint& Block) const;
+
+	FIntPoint Size = FIntPoint::ZeroValue;
+	int32 Stride = 0;
+	int32 FinestStride = 1;
+	TArray<FIntPoint> ActiveBlocks;
+	TArray<FIntPoint> NextBlocks;
+};
@@ -0,0 +1,149 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionQueryParams.h"
+#include "WorldCollision.h"
+#include "CollisionDebuggerTypes.h"
+#include "CollisionDebuggerPrimitiveIds.h"
+
+/** Result of one ray of a batch. Time is the hit fraction along the ray, negative on a miss. */
+struct FCollisionDebuggerRayHit
+{
+	FVector3f Normal = FVector3f::ZeroVector;
+	float Time = -1.f;
+
+	/** Entry of the query's primitive table, 0 if the query has none or nothing was hit. */
+	uint32 PrimitiveId = 0;
+
+	bool IsHit() const { return Time >= 0.f; }
+};
+
+/**
+ * One primitive along a ray of a response query, 16 bytes.
+ *
+ * BlockMask has bit N set when the body hit blocks collision channel N, so the layer answers
+ * for every channel and profile at once. Bodies may override their component's responses.
+ */
+struct COLLISIONDEBUGGERTOOL_API FCollisionDebuggerResponseLayer
+{
+	/** Oct encoded normal, see FCollisionDebuggerHitBuffer::PackNormal. */
+	uint32 Normal = 0;
+
+	/** 24 bit unorm hit time in the high bits, object type of the primitive in the low byte. */
+	uint32 TimeAndObjectType = 0;
+
+	uint32 BlockMask = 0;
+	uint32 PrimitiveId = 0;
+
+	static FCollisionDebuggerResponseLayer Make(const FVector3f& InNormal, float InTime, ECollisionChannel InObjectType, uint32 InBlockMask, uint32 InPrimitiveId);
+
+	FVector3f GetNormal() const;
+	float GetTime() const;
+	uint32 GetObjectType() const { return TimeAndObjectType & 0xFF; }
+};
+
+/**
+ * What a channel or profile test blocks on, reduced to two masks.
+ *
+ * A primitive blocks the test when it blocks the test's channel and the test blocks the
+ * primitive's object type. Channel tests block every object type.
+ */
+struct COLLISIONDEBUGGERTOOL_API FCollisionDebuggerResponseFilter
+{
+	uint32 ChannelBit = 0;
+	uint32 BlockedObjectTypes = 0;
+
+	static FCollisionDebuggerResponseFilter Make(const FInputRenderSettingsInternal& Settings);
+
+	bool Blocks(uint32 BlockMask, uint32 ObjectType) const
+	{
+		return (BlockMask & ChannelBit) != 0 && (BlockedObjectTypes & (1u << (ObjectType & 31))) != 0;
+	}
+
+	bool Blocks(const FCollisionDebuggerResponseLayer& Layer) const
+	{
+		return Blocks(Layer.BlockMask, Layer.GetObjectType());
+	}
+
+	/** First layer the test blocks on, a miss if there is none. */
+	FCollisionDebuggerRayHit Resolve(const FCollisionDebuggerResponseLayer* Layers, int32 NumLayers) const;
+
+	bool operator==(const FCollisionDebuggerResponseFilter& Other) const
+	{
+		return ChannelBit == Other.ChannelBit && BlockedObjectTypes == Other.BlockedObjectTypes;
+	}
+};
+
+/**
+ * Line traces packets of rays that share an origin against one channel or profile.
+ *
+ * The channel, profile responses and query params are resolved once when the query is built,
+ * and every batch runs under a single physics scene read lock instead of one per ray. With a
+ * collision mirror the rays trace the mirror instead and never touch the physics scene.
+ * A built query is immutable and can be shared by all trace workers.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerRayQuery
+{
+public:
+	/** Hits are tagged with their entry in Primitives when one is given. */
+	FCollisionDebuggerRayQuery(const UWorld* InWorld, const FInputRenderSettingsInternal& Settings, FCollisionDebuggerPrimitiveTable* InPrimitives = nullptr, FCollisionDebuggerMirrorScenePtr InMirror = nullptr);
+
+	/** Traces Origin + Directions[i] * Length for every direction, writing OutHits[i]. */
+	void TraceBatch(const FVector& Origin, TConstArrayView<FVector3f> Directions, double Length, TArrayView<FCollisionDebuggerRayHit> OutHits) const;
+
+	/**
+	 * Traces the same rays as TraceBatch but keeps every primitive the test blocks on, nearest
+	 * first and the first one being TraceBatch's hit. OutLayers holds MaxLayers entries per
+	 * direction, OutNumLayers one count per direction. Always traces the physics scene.
+	 */
+	void TraceLayers(const FVector& Origin, TConstArrayView<FVector3f> Directions, double Length, int32 MaxLayers, TArrayView<FCollisionDebuggerRayHit> OutLayers, TArrayView<uint8> OutNumLayers) const;
+
+	/**
+	 * Game thread. Queues the ray as an async line trace by channel or profile for the world's
+	 * next async trace phase, Delegate is called with UserData once the result is in. Always
+	 * traces the physics scene. Hits are not tagged, the delegate resolves its own primitives.
+	 */
+	FTraceHandle TraceAsync(const FVector& Origin, const FVector3f& Direction, double Length, FTraceDelegate& Delegate, uint32 UserData) const;
+
+	bool IsValid() const { return World != nullptr; }
+
+private:
+	const UWorld* World = nullptr;
+	FCollisionDebuggerPrimitiveTable* Primitives = nullptr;
+	FCollisionDebuggerMirrorScenePtr Mirror;
+	ECollisionChannel TraceChannel = ECC_WorldStatic;
+
+	/** Profile of a profile test, None for channel tests. */
+	FName ProfileName;
+	FCollisionQueryParams QueryParams;
+	FCollisionResponseParams ResponseParams;
+	FCollisionDebuggerResponseFilter Filter;
+};
+
+/**
+ * Traces packets of rays against every object type and records, per ray, the primitives any
+ * channel or profile test could stop on, nearest first.
+ *
+ * A primitive is only kept when it blocks a channel for its object type that no nearer primitive
+ * of the same object type already blocks, so the kept layers resolve every test exactly until
+ * MaxLayers runs out. Only the trace complex setting of the query matters.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerResponseQuery
+{
+public:
+	FCollisionDebuggerResponseQuery(const UWorld* InWorld, const FInputRenderSettingsInternal& Settings, int32 InMaxLayers, FCollisionDebuggerPrimitiveTable* InPrimitives = nullptr);
+
+	int32 GetMaxLayers() const { return MaxLayers; }
+
+	/** OutLayers holds MaxLayers entries per direction, OutNumLayers one count per direction. */
+	void TraceBatch(const FVector& Origin, TConstArrayView<FVector3f> Directions, double Length, TArrayView<FCollisionDebuggerResponseLayer> OutLayers, TArrayView<uint8> OutNumLayers) const;
+
+private:
+	const UWorld* World = nullptr;
+	FCollisionDebuggerPrimitiveTable* Primitives = nullptr;
+	int32 MaxLayers = 1;
+	FCollisionQueryParams QueryParams;
+	FCollisionObjectQueryParams ObjectParams;
+};
@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Camera space ray directions for every pixel of a debug view.
+ *
+ * The directions only depend on the view size and field of view, so they are built once and
+ * every tile just rotates them into world space. Directions are stored as padded SoA rows so
+ * the rotation runs four rays at a time.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerRayTable
+{
+public:
+	/** Scale of the view plane at distance 1, the old per pixel "FovHack". */
+	static constexpr float DefaultFovScale = .7f;
+
+	FCollisionDebuggerRayTable(FIntPoint InSize, float InFovScale = DefaultFovScale);
+
+	FIntPoint GetSize() const { return Size; }
+	float GetFovScale() const { return FovScale; }
+	bool Matches(FIntPoint InSize, float InFovScale) const { return Size == InSize && FovScale == InFovScale; }
+
+	/** Writes the normalized world space directions of Count pixels of Row starting at MinX. */
+	void TransformRow(int32 Row, int32 MinX, int32 Count, const FQuat& Rotation, FVector3f* OutDirections) const;
+
+	/** Normalized camera space direction of a pixel (X forward, Y right, Z up). */
+	FVector3f GetDirection(int32 X, int32 Y) const;
+
+private:
+	FIntPoint Size;
+	float FovScale;
+	int32 Stride;
+
+	TArray<float, TAlignedHeapAllocator<16>> DirX;
+	TArray<float, TAlignedHeapAllocator<16>> DirY;
+	TArray<float, TAlignedHeapAllocator<16>> DirZ;
+};
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionDebuggerRayTable.h"
+#include "CollisionDebuggerHitBuffer.h"
+
+/**
+ * Moves a traced hit buffer from one camera to another without tracing.
+ *
+ * Every hit is rebuilt into a world position from its ray and hit time, projected into the new
+ * view and depth tested against the other hits landing on the same pixel. Misses are treated as
+ * hits at infinity and only follow the camera rotation. Pixels nothing lands on are disoccluded
+ * and get flagged for a retrace.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerReprojection
+{
+public:
+	/**
+	 * Reprojects Pixels in place. NeedsTrace flags pixels that hold no valid data: flagged
+	 * pixels are not used as a source and every pixel left without a source is flagged.
+	 * PrimitiveIds, when not empty, moves along with the hits.
+	 * @return number of pixels flagged for a retrace
+	 */
+	int32 Reproject(
+		FCollisionDebuggerHitBuffer& Pixels,
+		TArrayView<uint8> NeedsTrace,
+		const FCollisionDebuggerRayTable& RayTable,
+		const FTransform& OldCamera,
+		const FTransform& NewCamera,
+		double TraceLength,
+		TArrayView<uint32> PrimitiveIds = TArrayView<uint32>());
+
+	/** Pixel a camera space direction lands on, false if it is behind the camera or off screen. */
+	static bool ProjectDirection(const FVector& LocalDirection, const FCollisionDebuggerRayTable& RayTable, FIntPoint& OutPixel);
+
+	/**
+	 * Conservative rectangle of the view a world space box covers, the whole view if the box
+	 * straddles the camera plane. False if the box is behind the camera or off screen.
+	 */
+	static bool ProjectBounds(const FBox& Bounds, const FTransform& Camera, const FCollisionDebuggerRayTable& RayTable, FIntRect& OutRect);
+
+private:
+	TArray<uint8> SourcePixels;
+	TArray<int64> DepthKeys;
+	TArray<uint32> SourceIds;
+};
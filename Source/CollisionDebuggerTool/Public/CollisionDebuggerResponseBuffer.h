@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionDebuggerRayQuery.h"
+#include "CollisionDebuggerHitBuffer.h"
+
+/**
+ * Per pixel response layers of a debug view, traced once against every object type.
+ *
+ * With CollisionDebug.ResponseMask on, switching the tested channel or profile resolves the new
+ * hits from these layers instead of retracing the view. Pixels whose layers no longer belong to
+ * the buffer camera, after a reprojection or a trace complex change, are unknown and left alone
+ * by a resolve until they are traced again.
+ * Writes to different pixels may happen from different threads.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerResponseBuffer
+{
+public:
+	static bool IsEnabled();
+	static int32 GetConfiguredLayers();
+
+	/** Resizes the buffer, every pixel starts unknown. */
+	void Init(FIntPoint InSize, int32 InMaxLayers);
+	void Empty();
+	bool IsEmpty() const { return NumLayers.Num() == 0; }
+
+	FIntPoint GetSize() const { return Size; }
+	int32 GetMaxLayers() const { return MaxLayers; }
+
+	void Set(int32 Index, const FCollisionDebuggerResponseLayer* InLayers, int32 InNumLayers);
+	void CopyPixel(int32 DestIndex, int32 SourceIndex);
+
+	/** Marks every pixel unknown. */
+	void Invalidate();
+
+	/** Writes the hits of every known pixel for another channel or profile, without tracing. */
+	void Resolve(const FCollisionDebuggerResponseFilter& Filter, FCollisionDebuggerHitBuffer& OutPixels, FCollisionDebuggerPrimitiveIds* OutPrimitiveIds = nullptr) const;
+
+	/** Sets the primitive id of every layer of the known pixels in OutLive, which is indexed by id. */
+	void MarkLivePrimitives(TBitArray<>& OutLive) const;
+
+	/** Renumbers the primitive ids of the known pixels after the primitive table was compacted. */
+	void RemapPrimitives(TConstArrayView<uint32> Remap);
+
+	SIZE_T GetAllocatedSize() const { return Layers.GetAllocatedSize() + NumLayers.GetAllocatedSize(); }
+
+private:
+	static constexpr uint8 Unknown = 0xFF;
+
+	FIntPoint Size = FIntPoint::ZeroValue;
+	int32 MaxLayers = 1;
+
+	/** MaxLayers entries per pixel, nearest first. */
+	TArray<FCollisionDebuggerResponseLayer> Layers;
+	TArray<uint8> NumLayers;
+};
@@ -0,0 +1,198 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionDebuggerTypes.h"
+#include "CollisionDebuggerBVH.h"
+#include "CollisionDebuggerRayQuery.h"
+
+class UBodySetup;
+class UPrimitiveComponent;
+class UWorld;
+
+/**
+ * Collision geometry of one body at one scale, in the space of its component without the
+ * component's rotation and location. Scale is baked in.
+ *
+ * Spheres, boxes and capsules are tested one by one, triangles of trimeshes and convex hulls
+ * four at a time through a BVH over them. Hulls also keep their planes, triangles alone would
+ * let a ray starting inside a hull pass through its back faces.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerMirrorMesh
+{
+public:
+	struct FSphereShape
+	{
+		FVector3f Center;
+		float Radius;
+	};
+
+	struct FBoxShape
+	{
+		FVector3f Center;
+		FQuat4f Rotation;
+		FVector3f Extent;
+	};
+
+	/** Segment along the local Z axis of Rotation, HalfLength from the center to either sphere. */
+	struct FCapsuleShape
+	{
+		FVector3f Center;
+		FQuat4f Rotation;
+		float Radius;
+		float HalfLength;
+	};
+
+	/** Planes of a convex hull in HullPlanes, facing out. */
+	struct FHullShape
+	{
+		FBox3f Bounds;
+		int32 FirstPlane;
+		int32 NumPlanes;
+	};
+
+	void AddSphere(const FVector3f& Center, float Radius);
+	void AddBox(const FVector3f& Center, const FQuat4f& Rotation, const FVector3f& Extent);
+	void AddCapsule(const FVector3f& Center, const FQuat4f& Rotation, float Radius, float HalfLength);
+	void AddTriangle(const FVector3f& V0, const FVector3f& V1, const FVector3f& V2);
+
+	/** Triangles of a convex hull, three indices each. */
+	void AddHull(TConstArrayView<FVector3f> Vertices, TConstArrayView<int32> Indices);
+
+	/** Sorts the triangles into their BVH, call once all geometry was added. Any thread. */
+	void Build();
+
+	bool IsEmpty() const { return Spheres.Num() == 0 && Boxes.Num() == 0 && Capsules.Num() == 0 && NumTriangles == 0; }
+	const FBox3f& GetBounds() const { return Bounds; }
+
+	/**
+	 * Nearest hit of Origin + Direction * Time before InOutTime. Lowers InOutTime and sets the
+	 * normal, facing the ray, on a hit. A ray starting inside a shape hits at 0.
+	 */
+	bool Trace(const FVector3f& Origin, const FVector3f& Direction, float& InOutTime, FVector3f& OutNormal) const;
+
+private:
+	TArray<FSphereShape> Spheres;
+	TArray<FBoxShape> Boxes;
+	TArray<FCapsuleShape> Capsules;
+	TArray<FHullShape> Hulls;
+	TArray<FPlane4f> HullPlanes;
+
+	bool IsInsideHull(const FHullShape& Hull, const FVector3f& Point) const;
+	bool TraceTriangles(const FCollisionDebuggerBVHRay& Ray, int32 First, int32 Count, float& InOutTime, FVector3f& OutNormal) const;
+
+	/** Triangles as V0 and the edges to V1 and V2, one array per component, padded so four can always be loaded. */
+	TArray<float> Triangles[9];
+	int32 NumTriangles = 0;
+	FCollisionDebuggerBVH TriangleBVH;
+	FBox3f Bounds = FBox3f(ForceInit);
+};
+
+typedef TSharedPtr<const FCollisionDebuggerMirrorMesh, ESPMode::ThreadSafe> FCollisionDebuggerMirrorMeshPtr;
+
+/** One body of the mirror, where its mesh sits in the world. */
+struct FCollisionDebuggerMirrorInstance
+{
+	/** Null for a dead instance, and for a proxy traced through the component itself. */
+	const FCollisionDebuggerMirrorMesh* Mesh = nullptr;
+	bool IsProxy = false;
+
+	TWeakObjectPtr<UPrimitiveComponent> Component;
+	FQuat4f Rotation = FQuat4f::Identity;
+	FVector Location = FVector::ZeroVector;
+	FBox3f Bounds = FBox3f(ForceInit);
+};
+
+/**
+ * Immutable snapshot of the collision the tested channel or profile blocks on, shared by every
+ * trace worker.
+ *
+ * Bodies are instances of meshes through a BVH over their world bounds. Bodies the mirror can't
+ * hold, like landscapes, skeletal meshes or meshes without CPU side collision data, are proxies
+ * that trace the component's own physics bodies, only up to the nearest mirror hit so far.
+ *
+ * Traces resolve the weak component pointers of the bodies they hit, so tracing off the game
+ * thread needs the garbage collector held back with a FGCScopeGuard while the traces run.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerMirrorScene
+{
+public:
+	/** Nearest hit along Origin + Direction * Time for Time in [0, 1], OutComponent is what was hit. */
+	FCollisionDebuggerRayHit Trace(const FVector& Origin, const FVector3f& Direction, bool TraceComplex, const UPrimitiveComponent*& OutComponent) const;
+
+	int32 GetNumInstances() const { return Instances.Num(); }
+
+private:
+	friend class FCollisionDebuggerSceneMirror;
+
+	TArray<FCollisionDebuggerMirrorInstance> Instances;
+	TArray<FCollisionDebuggerMirrorMeshPtr> Meshes;
+	FCollisionDebuggerBVH InstanceBVH;
+};
+
+/**
+ * Keeps a mirror of the world's collision for the tested channel or profile, rays then skip the
+ * physics scene queries entirely. Off unless CollisionDebug.Backend is 1 and changes are tracked,
+ * never used for response masks.
+ *
+ * Moved bodies refit the instance BVH, added and removed ones rebuild it. Meshes are shared by
+ * every body with the same collision and scale and built in parallel. Every change publishes a
+ * new snapshot, tiles keep the one they were submitted with. Game thread only.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerSceneMirror
+{
+public:
+	static bool IsEnabled();
+
+	/**
+	 * Brings the mirror up to date with the primitives that changed since the last call, the
+	 * whole world is read again after the test changed. Without change tracking the mirror is off.
+	 */
+	void Update(UWorld* World, const FInputRenderSettingsInternal& Settings, TConstArrayView<TWeakObjectPtr<UPrimitiveComponent>> ChangedPrimitives, bool IsTracking);
+
+	/** Latest snapshot, null while the mirror is off. */
+	const FCollisionDebuggerMirrorScenePtr& GetScene() const { return Scene; }
+
+	void Reset();
+
+private:
+	struct FMeshKey
+	{
+		const UBodySetup* BodySetup = nullptr;
+		FVector3f Scale = FVector3f::OneVector;
+		bool Complex = false;
+
+		bool operator==(const FMeshKey& Other) const { return BodySetup == Other.BodySetup && Scale == Other.Scale && Complex == Other.Complex; }
+		friend uint32 GetTypeHash(const FMeshKey& Key) { return HashCombine(GetTypeHash(Key.BodySetup), HashCombine(GetTypeHash(Key.Scale), uint32(Key.Complex))); }
+	};
+
+	typedef TSharedPtr<FCollisionDebuggerMirrorMesh, ESPMode::ThreadSafe> FMeshPtr;
+
+	void Rebuild(UWorld* World);
+	void UpdateComponent(const TWeakObjectPtr<UPrimitiveComponent>& Primitive);
+	void AddInstances(UPrimitiveComponent* Component, TArray<FCollisionDebuggerMirrorInstance>& OutInstances);
+
+	/** Null if the body has to be traced through the physics scene. */
+	FMeshPtr FindOrAddMesh(const UBodySetup* BodySetup, const FVector& Scale);
+	bool IsRelevant(const UPrimitiveComponent* Component) const;
+	void BuildPendingMeshes();
+	void RebuildInstanceBVH();
+	void RefitInstanceBVH();
+	void Publish();
+
+	FInputRenderSettingsInternal Settings;
+	FCollisionDebuggerResponseFilter Filter;
+	bool HasSettings = false;
+
+	TArray<FCollisionDebuggerMirrorInstance> Instances;
+	TMap<TWeakObjectPtr<UPrimitiveComponent>, TArray<int32>> ComponentInstances;
+	FCollisionDebuggerBVH InstanceBVH;
+	bool TopologyChanged = false;
+	bool BoundsChanged = false;
+
+	TMap<FMeshKey, FMeshPtr> Meshes;
+	TArray<FCollisionDebuggerMirrorMesh*> PendingMeshes;
+
+	FCollisionDebuggerMirrorScenePtr Scene;
+};
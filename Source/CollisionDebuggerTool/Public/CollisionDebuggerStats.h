@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Trace/Trace.h"
+
+/**
+ * Everything the collision debugger costs, kept apart from the game's own stats.
+ * "stat CollisionDebugger" shows the group, -trace=cpu,CollisionDebugger adds the tool's
+ * scopes to an Insights capture.
+ */
+DECLARE_STATS_GROUP(TEXT("CollisionDebugger"), STATGROUP_CollisionDebugger, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Tick"), STAT_CollisionDebugger_Tick, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Submit Tiles"), STAT_CollisionDebugger_Submit, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Invalidate"), STAT_CollisionDebugger_Invalidate, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Reproject"), STAT_CollisionDebugger_Reproject, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Trace Row"), STAT_CollisionDebugger_TraceRow, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Encode Block"), STAT_CollisionDebugger_Encode, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Upload Block"), STAT_CollisionDebugger_Upload, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Async Traces"), STAT_CollisionDebugger_AsyncTraces, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Surfel Cache"), STAT_CollisionDebugger_SurfelCache, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Rays Traced"), STAT_CollisionDebugger_RaysTraced, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Tiles Traced"), STAT_CollisionDebugger_TilesTraced, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Tiles Dropped"), STAT_CollisionDebugger_TilesDropped, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Bytes Uploaded"), STAT_CollisionDebugger_BytesUploaded, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Tiles In Flight"), STAT_CollisionDebugger_TilesInFlight, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Rows Queued"), STAT_CollisionDebugger_RowsQueued, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Tile Size"), STAT_CollisionDebugger_TileSize, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Trace Stride"), STAT_CollisionDebugger_TraceStride, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Ray Budget"), STAT_CollisionDebugger_RayBudget, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Hit Ratio"), STAT_CollisionDebugger_HitRatio, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Ms Per Tile"), STAT_CollisionDebugger_MsPerTile, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Full Refresh Ms"), STAT_CollisionDebugger_RefreshLatency, STATGROUP_CollisionDebugger, COLLISIONDEBUGGERTOOL_API);
+
+UE_TRACE_CHANNEL_EXTERN(CollisionDebuggerChannel, COLLISIONDEBUGGERTOOL_API);
+
+/** Cycle stat and Insights scope of one collision debugger stage, Name is the STAT_CollisionDebugger_ suffix. */
+#define COLLISIONDEBUGGER_SCOPE(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_CollisionDebugger_##Name); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(CollisionDebugger_##Name, CollisionDebuggerChannel)
@@ -10,6 +10,12 @@
 #include "TextureResource.h"
 #include "RenderingThread.h"
 #include "Tasks/Task.h"
+#include "CollisionDebuggerTypes.h"
+#include "CollisionDebuggerView.h"
+#include "CollisionDebuggerFrameBudget.h"
+#include "CollisionDebuggerDynamicResolution.h"
+#include "CollisionDebuggerChangeTracker.h"
+#include "CollisionDebuggerSceneMirror.h"
 
 // Slate
 #include "Widgets/SWidget.h"
@@ -18,43 +24,8 @@
 // Reflection 
 #include "CollisionDebuggerSubsystem.generated.h"
 
-USTRUCT(BlueprintType)
-struct FInputRenderSettings
-{
-	GENERATED_BODY()
-
-public:
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collision Debugger Subsystem")
-	bool IsChannelTest = true;
-
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collision Debugger Subsystem")
-	bool TraceComplex = false;
-
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collision Debugger Subsystem")
-	FString ChannelName = "";
-
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collision Debugger Subsystem")
-	FString ProfileName = "";
-};
-
-USTRUCT()
-struct FInputRenderSettingsInternal
-{
-	GENERATED_BODY()
-
-public:
-	UPROPERTY(Transient)
-	bool bIsChannelTest = true;
-
-	UPROPERTY(Transient)
-	TEnumAsByte<ECollisionChannel> ChannelToTest = ECollisionChannel::ECC_WorldStatic;
-
-	UPROPERTY(Transient)
-	FName ProfileNameToTest = TEXT("");
-	
-	UPROPERTY(Transient)
-	bool TraceComplex = false;
-};
+struct FStreamableHandle;
+class UMaterialInterface;
 
 /**
  * TODO:
@@ -92,19 +63,56 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void SetRenderSettings(FInputRenderSettings NewSettings);
 
+	/** Debug views, one per local player in game worlds and one in the editor. */
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumViews() const;
+
+	/** The view of a local player, the first view for players without one. INDEX_NONE while nothing runs. */
+	UFUNCTION(BlueprintCallable)
+	int32 GetViewForPlayer(APlayerController* PlayerController) const;
+
+	UFUNCTION(BlueprintCallable)
+	UTextureRenderTarget2D* GetViewRenderTarget(int32 ViewIndex) const;
+
+	/** What a pixel of a debug view hit, without tracing. False for misses and untraced pixels. */
+	UFUNCTION(BlueprintCallable)
+	bool GetHitAtPixel(int32 ViewIndex, int32 X, int32 Y, FCollisionDebuggerHitInfo& OutHit) const;
+
+	/** GetHitAtPixel with UV in 0..1 over the debug view, for hover and picking in the widget. */
+	UFUNCTION(BlueprintCallable)
+	bool GetHitAtUV(int32 ViewIndex, FVector2D UV, FCollisionDebuggerHitInfo& OutHit) const;
+
+	/** UV bounds of everything a debug view shows of a primitive, to outline it. */
+	UFUNCTION(BlueprintCallable)
+	bool GetPrimitiveBoundsUV(int32 ViewIndex, UPrimitiveComponent* Component, FVector2D& OutMin, FVector2D& OutMax) const;
+
+	/**
+	 * Layer the widgets show while CollisionDebug.XRay is on, 0 for the nearest collision along
+	 * each pixel. -1 blends every layer front to back.
+	 */
+	UFUNCTION(BlueprintCallable)
+	void SetXRayLayer(int32 Layer);
+
+	static TArray<FString> GetCollisionProfileNames();
+	static TArray<FString> GetCollisionChannelNames();
+
+	/** Looks up the channel and profile by name. Unknown channels test WorldStatic, unknown profiles the first one. */
+	static FInputRenderSettingsInternal ResolveRenderSettings(const FInputRenderSettings& NewSettings);
+
+	static void AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector);
+
 private:
 	// ------------ Running --------------
-	UPROPERTY(Transient)
-	TObjectPtr<class UTextureRenderTarget2D> DebugRenderTarget = nullptr;
-
-	UPROPERTY(Transient)
-	TArray<FLinearColor> PixelColors;
 
+	/** Streamed in when the tool first starts, views get their widget once it is loaded. */
 	UPROPERTY(Transient)
 	UClass* CollisionDebugMainWidgetClass = nullptr;
 
+	TSharedPtr<FStreamableHandle> AssetLoadHandle;
+
+	/** Material the widgets draw the views with, see FCollisionDebuggerViewMaterial. Null where it can't be built. */
 	UPROPERTY(Transient)
-	class UUserWidget* CollisionDebugMainWidget = nullptr;
+	TObjectPtr<UMaterialInterface> ViewMaterial = nullptr;
 
 	UPROPERTY(Transient)
 	bool ShouldRun = false;
@@ -112,45 +120,83 @@ private:
 	UPROPERTY(Transient)
 	bool StopHasStarted = false;
 
+	/** Render targets of removed views, sized by CollisionDebug.ResolutionX and Y when they are reused. */
 	UPROPERTY(Transient)
-	int32 IndexX = 0;
+	TArray<TObjectPtr<UTextureRenderTarget2D>> RenderTargetPool;
 
-	UPROPERTY(Transient)
-	int32 IndexY = 0;
+	FDelegateHandle PIECallbackHandle;
 
+	// ------------ Views --------------
 
-	TSharedPtr<SWidget> CreatedSlateWidget = nullptr;
-	const int32 UpdateSize = 256;
-	UE::Tasks::FTask Task;
-	FDelegateHandle PIECallbackHandle;
+	TArray<TUniquePtr<FCollisionDebuggerView>> Views;
+
+	/** Removed views whose cancelled tiles have not drained yet. */
+	TArray<TUniquePtr<FCollisionDebuggerView>> RetiringViews;
+
+	/**
+	 * Views of the last run, kept with their buffers and render target while the tool is off so
+	 * starting it again only has to add the widgets back. Their cancelled tiles drain in the meantime.
+	 */
+	TArray<TUniquePtr<FCollisionDebuggerView>> ParkedViews;
+
+	/** View that gets the first tile of the next tick, rotates so every view gets to go first. */
+	int32 FirstViewToSubmit = 0;
+
+	/** See SetXRayLayer. */
+	int32 XRayLayer = -1;
+
+	/** Rays, tile size and tiles in flight of every view together. */
+	FCollisionDebuggerFrameBudget FrameBudget;
+
+	/** Trace stride of every view, from the measured rays per second. */
+	FCollisionDebuggerDynamicResolution DynamicResolution;
+
+	// ------------ Invalidation --------------
+
+	FCollisionDebuggerChangeTracker ChangeTracker;
+
+	/** Collision the views trace instead of the physics scene, see CollisionDebug.Backend. */
+	FCollisionDebuggerSceneMirror SceneMirror;
+
+	/** What the views traced, kept per level on disk, see CollisionDebug.SurfelCache. */
+	FCollisionDebuggerSurfelCache SurfelCache;
+
+	// ------------ Stats --------------
+
+	/** Time the current refresh started, negative while the view is up to date. */
+	double RefreshStartTime = -1.0;
 
 // ------------ Rendering --------------
 
 	FInputRenderSettingsInternal CurrentRenderSettings;
 
 private:
-	 void UpdateTextureRegion(
-		 FTexture2DRHIRef TextureRHI,
-		 int32 MipIndex,
-		 uint32 NumRegions,
-		 FUpdateTextureRegion2D Region,
-		 uint32 SrcPitch,
-		 uint32 SrcBpp,
-		 uint8* SrcData,
-		 TFunction<void(uint8* SrcData)> DataCleanupFunc = [](uint8*) {}
-	 );
-
 	 void SetupAssets();
+	 void OnAssetsLoaded();
 	 void CleanupAndClear();
 	 void CheckState();
-	 void SetupWidget();
 	 bool ShouldTickOrRun();
-	 void RemoveEditorWidget();
 	 void StartCollisionDebug();
 	 void StopCollisionDebug();
 
-	 //GPU
-	 void UpdateTexture(FTransform trans, FUpdateTextureRegion2D region, FInputRenderSettingsInternal TileRenderSettings);
+	 void UpdateViews();
+	 void CreateView(APlayerController* PlayerController);
+	 void RetireView(int32 ViewIndex);
+	 void ParkView(int32 ViewIndex);
+	 TUniquePtr<FCollisionDebuggerView> UnparkView(APlayerController* PlayerController);
+	 void DestroyRetiredViews(bool Wait);
+	 int32 FindViewIndex(const APlayerController* PlayerController) const;
+	 UTextureRenderTarget2D* AcquireRenderTarget();
+	 void ReleaseRenderTarget(UTextureRenderTarget2D* RenderTarget);
+
+	 //UI
+	 void SetupWidget(FCollisionDebuggerView& View);
+	 void RemoveWidget(FCollisionDebuggerView& View);
+	 void BindWidgetTexture(FCollisionDebuggerView& View);
+
+	 void InvalidateChangedTiles(TArray<FBox>& OutDirtyBounds);
+	 void SubmitTiles(TArray<FCollisionDebuggerView*>& ReadyViews);
+	 void UpdateStats();
 
 	 //Callback
 	 void OnPreEndPIE(const bool bIsSimulating);
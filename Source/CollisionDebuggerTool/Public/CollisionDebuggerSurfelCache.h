@@ -0,0 +1,180 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionDebuggerTypes.h"
+
+class FCollisionDebuggerHitBuffer;
+class FCollisionDebuggerPrimitiveIds;
+class FCollisionDebuggerRayTable;
+class IMappedFileHandle;
+class IMappedFileRegion;
+class UPrimitiveComponent;
+class UWorld;
+
+/** One traced surface point, also the layout on disk. 20 bytes. */
+struct FCollisionDebuggerSurfel
+{
+	/** Relative to the minimum corner of the surfel's cell. */
+	FVector3f Offset;
+
+	/** Oct encoded, see FCollisionDebuggerHitBuffer::PackNormal. */
+	uint32 Normal;
+
+	/** Entry of the cache's primitive path table. */
+	uint32 Primitive;
+};
+
+/**
+ * What the debug views traced so far, as surfels in a sparse world space hash grid, so a view
+ * that starts or jumps is splatted from the cache and only traces where the cache has nothing.
+ *
+ * The grid is kept per level and per tested channel or profile in a file under Saved. The file
+ * holds the cells sorted by key and is memory mapped when it is opened, only cells that are
+ * changed get copied into memory. Closing writes the merged grid back. Cells are dropped when
+ * the change tracker reports a change inside them, a cache whose level was saved since the file
+ * was written is discarded. Off unless CollisionDebug.SurfelCache is 1. Game thread only, Splat
+ * spreads its work over the task graph.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerSurfelCache
+{
+public:
+	static constexpr double CellSize = 50.0;
+	static constexpr int32 MaxSurfelsPerCell = 8;
+
+	static bool IsEnabled();
+
+	~FCollisionDebuggerSurfelCache();
+
+	/** Opens the cache of the world's level and the tested channel or profile, saving the one open before. */
+	void Update(UWorld* InWorld, const FInputRenderSettingsInternal& Settings);
+
+	/**
+	 * Opens the cache file at InFilePath for the level saved at InMapFilePath, saving the one open
+	 * before. Update picks both from the world.
+	 */
+	void Open(const FString& InFilePath, const FString& InMapFilePath, int32 InPIEInstance = INDEX_NONE);
+
+	/** Saves and closes the cache. */
+	void Close();
+
+	bool IsOpen() const { return !FilePath.IsEmpty(); }
+	bool IsEmpty() const { return NumBaseCells == 0 && Slots.Num() == 0; }
+
+	/**
+	 * Adds the hits of a traced rectangle of a view, Camera being the camera the tile was traced
+	 * from. Only pixels flagged in Mask are real samples, a null mask takes all of them. Only hits
+	 * on static primitives loaded with the level are kept.
+	 */
+	void AddHits(const FCollisionDebuggerHitBuffer& Pixels, const FCollisionDebuggerPrimitiveIds& PrimitiveIds, const FIntRect& Rect,
+		const TArray<uint8>* Mask, const FTransform& Camera, const FCollisionDebuggerRayTable& RayTable, double TraceLength);
+
+	/** Drops every cell overlapping one of the boxes, whatever CollisionDebug.SurfelCache.MaxCells says. */
+	void Invalidate(TConstArrayView<FBox> Bounds);
+
+	/** Surfels of the cell holding Position, empty where the cache has none. */
+	TConstArrayView<FCollisionDebuggerSurfel> FindCell(const FVector& Position) const;
+
+	/**
+	 * Splats every surfel within trace length in front of Camera into the view, nearest first. Pixels the cache
+	 * covers are written and cleared in NeedsTrace, the others are flagged. Splatted pixels are
+	 * only an estimate, the caller still has them traced.
+	 * @return number of pixels flagged for a trace
+	 */
+	int32 Splat(FCollisionDebuggerHitBuffer& Pixels, FCollisionDebuggerPrimitiveIds& PrimitiveIds, TArrayView<uint8> NeedsTrace,
+		const FTransform& Camera, const FCollisionDebuggerRayTable& RayTable, double TraceLength);
+
+private:
+#if WITH_DEV_AUTOMATION_TESTS
+	friend class FCollisionDebuggerSurfelCacheTest;
+#endif
+
+	/** Cell table entry of the file. */
+	struct FFileCell
+	{
+		uint64 Key;
+		uint32 First;
+		uint32 Count;
+	};
+
+	/** A cell copied into memory. Empty slots hide the file's cell after it was invalidated. */
+	struct FSlot
+	{
+		uint8 Num = 0;
+		uint8 NextReplace = 0;
+		FCollisionDebuggerSurfel Surfels[MaxSurfelsPerCell];
+	};
+
+	/** A cell within trace length of the camera, see Splat. */
+	struct FSplatCell
+	{
+		uint64 Key;
+		const FCollisionDebuggerSurfel* Surfels;
+		int32 Num;
+	};
+
+	/** Inclusive pixel rectangle a surfel covers, MinY is INDEX_NONE if it covers none. */
+	struct FSplat
+	{
+		int32 MinX;
+		int32 MinY;
+		int32 MaxX;
+		int32 MaxY;
+		float Distance;
+		FLinearColor Color;
+
+		/** Entry of the primitive path table until resolved, then the view's primitive id. */
+		uint32 Id;
+	};
+
+	static uint64 GetCellKey(const FIntVector& Cell);
+	static FIntVector GetCell(uint64 Key);
+	static FVector GetCellMin(uint64 Key);
+
+	bool Load();
+	void Save();
+	void Unmap();
+
+	int32 LowerBoundFileCell(uint64 Key) const;
+	const FFileCell* FindFileCell(uint64 Key) const;
+	FSlot* FindOrAddSlot(uint64 Key);
+	void AddSurfel(const FVector& Position, const FVector3f& Normal, uint32 Primitive);
+	uint32 FindOrAddPrimitive(UPrimitiveComponent* Component);
+	UPrimitiveComponent* ResolvePrimitive(uint32 Primitive);
+
+	template<typename FunctionType>
+	void ForEachCell(FunctionType&& Function) const;
+
+	/** Only the cells of an inclusive box of cells. */
+	template<typename FunctionType>
+	void ForEachCellIn(const FIntVector& MinCell, const FIntVector& MaxCell, FunctionType&& Function) const;
+
+	/** World and test the open cache belongs to, a level that can't be cached leaves the cache closed. */
+	TWeakObjectPtr<UWorld> World;
+	uint32 TestHash = 0;
+
+	FString FilePath;
+	FString MapFilePath;
+	int32 PIEInstance = INDEX_NONE;
+	bool Dirty = false;
+
+	IMappedFileHandle* MappedFile = nullptr;
+	IMappedFileRegion* MappedRegion = nullptr;
+	const FFileCell* BaseCells = nullptr;
+	const FCollisionDebuggerSurfel* BaseSurfels = nullptr;
+	int32 NumBaseCells = 0;
+
+	TMap<uint64, int32> SlotIndices;
+	TArray<FSlot> Slots;
+
+	/** Primitives as soft object paths without PIE prefix, so they resolve in any session. */
+	TArray<FString> PrimitivePaths;
+	TMap<FString, uint32> PrimitiveIndices;
+	TMap<TWeakObjectPtr<const UPrimitiveComponent>, uint32> ComponentPrimitives;
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> ResolvedPrimitives;
+	TBitArray<> TriedToResolve;
+
+	/** Nearest splatted distance per pixel, kept between splats. */
+	TArray<float> SplatDepths;
+};
@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+
+/** What the scheduler knows about one tile of the debug view. */
+struct FCollisionDebuggerTileState
+{
+	FIntRect Rect;
+
+	/** Time the tile was last submitted, negative if it was never traced. */
+	double LastTraceTime = -1.0;
+
+	/** Moving average of how often a retrace changed the tile's content, 0..1. */
+	float ChangeRate = 1.f;
+
+	uint32 ContentHash = 0;
+	int32 NumInFlight = 0;
+
+	/** Something in the tile may have changed since it was last traced in full. */
+	bool Dirty = true;
+};
+
+struct FCollisionDebuggerSchedulerContext
+{
+	FIntPoint ViewSize = FIntPoint::ZeroValue;
+
+	/** Pixel the viewer is looking at, the screen center unless something better is known. */
+	FVector2D Focus = FVector2D::ZeroVector;
+
+	/** Seconds a traced tile waits before it is traced again, 0 unless the view is foveated. */
+	double PeripheryInterval = 0.0;
+
+	double Now = 0.0;
+};
+
+/** Scores a tile, the scheduler traces the highest scoring tile first and never one scoring below 0. */
+class ICollisionDebuggerTilePriority
+{
+public:
+	virtual ~ICollisionDebuggerTilePriority() {}
+	virtual double GetPriority(const FCollisionDebuggerTileState& Tile, const FCollisionDebuggerSchedulerContext& Context) const = 0;
+};
+
+/**
+ * Decides which tile of the debug view is traced next.
+ *
+ * The policy is picked with CollisionDebug.Scheduler.Policy from the registered priorities:
+ *  0: stalest tile first, which sweeps the view in raster order
+ *  1: tiles close to the focus point first
+ *  2: tiles whose content changes often first
+ *  3: foveated, focus first but no tile before its periphery interval ran out, active whenever
+ *     an interval is set
+ * Tiles start dirty and are flagged again when a change touches them, callers that only want to
+ * trace changed tiles pick among the dirty ones.
+ * Game thread only, except OnTileTraced which any trace worker may call.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerTileScheduler
+{
+public:
+	FCollisionDebuggerTileScheduler();
+
+	void Reset(FIntPoint InViewSize, int32 InTileSize);
+
+	/**
+	 * Rebuilds the tile grid at another size, keeping what is known about the pixels: a new tile
+	 * is dirty, stale and changing if any old tile it overlaps was. Only with no tile in flight.
+	 */
+	void SetTileSize(int32 InTileSize);
+	void RegisterPolicy(int32 PolicyIndex, TUniquePtr<ICollisionDebuggerTilePriority> Policy);
+
+	void SetFocus(const FVector2D& InFocus) { Context.Focus = InFocus; }
+
+	/** Seconds between two traces of a tile for a foveated view, 0 turns foveation off. */
+	void SetPeripheryInterval(double InInterval) { Context.PeripheryInterval = FMath::Max(InInterval, 0.0); }
+
+	/** Applies the results of traced tiles. Call once per tick before picking tiles. */
+	void Update();
+
+	/**
+	 * Highest priority tile that is not already being traced, optionally only among dirty tiles.
+	 * Tiles IsBlocked returns true for are left for a later pick, it is only called for tiles that are due.
+	 */
+	bool PickNextTile(FIntRect& OutRect, bool OnlyDirty = false) const;
+	bool PickNextTile(FIntRect& OutRect, bool OnlyDirty, TFunctionRef<bool(const FIntRect&)> IsBlocked) const;
+
+	/** Orders a list of tile origins, highest priority first. */
+	void SortByPriority(TArray<FIntPoint>& TileMins) const;
+
+	/** A full trace of the tile clears its dirty flag, a masked one leaves it. */
+	void OnTileSubmitted(const FIntRect& Rect, bool FullTrace = true);
+
+	/** Flags every tile overlapping a rectangle of the view. */
+	void MarkDirty(const FIntRect& PixelRect);
+	void MarkAllDirty();
+
+	/** Every tile is dirty but ranks as if it was just traced, for pixels filled in from a cache. */
+	void MarkAllEstimated();
+	void ClearDirty();
+	bool HasDirtyTiles() const;
+
+	/** Thread safe, the result is applied on the next Update. */
+	void OnTileTraced(const FIntRect& Rect, uint32 ContentHash);
+
+	/** A submitted tile was cancelled before it completed, it is flagged dirty again. */
+	void OnTileDropped(const FIntRect& Rect);
+
+	int32 GetTileSize() const { return TileSize; }
+	FCollisionDebuggerTileState* FindTile(const FIntPoint& Pixel);
+	const FCollisionDebuggerTileState* FindTile(const FIntPoint& Pixel) const;
+
+private:
+	const ICollisionDebuggerTilePriority& GetActivePolicy() const;
+
+	FCollisionDebuggerSchedulerContext Context;
+	int32 TileSize = 256;
+	FIntPoint NumTiles = FIntPoint::ZeroValue;
+	TArray<FCollisionDebuggerTileState> Tiles;
+
+	TArray<TUniquePtr<ICollisionDebuggerTilePriority>> Policies;
+	TQueue<TPair<FIntPoint, uint32>, EQueueMode::Mpsc> TracedTiles;
+};
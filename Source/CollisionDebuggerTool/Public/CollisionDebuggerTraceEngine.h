@@ -0,0 +1,231 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tasks/Task.h"
+#include "Containers/Queue.h"
+#include "WorldCollision.h"
+#include "CollisionDebuggerTypes.h"
+#include "CollisionDebuggerRayQuery.h"
+#include "CollisionDebuggerRayTable.h"
+#include "CollisionDebuggerHitBuffer.h"
+#include "CollisionDebuggerResponseBuffer.h"
+#include "CollisionDebuggerLayerBuffer.h"
+
+#include <atomic>
+
+/** What the trace engine did since its stats were last consumed. */
+struct FCollisionDebuggerTraceStats
+{
+	int64 NumRays = 0;
+	int64 NumHits = 0;
+	int32 NumTiles = 0;
+
+	/** Tiles that were cancelled before they completed. */
+	int32 NumDropped = 0;
+
+	/** Submit to completion time summed over the completed tiles. */
+	double TileSeconds = 0.0;
+
+	/** Worker time spent tracing the rays, summed over the workers. */
+	double TraceSeconds = 0.0;
+};
+
+/**
+ * Traces debug view tiles on the task workers.
+ *
+ * Every submitted tile is split into row work items that go into one queue shared by every
+ * engine, so all debug views trace on the same capped set of worker tasks. Several tiles are in
+ * flight at once and a single expensive tile is spread over all workers instead of holding one
+ * of them for the whole tile. CollisionDebug.TilesInFlight caps the tiles of all engines together.
+ * Every tile is stamped with the engine's epoch. Cancel starts a new one, workers skip the
+ * remaining rows of older tiles and drop them instead of completing them, so nothing traced for
+ * an old camera or old settings reaches the upload.
+ * With async traces on, tiles that only need the tested channel or profile's first hit against
+ * the physics scene skip the workers. Every ray of such a tile becomes an async line trace of the
+ * world's async trace phase, their results arrive through one shared delegate in the next world
+ * tick, and the tile completes there.
+ * Submit and Wait are game thread only, the tile completion callback runs on a worker or, for
+ * async tiles, on the game thread.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerTraceEngine
+{
+public:
+	typedef TFunction<void(const FCollisionDebuggerTile& Tile)> FOnTileComplete;
+
+	/** Length of every debug ray, hit times in the buffer are fractions of it. */
+	static constexpr double TraceLength = 100000.0;
+
+	~FCollisionDebuggerTraceEngine();
+
+	typedef TSharedPtr<const FCollisionDebuggerRayTable, ESPMode::ThreadSafe> FRayTablePtr;
+
+	/**
+	 * Hit buffer the rows are written into, and optionally the primitive every pixel hit.
+	 * Both must stay alive until the engine is idle.
+	 */
+	void SetTarget(UWorld* InWorld, FCollisionDebuggerHitBuffer* InPixels, FCollisionDebuggerPrimitiveIds* InPrimitiveIds = nullptr);
+
+	/**
+	 * Response layers traced along with the hits, tiles then trace every object type and resolve
+	 * their own channel or profile from the layers. Null traces the tested channel only.
+	 */
+	void SetResponseTarget(FCollisionDebuggerResponseBuffer* InResponses);
+
+	/**
+	 * X-ray layers traced along with the hits, every row then runs a multi trace. Completed tiles
+	 * carry the range of the pool they wrote. Null keeps the first hit only.
+	 */
+	void SetLayerTarget(FCollisionDebuggerLayerBuffer* InLayers);
+
+	/** CollisionDebug.AsyncTraces is on. */
+	static bool IsAsyncEnabled();
+
+	/**
+	 * Traces the tiles that allow it in the world's async trace phase instead of on the workers.
+	 * Their results only land in a world tick, so engines of a world that does not tick, like
+	 * the commandlets', leave it off.
+	 */
+	void SetUseAsyncTraces(bool InUseAsyncTraces) { UseAsyncTraces = InUseAsyncTraces; }
+
+	/** Camera ray directions for the current target, rebuilt only when the size changes. */
+	const FRayTablePtr& GetRayTable() const { return RayTable; }
+
+	/** Another tile fits in the pool, MaxTilesInFlight lowers the CollisionDebug.TilesInFlight cap further. */
+	static bool CanAcceptTile(int32 MaxTilesInFlight = MAX_int32);
+	void SubmitTile(const FCollisionDebuggerTile& Tile, FOnTileComplete OnComplete);
+
+	/** Tiles of this engine that have not completed yet. */
+	int32 GetNumTilesInFlight() const { return NumTilesInFlight.load(); }
+	bool IsIdle() const { return GetNumTilesInFlight() == 0; }
+
+	/**
+	 * Blocks until every tile of this engine has been traced or dropped, tiles of other engines are
+	 * not waited for. Cancel first to only wait for the rows being traced right now. Async tiles can
+	 * only complete in a world tick, the ones still waiting are dropped. Only for teardown and
+	 * commandlets, the tick lets cancelled tiles drain instead, see IsIdle.
+	 */
+	void Wait();
+
+	/**
+	 * Any thread. Tiles submitted so far stop at their next row and are dropped, their completion
+	 * callback never runs. Cheap, call it whenever in flight work went stale.
+	 */
+	void Cancel() { Epoch++; }
+
+	/** Game thread. Tiles dropped since the last call, only some of their rows were traced. */
+	void ConsumeDroppedTiles(TArray<FCollisionDebuggerTile>& OutTiles);
+
+	/** Any thread. Returns the stats gathered since the last call and starts over. */
+	FCollisionDebuggerTraceStats ConsumeStats();
+
+	/** Rows queued by all engines. */
+	static int32 GetNumQueuedRows();
+
+	static int32 GetMaxWorkers();
+	static int32 GetMaxTilesInFlight();
+
+private:
+	friend class FCollisionDebuggerTracePool;
+
+	struct FTileWork
+	{
+		FCollisionDebuggerTraceEngine* Engine = nullptr;
+		FCollisionDebuggerTile Tile;
+		TOptional<FCollisionDebuggerRayQuery> Query;
+		TOptional<FCollisionDebuggerResponseQuery> ResponseQuery;
+		FCollisionDebuggerResponseFilter ResponseFilter;
+		FRayTablePtr RayTable;
+		FOnTileComplete OnComplete;
+		std::atomic<int32> RowsRemaining{ 0 };
+		uint64 SubmitCycles = 0;
+
+		/** Range of the x-ray pool the rows allocated so far. */
+		std::atomic<int32> LayersBegin{ MAX_int32 };
+		std::atomic<int32> LayersEnd{ 0 };
+
+		/** Engine epoch at submit, the tile is stale once they differ. */
+		uint32 Epoch = 0;
+
+		/** Triggered once the tile completed or was dropped, what Wait blocks on. */
+		UE::Tasks::FTaskEvent Finished{ UE_SOURCE_LOCATION };
+
+		/** Pixel of every async ray of the tile, x | y << 16 relative to the tile, by ray number. */
+		TArray<uint32> AsyncPixels;
+		int32 AsyncRaysRemaining = 0;
+	};
+
+	struct FRowWorkItem
+	{
+		TSharedPtr<FTileWork, ESPMode::ThreadSafe> Work;
+		int32 Row = 0;
+	};
+
+	/** Per worker row buffers, reused so tracing a row does not allocate. */
+	struct FRowScratch
+	{
+		TArray<FVector3f> Directions;
+		TArray<FCollisionDebuggerRayHit> Hits;
+		TArray<int32> Columns;
+		TArray<FCollisionDebuggerResponseLayer> Layers;
+		TArray<uint8> NumLayers;
+		TArray<FCollisionDebuggerRayHit> XRayLayers;
+		TArray<uint8> NumXRayLayers;
+		int64 NumRays = 0;
+		int64 NumHits = 0;
+
+		/** X-ray pool range the last row allocated, empty if it allocated none. */
+		int32 XRayFirst = 0;
+		int32 XRayCount = 0;
+	};
+
+	/**
+	 * Async tiles waiting for their rays. Every queued trace holds a copy of the delegate, it only
+	 * keeps a weak reference so results that arrive after the engine is gone are ignored.
+	 */
+	struct FAsyncTraces
+	{
+		TMap<uint32, TSharedPtr<FTileWork, ESPMode::ThreadSafe>> Tiles;
+		FTraceDelegate Delegate;
+		uint32 NextTile = 0;
+	};
+
+	void TraceRow(const FTileWork& Work, int32 Row, FRowScratch& Scratch) const;
+
+	/** Copies a coarse sample over the square of its footprint. */
+	void FillFootprint(const FTileWork& Work, int32 Column, int32 Row) const;
+
+	/** Completes a tile whose every row or ray is done, or drops it if it went stale. */
+	void FinishTile(FTileWork& Work, bool Drop = false);
+
+	/** Game thread. Queues one async trace per ray, false if the tile has to go to the workers. */
+	bool SubmitAsyncTile(const TSharedPtr<FTileWork, ESPMode::ThreadSafe>& Work);
+	void OnAsyncTrace(const FTraceHandle& Handle, FTraceDatum& Datum);
+	void DropAsyncTiles();
+
+	UWorld* World = nullptr;
+	FCollisionDebuggerHitBuffer* Pixels = nullptr;
+	FCollisionDebuggerResponseBuffer* Responses = nullptr;
+	FCollisionDebuggerLayerBuffer* Layers = nullptr;
+	FCollisionDebuggerPrimitiveIds* PrimitiveIds = nullptr;
+	FIntPoint Size = FIntPoint::ZeroValue;
+	FRayTablePtr RayTable;
+
+	bool UseAsyncTraces = false;
+	TSharedPtr<FAsyncTraces> AsyncTraces;
+
+	std::atomic<int32> NumTilesInFlight{ 0 };
+	std::atomic<uint32> Epoch{ 0 };
+
+	/** Game thread. Finished events of the tiles submitted so far, pruned on submit. */
+	TArray<UE::Tasks::FTaskEvent> TileEvents;
+	TQueue<FCollisionDebuggerTile, EQueueMode::Mpsc> DroppedTiles;
+
+	std::atomic<int64> StatRays{ 0 };
+	std::atomic<int64> StatHits{ 0 };
+	std::atomic<int32> StatTiles{ 0 };
+	std::atomic<int32> StatDropped{ 0 };
+	std::atomic<uint64> StatTileCycles{ 0 };
+	std::atomic<uint64> StatTraceCycles{ 0 };
+};
@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+
+// Reflection
+#include "CollisionDebuggerTypes.generated.h"
+
+class FCollisionDebuggerMirrorScene;
+typedef TSharedPtr<const FCollisionDebuggerMirrorScene, ESPMode::ThreadSafe> FCollisionDebuggerMirrorScenePtr;
+
+USTRUCT(BlueprintType)
+struct FInputRenderSettings
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collision Debugger Subsystem")
+	bool IsChannelTest = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collision Debugger Subsystem")
+	bool TraceComplex = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collision Debugger Subsystem")
+	FString ChannelName = "";
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collision Debugger Subsystem")
+	FString ProfileName = "";
+};
+
+USTRUCT()
+struct FInputRenderSettingsInternal
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(Transient)
+	bool bIsChannelTest = true;
+
+	UPROPERTY(Transient)
+	TEnumAsByte<ECollisionChannel> ChannelToTest = ECollisionChannel::ECC_WorldStatic;
+
+	UPROPERTY(Transient)
+	FName ProfileNameToTest = TEXT("");
+
+	UPROPERTY(Transient)
+	bool TraceComplex = false;
+};
+
+/** What one pixel of the debug view hit, answered from the traced buffers. */
+USTRUCT(BlueprintType)
+struct FCollisionDebuggerHitInfo
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(BlueprintReadOnly, Category = "Collision Debugger Subsystem")
+	bool IsHit = false;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Collision Debugger Subsystem")
+	TObjectPtr<class AActor> Actor = nullptr;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Collision Debugger Subsystem")
+	TObjectPtr<class UPrimitiveComponent> Component = nullptr;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Collision Debugger Subsystem")
+	FName ProfileName;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Collision Debugger Subsystem")
+	FName ObjectType;
+
+	/** "Actor's Component, profile Name", ready for a tooltip. */
+	UPROPERTY(BlueprintReadOnly, Category = "Collision Debugger Subsystem")
+	FString Description;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Collision Debugger Subsystem")
+	FVector Location = FVector::ZeroVector;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Collision Debugger Subsystem")
+	FVector Normal = FVector::ZeroVector;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Collision Debugger Subsystem")
+	float Distance = 0.f;
+};
+
+/** One rectangle of the debug view, traced from a fixed camera with fixed settings. */
+struct FCollisionDebuggerTile
+{
+	FIntRect Rect;
+	FTransform Camera;
+	FInputRenderSettingsInternal Settings;
+
+	/**
+	 * One byte per pixel of Rect, only non zero pixels are traced. The value is the size of the
+	 * square the sample is splatted over, 1 for a single pixel. Null traces the whole tile.
+	 */
+	TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe> TraceMask;
+
+	/** Collision mirror the tile traces against, null traces the physics scene. */
+	FCollisionDebuggerMirrorScenePtr Mirror;
+
+	/** X-ray pool layers [LayersBegin, LayersEnd) the trace wrote, set once the tile completed. */
+	int32 LayersBegin = 0;
+	int32 LayersEnd = 0;
+
+	/** Focus window of a foveated view rather than a tile of the grid, the scheduler never sees it. */
+	bool Focus = false;
+};
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tasks/Task.h"
+#include "CollisionDebuggerHitBuffer.h"
+
+#include <atomic>
+
+class FTextureResource;
+class UTextureRenderTarget2D;
+
+/** Pixels an upload copies from, rows of Width pixels of BytesPerPixel each. */
+struct FCollisionDebuggerUploadSource
+{
+	const uint8* Data = nullptr;
+	int32 Width = 0;
+	int32 BytesPerPixel = 0;
+};
+
+/**
+ * Copies traced rectangles of the hit buffer, or of any other pixel array, to a render target.
+ *
+ * Every rectangle goes through two dependent tasks: an encode stage that snapshots it into a
+ * pooled staging block, and an upload stage that hands the block to the render thread. The
+ * render thread returns the block to the pool once it is uploaded, so later traces can write
+ * the hit buffer while older uploads are in flight and the steady state does not allocate.
+ * The snapshot only comes out whole if nothing writes the rectangle until OnStaged, callers
+ * keep overlapping traces back until then.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerUploadPipeline
+{
+public:
+	typedef TFunction<void(const FIntRect& Rect, uint32 ContentHash)> FOnStaged;
+
+	~FCollisionDebuggerUploadPipeline();
+
+	/** Game thread. The target and source must outlive every submitted rectangle. */
+	void SetTarget(UTextureRenderTarget2D* InTarget, const FCollisionDebuggerHitBuffer* InSource);
+	void SetTarget(UTextureRenderTarget2D* InTarget, const FCollisionDebuggerUploadSource& InSource);
+
+	/**
+	 * Any thread. OnStaged runs on the encode stage with the CRC of the staged pixels.
+	 * @return false if there was nothing to upload to, OnStaged is not called then
+	 */
+	bool Submit(const FIntRect& Rect, FOnStaged OnStaged = nullptr);
+
+	/** True while a stage may still read the source. */
+	bool IsEncoding() const { return NumEncoding.load() > 0; }
+
+	/** Game thread. Waits for every stage and for the render thread to consume the blocks. */
+	void Wait();
+
+	int32 GetNumPooledBlocks() const;
+
+private:
+	struct FStagingBlock
+	{
+		TArray<uint8> Data;
+		FIntRect Rect;
+		uint32 Pitch = 0;
+	};
+
+	FStagingBlock* AcquireBlock();
+	void ReleaseBlock(FStagingBlock* Block);
+	FCollisionDebuggerUploadSource GetSource() const;
+
+	FTextureResource* TargetResource = nullptr;
+	const FCollisionDebuggerHitBuffer* Source = nullptr;
+	FCollisionDebuggerUploadSource RawSource;
+
+	mutable FCriticalSection PoolLock;
+	TArray<TUniquePtr<FStagingBlock>> Blocks;
+	TArray<FStagingBlock*> FreeBlocks;
+
+	FCriticalSection TaskLock;
+	TArray<UE::Tasks::FTask> PendingUploads;
+	std::atomic<int32> NumEncoding{ 0 };
+};
@@ -0,0 +1,227 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionDebuggerTypes.h"
+#include "CollisionDebuggerTraceEngine.h"
+#include "CollisionDebuggerHitBuffer.h"
+#include "CollisionDebuggerUploadPipeline.h"
+#include "CollisionDebuggerReprojection.h"
+#include "CollisionDebuggerProgressive.h"
+#include "CollisionDebuggerTileScheduler.h"
+#include "CollisionDebuggerResponseBuffer.h"
+#include "CollisionDebuggerLayerBuffer.h"
+#include "CollisionDebuggerSurfelCache.h"
+#include "CollisionDebuggerPrimitiveIds.h"
+
+class APlayerController;
+class UTextureRenderTarget2D;
+class UUserWidget;
+class SWidget;
+
+/**
+ * One debug view: the camera it follows, the render target it draws into and everything that
+ * was traced for it.
+ *
+ * A view either follows a local player's camera or, without a player, the first player camera
+ * and then the active editor viewport. Views trace on the worker pool every trace engine shares,
+ * the subsystem decides which view submits the next tile. Game thread only.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerView
+{
+public:
+	FCollisionDebuggerView(UWorld* InWorld, APlayerController* InPlayer, UTextureRenderTarget2D* InRenderTarget, int32 InTileSize);
+	~FCollisionDebuggerView();
+
+	/** Null for the view that follows the editor viewport. */
+	APlayerController* GetPlayer() const { return Player.Get(); }
+	bool IsPlayerView() const { return FollowsPlayer; }
+	UTextureRenderTarget2D* GetRenderTarget() const { return RenderTarget; }
+
+	/** X-ray entry table and layer pool, see FCollisionDebuggerLayerBuffer. Null while x-ray is off. */
+	UTextureRenderTarget2D* GetXRayEntryTarget() const { return XRayEntryTarget; }
+	UTextureRenderTarget2D* GetXRayLayerTarget() const { return XRayLayerTarget; }
+
+	/** True once after the x-ray targets were created or dropped, the widget has to be bound again. */
+	bool ConsumeXRayTargetsChanged() { return XRayTargetsChanged ? (XRayTargetsChanged = false, true) : false; }
+	FIntPoint GetSize() const { return PixelColors.GetSize(); }
+	ECollisionDebuggerHitFormat GetHitFormat() const { return PixelColors.GetFormat(); }
+
+	/**
+	 * Applies traced tiles, follows the camera and flags tiles touched by world space changes.
+	 * False while the view has to wait for its tiles in flight before taking new ones.
+	 */
+	bool BeginTick(const FInputRenderSettingsInternal& Settings, TConstArrayView<FBox> DirtyBounds);
+
+	/**
+	 * Submits the next tile that needs a trace, only tiles flagged dirty with ChangedOnly.
+	 * @return number of rays the tile traces, 0 if there was nothing to submit
+	 */
+	int32 SubmitNextTile(const FInputRenderSettingsInternal& Settings, bool ChangedOnly);
+
+	bool IsIdle() const { return TraceEngine.IsIdle(); }
+	int32 GetNumTilesInFlight() const { return TraceEngine.GetNumTilesInFlight(); }
+
+	/** True until the view holds an up to date trace of every pixel. */
+	bool IsRefreshing() const;
+
+	void Wait();
+
+	/** Drops the tiles in flight at their next row, see FCollisionDebuggerTraceEngine::Cancel. */
+	void Cancel() { TraceEngine.Cancel(); }
+
+	void MarkAllDirty() { Scheduler.MarkAllDirty(); }
+
+	/** The view stops submitting until its tiles in flight have landed, then switches tile size. */
+	void SetTileSize(int32 InTileSize) { WantedTileSize = InTileSize; }
+	int32 GetTileSize() const { return TileSize; }
+
+	/**
+	 * Full traces take one sample per Stride by Stride square, see FCollisionDebuggerDynamicResolution.
+	 * A finer stride than before flags every tile for a retrace.
+	 */
+	void SetTraceStride(int32 InStride);
+	int32 GetTraceStride() const { return TraceStride; }
+
+	/** Stride full traces of grid tiles take, coarser in the periphery of a foveated view. */
+	int32 GetFullTraceStride() const;
+
+	/**
+	 * Window around the cursor or screen center retraced at full resolution every tick, empty
+	 * unless CollisionDebug.Foveated is on. Updated by BeginTick.
+	 */
+	FIntRect GetFocusRect() const { return FocusRect; }
+	bool IsFoveated() const { return !FocusRect.IsEmpty(); }
+
+	/** Collision mirror new tiles trace against, null for the physics scene. */
+	void SetSceneMirror(const FCollisionDebuggerMirrorScenePtr& InMirror) { Mirror = InMirror; }
+
+	/** Cache traced tiles are added to and a starting or jumping view is splatted from, null for none. */
+	void SetSurfelCache(FCollisionDebuggerSurfelCache* InCache) { SurfelCache = InCache; }
+
+	FCollisionDebuggerTraceStats ConsumeStats() { return TraceEngine.ConsumeStats(); }
+
+	/** The tested channel or profile changed, trace complex did not. */
+	void OnTestChanged();
+	void OnTraceComplexChanged();
+
+	bool GetHitAtPixel(int32 X, int32 Y, FCollisionDebuggerHitInfo& OutHit) const;
+	bool GetPrimitiveBoundsUV(const UPrimitiveComponent* Component, FVector2D& OutMin, FVector2D& OutMax) const;
+
+	void AddReferencedObjects(FReferenceCollector& Collector);
+
+	/** Widget showing the view, and its slate overlay in the editor. Owned by the subsystem. */
+	TObjectPtr<UUserWidget> Widget = nullptr;
+	TSharedPtr<SWidget> SlateWidget;
+
+private:
+	bool GetCameraTransform(FTransform& OutTransform) const;
+	FVector2D GetFocusPixel() const;
+	void UpdateFocus();
+	int32 SubmitFocusTile(const FInputRenderSettingsInternal& Settings);
+	bool ReprojectToCamera(const FTransform& trans);
+	void InvalidateBounds(TConstArrayView<FBox> DirtyBounds);
+	bool UpdateResponseMasks(const FInputRenderSettingsInternal& Settings);
+	bool UpdateXRayLayers();
+	void UpdateXRayTargets();
+	void InvalidateXRayLayers();
+	bool SplatFromCache(const FTransform& trans);
+	void AddTracedTilesToCache();
+	void QueueRetraceTiles();
+	void ApplyTileSize();
+	void CompactPrimitiveIds();
+	void RestoreDroppedTiles();
+
+	bool OverlapsInFlight(const FIntRect& Rect) const;
+
+	/** OverlapsInFlight for grid and retrace tiles, notes when it is the focus window that holds one back. */
+	bool IsHeldBack(const FIntRect& Rect);
+	void ApplyLandedRects();
+
+	void UploadTile(const FCollisionDebuggerTile& Tile);
+	void UploadRect(const FIntRect& Rect);
+
+	/** True while an upload may still read the hit buffer or the x-ray layers. */
+	bool IsEncoding() const;
+
+	TWeakObjectPtr<UWorld> World;
+	TWeakObjectPtr<APlayerController> Player;
+	bool FollowsPlayer = false;
+	TObjectPtr<UTextureRenderTarget2D> RenderTarget = nullptr;
+	int32 TileSize = 256;
+	int32 WantedTileSize = 256;
+	int32 TraceStride = 1;
+
+	/** Camera of the current tick, new tiles trace from it. */
+	FTransform Camera;
+	FCollisionDebuggerMirrorScenePtr Mirror;
+
+	FCollisionDebuggerHitBuffer PixelColors;
+	FCollisionDebuggerPrimitiveIds PrimitiveIds;
+	FCollisionDebuggerTraceEngine TraceEngine;
+	FCollisionDebuggerUploadPipeline UploadPipeline;
+	FCollisionDebuggerTileScheduler Scheduler;
+
+	/**
+	 * Rectangles of the tiles submitted and not yet dropped or snapshotted by every upload that
+	 * reads them. No two overlap, so a snapshot never catches another trace halfway.
+	 */
+	TArray<FIntRect> InFlightRects;
+
+	/** Rectangles whose uploads took their snapshots, filled by the encode stage. */
+	TQueue<FIntRect, EQueueMode::Mpsc> LandedRects;
+
+	// ------------ Reprojection --------------
+
+	/** Camera every valid pixel of PixelColors is relative to. */
+	FTransform BufferCamera;
+	bool HasBufferCamera = false;
+
+	/** One byte per pixel, set for pixels that hold no valid trace for BufferCamera. */
+	TArray<uint8> PixelNeedsTrace;
+
+	/** Tiles with flagged pixels in priority order, traced before the sweep or next progressive pass. */
+	TArray<FIntPoint> RetraceTiles;
+
+	FCollisionDebuggerReprojection Reprojection;
+	FCollisionDebuggerProgressiveRefinement Progressive;
+
+	// ------------ Response mask --------------
+
+	/** Per pixel block responses of everything hit, empty unless CollisionDebug.ResponseMask is on. */
+	FCollisionDebuggerResponseBuffer ResponseMasks;
+
+	/** The tested channel or profile changed and the view waits for in flight tiles to be resolved again. */
+	bool ResolvePending = false;
+
+	// ------------ X-ray --------------
+
+	/** Every layer the test blocks on per pixel, empty unless CollisionDebug.XRay is on. */
+	FCollisionDebuggerLayerBuffer XRayLayers;
+	TObjectPtr<UTextureRenderTarget2D> XRayEntryTarget = nullptr;
+	TObjectPtr<UTextureRenderTarget2D> XRayLayerTarget = nullptr;
+	FCollisionDebuggerUploadPipeline XRayEntryUpload;
+	FCollisionDebuggerUploadPipeline XRayLayerUpload;
+	bool XRayTargetsChanged = false;
+
+	// ------------ Surfel cache --------------
+
+	FCollisionDebuggerSurfelCache* SurfelCache = nullptr;
+
+	/** Tiles completed since the last tick, their hits go into the cache. */
+	TQueue<FCollisionDebuggerTile, EQueueMode::Mpsc> TracedTiles;
+
+	// ------------ Foveation --------------
+
+	FIntRect FocusRect;
+
+	/** Set every tick, the first tile the view submits is the focus window. */
+	bool FocusPending = false;
+
+	/** Focus tiles not yet uploaded or dropped, a slow trace skips the window rather than piling them up. */
+	std::atomic<int32> NumFocusTilesInFlight{ 0 };
+
+	/** A tile waited for the focus window, the window lets it go first next time so it can't starve. */
+	bool FocusHeldTileBack = false;
+};
@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionDebuggerHitBuffer.h"
+
+class UMaterialInterface;
+class UTexture;
+
+/**
+ * The material the debug view widgets draw with. M_ShowCollision samples one fixed render
+ * target, this one is built in code around CollisionDebuggerView.ush and every view binds its
+ * own render target to a dynamic instance of it through the parameters below.
+ *
+ * Building it needs editor only data, without it the widgets keep M_ShowCollision.
+ */
+class COLLISIONDEBUGGERTOOL_API FCollisionDebuggerViewMaterial
+{
+public:
+	/** Texture object parameter, the render target of the view. */
+	static const FName TextureParameter;
+
+	/** Scalar parameter, the ECollisionDebuggerHitFormat of the render target. */
+	static const FName HitFormatParameter;
+
+	/** X-ray parameters, see CollisionDebuggerXRay.ush. XRay is 1 while the view has layers, XRayLayer -1 blends them. */
+	static const FName XRayParameter;
+	static const FName XRayLayerParameter;
+	static const FName XRayEntriesParameter;
+	static const FName XRayLayersParameter;
+
+	/** Scalar parameter, the pixel stride the view is traced at, see CollisionDebuggerUpscale.ush. */
+	static const FName TraceStrideParameter;
+
+	/** Vector parameter, the full resolution window of a foveated view in UV, min in RG and max in BA, zero sized when off. */
+	static const FName FocusRectParameter;
+
+	static bool IsSupported();
+
+	/** CollisionDebug.HitFormat where the material can decode it, RGBA32f for M_ShowCollision. */
+	static ECollisionDebuggerHitFormat GetHitFormat();
+
+	/**
+	 * Builds the material and starts compiling it, null where that is not supported.
+	 * DefaultTexture fills the texture parameters until a view is bound.
+	 */
+	static UMaterialInterface* Create(UObject* Outer, UTexture* DefaultTexture);
+};
@@ -0,0 +1,26 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Modules/ModuleManager.h"
+#include "Interfaces/IPluginManager.h"
+#include "ShaderCore.h"
+
+/**
+ * Maps the plugin's Shaders directory to /Plugin/CollisionDebuggerTool, so the widget material
+ * can include the hit decode. Shader directory mappings have to exist before the shader compiler
+ * starts, which is why this is its own PostConfigInit module.
+ */
+class FCollisionDebuggerToolShadersModule : public IModuleInterface
+{
+public:
+	virtual void StartupModule() override
+	{
+		const FString ShaderDir = FPaths::Combine(IPluginManager::Get().FindPlugin(TEXT("CollisionDebuggerTool"))->GetBaseDir(), TEXT("Shaders"));
+		if (!AllShaderSourceDirectoryMappings().Contains(TEXT("/Plugin/CollisionDebuggerTool")))
+		{
+			AddShaderSourceDirectoryMapping(TEXT("/Plugin/CollisionDebuggerTool"), ShaderDir);
+		}
+	}
+};
+
+IMPLEMENT_MODULE(FCollisionDebuggerToolShadersModule, CollisionDebuggerToolShaders)